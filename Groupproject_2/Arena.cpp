@@ -0,0 +1,166 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+AllocationCounters allocationCounters;
+
+// Global operator new replacements, so that heap allocations can be counted per code path
+void* operator new(size_t size) {
+    allocationCounters.heapAllocations.fetch_add(1, memory_order_relaxed);
+    allocationCounters.heapBytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    allocationCounters.heapAllocations.fetch_add(1, memory_order_relaxed);
+    allocationCounters.heapBytes.fetch_add(size, memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+    free(p);
+}
+
+Arena::Arena(size_t initialChunkSize) : nextChunkSize(initialChunkSize) {
+}
+
+Arena::~Arena() {
+    release();
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (cursor == nullptr || aligned + bytes > limit) {
+        size_t chunkSize = max(nextChunkSize, bytes + alignment + sizeof(Chunk));
+        Chunk* chunk = static_cast<Chunk*>(::operator new(chunkSize));
+        chunk->next = head;
+        chunk->size = chunkSize;
+        head = chunk;
+        cursor = reinterpret_cast<char*>(chunk + 1);
+        limit = reinterpret_cast<char*>(chunk) + chunkSize;
+        aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        nextChunkSize = chunkSize * 2;
+        reserved += chunkSize;
+        ++chunks;
+        allocationCounters.arenaChunks.fetch_add(1, memory_order_relaxed);
+    }
+    cursor = aligned + bytes;
+    used += bytes;
+    allocationCounters.arenaAllocations.fetch_add(1, memory_order_relaxed);
+    allocationCounters.arenaBytes.fetch_add(bytes, memory_order_relaxed);
+    return aligned;
+}
+
+void Arena::release() {
+    // The next snapshot is usually about as big as this one, so let it start in a single chunk
+    if (reserved > 0) {
+        nextChunkSize = reserved;
+    }
+    while (head != nullptr) {
+        Chunk* next = head->next;
+        ::operator delete(head);
+        head = next;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+    reserved = 0;
+    chunks = 0;
+}
+
+FixedPool::FixedPool(size_t blockSize, size_t alignment, size_t blocksPerChunk)
+    : blocksPerChunk(blocksPerChunk) {
+    alignment = max(alignment, alignof(FreeBlock));
+    size = (max(blockSize, sizeof(FreeBlock)) + alignment - 1) / alignment * alignment;
+    chunkHeader = (sizeof(void*) + alignment - 1) / alignment * alignment;
+}
+
+FixedPool::~FixedPool() {
+    while (chunkList != nullptr) {
+        void* previous = *static_cast<void**>(chunkList);
+        ::operator delete(chunkList);
+        chunkList = previous;
+    }
+}
+
+void FixedPool::addChunk() {
+    char* chunk = static_cast<char*>(::operator new(chunkHeader + size * blocksPerChunk));
+    *reinterpret_cast<void**>(chunk) = chunkList;
+    chunkList = chunk;
+
+    // Thread the new blocks onto the free list, lowest address first
+    char* blocks = chunk + chunkHeader;
+    for (size_t i = blocksPerChunk; i > 0; --i) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(blocks + (i - 1) * size);
+        block->next = freeList;
+        freeList = block;
+    }
+    reserved += blocksPerChunk;
+    allocationCounters.poolChunks.fetch_add(1, memory_order_relaxed);
+    allocationCounters.poolBlocksReserved.fetch_add(blocksPerChunk, memory_order_relaxed);
+}
+
+void* FixedPool::allocate() {
+    lock_guard<std::mutex> lock(mutex);
+    if (freeList == nullptr) {
+        addChunk();
+    }
+    FreeBlock* block = freeList;
+    freeList = block->next;
+    ++inUse;
+    allocationCounters.poolAllocations.fetch_add(1, memory_order_relaxed);
+    allocationCounters.poolBlocksInUse.fetch_add(1, memory_order_relaxed);
+    return block;
+}
+
+void FixedPool::deallocate(void* p) {
+    lock_guard<std::mutex> lock(mutex);
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = freeList;
+    freeList = block;
+    --inUse;
+    allocationCounters.poolBlocksInUse.fetch_sub(1, memory_order_relaxed);
+}
+
+void printAllocationCounters(ostream& out) {
+    out << "Heap allocations: " << allocationCounters.heapAllocations.load() << " (" << allocationCounters.heapBytes.load() << " bytes)\n";
+    out << "Arena allocations: " << allocationCounters.arenaAllocations.load() << " (" << allocationCounters.arenaBytes.load()
+        << " bytes in " << allocationCounters.arenaChunks.load() << " chunks)\n";
+    out << "Pool allocations: " << allocationCounters.poolAllocations.load() << " (" << allocationCounters.poolChunks.load() << " chunks, "
+        << allocationCounters.poolBlocksInUse.load() << " of " << allocationCounters.poolBlocksReserved.load() << " blocks in use)\n";
+}
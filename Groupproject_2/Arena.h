@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+
+// Process-wide allocation counters. heapAllocations counts every call to the global operator new,
+// so a path can be checked for per-record mallocs by taking the difference before and after it.
+struct AllocationCounters {
+    std::atomic<uint64_t> heapAllocations{ 0 };
+    std::atomic<uint64_t> heapBytes{ 0 };
+    std::atomic<uint64_t> arenaAllocations{ 0 };
+    std::atomic<uint64_t> arenaBytes{ 0 };
+    std::atomic<uint64_t> arenaChunks{ 0 };
+    std::atomic<uint64_t> poolAllocations{ 0 };
+    std::atomic<uint64_t> poolChunks{ 0 };
+    std::atomic<uint64_t> poolBlocksInUse{ 0 };
+    std::atomic<uint64_t> poolBlocksReserved{ 0 };
+};
+
+extern AllocationCounters allocationCounters;
+
+// Bump allocator for one snapshot of a site's floors. Individual deallocations are ignored; everything
+// is freed in one shot by release(), which also sizes the next first chunk to fit the whole snapshot.
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t initialChunkSize = 64 * 1024);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Frees every chunk. Anything allocated from the arena must already be destroyed.
+    void release();
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+    size_t chunkCount() const { return chunks; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    Chunk* head = nullptr;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextChunkSize;
+    size_t used = 0;
+    size_t reserved = 0;
+    size_t chunks = 0;
+};
+
+// Fixed-size block pool with an intrusive free list. Freed blocks are threaded through their own
+// storage and handed out again before a new chunk is requested from the heap.
+class FixedPool {
+public:
+    FixedPool(size_t blockSize, size_t alignment, size_t blocksPerChunk = 1024);
+    ~FixedPool();
+
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+    void* allocate();
+    void deallocate(void* block);
+
+    size_t blockSize() const { return size; }
+    size_t blocksInUse() const { return inUse; }
+    size_t blocksReserved() const { return reserved; }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    void addChunk();
+
+    size_t size;
+    size_t blocksPerChunk;
+    FreeBlock* freeList = nullptr;
+    void* chunkList = nullptr; // Each chunk starts with a pointer to the previous one
+    size_t chunkHeader;
+    size_t inUse = 0;
+    size_t reserved = 0;
+    std::mutex mutex;
+};
+
+// Allocator that takes single-element allocations (container nodes) from a pool shared by every
+// container of the same element type. Larger requests go to the heap.
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(pool().allocate());
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        pool().deallocate(p);
+    }
+
+    static FixedPool& pool() {
+        // Never destroyed, so containers that outlive it during static destruction can still free their nodes
+        static FixedPool& instance = *new FixedPool(sizeof(T), alignof(T));
+        return instance;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+// Writes the allocation counters in a human readable form.
+void printAllocationCounters(std::ostream& out);
@@ -0,0 +1,633 @@
+#include "Benchmark.h"
+#include "Parking.h"
+#include "DataParser.h"
+#include "History.h"
+#include "MemoryReport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+// The loader as it was before the buffer parser: one istringstream per line and operator>> per field.
+static void loadWithStreams(const string& dataDir, map<string, vector<ParkingSpot>>& parkingLots, map<string, Customer>& customers) {
+    ifstream inFile(dataDir + "/parkingLots.dat");
+    string floor;
+    while (getline(inFile, floor)) {
+        vector<ParkingSpot> spots;
+        string line;
+        while (getline(inFile, line)) {
+            if (line == "#") break;
+            istringstream iss(line);
+            ParkingSpot spot;
+            iss >> spot.id >> spot.type >> spot.isOccupied >> spot.vehicleType
+                >> spot.plateNumber >> spot.startTime >> spot.entrance;
+            spots.push_back(spot);
+        }
+        parkingLots[floor] = spots;
+    }
+    inFile.close();
+
+    inFile.open(dataDir + "/customers.dat");
+    string plateNumber;
+    while (inFile >> plateNumber) {
+        Customer customer;
+        customer.plateNumber = plateNumber;
+        inFile >> customer.startTime >> customer.endTime >> customer.parkingType
+            >> customer.vehicleType >> customer.entrance >> customer.exit >> customer.payment;
+        customers[plateNumber] = customer;
+    }
+}
+
+// Loads the two files with the buffer parser, the same way loadGarage() does.
+static size_t loadWithParser(Garage& site) {
+    string buffer;
+    vector<ParseError> errors;
+    site.floors.clear();
+    site.arena.release();
+    readWholeFile(garageFilePath(site, "parkingLots.dat"), buffer);
+    parseParkingLots(buffer, site, errors);
+    readWholeFile(garageFilePath(site, "customers.dat"), buffer);
+    parseCustomers(buffer, site.customers, errors);
+    return errors.size();
+}
+
+int runParserBenchmark(int spotCount) {
+    if (spotCount <= 0) {
+        cerr << "Error: spot count must be positive\n";
+        return 1;
+    }
+    string dataDir = (filesystem::temp_directory_path() / "parking_parser_bench").string();
+    GeneratorOptions garage;
+    garage.spots = spotCount;
+    garage.floors = (spotCount + 4999) / 5000;
+    garage.occupancy = 1.0 / 3;
+    garage.idleCustomers = 0;
+    if (!generateGarageFiles(garage, dataDir)) {
+        return 1;
+    }
+    uintmax_t bytes = filesystem::file_size(dataDir + "/parkingLots.dat") + filesystem::file_size(dataDir + "/customers.dat");
+
+    const int rounds = 3;
+    double streamBest = 0, parserBest = 0;
+    uint64_t streamAllocations = 0, parserAllocations = 0;
+    size_t parseErrors = 0;
+
+    for (int round = 0; round < rounds; ++round) {
+        map<string, vector<ParkingSpot>> parkingLots;
+        map<string, Customer> customers;
+        uint64_t heapBefore = allocationCounters.heapAllocations.load();
+        auto start = chrono::steady_clock::now();
+        loadWithStreams(dataDir, parkingLots, customers);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        streamAllocations = allocationCounters.heapAllocations.load() - heapBefore;
+        if (round == 0 || seconds < streamBest) streamBest = seconds;
+    }
+
+    Garage site;
+    site.name = "Benchmark";
+    site.dataDir = dataDir;
+    for (int round = 0; round < rounds; ++round) {
+        site.customers.clear();
+        uint64_t heapBefore = allocationCounters.heapAllocations.load();
+        auto start = chrono::steady_clock::now();
+        parseErrors = loadWithParser(site);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        parserAllocations = allocationCounters.heapAllocations.load() - heapBefore;
+        if (round == 0 || seconds < parserBest) parserBest = seconds;
+    }
+
+    double megabytes = bytes / (1024.0 * 1024.0);
+    cout << "Parser benchmark: " << spotCount << " spots, " << site.customers.size() << " customers, "
+        << fixed << setprecision(1) << megabytes << " MB (best of " << rounds << ")\n";
+    cout << left << setw(14) << "loader" << setw(12) << "ms" << setw(12) << "MB/s" << "heap allocations\n";
+    cout << left << setw(14) << "istringstream" << setw(12) << streamBest * 1000 << setw(12) << megabytes / streamBest << streamAllocations << "\n";
+    cout << left << setw(14) << "buffer parser" << setw(12) << parserBest * 1000 << setw(12) << megabytes / parserBest << parserAllocations << "\n";
+    cout << "Speedup: " << setprecision(2) << streamBest / parserBest << "x\n";
+    if (parseErrors > 0) {
+        cerr << "Error: the parser reported " << parseErrors << " errors on generated data\n";
+        return 1;
+    }
+    filesystem::remove_all(dataDir);
+    return 0;
+}
+
+TimingStats summarizeTimings(vector<double> samples) {
+    TimingStats stats;
+    stats.count = samples.size();
+    if (samples.empty()) {
+        return stats;
+    }
+    sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    stats.mean = total / samples.size();
+    stats.p50 = samples[samples.size() / 2];
+    stats.p99 = samples[min(samples.size() - 1, samples.size() * 99 / 100)];
+    stats.max = samples.back();
+    return stats;
+}
+
+static double elapsedNs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+// Writes one result object of the JSON report.
+static void writeResult(ostream& out, bool& first, const string& operation, int spots, const TimingStats& stats) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "    {\"operation\": \"" << operation << "\", \"spots\": " << spots << ", \"iterations\": " << stats.count
+        << fixed << setprecision(1)
+        << ", \"mean_ns\": " << stats.mean << ", \"p50_ns\": " << stats.p50 << ", \"p99_ns\": " << stats.p99
+        << ", \"max_ns\": " << stats.max
+        << ", \"ops_per_sec\": " << (stats.mean > 0 ? 1e9 / stats.mean : 0) << "}";
+}
+
+int runBenchmarkSuite(const BenchmarkOptions& options) {
+    if (sharedParkingTypes().empty()) {
+        cerr << "Error: no parking types are defined\n";
+        return 1;
+    }
+    ostringstream results;
+    bool first = true;
+    mt19937 random(options.garage.seed);
+
+    for (int size : options.sizes) {
+        string dataDir = (filesystem::temp_directory_path() / ("parking_bench_" + to_string(size))).string();
+        GeneratorOptions garage = options.garage;
+        garage.spots = size;
+        garage.floors = max(1, (size + options.spotsPerFloor - 1) / options.spotsPerFloor);
+        cerr << "Generating " << size << " spots on " << garage.floors << " floors...\n";
+        if (!generateGarageFiles(garage, dataDir)) {
+            return 1;
+        }
+
+        Garage site;
+        site.name = "Benchmark";
+        site.dataDir = dataDir;
+
+        // loadData: full reload of the site's files
+        vector<double> samples;
+        for (int i = 0; i < options.repeats; ++i) {
+            auto start = chrono::steady_clock::now();
+            loadGarage(site);
+            samples.push_back(elapsedNs(start));
+        }
+        writeResult(results, first, "loadData", size, summarizeTimings(samples));
+
+        // saveData: rewrite of every file of the site
+        samples.clear();
+        for (int i = 0; i < options.repeats; ++i) {
+            auto start = chrono::steady_clock::now();
+            saveGarage(site);
+            samples.push_back(elapsedNs(start));
+        }
+        writeResult(results, first, "saveData", size, summarizeTimings(samples));
+
+        // searchAvailableSpots: one scan per vehicle type in turn
+        map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+        vector<string> vehicleTypes;
+        for (const auto& type : parkingTypes) {
+            vehicleTypes.insert(vehicleTypes.end(), type.second.begin(), type.second.end());
+        }
+        samples.clear();
+        int searches = max(1, min(options.operations, 100000000 / max(size, 1))); // Keep the largest sizes to a few seconds
+        for (int i = 0; i < searches; ++i) {
+            const string& vehicleType = vehicleTypes[i % vehicleTypes.size()];
+            auto start = chrono::steady_clock::now();
+            vector<SpotRef> available = findAvailableSpots(site, vehicleType);
+            samples.push_back(elapsedNs(start));
+        }
+        writeResult(results, first, "searchAvailableSpots", size, summarizeTimings(samples));
+
+        // rentParkingSpot: resolve the floor name and spot id, then rent
+        vector<pair<string, string>> freeSpots; // floor name, spot id
+        for (const auto& floor : site.floors) {
+            for (const auto& spot : floor.spots) {
+                if (!spot.isOccupied && !spot.type.empty()) {
+                    freeSpots.emplace_back(floor.name, spot.id);
+                }
+            }
+        }
+        shuffle(freeSpots.begin(), freeSpots.end(), random);
+        freeSpots.resize(min(freeSpots.size(), static_cast<size_t>(options.operations)));
+
+        samples.clear();
+        time_t now = time(nullptr);
+        vector<string> rentedPlates;
+        for (size_t i = 0; i < freeSpots.size(); ++i) {
+            string plate = "BENCH" + to_string(i);
+            auto start = chrono::steady_clock::now();
+            FloorHandle floor = site.floors.find(freeSpots[i].first);
+            SpotRef spot{ floor, findSpotIndex(site.floors[floor], freeSpots[i].second) };
+            const string& vehicleType = *parkingTypes.at(site.floors[floor].spots[spot.index].type).begin();
+            RentResult result = rentSpot(site, spot, plate, vehicleType, 1, now);
+            samples.push_back(elapsedNs(start));
+            if (result == RentResult::Rented) {
+                rentedPlates.push_back(plate);
+            }
+        }
+        writeResult(results, first, "rentParkingSpot", size, summarizeTimings(samples));
+
+        // settleParkingFee: charge the customers rented above and free their spots
+        samples.clear();
+        for (const string& plate : rentedPlates) {
+            double payment;
+            auto start = chrono::steady_clock::now();
+            settleCustomer(site, plate, 1, now + 3 * 3600, payment);
+            samples.push_back(elapsedNs(start));
+        }
+        writeResult(results, first, "settleParkingFee", size, summarizeTimings(samples));
+
+        // assignNearestSpot: the first call builds the entrance index, later ones update it
+        samples.clear();
+        rentedPlates.clear();
+        for (int i = 0; i < options.operations; ++i) {
+            string plate = "NEAR" + to_string(i);
+            SpotRef spot;
+            auto start = chrono::steady_clock::now();
+            RentResult result = rentNearestSpot(site, plate, vehicleTypes[i % vehicleTypes.size()], 1 + i % 2, now, spot);
+            samples.push_back(elapsedNs(start));
+            if (result == RentResult::Rented) {
+                rentedPlates.push_back(plate);
+            }
+        }
+        writeResult(results, first, "assignNearestSpot", size, summarizeTimings(samples));
+        for (const string& plate : rentedPlates) {
+            double payment;
+            settleCustomer(site, plate, 1, now + 3600, payment);
+        }
+
+        // searchPlatePrefix and searchPlateFuzzy: the first three characters of a known plate, and
+        // the plate with one character changed
+        vector<string> knownPlates;
+        for (const auto& customer : site.customers) {
+            knownPlates.push_back(customer.first);
+        }
+        if (!knownPlates.empty()) {
+            shuffle(knownPlates.begin(), knownPlates.end(), random);
+            knownPlates.resize(min(knownPlates.size(), static_cast<size_t>(options.operations)));
+            samples.clear();
+            for (const string& plate : knownPlates) {
+                vector<string> matches;
+                auto start = chrono::steady_clock::now();
+                site.plates.withPrefix(plate.substr(0, 3), 20, matches);
+                samples.push_back(elapsedNs(start));
+            }
+            writeResult(results, first, "searchPlatePrefix", size, summarizeTimings(samples));
+
+            samples.clear();
+            for (const string& plate : knownPlates) {
+                string misread = plate;
+                size_t position = random() % misread.size();
+                misread[position] = misread[position] == '8' ? 'B' : '8';
+                auto start = chrono::steady_clock::now();
+                vector<string> matches = site.plates.similar(misread, 20);
+                samples.push_back(elapsedNs(start));
+            }
+            writeResult(results, first, "searchPlateFuzzy", size, summarizeTimings(samples));
+        }
+
+        filesystem::remove_all(dataDir);
+    }
+
+    ostringstream report;
+    report << "{\n  \"benchmark\": \"parking\",\n  \"timestamp\": " << time(nullptr)
+        << ",\n  \"occupancy\": " << options.garage.occupancy << ",\n  \"spots_per_floor\": " << options.spotsPerFloor
+        << ",\n  \"results\": [" << results.str() << "\n  ]\n}\n";
+
+    if (options.outputPath.empty()) {
+        cout << report.str();
+    }
+    else {
+        ofstream outFile(options.outputPath);
+        if (!outFile.is_open()) {
+            cerr << "Error: Unable to open " << options.outputPath << " for writing\n";
+            return 1;
+        }
+        outFile << report.str();
+        cerr << "Results written to " << options.outputPath << "\n";
+    }
+    return 0;
+}
+
+int runReplayBenchmark(int spotCount, int events, int interval) {
+    string dataDir = (filesystem::temp_directory_path() / "parking_replay_bench").string();
+    filesystem::remove_all(dataDir);
+    GeneratorOptions garage;
+    garage.spots = spotCount;
+    garage.floors = max(1, spotCount / 2500);
+    if (!generateGarageFiles(garage, dataDir)) {
+        return 1;
+    }
+
+    // Record the events: rents of random free spots and settlements of random parked cars, a few
+    // seconds apart, through the same engine calls the menus use
+    Garage site;
+    site.name = "ReplayBenchmark";
+    site.dataDir = dataDir;
+    loadGarage(site);
+    site.events.checkpointInterval = static_cast<uint64_t>(max(1, interval));
+    time_t start = time(nullptr);
+    time_t now = start;
+    if (!site.events.open(site, now)) {
+        return 1;
+    }
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    vector<SpotRef> freeSpots;
+    vector<pair<string, SpotRef>> parked; // Plate and the spot it occupies
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        const FloorSpots& spots = site.floors[floor].spots;
+        for (size_t i = 0; i < spots.size(); ++i) {
+            if (spots[i].isOccupied) {
+                parked.emplace_back(spots[i].plateNumber, SpotRef{ floor, static_cast<int>(i) });
+            }
+            else if (!spots[i].type.empty()) {
+                freeSpots.push_back(SpotRef{ floor, static_cast<int>(i) });
+            }
+        }
+    }
+    mt19937 random(garage.seed);
+    cerr << "Recording " << events << " events on " << spotCount << " spots...\n";
+    for (int i = 0; i < events; ++i) {
+        now += 1 + random() % 10;
+        bool rent = !freeSpots.empty() && (parked.empty() || random() % 2 == 0);
+        if (rent) {
+            size_t pick = random() % freeSpots.size();
+            SpotRef spot = freeSpots[pick];
+            freeSpots[pick] = freeSpots.back();
+            freeSpots.pop_back();
+            const string& vehicleType = *parkingTypes.at(site.floors[spot.floor].spots[spot.index].type).begin();
+            string plate = "R" + to_string(i);
+            rentSpot(site, spot, plate, vehicleType, 1, now);
+            parked.emplace_back(plate, spot);
+        }
+        else {
+            size_t pick = random() % parked.size();
+            string plate = parked[pick].first;
+            freeSpots.push_back(parked[pick].second);
+            parked[pick] = parked.back();
+            parked.pop_back();
+            double payment;
+            if (!settleCustomer(site, plate, 1, now, payment)) {
+                releaseSpot(site, plate, now);
+            }
+        }
+    }
+    site.events.close();
+    time_t end = now;
+
+    // Fast-forward: the whole log from the first checkpoint, through every later one
+    double best = 0;
+    ReplayResult full;
+    for (int round = 0; round < 3; ++round) {
+        Garage state;
+        auto begin = chrono::steady_clock::now();
+        full = reconstructSite(dataDir, end, state, false);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (round == 0 || seconds < best) best = seconds;
+        if (!full.restored) {
+            cerr << "Error: " << full.error << "\n";
+            return 1;
+        }
+    }
+
+    // Point-in-time queries: the nearest checkpoint and at most one interval of events each
+    vector<double> samples;
+    size_t mostReplayed = 0;
+    for (int i = 0; i < 50; ++i) {
+        time_t asOf = start + static_cast<time_t>(random() % static_cast<unsigned long>(end - start + 1));
+        Garage state;
+        auto begin = chrono::steady_clock::now();
+        ReplayResult result = reconstructSite(dataDir, asOf, state);
+        samples.push_back(elapsedNs(begin));
+        mostReplayed = max(mostReplayed, result.eventsReplayed);
+    }
+    TimingStats queries = summarizeTimings(samples);
+
+    cout << "Replay benchmark: " << spotCount << " spots, " << full.eventsReplayed << " events, checkpoint every "
+        << interval << " events (best of 3)\n";
+    cout << fixed << setprecision(1);
+    cout << "Full replay: " << best * 1000 << " ms, " << setprecision(0) << full.eventsReplayed / best << " events/s\n";
+    cout << setprecision(2) << "State as of a random time: p50 " << queries.p50 / 1e6 << " ms, p99 " << queries.p99 / 1e6
+        << " ms, at most " << mostReplayed << " events replayed\n";
+    filesystem::remove_all(dataDir);
+    return 0;
+}
+
+int runKioskBenchmark(const KioskBenchmarkOptions& options) {
+    if (options.spots <= 0 || options.logins <= 0) {
+        cerr << "Error: spot and login counts must be positive\n";
+        return 1;
+    }
+    string dataDir = (filesystem::temp_directory_path() / "parking_kiosk_bench").string();
+    filesystem::remove_all(dataDir);
+    GeneratorOptions garage;
+    garage.spots = options.spots;
+    garage.floors = max(1, options.spots / 2500);
+    garage.occupancy = 0;
+    garage.idleCustomers = 0;
+    garage.seed = options.seed;
+    if (!generateGarageFiles(garage, dataDir)) {
+        return 1;
+    }
+    Garage site;
+    site.name = "KioskBenchmark";
+    site.dataDir = dataDir;
+    loadGarage(site);
+
+    // What saving every login would have kept: a customer record for each plate that never rented
+    Garage placeholders;
+    placeholders.name = "Placeholders";
+
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    vector<string> vehicleTypes;
+    for (const auto& type : parkingTypes) {
+        vehicleTypes.insert(vehicleTypes.end(), type.second.begin(), type.second.end());
+    }
+    priority_queue<pair<time_t, string>, vector<pair<time_t, string>>, greater<pair<time_t, string>>> departures;
+    vector<string> recentPlates; // Plates typed without renting lately, for drivers who come back to the kiosk
+    size_t recentNext = 0;
+    mt19937 random(options.seed);
+    time_t now = time(nullptr);
+    int rentals = 0, refused = 0;
+
+    ostringstream samples;
+    int reportEvery = max(1, options.logins / 10);
+    for (int i = 1; i <= options.logins; ++i) {
+        now += 1 + random() % 10;
+        while (!departures.empty() && departures.top().first <= now) {
+            double payment;
+            settleCustomer(site, departures.top().second, 1, departures.top().first, payment);
+            departures.pop();
+        }
+
+        int roll = static_cast<int>(random() % 100);
+        string plate;
+        if (roll >= options.rentPercent && roll < options.rentPercent + options.returnPercent && !recentPlates.empty()) {
+            plate = recentPlates[random() % recentPlates.size()];
+        }
+        else {
+            plate = (roll < options.rentPercent ? "K" : "V") + to_string(i);
+        }
+        site.visitors.touch(plate, now); // What customerLogin() does for a plate that is not a customer
+        bool rented = false;
+        if (roll < options.rentPercent) {
+            SpotRef spot;
+            const string& vehicleType = vehicleTypes[random() % vehicleTypes.size()];
+            rented = rentNearestSpot(site, plate, vehicleType, 1, now, spot) == RentResult::Rented;
+            if (rented) {
+                departures.emplace(now + 1800 + static_cast<time_t>(random() % (4 * 3600)), plate);
+                ++rentals;
+            }
+            else {
+                ++refused;
+            }
+        }
+        if (!rented) {
+            if (placeholders.customers.find(plate) == placeholders.customers.end()) {
+                placeholders.customers[plate].plateNumber = plate;
+            }
+            if (recentPlates.size() < 64) {
+                recentPlates.push_back(plate);
+            }
+            else {
+                recentPlates[recentNext++ % recentPlates.size()] = plate;
+            }
+        }
+
+        if (i % reportEvery == 0 || i == options.logins) {
+            MemoryReport memory = measureMemory(site);
+            MemoryReport legacyMemory = measureMemory(placeholders);
+            ostringstream customerFile, placeholderFile;
+            writeCustomers(customerFile, site.customers);
+            writeCustomers(placeholderFile, placeholders.customers);
+            size_t customerFileBytes = customerFile.str().size();
+            samples << (samples.tellp() > 0 ? "," : "") << "\n    {\"logins\": " << i
+                << ", \"customers\": " << site.customers.size() << ", \"visitors\": " << site.visitors.size()
+                << ", \"visitors_evicted\": " << site.visitors.evicted()
+                << ", \"customer_bytes\": " << memory.customerTable().totalBytes()
+                << ", \"visitor_bytes\": " << memory.visitorTable().totalBytes()
+                << ", \"customers_dat_bytes\": " << customerFileBytes
+                << ", \"saved_every_login_customers\": " << site.customers.size() + placeholders.customers.size()
+                << ", \"saved_every_login_customer_bytes\": " << memory.customerTable().totalBytes() + legacyMemory.customerTable().totalBytes()
+                << ", \"saved_every_login_customers_dat_bytes\": " << customerFileBytes + placeholderFile.str().size() << "}";
+        }
+    }
+
+    cout << "{\n  \"benchmark\": \"kiosk\",\n  \"spots\": " << options.spots << ",\n  \"logins\": " << options.logins
+        << ",\n  \"rent_percent\": " << options.rentPercent << ",\n  \"return_percent\": " << options.returnPercent
+        << ",\n  \"rentals\": " << rentals << ",\n  \"rentals_refused\": " << refused
+        << ",\n  \"visitor_capacity\": " << site.visitors.capacity << ",\n  \"visitor_idle_seconds\": " << site.visitors.idleSeconds
+        << ",\n  \"samples\": [" << samples.str() << "\n  ]\n}\n";
+    filesystem::remove_all(dataDir);
+    return 0;
+}
+
+// Milliseconds to load the site, and its floors' memory once loaded.
+static double timedLoad(Garage& site, size_t& floorBytes) {
+    auto start = chrono::steady_clock::now();
+    loadGarage(site);
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    floorBytes = measureMemory(site).floors().totalBytes();
+    return milliseconds;
+}
+
+int runFloorBenchmark(const FloorBenchmarkOptions& options) {
+    if (options.spots <= 0 || options.floors <= 0 || options.transactions < 0 || options.budgetMegabytes < 0) {
+        cerr << "Error: spot and floor counts must be positive\n";
+        return 1;
+    }
+    string dataDir = (filesystem::temp_directory_path() / "parking_floor_bench").string();
+    filesystem::remove_all(dataDir);
+    GeneratorOptions garage;
+    garage.spots = options.spots;
+    garage.floors = options.floors;
+    garage.occupancy = options.occupancy;
+    garage.idleCustomers = 0;
+    garage.seed = options.seed;
+    if (!generateGarageFiles(garage, dataDir)) {
+        return 1;
+    }
+
+    size_t eagerBytes, indexedBytes, scannedBytes;
+    double eagerMs, indexedMs, scannedMs;
+    {
+        Garage site;
+        site.name = "FloorBenchmark";
+        site.dataDir = dataDir;
+        eagerMs = timedLoad(site, eagerBytes);
+        saveGarage(site); // Writes floorIndex.dat
+    }
+    ofstream(dataDir + "/floorBudget.dat") << options.budgetMegabytes << "\n";
+    {
+        // Without floorIndex.dat the floors are listed by scanning parkingLots.dat
+        Garage site;
+        site.name = "FloorBenchmark";
+        site.dataDir = dataDir;
+        filesystem::rename(dataDir + "/floorIndex.dat", dataDir + "/floorIndex.dat.bench");
+        scannedMs = timedLoad(site, scannedBytes);
+        filesystem::rename(dataDir + "/floorIndex.dat.bench", dataDir + "/floorIndex.dat");
+    }
+
+    Garage site;
+    site.name = "FloorBenchmark";
+    site.dataDir = dataDir;
+    indexedMs = timedLoad(site, indexedBytes);
+
+    // Cars arrive at one gate, so the floors nearest it are the working set
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    vector<string> vehicleTypes;
+    for (const auto& type : parkingTypes) {
+        vehicleTypes.insert(vehicleTypes.end(), type.second.begin(), type.second.end());
+    }
+    mt19937 random(options.seed);
+    queue<string> parked;
+    vector<double> rentSamples, settleSamples;
+    time_t now = time(nullptr);
+    for (int i = 0; i < options.transactions; ++i) {
+        now += 60;
+        string plate = "F" + to_string(i);
+        SpotRef spot;
+        auto start = chrono::steady_clock::now();
+        if (rentNearestSpot(site, plate, vehicleTypes[random() % vehicleTypes.size()], 1, now, spot) == RentResult::Rented) {
+            saveGarage(site);
+            rentSamples.push_back(static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+            parked.push(plate);
+        }
+        if (parked.size() > 16) {
+            double payment;
+            start = chrono::steady_clock::now();
+            settleCustomer(site, parked.front(), 1, now, payment);
+            saveGarage(site);
+            settleSamples.push_back(static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+            parked.pop();
+        }
+    }
+    MemoryReport memory = measureMemory(site);
+    TimingStats rent = summarizeTimings(rentSamples);
+    TimingStats settle = summarizeTimings(settleSamples);
+
+    cout << fixed << setprecision(3);
+    cout << "{\n  \"benchmark\": \"floors\",\n  \"spots\": " << options.spots << ",\n  \"floors\": " << options.floors
+        << ",\n  \"budget_bytes\": " << site.floors.budget()
+        << ",\n  \"eager_load_ms\": " << eagerMs << ",\n  \"eager_floor_bytes\": " << eagerBytes
+        << ",\n  \"indexed_load_ms\": " << indexedMs << ",\n  \"indexed_floor_bytes\": " << indexedBytes
+        << ",\n  \"scanned_load_ms\": " << scannedMs << ",\n  \"scanned_floor_bytes\": " << scannedBytes
+        << ",\n  \"rentals\": " << rent.count << ",\n  \"settlements\": " << settle.count
+        << ",\n  \"rent_and_save_ms\": {\"p50\": " << rent.p50 / 1e6 << ", \"p99\": " << rent.p99 / 1e6 << ", \"max\": " << rent.max / 1e6 << "}"
+        << ",\n  \"settle_and_save_ms\": {\"p50\": " << settle.p50 / 1e6 << ", \"p99\": " << settle.p99 / 1e6 << ", \"max\": " << settle.max / 1e6 << "}"
+        << ",\n  \"floors_loaded\": " << memory.floorsLoaded << ",\n  \"floor_loads\": " << memory.floorLoads
+        << ",\n  \"floor_unloads\": " << memory.floorUnloads << ",\n  \"floor_bytes\": " << memory.floors().totalBytes() << "\n}\n";
+    filesystem::remove_all(dataDir);
+    return 0;
+}
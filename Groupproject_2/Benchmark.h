@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "GarageGenerator.h"
+
+// Summary of per-operation timings, in nanoseconds.
+struct TimingStats {
+    size_t count = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+TimingStats summarizeTimings(std::vector<double> samples);
+
+// Settings for the benchmark suite.
+struct BenchmarkOptions {
+    std::vector<int> sizes = { 1000, 10000, 100000, 1000000 }; // Garage sizes in spots
+    int spotsPerFloor = 2500;
+    int operations = 1000; // Rent, settle and search operations timed per size
+    int repeats = 3; // Loads and saves timed per size
+    GeneratorOptions garage; // Type mix, occupancy and seed; floors and spots are set per size
+    std::string outputPath; // JSON report file; empty means standard output
+};
+
+// Generates a garage of every requested size and times loadGarage, saveGarage, findAvailableSpots,
+// renting by floor and spot id, and settlement on it. Writes the results as JSON.
+// Returns the process exit code.
+int runBenchmarkSuite(const BenchmarkOptions& options);
+
+// Generates parking lot and customer files with the given number of spots and compares the time
+// taken by the istringstream loader against the buffer parser. Returns the process exit code.
+int runParserBenchmark(int spotCount);
+
+// Generates a site, records the given number of rents and settlements against it with a
+// checkpoint every interval events, and times a replay of the whole log and queries for random
+// times. Returns the process exit code.
+int runReplayBenchmark(int spotCount, int events, int interval);
+
+// Settings for the kiosk benchmark.
+struct KioskBenchmarkOptions {
+    int spots = 2000;
+    int logins = 200000;
+    int rentPercent = 30; // Logins that go on to rent a spot; the rest drive away or mistype the plate
+    int returnPercent = 20; // Logins without a rental that repeat a plate typed in the last few minutes
+    unsigned int seed = 1;
+};
+
+// Runs logins a few seconds apart against a generated site, renting and settling for some of them,
+// and reports at every tenth of the run how many customers and visitors are kept, their memory and
+// the size of customers.dat, next to what saving every login as a customer would have kept.
+// Returns the process exit code.
+int runKioskBenchmark(const KioskBenchmarkOptions& options);
+
+// Settings for the on-demand floor benchmark.
+struct FloorBenchmarkOptions {
+    int spots = 200000;
+    int floors = 200;
+    double budgetMegabytes = 1; // floorBudget.dat of the on-demand load
+    int transactions = 200;
+    double occupancy = 0.6;
+    unsigned int seed = 1;
+};
+
+// Loads a generated site with every floor and again with a floor budget, from floorIndex.dat and by
+// scanning parkingLots.dat, then rents and settles at the gate with a save after each, and reports
+// the load times, the floors' memory and how many floors were loaded. Returns the process exit code.
+int runFloorBenchmark(const FloorBenchmarkOptions& options);
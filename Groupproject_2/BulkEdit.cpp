@@ -0,0 +1,260 @@
+#include "BulkEdit.h"
+#include "Parking.h"
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+static const int maximumRangeSpots = 1000000;
+static const size_t maximumErrors = 20; // Errors listed in the summary; the rest are counted
+
+bool parseSpotId(const string& id, string& floor, int& number) {
+    size_t separator = id.rfind('_');
+    if (separator == string::npos || separator == 0 ||
+        !parseNumber(string_view(id).substr(separator + 1), number)) {
+        return false;
+    }
+    floor = id.substr(0, separator);
+    return true;
+}
+
+bool parseSpotRanges(const string& text, vector<SpotRange>& ranges) {
+    stringstream ss(text);
+    string part;
+    while (getline(ss, part, ',')) {
+        size_t dash = part.find('-', part.find('_'));
+        SpotRange range;
+        string lastFloor;
+        if (!parseSpotId(part.substr(0, dash), range.floor, range.first)) {
+            return false;
+        }
+        range.last = range.first;
+        if (dash != string::npos && (!parseSpotId(part.substr(dash + 1), lastFloor, range.last) || lastFloor != range.floor)) {
+            return false;
+        }
+        ranges.push_back(range);
+    }
+    return !ranges.empty();
+}
+
+// A spot the edit applies to, found while validating.
+struct PlannedSpot {
+    FloorHandle floor;
+    int index;
+};
+
+BulkEditSummary applyBulkEdit(Garage& site, const BulkEdit& edit) {
+    static const Operation operations[] = { Operation::ModifySpot, Operation::DeleteSpot, Operation::ClearOccupation, Operation::AddSpot };
+    OperationTimer timer(operations[static_cast<int>(edit.action)]);
+    TraceSpan span("applyBulkEdit", site.name);
+    BulkEditSummary summary;
+    size_t errorCount = 0;
+    auto fail = [&](const string& message) {
+        if (summary.errors.size() < maximumErrors) {
+            summary.errors.push_back(message);
+        }
+        ++errorCount;
+    };
+
+    bool newType = edit.action == BulkAction::Retype || edit.action == BulkAction::Add;
+    if (newType && ConfigView(site)->parkingTypes.count(edit.parkingType) == 0) {
+        fail("Invalid parking type " + edit.parkingType);
+    }
+    if (edit.ranges.empty()) {
+        fail("No spots given");
+    }
+
+    // Ranges of each floor, sorted and merged
+    map<string, vector<pair<int, int>>> floorRanges;
+    for (const auto& range : edit.ranges) {
+        string name = range.floor + "_" + to_string(range.first) + " to " + range.floor + "_" + to_string(range.last);
+        if (range.first < 1 || range.last < range.first) {
+            fail("Invalid range " + name);
+        }
+        else if (range.last - range.first >= maximumRangeSpots) {
+            fail("Range " + name + " has more than " + to_string(maximumRangeSpots) + " spots");
+        }
+        else if (edit.action != BulkAction::Add && site.floors.find(range.floor) == invalidFloor) {
+            fail("Invalid floor " + range.floor);
+        }
+        else {
+            floorRanges[range.floor].emplace_back(range.first, range.last);
+        }
+    }
+    for (auto& floor : floorRanges) {
+        vector<pair<int, int>>& ranges = floor.second;
+        sort(ranges.begin(), ranges.end());
+        size_t merged = 0;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].first <= ranges[merged].second + 1) {
+                ranges[merged].second = max(ranges[merged].second, ranges[i].second);
+            }
+            else {
+                ranges[++merged] = ranges[i];
+            }
+        }
+        ranges.resize(merged + 1);
+    }
+
+    // Validate: find every spot in the ranges with one pass over each affected floor
+    vector<PlannedSpot> planned;
+    vector<pair<string, vector<int>>> appended; // Add: floor and the spot numbers it does not have yet
+    for (const auto& floor : floorRanges) {
+        const vector<pair<int, int>>& ranges = floor.second;
+        vector<int> matched(ranges.size(), 0);
+        vector<int> existing; // Add: spot numbers in the ranges that already exist
+        FloorHandle handle = site.floors.find(floor.first);
+        if (handle != invalidFloor) {
+            const FloorSpots& spots = site.floors[handle].spots;
+            for (size_t i = 0; i < spots.size(); ++i) {
+                string spotFloor;
+                int number;
+                if (!parseSpotId(spots[i].id, spotFloor, number)) continue;
+                auto range = upper_bound(ranges.begin(), ranges.end(), make_pair(number, numeric_limits<int>::max()));
+                if (range == ranges.begin() || number > prev(range)->second) continue;
+                ++matched[prev(range) - ranges.begin()];
+
+                const ParkingSpot& spot = spots[i];
+                bool deleted = spot.type.empty();
+                if (edit.action == BulkAction::Add) {
+                    if (!deleted) {
+                        fail("Spot " + spot.id + " already exists");
+                        continue;
+                    }
+                    existing.push_back(number);
+                }
+                else if (spot.isOccupied && !deleted && edit.action != BulkAction::Clear) {
+                    fail("Spot " + spot.id + " is occupied by " + spot.plateNumber);
+                    continue;
+                }
+                planned.push_back(PlannedSpot{ handle, static_cast<int>(i) });
+            }
+        }
+
+        if (edit.action == BulkAction::Add) {
+            sort(existing.begin(), existing.end());
+            vector<int> missing;
+            for (const auto& range : ranges) {
+                for (int number = range.first; number <= range.second; ++number) {
+                    if (!binary_search(existing.begin(), existing.end(), number)) {
+                        missing.push_back(number);
+                    }
+                }
+            }
+            appended.emplace_back(floor.first, move(missing));
+            continue;
+        }
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            int size = ranges[r].second - ranges[r].first + 1;
+            if (matched[r] < size) {
+                fail("Only " + to_string(matched[r]) + " of the " + to_string(size) + " spots " + floor.first + "_" +
+                    to_string(ranges[r].first) + " to " + floor.first + "_" + to_string(ranges[r].second) + " exist");
+            }
+        }
+    }
+    if (errorCount > summary.errors.size()) {
+        summary.errors.push_back("... and " + to_string(errorCount - summary.errors.size()) + " more");
+    }
+    if (errorCount > 0) {
+        return summary;
+    }
+
+    // Apply
+    for (const PlannedSpot& plannedSpot : planned) {
+        ParkingSpot& spot = site.floors[plannedSpot.floor].spots[plannedSpot.index];
+        bool changed = true;
+        switch (edit.action) {
+        case BulkAction::Retype:
+        case BulkAction::Add:
+            changed = spot.type != edit.parkingType || spot.isOccupied;
+            spot.type = edit.parkingType;
+            spot.isOccupied = false; // Deleted spots are marked occupied
+            break;
+        case BulkAction::Delete:
+            changed = !spot.type.empty();
+            spot.type.clear();
+            spot.isOccupied = true; // Set the spot to be unavailable
+            break;
+        case BulkAction::Clear:
+            changed = spot.isOccupied && !spot.type.empty();
+            if (changed) {
+                auto customer = site.customers.find(spot.plateNumber);
+                if (customer != site.customers.end()) {
+                    customer->second.startTime = 0;
+                    customer->second.endTime = 0;
+                    customer->second.parkingType = "";
+                    customer->second.vehicleType = "";
+                    customer->second.entrance = 0;
+                    customer->second.exit = 0;
+                    customer->second.payment = 0.0;
+                    ++summary.customersReset;
+                }
+                spot.isOccupied = false;
+                spot.vehicleType = "";
+                spot.plateNumber = "";
+                spot.startTime = 0;
+                spot.entrance = 0;
+            }
+            break;
+        }
+        summary.changed += changed ? 1 : 0;
+        summary.unchanged += changed ? 0 : 1;
+    }
+    for (const auto& floor : appended) {
+        FloorSpots& spots = site.floors[site.floors.add(floor.first)].spots;
+        spots.reserve(spots.size() + floor.second.size());
+        for (int number : floor.second) {
+            ParkingSpot spot;
+            spot.id = floor.first + "_" + to_string(number);
+            spot.type = edit.parkingType;
+            spots.push_back(spot);
+        }
+        summary.added += static_cast<int>(floor.second.size());
+        summary.changed += static_cast<int>(floor.second.size());
+    }
+
+    site.allocator.invalidate(); // Spots were edited in place
+    site.forecaster.invalidate();
+    site.overstays.invalidate();
+    site.views.publishAll(site);
+    summary.saved = summary.changed == 0 || saveGarage(site);
+    if (!summary.saved) {
+        loadGarage(site); // Back to the state that is still on disk
+    }
+    else if (summary.changed > 0) {
+        site.events.checkpoint(site, time(nullptr)); // Spot edits are not logged one by one
+    }
+    return summary;
+}
+
+void writeBulkEditSummary(ostream& out, const BulkEdit& edit, const BulkEditSummary& summary) {
+    if (!summary.errors.empty()) {
+        out << "No spots were changed:\n";
+        for (const auto& error : summary.errors) {
+            out << "  " << error << "\n";
+        }
+        return;
+    }
+    if (!summary.saved) {
+        out << "Error: the changes could not be saved and were undone\n";
+        return;
+    }
+    static const char* const verbs[] = { "modified", "deleted", "cleared", "added" };
+    out << summary.changed << " parking spots " << verbs[static_cast<int>(edit.action)] << " successfully";
+    if (summary.added > 0 && summary.added < summary.changed) {
+        out << " (" << summary.added << " new, " << summary.changed - summary.added << " restored)";
+    }
+    out << "\n";
+    if (summary.unchanged > 0) {
+        out << summary.unchanged << " spots already were in that state\n";
+    }
+    if (summary.customersReset > 0) {
+        out << summary.customersReset << " customer rentals were reset\n";
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Garage;
+
+enum class BulkAction {
+    Retype, // Give free spots a new parking type; deleted spots come back with it
+    Delete, // Mark free spots as deleted
+    Clear, // Free occupied spots and reset their customers' rentals
+    Add // Create the spots, reusing deleted ones and appending the rest
+};
+
+// Spots first to last of one floor, numbered as in their ids (B1_1 is spot 1 of floor B1).
+struct SpotRange {
+    std::string floor;
+    int first;
+    int last;
+};
+
+struct BulkEdit {
+    BulkAction action = BulkAction::Retype;
+    std::vector<SpotRange> ranges;
+    std::string parkingType; // New type of the spots for Retype and Add
+};
+
+struct BulkEditSummary {
+    std::vector<std::string> errors; // Validation errors; when there are any nothing was changed
+    bool saved = false;
+    int changed = 0; // Spots whose state changed, including spots added
+    int added = 0; // Spots appended to the end of a floor
+    int unchanged = 0; // Spots that already were in the requested state
+    int customersReset = 0; // Customers whose rental was cleared
+};
+
+// Splits a spot id such as B1_12 into its floor and spot number. Returns false if it does not end in a number.
+bool parseSpotId(const std::string& id, std::string& floor, int& number);
+
+// Parses a list such as "B1_1-B1_500,B2_7" into ranges. Returns false if an id is invalid or a
+// range spans two floors.
+bool parseSpotRanges(const std::string& text, std::vector<SpotRange>& ranges);
+
+// Validates the whole edit first: the parking type, every range, and that each spot exists and is
+// in a state the action applies to (spots to retype or delete must be free). Only then are the
+// changes applied, in one pass over each affected floor, and the site saved once, so either every
+// spot changes on disk or none does. If the save fails the site is reloaded from its old files.
+BulkEditSummary applyBulkEdit(Garage& site, const BulkEdit& edit);
+
+// Writes the summary, or the validation errors, for the admin.
+void writeBulkEditSummary(std::ostream& out, const BulkEdit& edit, const BulkEditSummary& summary);
@@ -0,0 +1,397 @@
+#include "BulkImport.h"
+#include "BulkEdit.h"
+#include "Parking.h"
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+static const size_t maximumErrors = 20; // Errors listed in the summary; the rest are counted
+static const size_t chunkBytes = 1 << 20; // Text parsed by one worker pool task
+
+// One record of the file. Text fields point into the file buffer.
+struct ImportRow {
+    string_view key; // Floor of a layout row, plate of a customer row
+    string_view type; // Parking type of a layout row, vehicle type of a customer row
+    int number = 0; // Spot number of a layout row
+    const string* parkingType = nullptr; // Parking type of a customer row
+    size_t line = 0;
+};
+
+// A run of whole lines parsed by one task. Line numbers are counted from the start of the chunk
+// until every chunk is done and the offsets are known.
+struct ImportChunk {
+    string_view text;
+    vector<ImportRow> rows;
+    vector<pair<size_t, string>> errors;
+    size_t errorCount = 0;
+    size_t lines = 0;
+};
+
+// Parking types, and the parking type each vehicle type is parked as, looked up without copying
+// the field. A vehicle type listed under several parking types takes the first, as
+// addCustomerInformation() does.
+struct ImportTypes {
+    set<string, less<>> parkingTypes;
+    map<string, const string*, less<>> vehicleParkingTypes;
+};
+
+static string_view trimField(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) field.remove_suffix(1);
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        field = field.substr(1, field.size() - 2);
+    }
+    return field;
+}
+
+// Splits a line at commas. Returns the number of fields, which may be larger than maxFields.
+static size_t splitCsv(string_view line, string_view* fields, size_t maxFields) {
+    size_t count = 0;
+    while (true) {
+        size_t comma = line.find(',');
+        if (count < maxFields) {
+            fields[count] = trimField(line.substr(0, comma));
+        }
+        ++count;
+        if (comma == string_view::npos) {
+            return count;
+        }
+        line.remove_prefix(comma + 1);
+    }
+}
+
+// Fields end up in space separated data files, so they must be one token and not the placeholder
+// written for an empty field.
+static bool isToken(string_view field) {
+    return !field.empty() && field != emptyFieldPlaceholder && field.find_first_of(" \t\"") == string_view::npos;
+}
+
+static bool equalsIgnoringCase(string_view text, const char* word) {
+    size_t i = 0;
+    for (; i < text.size() && word[i] != '\0'; ++i) {
+        if (tolower(static_cast<unsigned char>(text[i])) != word[i]) return false;
+    }
+    return i == text.size() && word[i] == '\0';
+}
+
+static void parseChunk(ImportChunk& chunk, ImportKind kind, const ImportTypes& types, bool firstChunk) {
+    auto fail = [&](size_t line, string message) {
+        if (chunk.errors.size() < maximumErrors) {
+            chunk.errors.emplace_back(line, move(message));
+        }
+        ++chunk.errorCount;
+    };
+    size_t expected = kind == ImportKind::Layout ? 3 : 2;
+    TextCursor cursor(chunk.text);
+    string_view line;
+    string_view fields[3];
+    while (cursor.nextLine(line)) {
+        size_t lineNumber = static_cast<size_t>(cursor.lineNumber());
+        if (trimField(line).empty()) {
+            continue;
+        }
+        size_t count = splitCsv(line, fields, 3);
+        if (firstChunk && lineNumber == 1 && equalsIgnoringCase(fields[0], kind == ImportKind::Layout ? "floor" : "plate")) {
+            continue; // Header
+        }
+        if (count != expected) {
+            fail(lineNumber, "expected " + to_string(expected) + " fields, found " + to_string(count));
+            continue;
+        }
+
+        ImportRow row;
+        row.key = fields[0];
+        row.type = fields[1 + (kind == ImportKind::Layout ? 1 : 0)];
+        row.line = lineNumber;
+        if (!isToken(row.key)) {
+            fail(lineNumber, string(kind == ImportKind::Layout ? "invalid floor " : "invalid plate ") + "\"" + string(row.key) + "\"");
+            continue;
+        }
+        if (kind == ImportKind::Layout) {
+            // The spot is a number, or an id of this floor such as B1_12
+            string floor = string(row.key);
+            int number;
+            if (!parseNumber(fields[1], number)) {
+                string idFloor;
+                if (!parseSpotId(string(fields[1]), idFloor, number) || idFloor != floor) {
+                    fail(lineNumber, "invalid spot " + string(fields[1]) + " for floor " + floor);
+                    continue;
+                }
+            }
+            if (number < 1) {
+                fail(lineNumber, "spot numbers start at 1");
+                continue;
+            }
+            if (types.parkingTypes.find(row.type) == types.parkingTypes.end()) {
+                fail(lineNumber, "unknown parking type " + string(row.type));
+                continue;
+            }
+            row.number = number;
+        }
+        else {
+            auto vehicle = types.vehicleParkingTypes.find(row.type);
+            if (vehicle == types.vehicleParkingTypes.end()) {
+                fail(lineNumber, "unknown vehicle type " + string(row.type));
+                continue;
+            }
+            row.parkingType = vehicle->second;
+        }
+        chunk.rows.push_back(row);
+    }
+    chunk.lines = static_cast<size_t>(cursor.lineNumber());
+}
+
+// Plans the new spots of each floor: which deleted spots are given a type again and which spots
+// are appended. Fails on a spot listed twice, or one that exists and is not deleted.
+struct FloorPlan {
+    string name;
+    vector<pair<size_t, string_view>> restored; // Index of a deleted spot and its new type
+    vector<const ImportRow*> appended;
+};
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+ImportSummary importFile(Garage& site, ImportKind kind, const string& path) {
+    OperationTimer timer(Operation::Import);
+    TraceSpan span("importFile", path);
+    ImportSummary summary;
+    auto fail = [&](const string& message) {
+        if (summary.errors.size() < maximumErrors) {
+            summary.errors.push_back(message);
+        }
+        ++summary.errorCount;
+    };
+
+    auto start = chrono::steady_clock::now();
+    string buffer;
+    if (!readWholeFile(path, buffer)) {
+        fail("Unable to open " + path);
+        return summary;
+    }
+    ImportTypes types;
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    for (const auto& type : parkingTypes) {
+        types.parkingTypes.insert(type.first);
+        for (const auto& vehicle : type.second) {
+            types.vehicleParkingTypes.emplace(vehicle, &type.first); // Keeps the first parking type
+        }
+    }
+
+    // Chunks end at a line break, so no line is split between two tasks
+    vector<ImportChunk> chunks;
+    string_view text(buffer);
+    for (size_t begin = 0; begin < text.size();) {
+        size_t end = begin + chunkBytes < text.size() ? text.find('\n', begin + chunkBytes) : string_view::npos;
+        end = end == string_view::npos ? text.size() : end + 1;
+        chunks.emplace_back();
+        chunks.back().text = text.substr(begin, end - begin);
+        begin = end;
+    }
+    vector<future<void>> pending;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        ImportChunk* chunk = &chunks[i];
+        bool firstChunk = i == 0;
+        pending.push_back(workerPool().submit([chunk, kind, &types, firstChunk] { parseChunk(*chunk, kind, types, firstChunk); }));
+    }
+    for (auto& result : pending) {
+        result.get();
+    }
+
+    size_t lineOffset = 0;
+    for (auto& chunk : chunks) {
+        for (const auto& error : chunk.errors) {
+            fail("line " + to_string(error.first + lineOffset) + ": " + error.second);
+        }
+        summary.errorCount += chunk.errorCount - chunk.errors.size();
+        for (auto& row : chunk.rows) {
+            row.line += lineOffset;
+        }
+        summary.rows += chunk.rows.size();
+        lineOffset += chunk.lines;
+    }
+    summary.parseSeconds = secondsSince(start);
+    if (summary.errorCount > 0) {
+        return summary;
+    }
+    if (summary.rows == 0) {
+        fail("The file has no records");
+        return summary;
+    }
+
+    start = chrono::steady_clock::now();
+    if (kind == ImportKind::Layout) {
+        // Rows of each floor, floors in the order they first appear
+        vector<FloorPlan> plans;
+        unordered_map<string_view, size_t> planOf;
+        for (const auto& chunk : chunks) {
+            for (const auto& row : chunk.rows) {
+                auto found = planOf.emplace(row.key, plans.size());
+                if (found.second) {
+                    plans.emplace_back();
+                    plans.back().name = string(row.key);
+                }
+                plans[found.first->second].appended.push_back(&row);
+            }
+        }
+
+        for (auto& plan : plans) {
+            unordered_map<string, size_t> existing; // Spot id -> index on the floor
+            FloorHandle handle = site.floors.find(plan.name);
+            if (handle != invalidFloor) {
+                const FloorSpots& spots = site.floors[handle].spots;
+                existing.reserve(spots.size());
+                for (size_t i = 0; i < spots.size(); ++i) {
+                    existing.emplace(spots[i].id, i);
+                }
+            }
+            unordered_map<int, size_t> firstLine; // Spot number -> line it was first listed on
+            firstLine.reserve(plan.appended.size());
+            vector<const ImportRow*> appended;
+            appended.reserve(plan.appended.size());
+            for (const ImportRow* row : plan.appended) {
+                auto listed = firstLine.emplace(row->number, row->line);
+                string id = plan.name + "_" + to_string(row->number);
+                if (!listed.second) {
+                    fail("line " + to_string(row->line) + ": spot " + id + " is also on line " + to_string(listed.first->second));
+                    continue;
+                }
+                auto spot = existing.find(id);
+                if (spot == existing.end()) {
+                    appended.push_back(row);
+                }
+                else if (site.floors[handle].spots[spot->second].type.empty()) {
+                    plan.restored.emplace_back(spot->second, row->type); // Deleted: comes back with the new type
+                }
+                else {
+                    fail("line " + to_string(row->line) + ": spot " + id + " already exists");
+                }
+            }
+            plan.appended.swap(appended);
+        }
+        if (summary.errorCount > 0) {
+            return summary;
+        }
+
+        for (const auto& plan : plans) {
+            FloorHandle handle = site.floors.find(plan.name);
+            if (handle == invalidFloor) {
+                handle = site.floors.add(plan.name);
+                ++summary.floorsAdded;
+            }
+            FloorSpots& spots = site.floors[handle].spots;
+            for (const auto& restored : plan.restored) {
+                spots[restored.first].type = string(restored.second);
+                spots[restored.first].isOccupied = false; // Deleted spots are marked occupied
+            }
+            spots.reserve(spots.size() + plan.appended.size());
+            for (const ImportRow* row : plan.appended) {
+                ParkingSpot spot;
+                spot.id = plan.name + "_" + to_string(row->number);
+                spot.type = string(row->type);
+                spots.push_back(move(spot));
+            }
+            summary.spotsRestored += plan.restored.size();
+            summary.spotsAdded += plan.appended.size();
+        }
+        site.allocator.invalidate(); // Spots were added directly
+        site.forecaster.invalidate();
+    }
+    else {
+        // Sorted by plate, so duplicates are neighbours and the map is filled in order
+        vector<const ImportRow*> rows;
+        rows.reserve(summary.rows);
+        for (const auto& chunk : chunks) {
+            for (const auto& row : chunk.rows) {
+                rows.push_back(&row);
+            }
+        }
+        stable_sort(rows.begin(), rows.end(), [](const ImportRow* a, const ImportRow* b) { return a->key < b->key; });
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (i > 0 && rows[i]->key == rows[i - 1]->key) {
+                fail("line " + to_string(rows[i]->line) + ": plate " + string(rows[i]->key) + " is also on line " + to_string(rows[i - 1]->line));
+            }
+            else if (site.customers.find(string(rows[i]->key)) != site.customers.end()) {
+                fail("line " + to_string(rows[i]->line) + ": plate " + string(rows[i]->key) + " is already a customer");
+            }
+        }
+        if (summary.errorCount > 0) {
+            return summary;
+        }
+
+        auto hint = site.customers.end();
+        if (!rows.empty()) {
+            hint = site.customers.lower_bound(string(rows.front()->key));
+        }
+        for (const ImportRow* row : rows) {
+            Customer customer;
+            customer.plateNumber = string(row->key);
+            customer.vehicleType = string(row->type);
+            customer.parkingType = *row->parkingType;
+            auto inserted = site.customers.emplace_hint(hint, customer.plateNumber, move(customer));
+            hint = next(inserted);
+            site.plates.insert(inserted->first);
+        }
+        summary.customersAdded = rows.size();
+    }
+    site.views.publishAll(site);
+    summary.buildSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    summary.saved = saveGarage(site);
+    summary.saveSeconds = secondsSince(start);
+    if (summary.saved) {
+        site.events.checkpoint(site, time(nullptr)); // Imports are not logged row by row
+    }
+    else {
+        loadGarage(site); // Back to the state that is still on disk
+    }
+    return summary;
+}
+
+void writeImportSummary(ostream& out, ImportKind kind, const ImportSummary& summary) {
+    if (summary.errorCount > 0) {
+        out << "Nothing was imported:\n";
+        for (const auto& error : summary.errors) {
+            out << "  " << error << "\n";
+        }
+        if (summary.errorCount > summary.errors.size()) {
+            out << "  ... and " << summary.errorCount - summary.errors.size() << " more errors\n";
+        }
+        return;
+    }
+    if (!summary.saved) {
+        out << "Error: the import could not be saved and was undone\n";
+        return;
+    }
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    if (kind == ImportKind::Layout) {
+        out << summary.spotsAdded + summary.spotsRestored << " parking spots imported";
+        if (summary.spotsRestored > 0) {
+            out << " (" << summary.spotsAdded << " new, " << summary.spotsRestored << " restored)";
+        }
+        if (summary.floorsAdded > 0) {
+            out << ", " << summary.floorsAdded << " new floors";
+        }
+        out << "\n";
+    }
+    else {
+        out << summary.customersAdded << " customers imported\n";
+    }
+    out << fixed << setprecision(2) << "Parse " << summary.parseSeconds << " s, build " << summary.buildSeconds
+        << " s, save " << summary.saveSeconds << " s\n";
+    out.flags(flags);
+    out.precision(precision);
+}
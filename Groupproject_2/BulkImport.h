@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Garage;
+
+// Files the importer reads. Both are comma separated, one record per line, with an optional header
+// line and blank lines ignored:
+//   layout:    floor,spot,parkingType  (spot is a number such as 12 or an id such as B1_12)
+//   customers: plate,vehicleType       (the parking type follows from the vehicle type)
+enum class ImportKind {
+    Layout,
+    Customers
+};
+
+struct ImportSummary {
+    std::vector<std::string> errors; // Validation errors; when there are any nothing was changed
+    size_t errorCount = 0; // Including errors not listed
+    bool saved = false;
+    size_t rows = 0;
+    size_t floorsAdded = 0;
+    size_t spotsAdded = 0; // Spots appended to a floor
+    size_t spotsRestored = 0; // Deleted spots given a type again
+    size_t customersAdded = 0;
+    double parseSeconds = 0; // Reading, parsing and validating the file
+    double buildSeconds = 0; // Duplicate checks and building the site's structures
+    double saveSeconds = 0;
+};
+
+// Imports a layout or customer file into the site. The file is split into chunks at line breaks
+// and the chunks are parsed and validated on the worker pool at the same time: field counts, spot
+// ids, and parking and vehicle types against the site's config. Duplicate spots and plates,
+// within the file and against the site, are then found in one pass, and only if the whole file is
+// valid are the floors or the customer table extended and the site saved, once. If the save fails
+// the site is reloaded from its old files.
+ImportSummary importFile(Garage& site, ImportKind kind, const std::string& path);
+
+// Writes the counts and timings of an import, or its validation errors.
+void writeImportSummary(std::ostream& out, ImportKind kind, const ImportSummary& summary);
@@ -12,44 +12,40 @@
 #include <thread>
 #include <chrono>
 #include <cctype> // To use isdigit function
+#include <cmath>
+#include <filesystem>
+#include <utility>
+
+#include "Parking.h"
+#include "DataParser.h"
+#include "CommandLine.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "MemoryReport.h"
+#include "Dashboard.h"
+#include "CustomerQuery.h"
+#include "BulkEdit.h"
+#include "BulkImport.h"
+#include "Overstay.h"
+#include "QueryEngine.h"
+#include "Replica.h"
 
     using namespace std;
 
-// Structure definitions
-struct ParkingSpot {
-    string id;
-    string type;
-    bool isOccupied;
-    string vehicleType;
-    string plateNumber;
-    time_t startTime;
-    int entrance;
-};
-
-struct Customer {
-    string plateNumber;
-    time_t startTime;
-    time_t endTime;
-    string parkingType;
-    string vehicleType;
-    int entrance;
-    int exit;
-    double payment;
-};
-
 // Global variables
-map<string, vector<ParkingSpot>> parkingLots;
-map<string, Customer> customers;
-map<string, set<string>> parkingTypeToVehicleTypes;
-map<string, map<string, double>> hourlyRates;
 string currentPlateNumber;
 string adminPassword;
-double dailyMaxRate = 50.0;
+const string metricsFilePath = "metrics.json"; // Written every metricsIntervalSeconds and on SIGUSR1
+const int metricsIntervalSeconds = 60;
+const string traceFilePath = "trace.json";
 
 // Function declarations
 // Initializes the system by loading data and setting the admin password if it is not set.
 void initializeSystem();
 
+// Lets the user choose which site the kiosk is serving.
+void selectSite();
+
 // Prompts the admin for a password and, if correct, allows access to the admin functions.
 void adminLogin();
 
@@ -68,6 +64,10 @@ void modifyParkingSpot();
 // Deletes specified parking spots from a given floor and marks them as unavailable.
 void deleteParkingSpot();
 
+// Reads the spots to modify, delete or clear on a floor: a list of IDs when choice is 1, otherwise
+// a start and end ID. Returns false if an ID does not belong to the floor.
+bool readSpotRanges(const string& floor, int choice, const string& verb, vector<SpotRange>& ranges);
+
 // Sets the hourly rate for a specified parking type.
 void setHourlyRate();
 
@@ -77,76 +77,138 @@ void setDailyMaxRate();
 // Searches and displays available parking spots based on vehicle type.
 void searchAvailableSpots();
 
-// Allows customers to rent a parking spot by specifying the floor, spot ID, and vehicle type.
+// Allows customers to rent a parking spot, either assigned nearest their entrance or by specifying the floor,
+// spot ID, and vehicle type.
 void rentParkingSpot();
 
+// Rents the free spot nearest the customer's entrance that fits their vehicle type.
+void assignNearestParkingSpot();
+
 // Calculates and settles the parking fee for a customer based on the time parked.
 void settleParkingFee();
 
-// Saves all current data (admin password, parking lots, customers, parking type to vehicle types, hourly rates, and daily max rate) to files.
+// Saves the shared data and the current site's data (parking lots, customers, hourly rates, and daily max rate) to files.
 void saveData();
 
-// Loads data (admin password, parking lots, customers, parking type to vehicle types, hourly rates, and daily max rate) from files.
+// Loads the shared data and the current site's data (parking lots, customers, hourly rates, and daily max rate) from files.
 void loadData();
 
 // Modifies the vehicle types associated with a parking type by adding or removing vehicle types.
 void modifyParkingTypeVehicleTypes();
 
-// Clears the console screen.
-void clearScreen();
-
 // Generates a unique parking spot ID based on the floor and index.
 string generateParkingSpotId(const string& floor, int index);
 
 // Displays a visual representation of the parking status on a specified floor.
-void displayVisualParkingStatus(const string& floor);
+void displayVisualParkingStatus(FloorHandle floor);
 
 // Clears the occupation status of a specified parking spot and removes associated customer information.
 void clearParkingSpotOccupation();
 
+// Reloads the current site and reports how many heap, arena and pool allocations the reload needed.
+void displayAllocationStatistics();
+
+// Displays the latency percentiles of every recorded operation and writes them to the metrics file.
+void displayOperationMetrics();
+
+// Turns span tracing to the trace file on, or off if it is already on.
+void toggleTracing();
+
+// Displays the estimated memory footprint of the current site's floors, customers and rates.
+void displayMemoryUsage();
+
+// Shows the live occupancy dashboard of the current site until Enter is pressed.
+void displayLiveDashboard();
+
+// Displays the expected free spots of the current site for the next hours.
+void displayOccupancyForecast();
+
+// Runs ad-hoc count, sum and group-by queries over the current site's spots and customers.
+void runAdHocQueries();
+
+// Rebuilds the current site as it was at an entered time from its event log, optionally for one plate.
+void displaySiteHistory();
+
+// Adds the spots or customers listed in a CSV file to the current site, all of them or none.
+void importFromFile();
+
+// Lists the cars over their stay limit and lets the admin change the limits.
+void displayOverstays();
+
+// Shows the revenue of the recent hours, days or months from the site's ledger.
+void displayRevenueReport();
+
+// Shows the overstay alerts fired since the last call and appends them to the site's alerts.log.
+void showOverstayAlerts(Garage& site);
+
 // Manages customer information, including viewing, adding, and deleting customer records.
 void manageCustomerInformation();
 
-// Displays information about all customers, including plate number, vehicle type, entrance, and estimated payment if not yet departed.
+// Displays customer information one page at a time, optionally filtered and sorted: plate number, vehicle type,
+// entrance, and estimated payment if not yet departed.
 void viewCustomerInformation();
 
+// Asks for the status, parking type, minimum duration and fee, sort key and page size of a customer listing.
+void readCustomerQuery(CustomerQuery& query);
+
 // Adds a new customer information record, including plate number and vehicle type.
 void addCustomerInformation();
 
 // Deletes a customer information record after displaying the information and confirming the deletion.
 void deleteCustomerInformation();
 
+// Looks customers up by the start of a plate number, or by a plate with one character wrong.
+void findCustomerByPlate();
+
 
 
 
 
-int main() {
-    initializeSystem();
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        int result = runCommandLine(argc, argv); // Batch modes such as --bench run without the menus
+        if (result != standbyPromoted) {
+            return result;
+        }
+        // A promoted standby already holds its site: the menus start on it without loading it again
+    }
+    else {
+        initializeSystem();
+    }
+    startMetricsReporter(metricsFilePath, metricsIntervalSeconds);
+    startConfigWatcher(); // Picks up rate and type files edited outside the program
     int choice;
     do {
         clearScreen();
         cout << "Welcome to the Parking Management System\n";
+        cout << "Site: " << currentGarage->name << "\n";
         cout << "1. Admin Login\n";
         cout << "2. Customer Login\n";
+        cout << "3. Select Site\n";
         cout << "0. Exit\n";
         cout << "Please choose: ";
         cin >> choice;
-        while (cin.fail() || (choice < 0 || choice > 2)) {// Validate the user's input
+        while (cin.fail() || (choice < 0 || choice > 3)) {// Validate the user's input
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please enter a number between 0 and 2: ";
+            cout << "Invalid input. Please enter a number between 0 and 3: ";
             cin >> choice;
         }
         switch (choice) {// Perform actions based on the user's choice
         case 1: adminLogin(); break;// Call the adminLogin function
         case 2: customerLogin(); break;// Call the customerLogin function
+        case 3: selectSite(); break;// Call the selectSite function
         }
     } while (choice != 0);// Continue the loop until the user chooses to exit
+    stopConfigWatcher();
+    stopTracing();
+    stopMetricsReporter();
     return 0;
 }
 
 void initializeSystem() {
-    loadData();// Load data from storage
+    loadSharedData();// Load the data shared by every site
+    loadAllGarages();// Load every site in parallel
 
     if (adminPassword.empty()) {
         cout << "Please set the admin password: ";
@@ -157,7 +219,22 @@ void initializeSystem() {
             cout << "Invalid input. Please enter a non-empty password: ";
             cin >> adminPassword;
         }
-        saveData();// Save the updated data
+        saveSharedData();// Save the updated data
+    }
+}
+
+void selectSite() {
+    clearScreen();
+    cout << "Available sites: ";
+    for (const auto& entry : garages) {
+        cout << entry.first << " ";
+    }
+    cout << "\nEnter site name: ";
+    string name;
+    cin >> name;
+    while (!selectGarage(name)) {
+        cout << "Invalid site. Please enter a valid site name: ";
+        cin >> name;
     }
 }
 
@@ -169,7 +246,8 @@ void adminLogin() {
         int choice;
         do {
             clearScreen();
-            cout << "Admin System\n";
+            cout << "Admin System (" << currentGarage->name << ")\n";
+            showOverstayAlerts(*currentGarage);
             cout << "1. Browse Parking Information\n";
             cout << "2. Add Parking Spot\n";
             cout << "3. Modify Parking Spot\n";
@@ -180,13 +258,25 @@ void adminLogin() {
             cout << "8. Search Available Spots\n";
             cout << "9. Clear Parking Spot Occupation\n";
             cout << "10. Manage Customer Information\n";
+            cout << "11. Manage Sites\n";
+            cout << "12. Allocation Statistics\n";
+            cout << "13. Operation Metrics\n";
+            cout << "14. " << (tracingOn() ? "Stop" : "Start") << " Tracing\n";
+            cout << "15. Memory Usage\n";
+            cout << "16. Live Dashboard\n";
+            cout << "17. Occupancy Forecast\n";
+            cout << "18. Query Spots and Sessions\n";
+            cout << "19. Site History\n";
+            cout << "20. Import Layout or Customers (CSV)\n";
+            cout << "21. Overstays\n";
+            cout << "22. Revenue Report\n";
             cout << "0. Exit\n";
             cout << "Please choose: ";
             cin >> choice;
-            while (cin.fail() || (choice < 0 || choice > 10)) { // Validate the user's input
+            while (cin.fail() || (choice < 0 || choice > 22)) { // Validate the user's input
                 cin.clear();
                 cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                cout << "Invalid input. Please enter a number between 0 and 10: ";
+                cout << "Invalid input. Please enter a number between 0 and 22: ";
                 cin >> choice;
             }
             switch (choice) {  // Perform actions based on the admin's choice
@@ -200,6 +290,18 @@ void adminLogin() {
             case 8: searchAvailableSpots(); break;
             case 9: clearParkingSpotOccupation(); break;
             case 10: manageCustomerInformation(); break;
+            case 11: manageSites(); break;
+            case 12: displayAllocationStatistics(); break;
+            case 13: displayOperationMetrics(); break;
+            case 14: toggleTracing(); break;
+            case 15: displayMemoryUsage(); break;
+            case 16: displayLiveDashboard(); break;
+            case 17: displayOccupancyForecast(); break;
+            case 18: runAdHocQueries(); break;
+            case 19: displaySiteHistory(); break;
+            case 20: importFromFile(); break;
+            case 21: displayOverstays(); break;
+            case 22: displayRevenueReport(); break;
             case 0: break;
             default: cout << "Invalid choice\n";
             }
@@ -214,13 +316,13 @@ void adminLogin() {
 }
 
 void customerLogin() {
+    Garage& site = *currentGarage;
     cout << "Please enter your plate number: ";
     cin >> currentPlateNumber;// Get the customer's plate number
 
-    if (customers.find(currentPlateNumber) == customers.end()) { // Check if the customer is new
-        Customer newCustomer;
-        newCustomer.plateNumber = currentPlateNumber;
-        customers[currentPlateNumber] = newCustomer;
+    // A new plate stays a visitor, kept in memory only, until it rents a spot
+    if (site.customers.find(currentPlateNumber) == site.customers.end()) {
+        site.visitors.touch(currentPlateNumber, time(nullptr));
     }
 
     int choice;
@@ -250,9 +352,10 @@ void customerLogin() {
 }
 
 void displayParkingStatus() {//display parking status
+    Garage& site = *currentGarage;
     clearScreen();
-    for (const auto& floor : parkingLots) {
-        displayVisualParkingStatus(floor.first);
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        displayVisualParkingStatus(floor); // Each floor is loaded as it is shown
     }
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -260,7 +363,14 @@ void displayParkingStatus() {//display parking status
 }
 
 
+// The parking types of the site's current config, for a menu to list and check its input against.
+static map<string, set<string>> siteParkingTypes(const Garage& site) {
+    ConfigView config(site);
+    return config->parkingTypes;
+}
+
 void addParkingSpot() {// Function to add parking spots
+    Garage& site = *currentGarage;
     clearScreen();
     string floor;
     int count;
@@ -277,55 +387,58 @@ void addParkingSpot() {// Function to add parking spots
     }
 
 
+    map<string, set<string>> parkingTypes = siteParkingTypes(site);
     cout << "Available parking types: ";
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         cout << type.first << " ";
     }
     cout << "\nEnter spot type: ";
 
     ParkingSpot newSpot;
     cin >> newSpot.type;//get the name of new spot type
-    while (parkingTypeToVehicleTypes.find(newSpot.type) == parkingTypeToVehicleTypes.end()) {
+    while (parkingTypes.find(newSpot.type) == parkingTypes.end()) {
         cout << "Invalid parking type. Please enter a valid parking type: ";
         cin >> newSpot.type;
     }
-    newSpot.isOccupied = false;
-
-    auto& spots = parkingLots[floor];
-    int currentSize = spots.size();
-    for (int i = 0; i < count; ++i) {
-        auto it = find_if(spots.begin(), spots.end(), [](const ParkingSpot& spot) {
-            return spot.type.empty();
-            });
-        if (it != spots.end()) {// Update the existing spot with new information
-            it->type = newSpot.type;
-            it->isOccupied = newSpot.isOccupied;
-            it->vehicleType = newSpot.vehicleType;
-            it->plateNumber = newSpot.plateNumber;
-            it->startTime = newSpot.startTime;
-            it->entrance = newSpot.entrance;
-            it->id = generateParkingSpotId(floor, distance(spots.begin(), it));
-        }
-        else {
-            newSpot.id = generateParkingSpotId(floor, currentSize + i);
-            spots.push_back(newSpot);
+
+    // Deleted spots are reused first, then new spots are numbered after the last one
+    BulkEdit edit;
+    edit.action = BulkAction::Add;
+    edit.parkingType = newSpot.type;
+    FloorHandle floorHandle = site.floors.find(floor);
+    int lastNumber = 0;
+    if (floorHandle != invalidFloor) {
+        for (const auto& spot : site.floors[floorHandle].spots) {
+            string spotFloor;
+            int number;
+            if (!parseSpotId(spot.id, spotFloor, number)) continue;
+            lastNumber = max(lastNumber, number);
+            if (spot.type.empty() && count > 0) {
+                edit.ranges.push_back(SpotRange{ floor, number, number });
+                --count;
+            }
         }
     }
-    saveData();// Save the updated parking data
-    cout << "Parking spots added successfully\n";
+    if (count > 0) {
+        edit.ranges.push_back(SpotRange{ floor, lastNumber + 1, lastNumber + count });
+    }
+    writeBulkEditSummary(cout, edit, applyBulkEdit(site, edit));
+    publishMemoryUsage(site);
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     cin.get();
 }
 
 void modifyParkingSpot() {
+    Garage& site = *currentGarage;
     clearScreen();
     string floor, newType;
     cout << "Enter floor you want to modify (e.g., B1, B2): ";
     cin >> floor;//get the floor information user want to modify
 
-    if (parkingLots.find(floor) != parkingLots.end()) {
-        auto& spots = parkingLots[floor];
+    FloorHandle floorHandle = site.floors.find(floor);
+    if (floorHandle != invalidFloor) {
+        const FloorSpots& spots = as_const(site.floors)[floorHandle].spots;
 
         // Display current parking spots information on the selected floor
         map<string, vector<string>> typeToSpots;
@@ -364,67 +477,28 @@ void modifyParkingSpot() {
             cin >> choice;
         }
 
-        vector<string> idsToModify;
-
-        if (choice == 1) {
-            // Input for individual spot IDs to modify
-            string spotIds;
-            cout << "Enter IDs of the spots to modify (separated by spaces): \n";
-            cout << "(Such as B1_1 B1_2 to modify the spots 1, 2 from B1)\n";
-            cin.ignore(); // Ignore any leftover newline character
-            getline(cin, spotIds);
-            stringstream ss(spotIds);
-            string spotId;
-            while (ss >> spotId) {
-                idsToModify.push_back(spotId);
-            }
-        }
-        else if (choice == 2) {
-            // Input for range of spot IDs to modify
-            string startId, endId;
-            cout << "Enter the start ID of the range to modify (e.g., B1_1): ";
-            cin >> startId;
-            cout << "Enter the end ID of the range to modify (e.g., B1_10): ";
-            cin >> endId;
-
-            int startIdx = stoi(startId.substr(startId.find('_') + 1));
-            int endIdx = stoi(endId.substr(endId.find('_') + 1));
-
-            for (int i = startIdx; i <= endIdx; ++i) {
-                idsToModify.push_back(floor + "_" + to_string(i));
+        BulkEdit edit;
+        edit.action = BulkAction::Retype;
+        if (readSpotRanges(floor, choice, "modify", edit.ranges)) {
+            // Show available parking types
+            map<string, set<string>> parkingTypes = siteParkingTypes(site);
+            cout << "Available parking types: ";
+            for (const auto& type : parkingTypes) {
+                cout << type.first << " ";
             }
-        }
-
-        // Show available parking types
-        cout << "Available parking types: ";
-        for (const auto& type : parkingTypeToVehicleTypes) {
-            cout << type.first << " ";
-        }
-        cout << "\nEnter new spot type: ";
-        cin >> newType;
-
-        while (parkingTypeToVehicleTypes.find(newType) == parkingTypeToVehicleTypes.end()) {
-            cout << "Invalid parking type. Please enter a valid parking type: ";
+            cout << "\nEnter new spot type: ";
             cin >> newType;
-        }
 
-        // Modify the specified spots
-        for (const string& id : idsToModify) {
-            auto it = find_if(spots.begin(), spots.end(), [&id](const ParkingSpot& spot) {
-                return spot.id == id;
-                });
-
-            if (it != spots.end()) {
-                it->type = newType;
-                it->isOccupied = false;  // Set the spot to be available
-                cout << "Parking spot " << id << " modified successfully\n";
+            while (parkingTypes.find(newType) == parkingTypes.end()) {
+                cout << "Invalid parking type. Please enter a valid parking type: ";
+                cin >> newType;
             }
-            else {
-                cout << "Invalid spot ID: " << id << "\n";
-            }
-        }
+            edit.parkingType = newType;
 
-        saveData();// save new parking spots data
+            // Every spot is checked before any is modified, and the change is saved once
+            writeBulkEditSummary(cout, edit, applyBulkEdit(site, edit));
+            publishMemoryUsage(site);
+        }
     }
     else {
         cout << "Invalid floor\n";
@@ -436,13 +510,15 @@ void modifyParkingSpot() {
 }
 
 void deleteParkingSpot() {
+    Garage& site = *currentGarage;
     clearScreen();
     string floor;
     cout << "Enter floor you want to delete spots from (e.g., B1, B2): ";
     cin >> floor;
 
-    if (parkingLots.find(floor) != parkingLots.end()) {
-        auto& spots = parkingLots[floor];
+    FloorHandle floorHandle = site.floors.find(floor);
+    if (floorHandle != invalidFloor) {
+        const FloorSpots& spots = as_const(site.floors)[floorHandle].spots;
 
         // Display current parking spots information on the selected floor
         map<string, vector<string>> typeToSpots;
@@ -481,61 +557,12 @@ void deleteParkingSpot() {
             cin >> choice;
         }
 
-        vector<string> idsToDelete;
-
-        if (choice == 1) {
-            // Input for individual spot IDs to delete
-            string spotIds;
-            cout << "Enter IDs of the spots to delete (separated by spaces): \n";
-            cout << "(Such as B1_1 B1_2 to delete the spots 1, 2 from B1)\n";
-            cin.ignore(); // Ignore any leftover newline character
-            getline(cin, spotIds);
-            stringstream ss(spotIds);
-            string spotId;
-            while (ss >> spotId) {
-                idsToDelete.push_back(spotId);
-            }
+        BulkEdit edit;
+        edit.action = BulkAction::Delete;
+        if (readSpotRanges(floor, choice, "delete", edit.ranges)) {
+            writeBulkEditSummary(cout, edit, applyBulkEdit(site, edit));
+            publishMemoryUsage(site);
         }
-        else if (choice == 2) {
-            // Input for range of spot IDs to delete
-            string startId, endId;
-            cout << "Enter the start ID of the range to delete (e.g., B1_1): ";
-            cin >> startId;
-            cout << "Enter the end ID of the range to delete (e.g., B1_10): ";
-            cin >> endId;
-
-            while (cin.fail()) {
-                cin.clear();
-                cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                cout << "Invalid input. Please enter valid spot IDs: ";
-                cin >> startId >> endId;
-            }
-
-            int startIdx = stoi(startId.substr(startId.find('_') + 1));
-            int endIdx = stoi(endId.substr(endId.find('_') + 1));
-
-            for (int i = startIdx; i <= endIdx; ++i) {
-                idsToDelete.push_back(floor + "_" + to_string(i));
-            }
-        }
-
-        // Delete the specified spots
-        for (const string& id : idsToDelete) {
-            auto it = find_if(spots.begin(), spots.end(), [&id](const ParkingSpot& spot) {
-                return spot.id == id;
-                });
-
-            if (it != spots.end()) {
-                it->type.clear();
-                it->isOccupied = true; // Set the spot to be unavailable
-                cout << "Parking spot " << id << " deleted successfully\n";
-            }
-            else {
-                cout << "Invalid spot ID: " << id << "\n";
-            }
-        }
-
-        saveData();
     }
     else {
         cout << "Invalid floor\n";
@@ -547,26 +574,74 @@ void deleteParkingSpot() {
 }
 
 
+bool readSpotRanges(const string& floor, int choice, const string& verb, vector<SpotRange>& ranges) {
+    if (choice == 1) {
+        // Input for individual spot IDs
+        string spotIds;
+        cout << "Enter IDs of the spots to " << verb << " (separated by spaces): \n";
+        cout << "(Such as B1_1 B1_2 to " << verb << " the spots 1, 2 from B1)\n";
+        cin.ignore(); // Ignore any leftover newline character
+        getline(cin, spotIds);
+        stringstream ss(spotIds);
+        string spotId;
+        while (ss >> spotId) {
+            SpotRange range;
+            if (!parseSpotId(spotId, range.floor, range.first) || range.floor != floor) {
+                cout << "Invalid spot ID: " << spotId << "\n";
+                return false;
+            }
+            range.last = range.first;
+            ranges.push_back(range);
+        }
+        return true;
+    }
+
+    // Input for a range of spot IDs
+    string startId, endId;
+    cout << "Enter the start ID of the range to " << verb << " (e.g., B1_1): ";
+    cin >> startId;
+    cout << "Enter the end ID of the range to " << verb << " (e.g., B1_10): ";
+    cin >> endId;
+
+    SpotRange range;
+    string endFloor;
+    if (!parseSpotId(startId, range.floor, range.first) || range.floor != floor) {
+        cout << "Invalid spot ID: " << startId << "\n";
+        return false;
+    }
+    if (!parseSpotId(endId, endFloor, range.last) || endFloor != floor) {
+        cout << "Invalid spot ID: " << endId << "\n";
+        return false;
+    }
+    ranges.push_back(range);
+    return true;
+}
+
 void setHourlyRate() {
+    Garage& site = *currentGarage;
     clearScreen();
     string parkingType;
     double rate;
 
     // Display available parking types from file
+    map<string, set<string>> parkingTypes = siteParkingTypes(site);
     cout << "Available parking types: ";
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         cout << type.first << " ";
     }
     cout << "\nEnter parking type: ";
     cin >> parkingType;
 
-    if (parkingTypeToVehicleTypes.find(parkingType) != parkingTypeToVehicleTypes.end()) {
+    if (parkingTypes.find(parkingType) != parkingTypes.end()) {
         // Display current hourly rate for the selected parking type
-        if (hourlyRates.find(parkingType) != hourlyRates.end()) {
-            cout << "Current hourly rate for " << parkingType << ": $" << hourlyRates[parkingType]["Default"] << "\n";
-        }
-        else {
-            cout << "No current hourly rate set for " << parkingType << "\n";
+        {
+            ConfigView config(site);
+            if (config->hourlyRates.find(parkingType) != config->hourlyRates.end()) {
+                cout << "Current hourly rate for " << parkingType << ": $" << config->hourlyRate(parkingType) << "\n";
+            }
+            else {
+                cout << "No current hourly rate set for " << parkingType << "\n";
+            }
         }
 
         cout << "Enter new hourly rate: ";
@@ -578,8 +653,12 @@ void setHourlyRate() {
             cin >> rate;
         }
 
-        hourlyRates[parkingType]["Default"] = rate;  // Use a default key since vehicle type is no longer relevant
-        saveData();
+        OperationTimer timer(Operation::SetHourlyRate);
+        // Use a default key since vehicle type is no longer relevant
+        site.config.update([&](SiteConfig& config) { config.hourlyRates[parkingType]["Default"] = rate; });
+        site.events.recordHourlyRate(site, parkingType, rate, time(nullptr));
+        saveRates(site);
+        timer.stop();
         cout << "Hourly rate set successfully\n";
     }
     else {
@@ -593,19 +672,25 @@ void setHourlyRate() {
 
 
 void setDailyMaxRate() {
+    Garage& site = *currentGarage;
     clearScreen();
     // Display current daily maximum rate
-    cout << "Current daily maximum rate: $" << dailyMaxRate << "\n";
+    cout << "Current daily maximum rate: $" << ConfigView(site)->dailyMaxRate << "\n";
 
+    double rate;
     cout << "Enter new daily maximum rate: ";
-    cin >> dailyMaxRate;
-    while (cin.fail() || dailyMaxRate < 0) {
+    cin >> rate;
+    while (cin.fail() || rate < 0) {
         cin.clear();
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cout << "Invalid input. Please enter a positive rate: ";
-        cin >> dailyMaxRate;
+        cin >> rate;
     }
-    saveData();
+    OperationTimer timer(Operation::SetDailyMaxRate);
+    site.config.update([rate](SiteConfig& config) { config.dailyMaxRate = rate; });
+    site.events.recordDailyMaxRate(site, rate, time(nullptr));
+    saveRates(site);
+    timer.stop();
     cout << "Daily maximum rate set successfully\n";
 
     cout << "Press Enter to continue...";
@@ -618,9 +703,11 @@ void modifyParkingTypeVehicleTypes() {
     clearScreen();
     string parkingType, vehicleType;
 
-    // Display available parking types and their associated vehicle types
+    // Display available parking types and their associated vehicle types. The edit is made to a
+    // copy of the table, which is then published to every site at once.
+    map<string, set<string>> parkingTypes = sharedParkingTypes();
     cout << "Current parking types and their associated vehicle types:\n";
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         cout << type.first << ": ";
         for (const auto& vehicle : type.second) {
             cout << vehicle << " ";
@@ -631,7 +718,7 @@ void modifyParkingTypeVehicleTypes() {
     cout << "Enter parking type to modify: ";
     cin >> parkingType;
 
-    if (parkingTypeToVehicleTypes.find(parkingType) == parkingTypeToVehicleTypes.end()) {
+    if (parkingTypes.find(parkingType) == parkingTypes.end()) {
         cout << "Invalid parking type\n";
         return;
     }
@@ -647,16 +734,19 @@ void modifyParkingTypeVehicleTypes() {
         cin >> choice;
     }
 
+    OperationTimer timer(Operation::ModifyParkingTypes);
     if (choice == 'a') {
-        parkingTypeToVehicleTypes[parkingType].insert(vehicleType);
+        parkingTypes[parkingType].insert(vehicleType);
         cout << "Vehicle type added to parking type\n";
     }
     else if (choice == 'r') {
-        parkingTypeToVehicleTypes[parkingType].erase(vehicleType);
+        parkingTypes[parkingType].erase(vehicleType);
         cout << "Vehicle type removed from parking type\n";
     }
 
-    saveData();
+    publishParkingTypes(parkingTypes);
+    saveSharedData(); // The sites' own files are unchanged
+    timer.stop();
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     cin.get();
@@ -664,13 +754,15 @@ void modifyParkingTypeVehicleTypes() {
 
 
 void clearParkingSpotOccupation() {
+    Garage& site = *currentGarage;
     clearScreen();
     string floor, spotId;
     cout << "Enter floor (e.g., B1, B2): ";
     cin >> floor;
 
-    if (parkingLots.find(floor) != parkingLots.end()) {
-        auto& spots = parkingLots[floor];
+    FloorHandle floorHandle = site.floors.find(floor);
+    if (floorHandle != invalidFloor) {
+        const FloorSpots& spots = as_const(site.floors)[floorHandle].spots;
 
         // Display current occupied parking spots on the selected floor
         map<string, vector<string>> typeToSpots;
@@ -709,79 +801,80 @@ void clearParkingSpotOccupation() {
             cin >> choice;
         }
 
-        vector<string> idsToClear;
-
-        if (choice == 1) {
-            // Input for individual spot IDs to clear
-            string spotIds;
-            cout << "Enter IDs of the spots to clear (separated by spaces): \n";
-            cout << "(Such as B1_1 B1_2 to clear the spots 1, 2 from B1)\n";
-            cin.ignore(); // Ignore any leftover newline character
-            getline(cin, spotIds);
-            stringstream ss(spotIds);
-            string spotId;
-            while (ss >> spotId) {
-                idsToClear.push_back(spotId);
-            }
+        BulkEdit edit;
+        edit.action = BulkAction::Clear;
+        if (readSpotRanges(floor, choice, "clear", edit.ranges)) {
+            writeBulkEditSummary(cout, edit, applyBulkEdit(site, edit));
+            publishMemoryUsage(site);
         }
-        else if (choice == 2) {
-            // Input for range of spot IDs to clear
-            string startId, endId;
-            cout << "Enter the start ID of the range to clear (e.g., B1_1): ";
-            cin >> startId;
-            cout << "Enter the end ID of the range to clear (e.g., B1_10): ";
-            cin >> endId;
+    }
+    else {
+        cout << "Invalid floor\n";
+    }
 
-            while (cin.fail()) {
-                cin.clear();
-                cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                cout << "Invalid input. Please enter valid spot IDs: ";
-                cin >> startId >> endId;
-            }
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
 
-            int startIdx = stoi(startId.substr(startId.find('_') + 1));
-            int endIdx = stoi(endId.substr(endId.find('_') + 1));
+void displayAllocationStatistics() {
+    Garage& site = *currentGarage;
+    clearScreen();
 
-            for (int i = startIdx; i <= endIdx; ++i) {
-                idsToClear.push_back(floor + "_" + to_string(i));
-            }
-        }
+    uint64_t heapBefore = allocationCounters.heapAllocations.load();
+    uint64_t poolBefore = allocationCounters.poolAllocations.load();
+    loadGarage(site); // Reload the current site while counting allocations
+    uint64_t heapDuringReload = allocationCounters.heapAllocations.load() - heapBefore;
+    uint64_t poolDuringReload = allocationCounters.poolAllocations.load() - poolBefore;
 
-        // Clear the specified spots and update customer information
-        for (const string& id : idsToClear) {
-            auto it = find_if(spots.begin(), spots.end(), [&id](const ParkingSpot& spot) {
-                return spot.id == id;
-                });
-
-            if (it != spots.end() && it->isOccupied) {
-                // Find and update the corresponding customer
-                auto customerIt = customers.find(it->plateNumber);
-                if (customerIt != customers.end()) {
-                    customerIt->second.startTime = 0;
-                    customerIt->second.endTime = 0;
-                    customerIt->second.parkingType = "";
-                    customerIt->second.vehicleType = "";
-                    customerIt->second.entrance = 0;
-                    customerIt->second.exit = 0;
-                    customerIt->second.payment = 0.0;
-                }
+    size_t spotCount = 0;
+    for (const auto& floor : site.floors) {
+        spotCount += floor.spots.size();
+    }
+    size_t recordCount = spotCount + site.customers.size();
 
-                it->isOccupied = false;
-                it->vehicleType = "";
-                it->plateNumber = "";
-                it->startTime = 0;
-                it->entrance = 0;
-                cout << "Occupation for spot " << id << " cleared successfully\n";
-            }
-            else {
-                cout << "Invalid spot ID: " << id << " or the spot is not occupied\n";
-            }
-        }
+    cout << "Allocation statistics for site " << site.name << ":\n";
+    cout << "Records: " << spotCount << " spots, " << site.customers.size() << " customers\n";
+    cout << "Heap allocations during reload: " << heapDuringReload;
+    if (recordCount > 0) {
+        cout << " (" << fixed << setprecision(3) << static_cast<double>(heapDuringReload) / recordCount << " per record)";
+    }
+    cout << "\n";
+    cout << "Customer pool allocations during reload: " << poolDuringReload << "\n";
+    cout << "Floor arena: " << site.arena.bytesUsed() << " bytes used, " << site.arena.bytesReserved()
+        << " bytes reserved in " << site.arena.chunkCount() << " chunks\n";
+    cout << "\n";
+    cout << "Process totals:\n";
+    printAllocationCounters(cout);
 
-        saveData();
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+void displayOperationMetrics() {
+    clearScreen();
+    cout << "Operation latencies since start-up (all sites):\n";
+    writeMetricsText(cout, takeMetricsSnapshot());
+    if (writeMetricsFile(metricsFilePath)) {
+        cout << "JSON snapshot written to " << metricsFilePath << "\n";
     }
-    else {
-        cout << "Invalid floor\n";
+
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+void toggleTracing() {
+    clearScreen();
+    if (tracingOn()) {
+        uint64_t spans = stopTracing();
+        cout << "Tracing stopped. " << spans << " spans written to " << traceFilePath << "\n";
+        cout << "Open it in chrome://tracing or ui.perfetto.dev\n";
+    }
+    else if (startTracing(traceFilePath)) {
+        cout << "Tracing saves, loads and operations to " << traceFilePath << "\n";
+        cout << "Choose this menu item again to stop\n";
     }
 
     cout << "Press Enter to continue...";
@@ -789,70 +882,330 @@ void clearParkingSpotOccupation() {
     cin.get();
 }
 
-void viewCustomerInformation() {
+void displayMemoryUsage() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    MemoryReport report = measureMemory(site);
+    cout << "Estimated memory footprint of site " << site.name << " (bytes):\n";
+    writeMemoryText(cout, report);
+    publishMemoryUsage(site);
+
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+void displayLiveDashboard() {
+    clearScreen();
+    runLiveDashboard(*currentGarage);
+}
+
+void displayOccupancyForecast() {
+    Garage& site = *currentGarage;
     clearScreen();
     loadData(); // Load the latest data from file
-    cout << "Customer Information:\n";
-    time_t currentTime = time(nullptr); // Get current time
+    writeForecastText(cout, site, time(nullptr), 4);
 
-    for (const auto& customer : customers) {
-        cout << "Plate Number: " << customer.first << "\n";
-        cout << "Vehicle Type: " << (customer.second.vehicleType.empty() ? "Not specified" : customer.second.vehicleType) << "\n"; // Added check for empty vehicle type
-        cout << "Entrance: " << customer.second.entrance << "\n";
-
-        if (customer.second.vehicleType.empty() && customer.second.entrance == 0) {
-            cout << "Status: Not rented a parking spot yet\n";
-        }
-        else if (customer.second.startTime == 0) {
-            cout << "Start Time: Not yet parked\n";
-            cout << "Current parking duration: Not yet parked\n";
-            cout << "Current estimated payment due: Not yet parked\n";
-            cout << "End Time: Not yet parked\n";
-        }
-        else if (customer.second.endTime == 0) {
-            double totalHours = ceil(difftime(currentTime, customer.second.startTime) / 3600.0); // Calculate total parking duration (round up to the nearest hour)
-            double rate = hourlyRates[customer.second.parkingType]["Default"];
-            double initialPayment = totalHours * rate;
-
-            // Add a 20% surcharge for every 6 hours
-            int sixHourIntervals = static_cast<int>(totalHours) / 6;
-            double surcharge = 0.0;
-            if (sixHourIntervals > 0) {
-                for (int i = 1; i <= sixHourIntervals; ++i) {
-                    surcharge += 6 * rate * 0.2 * i;
-                }
-                double remainingHours = totalHours - (sixHourIntervals * 6);
-                surcharge += remainingHours * rate * 0.2 * sixHourIntervals;
-            }
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
 
-            double payment = initialPayment + surcharge;
-            if (payment > dailyMaxRate) {
-                payment = dailyMaxRate;
-            }
+void runAdHocQueries() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    loadData(); // Load the latest data from file
+    writeQueryHelp(cout);
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    string text;
+    while (true) {
+        cout << "\nQuery (empty to return): ";
+        if (!getline(cin, text) || text.empty()) {
+            break;
+        }
+        Query query;
+        string error;
+        if (!parseQuery(text, query, error)) {
+            cout << "Invalid query: " << error << "\n";
+            continue;
+        }
+        writeQueryResult(cout, query, runQuery(site, query, time(nullptr)));
+    }
+}
+
+void displaySiteHistory() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    string text;
+    time_t asOf;
+    cout << "Enter the time (YYYY-MM-DD HH:MM): ";
+    getline(cin, text);
+    while (!parseLocalTime(text, asOf) && cin) {
+        cout << "Invalid time. Please enter it as YYYY-MM-DD HH:MM: ";
+        getline(cin, text);
+    }
+    string plateNumber;
+    cout << "Enter a plate number, or leave empty for the whole site: ";
+    getline(cin, plateNumber);
+
+    Garage state;
+    state.name = site.name;
+    state.dataDir = site.dataDir;
+    ReplayResult result = reconstructSite(site.dataDir, asOf, state);
+    if (result.restored) {
+        writeSiteHistory(cout, state, result, asOf, plateNumber);
+    }
+    else {
+        cout << result.error << "\n";
+    }
+
+    cout << "Press Enter to continue...";
+    cin.get();
+}
+
+void importFromFile() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    int choice;
+    cout << "1. Parking spots (floor,spot,parkingType)\n";
+    cout << "2. Customers (plate,vehicleType)\n";
+    cout << "Please choose: ";
+    cin >> choice;
+    while (cin.fail() || (choice < 1 || choice > 2)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter 1 or 2: ";
+        cin >> choice;
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    string path;
+    cout << "Enter the path of the CSV file: ";
+    getline(cin, path);
+
+    ImportKind kind = choice == 1 ? ImportKind::Layout : ImportKind::Customers;
+    writeImportSummary(cout, kind, importFile(site, kind, path));
+    publishMemoryUsage(site);
+
+    cout << "Press Enter to continue...";
+    cin.get();
+}
+
+void showOverstayAlerts(Garage& site) {
+    const size_t shown = 5;
+    site.overstays.poll(site, time(nullptr));
+    trimFloors(site); // The first poll reads every floor
+    vector<OverstayAlert> alerts = site.overstays.takeAlerts();
+    logOverstayAlerts(site, alerts);
+    for (size_t i = 0; i < alerts.size() && i < shown; ++i) {
+        cout << "Alert: " << alerts[i].plateNumber << " at " << alerts[i].spotId << " has been parked over "
+            << alerts[i].limitHours << " hours\n";
+    }
+    if (alerts.size() > shown) {
+        cout << "Alert: " << alerts.size() - shown << " more cars passed their stay limit (see 21. Overstays)\n";
+    }
+}
 
-            // Convert start time to string using localtime_s
-            struct tm timeinfo;
-            char startTimeStr[20];
-            localtime_s(&timeinfo, &customer.second.startTime);
-            strftime(startTimeStr, sizeof(startTimeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
+void displayOverstays() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    time_t now = time(nullptr);
+    writeOverstays(cout, site.overstays.current(site, now), now);
 
-            cout << "Start Time: " << startTimeStr << "\n";
-            cout << "Current parking duration: " << totalHours << " hours\n";
-            cout << "Current estimated payment due: $" << fixed << setprecision(2) << payment << "\n";
-            cout << "End Time: Not yet departed\n"; // Show not yet departed
+    cout << "\nStay limits:";
+    for (const auto& limit : site.overstays.limits()) {
+        cout << " " << (limit.first == OverstayMonitor::anyType ? "All" : limit.first) << " " << limit.second << " h";
+    }
+    char change;
+    cout << "\nChange a limit (y/n)? ";
+    cin >> change;
+    if (change == 'y' || change == 'Y') {
+        string parkingType;
+        map<string, set<string>> parkingTypes = siteParkingTypes(site);
+        cout << "Parking type (";
+        for (const auto& type : parkingTypes) {
+            cout << type.first << ", ";
+        }
+        cout << "or All): ";
+        cin >> parkingType;
+        while (parkingType != "All" && parkingTypes.find(parkingType) == parkingTypes.end()) {
+            cout << "Invalid parking type. Please enter a valid parking type: ";
+            cin >> parkingType;
+        }
+        double hours;
+        cout << "Limit in hours (0 to remove it): ";
+        cin >> hours;
+        while (cin.fail() || hours < 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter a number of hours: ";
+            cin >> hours;
+        }
+        site.overstays.setLimit(parkingType == "All" ? OverstayMonitor::anyType : parkingType, hours);
+
+        string path = garageFilePath(site, "overstayLimits.dat");
+        ofstream outFile(path);
+        if (outFile.is_open()) {
+            writeOverstayLimits(outFile, site.overstays);
+            outFile.close();
+            cout << "Stay limit set successfully\n";
         }
         else {
-            cout << "Status: Departed\n"; // Show departed but don't display specific end time and payment
+            cerr << "Error: Unable to open " << path << " for writing\n";
         }
+    }
 
-        cout << "--------------------------\n";
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+void displayRevenueReport() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    loadData(); // Load the latest data from file
+
+    int choice;
+    cout << "1. Last 24 hours\n";
+    cout << "2. Last 31 days\n";
+    cout << "3. Last 12 months\n";
+    cout << "Please choose: ";
+    cin >> choice;
+    while (cin.fail() || (choice < 1 || choice > 3)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter 1, 2 or 3: ";
+        cin >> choice;
+    }
+    clearScreen();
+    if (choice == 1) {
+        writeRevenueReport(cout, site.ledger, LedgerPeriod::Hour, time(nullptr), 24);
+    }
+    else if (choice == 2) {
+        writeRevenueReport(cout, site.ledger, LedgerPeriod::Day, time(nullptr), 31);
+    }
+    else {
+        writeRevenueReport(cout, site.ledger, LedgerPeriod::Month, time(nullptr), 12);
+    }
+
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+void viewCustomerInformation() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    loadData(); // Load the latest data from file
+
+    CustomerQuery query;
+    int choice;
+    cout << "1. List all customers\n";
+    cout << "2. Filter and sort customers\n";
+    cout << "Please choose: ";
+    cin >> choice;
+    while (cin.fail() || (choice < 1 || choice > 2)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter 1 or 2: ";
+        cin >> choice;
+    }
+    if (choice == 2) {
+        readCustomerQuery(query);
+    }
+
+    clearScreen();
+    cout << "Customer Information:\n";
+    CustomerCursor cursor(site, query, time(nullptr)); // Fees are estimated as of now
+    while (true) {
+        cursor.nextPage(cout); // Only this page's customers are formatted
+        if (cursor.done()) {
+            cout << cursor.rowsWritten() << " customers listed\n";
+            break;
+        }
+        char next;
+        cout << "Enter n for the next page or q to stop: ";
+        cin >> next;
+        if (next != 'n' && next != 'N') {
+            break;
+        }
     }
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     cin.get();
 }
 
+void readCustomerQuery(CustomerQuery& query) {
+    int choice;
+    cout << "Status (0. All, 1. Active, 2. Not yet parked, 3. Departed): ";
+    cin >> choice;
+    while (cin.fail() || (choice < 0 || choice > 3)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number between 0 and 3: ";
+        cin >> choice;
+    }
+    const CustomerStatus statuses[] = { CustomerStatus::Any, CustomerStatus::Active, CustomerStatus::NotParked, CustomerStatus::Departed };
+    query.status = statuses[choice];
+
+    map<string, set<string>> parkingTypes = siteParkingTypes(*currentGarage);
+    cout << "Parking type (";
+    for (const auto& type : parkingTypes) {
+        cout << type.first << ", ";
+    }
+    cout << "or All): ";
+    cin >> query.parkingType;
+    if (query.parkingType == "All" || query.parkingType == "all") {
+        query.parkingType.clear();
+    }
+
+    cout << "Minimum parking duration in hours (0 for any): ";
+    cin >> query.minimumHours;
+    while (cin.fail() || query.minimumHours < 0) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number of hours: ";
+        cin >> query.minimumHours;
+    }
+    cout << "Minimum fee (0 for any): ";
+    cin >> query.minimumFee;
+    while (cin.fail() || query.minimumFee < 0) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter an amount: ";
+        cin >> query.minimumFee;
+    }
+
+    cout << "Sort by (1. Plate number, 2. Start time, 3. Parking duration, 4. Fee): ";
+    cin >> choice;
+    while (cin.fail() || (choice < 1 || choice > 4)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number between 1 and 4: ";
+        cin >> choice;
+    }
+    const CustomerSortKey sortKeys[] = { CustomerSortKey::Plate, CustomerSortKey::StartTime, CustomerSortKey::Duration, CustomerSortKey::Fee };
+    query.sortKey = sortKeys[choice - 1];
+
+    char descending;
+    cout << "Descending order? (y/n): ";
+    cin >> descending;
+    query.descending = descending == 'y' || descending == 'Y';
+
+    cout << "Customers per page: ";
+    cin >> choice;
+    while (cin.fail() || choice < 1) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a positive number: ";
+        cin >> choice;
+    }
+    query.pageSize = static_cast<size_t>(choice);
+}
+
 void addCustomerInformation() {
+    Garage& site = *currentGarage;
     clearScreen();
     loadData(); // Load the latest data from file
     Customer newCustomer;
@@ -860,7 +1213,7 @@ void addCustomerInformation() {
     cin >> newCustomer.plateNumber;
 
     // Check for duplicate plate number
-    if (customers.find(newCustomer.plateNumber) != customers.end()) {
+    if (site.customers.find(newCustomer.plateNumber) != site.customers.end()) {
         cout << "Customer with this plate number already exists.\n";
         cout << "Press Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -869,8 +1222,9 @@ void addCustomerInformation() {
     }
 
     // Display available vehicle types from file, grouped by parking type
+    map<string, set<string>> parkingTypes = siteParkingTypes(site);
     cout << "Available vehicle types by parking type:\n";
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         cout << type.first << ": ";
         for (const auto& vehicle : type.second) {
             cout << vehicle << " ";
@@ -886,7 +1240,7 @@ void addCustomerInformation() {
     // Validate vehicle type and determine parking type
     bool validVehicleType = false;
     string parkingType;
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         if (type.second.find(vehicleType) != type.second.end()) {
             validVehicleType = true;
             parkingType = type.first;
@@ -902,6 +1256,7 @@ void addCustomerInformation() {
         return;
     }
 
+    OperationTimer timer(Operation::AddCustomer);
     // Set default values for other fields
     newCustomer.startTime = 0;
     newCustomer.endTime = 0;
@@ -911,32 +1266,74 @@ void addCustomerInformation() {
     newCustomer.payment = 0.0;
     newCustomer.vehicleType = vehicleType; // Set vehicle type from user input
 
-    customers[newCustomer.plateNumber] = newCustomer;
+    site.customers[newCustomer.plateNumber] = newCustomer;
+    site.plates.insert(newCustomer.plateNumber);
+    site.events.recordCustomer(site, newCustomer.plateNumber, newCustomer.vehicleType, newCustomer.parkingType, time(nullptr));
+    site.views.publish(site, {}, { newCustomer.plateNumber });
     saveData(); // Save the updated data to file
+    timer.stop();
     cout << "Customer information added successfully\n";
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     cin.get();
 }
 
+// Lists the other plates that start with the text, then the plates one character away from it
+// that are not already listed.
+static void writePlateSuggestions(ostream& out, const Garage& site, const string& text) {
+    const size_t shown = 20;
+    vector<string> longer;
+    size_t matching = site.plates.withPrefix(text, shown + 1, longer);
+    longer.erase(remove(longer.begin(), longer.end(), text), longer.end());
+    if (site.plates.contains(text)) {
+        --matching;
+    }
+    longer.resize(min(longer.size(), shown));
+    if (matching > 0) {
+        out << matching << " other plates start with " << text << ":";
+        for (const string& plate : longer) {
+            out << " " << plate;
+        }
+        out << (matching > longer.size() ? " ...\n" : "\n");
+    }
+
+    vector<string> similar;
+    for (const string& plate : site.plates.similar(text, shown + longer.size() + 1)) {
+        if (plate != text && !binary_search(longer.begin(), longer.end(), plate) && similar.size() < shown) {
+            similar.push_back(plate);
+        }
+    }
+    if (!similar.empty()) {
+        out << "Similar plates:";
+        for (const string& plate : similar) {
+            out << " " << plate;
+        }
+        out << "\n";
+    }
+}
+
 void deleteCustomerInformation() {
+    Garage& site = *currentGarage;
     clearScreen();
     loadData(); // Load the latest data from file
 
-    // Display all customer information before asking for the plate number
-    cout << "All Customers Information:\n";
-    for (const auto& customer : customers) {
-        cout << "Plate Number: " << customer.first << "\n";
-        cout << "Vehicle Type: " << (customer.second.vehicleType.empty() ? "Not specified" : customer.second.vehicleType) << "\n";
-        cout << "--------------------------\n";
+    // Page through the customers until a plate number is entered
+    CustomerQuery query;
+    query.detailed = false;
+    query.pageSize = 10;
+    CustomerCursor cursor(site, query, time(nullptr));
+    cout << "Customers:\n";
+    string plateNumber = "+";
+    while (plateNumber == "+" && cin) {
+        if (!cursor.done()) {
+            cursor.nextPage(cout);
+        }
+        cout << (cursor.done() ? "Enter plate number to delete: " : "Enter plate number to delete, or + for more customers: ");
+        cin >> plateNumber;
     }
 
-    string plateNumber;
-    cout << "Enter plate number to delete: ";
-    cin >> plateNumber;
-
-    auto it = customers.find(plateNumber);
-    if (it != customers.end()) {
+    auto it = site.customers.find(plateNumber);
+    if (it != site.customers.end()) {
         // Display customer information before deletion
         cout << "Customer Information:\n";
         cout << "Plate Number: " << it->second.plateNumber << "\n";
@@ -951,21 +1348,10 @@ void deleteCustomerInformation() {
             cin >> confirm;
         }
         if (confirm == 'y' || confirm == 'Y') {
-            // Clear parking spot occupation if exists
-            for (auto& floor : parkingLots) {
-                for (auto& spot : floor.second) {
-                    if (spot.plateNumber == plateNumber) {
-                        spot.isOccupied = false;
-                        spot.vehicleType = "";
-                        spot.plateNumber = "";
-                        spot.startTime = 0;
-                        spot.entrance = 0;
-                    }
-                }
-            }
-
-            customers.erase(it);
+            OperationTimer timer(Operation::DeleteCustomer);
+            removeCustomer(site, plateNumber, time(nullptr)); // Only the floor the car is parked on is loaded
             saveData(); // Save the updated data to file
+            timer.stop();
             cout << "Customer information deleted successfully\n";
         }
         else {
@@ -974,6 +1360,7 @@ void deleteCustomerInformation() {
     }
     else {
         cout << "Customer not found\n";
+        writePlateSuggestions(cout, site, plateNumber);
     }
 
     cout << "Press Enter to continue...";
@@ -981,6 +1368,33 @@ void deleteCustomerInformation() {
     cin.get();
 }
 
+void findCustomerByPlate() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    loadData(); // Load the latest data from file
+
+    string text;
+    cout << "Enter a plate number or the start of one: ";
+    cin >> text;
+
+    auto it = site.customers.find(text);
+    if (it != site.customers.end()) {
+        const Customer& customer = it->second;
+        cout << "Plate Number: " << it->first << "\n";
+        cout << "Vehicle Type: " << (customer.vehicleType.empty() ? "Not specified" : customer.vehicleType) << "\n";
+        cout << "Status: " << (customerStatus(customer) == CustomerStatus::Active ? "Parked" : "Not parked") << "\n";
+        cout << "--------------------------\n";
+    }
+    else {
+        cout << "No customer has plate " << text << "\n";
+    }
+    writePlateSuggestions(cout, site, text);
+
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
 void manageCustomerInformation() {
     int choice;
     do {
@@ -989,13 +1403,14 @@ void manageCustomerInformation() {
         cout << "1. View Customer Information\n";
         cout << "2. Add Customer Information\n";
         cout << "3. Delete Customer Information\n";
+        cout << "4. Find Customer by Plate\n";
         cout << "0. Exit\n";
         cout << "Please choose: ";
         cin >> choice;
-        while (cin.fail() || (choice < 0 || choice > 3)) {
+        while (cin.fail() || (choice < 0 || choice > 4)) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please enter a number between 0 and 3: ";
+            cout << "Invalid input. Please enter a number between 0 and 4: ";
             cin >> choice;
         }
 
@@ -1009,6 +1424,9 @@ void manageCustomerInformation() {
         case 3:
             deleteCustomerInformation();
             break;
+        case 4:
+            findCustomerByPlate();
+            break;
         case 0:
             break;
         default:
@@ -1019,11 +1437,13 @@ void manageCustomerInformation() {
 
 
 void searchAvailableSpots() {
+    Garage& site = *currentGarage;
     clearScreen();
 
     // Display available vehicle types from file
+    map<string, set<string>> parkingTypes = siteParkingTypes(site);
     set<string> availableVehicleTypes;
-    for (const auto& type : parkingTypeToVehicleTypes) {
+    for (const auto& type : parkingTypes) {
         for (const auto& vehicle : type.second) {
             availableVehicleTypes.insert(vehicle);
         }
@@ -1042,14 +1462,29 @@ void searchAvailableSpots() {
         cin >> vehicleType;
     }
 
-    for (const auto& floor : parkingLots) {
-        cout << "Floor: " << floor.first << "\n";
-        for (const auto& spot : floor.second) {
-            if (!spot.isOccupied && parkingTypeToVehicleTypes[spot.type].find(vehicleType) != parkingTypeToVehicleTypes[spot.type].end()) {
-                cout << "ID: " << spot.id << ", Type: " << spot.type << ", Available\n";
-            }
+    // Floors not loaded are only loaded if their counts show a free spot for the vehicle type
+    ConfigView config(site);
+    vector<FloorHandle> wanted;
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        const Floor& entry = site.floors.peek(floor);
+        if (!entry.loaded && entry.counts.hasFreeSpot(*config, vehicleType)) {
+            wanted.push_back(floor);
+        }
+    }
+    loadFloors(site, wanted);
+
+    ReadView view(site);
+    FloorHandle shownFloor = invalidFloor;
+    for (const SpotRef& available : findAvailableSpots(*view, *config, vehicleType)) {
+        const FloorVersion& floor = *view->floors[available.floor];
+        if (available.floor != shownFloor) {
+            cout << "Floor: " << floor.name << "\n";
+            shownFloor = available.floor;
         }
+        const ParkingSpot& spot = floor.spot(available.index);
+        cout << "ID: " << spot.id << ", Type: " << spot.type << ", Available\n";
     }
+    trimFloors(site);
 
     cout << "Press Enter to continue...";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -1057,15 +1492,34 @@ void searchAvailableSpots() {
 }
 
 void rentParkingSpot() {
+    Garage& site = *currentGarage;
+    clearScreen();
+    int choice;
+    cout << "1. Assign me the nearest free spot\n";
+    cout << "2. Choose a spot myself\n";
+    cout << "Please choose: ";
+    cin >> choice;
+    while (cin.fail() || (choice < 1 || choice > 2)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter 1 or 2: ";
+        cin >> choice;
+    }
+    if (choice == 1) {
+        assignNearestParkingSpot();
+        return;
+    }
+
     while (true) {
         clearScreen();
 
         // Display available floors and their available spots
         cout << "Available floors and spots:\n";
-        for (const auto& floor : parkingLots) {
-            cout << "Floor: " << floor.first << "\n";
+        for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+            const Floor& floor = as_const(site.floors)[handle];
+            cout << "Floor: " << floor.name << "\n";
             int count = 0;
-            for (const auto& spot : floor.second) {
+            for (const auto& spot : floor.spots) {
                 if (!spot.isOccupied) {
                     cout << "  ID: " << spot.id << ", Type: " << spot.type << "  ";
                     if (++count % 3 == 0) {
@@ -1076,11 +1530,13 @@ void rentParkingSpot() {
             if (count % 3 != 0) {
                 cout << "\n"; // Ensure a new line if the last line isn't complete
             }
+            trimFloors(site); // A site loading floors on demand keeps to its budget while they are listed
         }
 
         // Display available vehicle types from file, grouped by parking type
+        map<string, set<string>> parkingTypes = siteParkingTypes(site);
         cout << "Available vehicle types by parking type:\n";
-        for (const auto& type : parkingTypeToVehicleTypes) {
+        for (const auto& type : parkingTypes) {
             cout << type.first << ": ";
             for (const auto& vehicle : type.second) {
                 cout << vehicle << " ";
@@ -1107,43 +1563,26 @@ void rentParkingSpot() {
         cin >> vehicleType;
 
         // Validate parking type and vehicle type
-        if (parkingLots.find(floor) == parkingLots.end()) {
+        FloorHandle floorHandle = site.floors.find(floor);
+        if (floorHandle == invalidFloor) {
             cout << "Invalid floor. Please try again.\n";
             std::this_thread::sleep_for(std::chrono::seconds(2));  // Pause for 2 seconds
             continue;
         }
 
-        auto& spots = parkingLots[floor];
-        auto it = find_if(spots.begin(), spots.end(), [&spotId](const ParkingSpot& spot) {
-            return spot.id == spotId;
-            });
-
-        if (it == spots.end() || it->isOccupied) {
+        // Rent the parking spot
+        SpotRef spot{ floorHandle, findSpotIndex(as_const(site.floors)[floorHandle], spotId) };
+        RentResult result = rentSpot(site, spot, currentPlateNumber, vehicleType, entrance, time(nullptr));
+        if (result == RentResult::InvalidSpot || result == RentResult::SpotOccupied) {
             cout << "Invalid spot ID or the spot is already occupied. Please try again.\n";
             std::this_thread::sleep_for(std::chrono::seconds(2));  // Pause for 2 seconds
             continue;
         }
-
-        string type = it->type;
-        if (parkingTypeToVehicleTypes.find(type) == parkingTypeToVehicleTypes.end() ||
-            parkingTypeToVehicleTypes[type].find(vehicleType) == parkingTypeToVehicleTypes[type].end()) {
+        if (result == RentResult::IncompatibleVehicle) {
             cout << "Invalid parking type or vehicle type. Please try again.\n";
             std::this_thread::sleep_for(std::chrono::seconds(2));  // Pause for 2 seconds
             continue;
         }
-
-        // Rent the parking spot
-        it->isOccupied = true;
-        it->vehicleType = vehicleType;
-        it->plateNumber = currentPlateNumber;
-        it->startTime = time(nullptr);
-        it->entrance = entrance;
-        customers[currentPlateNumber].startTime = it->startTime;
-        customers[currentPlateNumber].entrance = entrance;
-        customers[currentPlateNumber].parkingType = type;  // Ensure parking type is recorded correctly
-        customers[currentPlateNumber].vehicleType = vehicleType;
-        customers[currentPlateNumber].endTime = 0;  // Initialize end time as 0
-        customers[currentPlateNumber].exit = 0;  // Initialize exit as 0
         saveData();
         cout << "Parking spot rented successfully\n";
 
@@ -1154,46 +1593,78 @@ void rentParkingSpot() {
     }
 }
 
+void assignNearestParkingSpot() {
+    Garage& site = *currentGarage;
+    while (true) {
+        clearScreen();
+        map<string, set<string>> parkingTypes = siteParkingTypes(site);
+        cout << "Vehicle types: ";
+        set<string> vehicleTypes;
+        for (const auto& type : parkingTypes) {
+            vehicleTypes.insert(type.second.begin(), type.second.end());
+        }
+        for (const auto& vehicle : vehicleTypes) {
+            cout << vehicle << " ";
+        }
+        cout << "\n";
+
+        string vehicleType;
+        int entrance;
+        cout << "Enter entrance you enter in (1 or 2): ";
+        cin >> entrance;
+        while (cin.fail() || (entrance < 1 || entrance > 2)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter 1 or 2: ";
+            cin >> entrance;
+        }
+        cout << "Enter your vehicle type: ";
+        cin >> vehicleType;
+
+        SpotRef spot;
+        RentResult result = rentNearestSpot(site, currentPlateNumber, vehicleType, entrance, time(nullptr), spot);
+        if (result == RentResult::IncompatibleVehicle) {
+            cout << "Invalid vehicle type. Please try again.\n";
+            std::this_thread::sleep_for(std::chrono::seconds(2));  // Pause for 2 seconds
+            continue;
+        }
+        if (result != RentResult::Rented) {
+            cout << "Sorry, there is no free spot for your vehicle\n";
+        }
+        else {
+            saveData();
+            const Floor& floor = as_const(site.floors)[spot.floor];
+            cout << "Your spot is " << floor.spots[spot.index].id << " on floor " << floor.name << "\n";
+        }
+
+        cout << "Press any key to return to the customer menu...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cin.get();
+        break;
+    }
+}
+
 void settleParkingFee() {
+    Garage& site = *currentGarage;
     clearScreen();
 
     // Ensure data is up-to-date by loading from file
     loadData();
 
-    if (customers.find(currentPlateNumber) == customers.end()) {
+    if (site.customers.find(currentPlateNumber) == site.customers.end()) {
         cout << "No such customer. Press Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cin.get();
         return;
     }
 
-    Customer& customer = customers[currentPlateNumber];
-    customer.endTime = time(nullptr);
-    double totalHours = ceil(difftime(customer.endTime, customer.startTime) / 3600.0); // Round up to nearest hour
-    double rate = hourlyRates[customer.parkingType]["Default"];
-    double initialPayment = totalHours * rate;
-
-    // Add surcharge for each 6-hour interval
-    int sixHourIntervals = static_cast<int>(totalHours) / 6;
-    double surcharge = 0.0;
-    if (sixHourIntervals > 0) {
-        for (int i = 1; i <= sixHourIntervals; ++i) {
-            surcharge += 6 * rate * 0.2 * i;
-        }
-        // Add surcharge for the remaining hours after the last 6-hour interval
-        double remainingHours = totalHours - (sixHourIntervals * 6);
-        surcharge += remainingHours * rate * 0.2 * sixHourIntervals;
-    }
-
-    customer.payment = initialPayment + surcharge;
-
-    // Apply daily max rate
-    if (customer.payment > dailyMaxRate) {
-        customer.payment = dailyMaxRate;
-    }
+    const Customer& customer = site.customers[currentPlateNumber];
+    time_t endTime = time(nullptr); // The quoted fee is the one charged, however long the payment takes
+    double totalHours;
+    double payment = calculateParkingFee(site, customer.parkingType, customer.startTime, endTime, totalHours);
 
     cout << "Total hours parked: " << totalHours << "\n";//display total hour that customer parking
-    cout << "Total payment due: $" << fixed << setprecision(2) << customer.payment << "\n";//display total fee
+    cout << "Total payment due: $" << fixed << setprecision(2) << payment << "\n";//display total fee
 
     char choice;
     cout << "Do you want to proceed with the payment? (y/n): ";
@@ -1238,7 +1709,6 @@ void settleParkingFee() {
         }
 
         if (exit == 1 || exit == 2) {
-            customer.exit = exit;
             break;
         }
         else {
@@ -1246,19 +1716,7 @@ void settleParkingFee() {
         }
     }
 
-    for (auto& floor : parkingLots) {
-        for (auto& spot : floor.second) {
-            if (spot.plateNumber == currentPlateNumber) {
-                spot.isOccupied = false;
-                spot.vehicleType = "";
-                spot.plateNumber = "";
-                spot.startTime = 0;
-                break;
-            }
-        }
-    }
-
-    customers.erase(currentPlateNumber);
+    settleCustomer(site, currentPlateNumber, exit, endTime, payment);
     saveData();// save custmomer information like parking time and parking fee
     cout << "Payment settled and receipt printed\n";
     cout << "Press Enter to continue...";
@@ -1268,198 +1726,572 @@ void settleParkingFee() {
 
 
 void saveData() {
-    ofstream outFile("adminPassword.dat"); // Save admin password to adminPassword.dat
-    if (outFile.is_open()) {
-        outFile << adminPassword;
-        outFile.close();
-    }
-    else {
-        cerr << "Error: Unable to open adminPassword.dat for writing\n";
+    TraceSpan span("saveData");
+    saveSharedData();
+    saveGarage(*currentGarage);
+    publishMemoryUsage(*currentGarage);
+}
+
+void loadData() {
+    TraceSpan span("loadData");
+    loadSharedData();
+    loadGarage(*currentGarage);
+    publishMemoryUsage(*currentGarage);
+}
+
+void saveSharedData() {
+    TraceSpan span("saveSharedData");
+    {
+        TraceSpan fileSpan("writeFile", "adminPassword.dat");
+        ofstream outFile("adminPassword.dat"); // Save admin password to adminPassword.dat
+        if (outFile.is_open()) {
+            outFile << adminPassword;
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+        }
+        else {
+            cerr << "Error: Unable to open adminPassword.dat for writing\n";
+        }
     }
 
-    outFile.open("parkingLots.dat");// Save parking lot data to parkingLots.dat
-    if (outFile.is_open()) {
-        for (const auto& floor : parkingLots) {
-            outFile << floor.first << "\n";// Write the floor number
-            for (const auto& spot : floor.second) {
-                outFile << spot.id << " " << spot.type << " " << spot.isOccupied << " "
-                    << spot.vehicleType << " " << spot.plateNumber << " "
-                    << spot.startTime << " " << spot.entrance << "\n";// Write spot details
+    {
+        TraceSpan fileSpan("writeFile", "parkingTypeToVehicleTypes.dat");
+        ofstream outFile("parkingTypeToVehicleTypes.dat");    // Save parking type to vehicle types mapping to parkingTypeToVehicleTypes.dat
+        if (outFile.is_open()) {
+            for (const auto& type : sharedParkingTypes()) {
+                outFile << type.first;
+                for (const auto& vehicle : type.second) {
+                    outFile << " " << vehicle;
+                }
+                outFile << "\n";// Write parking type and associated vehicle types
             }
-            outFile << "#\n"; // Mark end of floor spots
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+        }
+        else {
+            cerr << "Error: Unable to open parkingTypeToVehicleTypes.dat for writing\n";
         }
-        outFile.close();
-    }
-    else {
-        cerr << "Error: Unable to open parkingLots.dat for writing\n";
     }
+}
 
-    outFile.open("customers.dat");// Save customer data to customers.dat
-    if (outFile.is_open()) {
-        for (const auto& customer : customers) {
-            outFile << customer.first << " " << customer.second.startTime << " "
-                << customer.second.endTime << " " << customer.second.parkingType << " "
-                << customer.second.vehicleType << " " << customer.second.entrance << " "
-                << customer.second.exit << " " << customer.second.payment << "\n";// Write customer details
+// Files of a site that saveGarage() replaces together.
+static const char* const garageFiles[] = { "parkingLots.dat", "floorIndex.dat", "customers.dat", "hourlyRates.dat", "dailyMaxRate.dat", "forecast.dat", "ledger.dat" };
+static const char* const pendingSuffix = ".tmp";
+static const char* const commitMarker = "commit.pending";
+
+// Moves the committed temporaries of a save over the site's files and removes the commit marker.
+static void finishPendingCommit(const Garage& site) {
+    TraceSpan span("commitFiles", site.name);
+    for (const char* fileName : garageFiles) {
+        string path = garageFilePath(site, fileName);
+        error_code ec;
+        if (filesystem::exists(path + pendingSuffix, ec)) {
+            filesystem::rename(path + pendingSuffix, path, ec);
+            if (ec) {
+                cerr << "Error: Unable to replace " << path << ": " << ec.message() << "\n";
+            }
         }
-        outFile.close();
     }
-    else {
-        cerr << "Error: Unable to open customers.dat for writing\n";
+    error_code ec;
+    filesystem::remove(garageFilePath(site, commitMarker), ec);
+}
+
+// Completes a save that was committed but not finished, or drops the temporaries of one that
+// never reached its commit marker.
+static void recoverInterruptedSave(const Garage& site) {
+    error_code ec;
+    if (filesystem::exists(garageFilePath(site, commitMarker), ec)) {
+        finishPendingCommit(site);
+        return;
+    }
+    for (const char* fileName : garageFiles) {
+        filesystem::remove(garageFilePath(site, fileName) + pendingSuffix, ec);
     }
+}
 
-    outFile.open("parkingTypeToVehicleTypes.dat");    // Save parking type to vehicle types mapping to parkingTypeToVehicleTypes.dat
-    if (outFile.is_open()) {
-        for (const auto& type : parkingTypeToVehicleTypes) {
-            outFile << type.first;
-            for (const auto& vehicle : type.second) {
-                outFile << " " << vehicle;
+vector<FloorExtent> writeParkingLots(ostream& out, const Garage& site) {
+    vector<FloorExtent> extents;
+    extents.reserve(site.floors.size());
+    streamoff start = out.tellp();
+    for (FloorHandle handle = 0; handle < site.floors.size() && out; ++handle) { // Stops at a floor that could not be copied
+        const Floor& floor = site.floors.peek(handle);
+        TraceSpan floorSpan("serializeFloor", floor.name);
+        out << floor.name << "\n";// Write the floor number
+        FloorExtent extent;
+        extent.offset = static_cast<uint64_t>(out.tellp() - start);
+        if (!floor.loaded) {
+            site.floors.copyListed(handle, out); // Unchanged since it was read, so copied as it is
+            extent.counts = floor.counts;
+        }
+        else {
+            for (const auto& spot : floor.spots) {
+                out << spot.id << " " << fieldOrPlaceholder(spot.type) << " " << spot.isOccupied << " "
+                    << fieldOrPlaceholder(spot.vehicleType) << " " << fieldOrPlaceholder(spot.plateNumber) << " "
+                    << spot.startTime << " " << spot.entrance << "\n";// Write spot details, empty fields as a placeholder
+                extent.counts.add(spot.type, spot.isOccupied);
             }
-            outFile << "\n";// Write parking type and associated vehicle types
         }
-        outFile.close();
+        extent.bytes = static_cast<uint64_t>(out.tellp() - start) - extent.offset;
+        out << "#\n"; // Mark end of floor spots
+        extents.push_back(move(extent));
     }
-    else {
-        cerr << "Error: Unable to open parkingTypeToVehicleTypes.dat for writing\n";
+    return extents;
+}
+
+// Writes the floor directory for the parkingLots.dat with the given stamp.
+static void writeFloorIndex(ostream& out, const Garage& site, const vector<FloorExtent>& extents, const string& stamp) {
+    out << "parkingLots.dat " << stamp << "\n";
+    for (size_t i = 0; i < extents.size(); ++i) {
+        out << site.floors.peek(static_cast<FloorHandle>(i)).name << " " << extents[i].offset << " " << extents[i].bytes;
+        for (const auto& type : extents[i].counts.byParkingType) {
+            out << " " << type.first << " " << type.second.first << " " << type.second.second;
+        }
+        out << "\n";
+    }
+}
+
+// Reads floorBudget.dat: the megabytes of spots a site keeps loaded when it loads floors on
+// demand. Returns false if the site loads every floor.
+static bool readFloorBudget(const Garage& site, size_t& budgetBytes) {
+    string buffer;
+    if (!readWholeFile(garageFilePath(site, "floorBudget.dat"), buffer)) {
+        return false;
+    }
+    string_view token;
+    double megabytes;
+    string_view line = string_view(buffer).substr(0, buffer.find('\n'));
+    if (splitTokens(line, &token, 1) != 1 || !parseNumber(token, megabytes) || megabytes < 0) {
+        cerr << "Error: invalid floor budget in " << garageFilePath(site, "floorBudget.dat") << "; every floor is loaded\n";
+        return false;
+    }
+    budgetBytes = static_cast<size_t>(megabytes * 1024 * 1024);
+    return true;
+}
+
+// Lists the floors of parkingLots.dat in the site's registry, which is empty, from floorIndex.dat
+// if it describes the file as it is, otherwise by scanning the file. Returns false if the floors
+// could not be listed.
+static bool listFloors(Garage& site, const string& path, const string& stamp, size_t budgetBytes) {
+    string buffer;
+    string indexStamp;
+    vector<ListedFloor> listed;
+    vector<ParseError> errors;
+    string indexPath = garageFilePath(site, "floorIndex.dat");
+    bool indexed = readWholeFile(indexPath, buffer) && parseFloorIndex(buffer, indexStamp, listed, errors) && indexStamp == stamp;
+    reportParseErrors(indexPath, errors);
+    if (!indexed) {
+        listed.clear();
+        errors.clear();
+        if (!stamp.empty() && (!readWholeFile(path, buffer) || !scanParkingLots(buffer, listed, errors))) {
+            reportParseErrors(path, errors);
+            return false;
+        }
+    }
+    site.floors.loadOnDemand(path, stamp, budgetBytes);
+    for (const ListedFloor& floor : listed) {
+        site.floors.addListed(floor.name, floor.extent);
+    }
+    return true;
+}
+
+void writeCustomers(ostream& out, const CustomerMap& customers) {
+    for (const auto& customer : customers) {
+        out << customer.first << " " << customer.second.startTime << " "
+            << customer.second.endTime << " " << fieldOrPlaceholder(customer.second.parkingType) << " "
+            << fieldOrPlaceholder(customer.second.vehicleType) << " " << customer.second.entrance << " "
+            << customer.second.exit << " " << customer.second.payment << "\n";// Write customer details
     }
+}
 
-    outFile.open("hourlyRates.dat");  // Save hourly parking rates to hourlyRates.dat
-    if (outFile.is_open()) {
-        for (const auto& type : hourlyRates) {
-            outFile << type.first << " " << type.second.at("Default") << "\n"; // Save the rate associated with the parking type
+void writeHourlyRates(ostream& out, const map<string, map<string, double>>& hourlyRates) {
+    for (const auto& type : hourlyRates) {
+        out << type.first << " " << type.second.at("Default") << "\n"; // Save the rate associated with the parking type
+    }
+}
+
+// Writes hourlyRates.dat and dailyMaxRate.dat of the site's current config to temporaries.
+// Returns false if either could not be written.
+static bool writePendingRates(const Garage& site) {
+    bool written = true;
+    ConfigView config(site); // Both files from the same config
+    {
+        string path = garageFilePath(site, "hourlyRates.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path);  // Save hourly parking rates to hourlyRates.dat
+        if (outFile.is_open()) {
+            writeHourlyRates(outFile, config->hourlyRates);
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+        }
+        else {
+            cerr << "Error: Unable to open hourlyRates.dat for writing\n";
+            written = false;
         }
-        outFile.close();
     }
-    else {
-        cerr << "Error: Unable to open hourlyRates.dat for writing\n";
+
+    {
+        string path = garageFilePath(site, "dailyMaxRate.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path); // Save daily maximum rate to dailyMaxRate.dat
+        if (outFile.is_open()) {
+            outFile << config->dailyMaxRate << "\n";
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+        }
+        else {
+            cerr << "Error: Unable to open dailyMaxRate.dat for writing\n";
+            written = false;
+        }
     }
+    return written;
+}
 
-    outFile.open("dailyMaxRate.dat"); // Save daily maximum rate to dailyMaxRate.dat
-    if (outFile.is_open()) {
-        outFile << dailyMaxRate << "\n";
-        outFile.close();
+// Replaces the site's files with the temporaries written so far if written is true, or drops the
+// temporaries. Returns true if the files were replaced.
+static bool commitPendingFiles(const Garage& site, bool written) {
+    if (!written) {
+        for (const char* fileName : garageFiles) {
+            error_code ec;
+            filesystem::remove(garageFilePath(site, fileName) + pendingSuffix, ec);
+        }
+        return false;
     }
-    else {
-        cerr << "Error: Unable to open dailyMaxRate.dat for writing\n";
+
+    // The marker commits the save: from here on the new files replace the old ones, even if the
+    // process dies before the renames and loadGarage() has to finish them
+    string marker = garageFilePath(site, commitMarker);
+    {
+        ofstream markerFile(marker);
+        for (const char* fileName : garageFiles) {
+            markerFile << fileName << "\n";
+        }
+        markerFile.close();
+        if (markerFile.fail()) {
+            cerr << "Error: Unable to write " << marker << "\n";
+            return false;
+        }
     }
+    finishPendingCommit(site);
+    return true;
 }
 
-void loadData() {
-    ifstream inFile;
+bool saveRates(Garage& site) {
+    TraceSpan span("saveRates", site.name);
+    return commitPendingFiles(site, writePendingRates(site));
+}
 
-    // Load admin password
-    inFile.open("adminPassword.dat");
-    if (inFile.is_open()) {
-        inFile >> adminPassword;
-        inFile.close();
+bool saveGarage(Garage& site) {
+    OperationTimer timer(Operation::Save);
+    if (site.floors.skippedLines() > 0) {
+        // Writing the floors back would delete the lines the load could not read
+        cerr << "Error: " << site.floors.skippedLines() << " spot lines of " << garageFilePath(site, "parkingLots.dat")
+            << " could not be read; the site is not saved until they are fixed and the site is reloaded\n";
+        return false;
+    }
+    bool written = true; // Every file goes to a temporary first; nothing is replaced unless all were written
+    vector<FloorExtent> extents;
+    string savedStamp; // parkingLots.dat as written; the rename keeps its size and write time
+    {
+        string path = garageFilePath(site, "parkingLots.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path, ios::binary);// Save parking lot data to parkingLots.dat; binary so the floor offsets are byte offsets
+        if (outFile.is_open()) {
+            extents = writeParkingLots(outFile, site);
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+            savedStamp = FloorRegistry::fileStamp(path);
+        }
+        else {
+            cerr << "Error: Unable to open parkingLots.dat for writing\n";
+            written = false;
+        }
     }
-    else {
-        adminPassword = "";
+
+    if (written) {
+        string path = garageFilePath(site, "floorIndex.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path);
+        if (outFile.is_open()) {
+            writeFloorIndex(outFile, site, extents, savedStamp);
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = !outFile.fail();
+        }
+        else {
+            cerr << "Error: Unable to open floorIndex.dat for writing\n";
+            written = false;
+        }
     }
 
-    // Load parking lots
-    inFile.open("parkingLots.dat");
-    if (inFile.is_open()) {
-        string floor;
-        while (getline(inFile, floor)) {
-            vector<ParkingSpot> spots;
-            string line;
-            while (getline(inFile, line)) {
-                if (line == "#") break; // End of current floor
-                istringstream iss(line);
-                ParkingSpot spot;
-                iss >> spot.id >> spot.type >> spot.isOccupied >> spot.vehicleType
-                    >> spot.plateNumber >> spot.startTime >> spot.entrance;
-                spots.push_back(spot);
+    {
+        string path = garageFilePath(site, "customers.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path);// Save customer data to customers.dat
+        if (outFile.is_open()) {
+            writeCustomers(outFile, site.customers);
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+        }
+        else {
+            cerr << "Error: Unable to open customers.dat for writing\n";
+            written = false;
+        }
+    }
+
+    written = writePendingRates(site) && written;
+
+    // The traffic history changes once an hour, so it is only written when an hour has closed
+    bool forecastWritten = false;
+    if (site.forecaster.changedSinceSave()) {
+        string path = garageFilePath(site, "forecast.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path);
+        if (outFile.is_open()) {
+            for (const auto& slice : site.forecaster.allSeries()) {
+                const TrafficSeries& series = slice.second;
+                outFile << fieldOrPlaceholder(slice.first.first) << " " << fieldOrPlaceholder(slice.first.second) << " "
+                    << series.currentHour << " " << series.openArrivals << " " << series.openDepartures << " "
+                    << series.level << " " << series.recentArrivals << " " << series.recentDepartures << " "
+                    << series.dwellMinutes << " " << series.dwellCount;
+                for (int slot = 0; slot < TrafficSeries::hoursPerWeek; ++slot) {
+                    if (series.seen[slot]) {
+                        outFile << " " << series.arrivals[slot];
+                    }
+                    else {
+                        outFile << " " << emptyFieldPlaceholder;
+                    }
+                }
+                for (int slot = 0; slot < TrafficSeries::hoursPerWeek; ++slot) {
+                    outFile << " " << series.departures[slot];
+                }
+                outFile << "\n";
             }
-            parkingLots[floor] = spots;
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+            forecastWritten = true;
+        }
+        else {
+            cerr << "Error: Unable to open forecast.dat for writing\n";
+            written = false;
         }
-        inFile.close();
     }
 
-    // Load customers
-    inFile.open("customers.dat");
-    if (inFile.is_open()) {
-        string plateNumber;
-        while (inFile >> plateNumber) {
-            Customer customer;
-            customer.plateNumber = plateNumber;
-            inFile >> customer.startTime >> customer.endTime >> customer.parkingType
-                >> customer.vehicleType >> customer.entrance >> customer.exit >> customer.payment;
-            customers[plateNumber] = customer;
+    // Rollups only change when a payment is settled
+    bool ledgerWritten = false;
+    if (site.ledger.changedSinceSave()) {
+        string path = garageFilePath(site, "ledger.dat") + pendingSuffix;
+        TraceSpan fileSpan("writeFile", path);
+        ofstream outFile(path);
+        if (outFile.is_open()) {
+            writeLedger(outFile, site.ledger);
+            recordBytesPersisted(static_cast<uint64_t>(outFile.tellp()));
+            outFile.close();
+            written = written && !outFile.fail();
+            ledgerWritten = true;
+        }
+        else {
+            cerr << "Error: Unable to open ledger.dat for writing\n";
+            written = false;
         }
-        inFile.close();
     }
 
-    // Load parkingTypeToVehicleTypes
-    inFile.open("parkingTypeToVehicleTypes.dat");
+    if (!commitPendingFiles(site, written)) {
+        return false;
+    }
+    if (forecastWritten) {
+        site.forecaster.markSaved();
+    }
+    if (ledgerWritten) {
+        site.ledger.markSaved();
+    }
+    site.floors.saved(extents, savedStamp);
+    trimFloors(site);
+    return true;
+}
+
+void loadSharedData() {
+    TraceSpan span("loadSharedData");
+    ifstream inFile;
+
+    // Load admin password
+    inFile.open("adminPassword.dat");
     if (inFile.is_open()) {
-        string parkingType, vehicleType;
-        while (inFile >> parkingType) {
-            set<string> vehicleTypes;
-            while (inFile.peek() != '\n' && inFile >> vehicleType) {
-                vehicleTypes.insert(vehicleType);
-            }
-            parkingTypeToVehicleTypes[parkingType] = vehicleTypes;
-            inFile.ignore(numeric_limits<streamsize>::max(), '\n'); // Ignore the rest of the line
-        }
+        inFile >> adminPassword;
         inFile.close();
     }
     else {
-        // Initialize default values if file doesn't exist
-        parkingTypeToVehicleTypes["Compact"] = { "Car", "Van" };
-        parkingTypeToVehicleTypes["Handicapped"] = { "Truck", "Otto" };
-        parkingTypeToVehicleTypes["Motorcycle"] = { "Motorcycle" };
+        adminPassword = "";
     }
 
-    // Load hourly rates
-    inFile.open("hourlyRates.dat");
-    if (inFile.is_open()) {
-        string parkingType;
-        double rate;
-        while (inFile >> parkingType >> rate) {
-            hourlyRates[parkingType]["Default"] = rate; // Load the rate associated with the parking type
-        }
-        inFile.close();
+    // Load parkingTypeToVehicleTypes
+    string buffer;
+    vector<ParseError> errors;
+    map<string, set<string>> parkingTypes;
+    if (readWholeFile("parkingTypeToVehicleTypes.dat", buffer)) {
+        parseParkingTypes(buffer, parkingTypes, errors);
+        reportParseErrors("parkingTypeToVehicleTypes.dat", errors);
     }
     else {
-        // Initialize default hourly rates if file doesn't exist
-        hourlyRates["Compact"]["Default"] = 2.0;
-        hourlyRates["Handicapped"]["Default"] = 3.0;
-        hourlyRates["Motorcycle"]["Default"] = 1.5;
+        // Initialize default values if file doesn't exist
+        parkingTypes["Compact"] = { "Car", "Van" };
+        parkingTypes["Handicapped"] = { "Truck", "Otto" };
+        parkingTypes["Motorcycle"] = { "Motorcycle" };
     }
+    publishParkingTypes(parkingTypes); // Sites created later start with the table
+}
 
-    // Load daily maximum rate
-    inFile.open("dailyMaxRate.dat");
-    if (inFile.is_open()) {
-        inFile >> dailyMaxRate;
-        inFile.close();
+void loadGarage(Garage& site) {
+    OperationTimer timer(Operation::Load);
+    recoverInterruptedSave(site);
+    string buffer; // Each file is read into this one buffer and tokenized in place
+    vector<ParseError> errors;
+
+    // Load parking lots. The previous snapshot is dropped and its arena freed in one shot,
+    // then every floor is parsed straight into the fresh arena. A site with a floor budget only
+    // lists its floors, and keeps the floors it has loaded while parkingLots.dat is unchanged.
+    string path = garageFilePath(site, "parkingLots.dat");
+    size_t budgetBytes = 0;
+    bool onDemand = readFloorBudget(site, budgetBytes);
+    string stamp = onDemand ? FloorRegistry::fileStamp(path) : "";
+    bool current = onDemand && site.floors.onDemand() && site.floors.budget() == budgetBytes &&
+        site.floors.sourceStamp() == stamp && !site.floors.hasChanges();
+    if (!current) {
+        site.floors.clear();
+        site.arena.release();
+        if ((!onDemand || !listFloors(site, path, stamp, budgetBytes)) && readWholeFile(path, buffer)) {
+            parseParkingLots(buffer, site, errors);
+            reportParseErrors(path, errors);
+            site.floors.noteSkipped(skippedLineCount(errors));
+        }
+    }
+
+    // Load customers into a fresh table that replaces the old one, so a reload also drops customers
+    // added in memory and never saved. Plates that logged in and never rented were saved by older
+    // versions; they are visitors now, so they are dropped and the next save leaves them out.
+    path = garageFilePath(site, "customers.dat");
+    errors.clear();
+    CustomerMap customers;
+    if (readWholeFile(path, buffer)) {
+        parseCustomers(buffer, customers, errors);
+        reportParseErrors(path, errors);
+        for (auto it = customers.begin(); it != customers.end();) {
+            const Customer& customer = it->second;
+            bool placeholder = customer.startTime == 0 && customer.vehicleType.empty() && customer.parkingType.empty() && customer.payment == 0;
+            it = placeholder ? customers.erase(it) : next(it);
+        }
+    }
+    site.customers.swap(customers);
+
+    // Load hourly rates and the daily maximum rate into a copy of the config, which keeps the
+    // parking types published to it
+    SiteConfig config;
+    {
+        ConfigView view(site);
+        config = *view;
+    }
+    readSiteRates(site, config);
+    site.config.replace(config);
+
+    // The traffic history is read once; after that the in-memory series are newer than the file
+    site.forecaster.invalidate();
+    if (!site.forecaster.isLoaded()) {
+        site.forecaster.markLoaded();
+        path = garageFilePath(site, "forecast.dat");
+        errors.clear();
+        if (readWholeFile(path, buffer)) {
+            parseForecast(buffer, site.forecaster, errors);
+            reportParseErrors(path, errors);
+        }
+    }
+
+    // The revenue rollups are read once, like the traffic history
+    if (!site.ledger.isLoaded()) {
+        site.ledger.markLoaded();
+        path = garageFilePath(site, "ledger.dat");
+        errors.clear();
+        if (readWholeFile(path, buffer)) {
+            parseLedger(buffer, site.ledger, errors);
+            reportParseErrors(path, errors);
+        }
+    }
+
+    // Load the distance of every floor from each entrance; without it floors fill in order
+    site.allocator.clear();
+    path = garageFilePath(site, "entranceCosts.dat");
+    errors.clear();
+    if (readWholeFile(path, buffer)) {
+        parseEntranceCosts(buffer, site.allocator, errors);
+        reportParseErrors(path, errors);
+    }
+
+    // Load the stay limits; the parked cars are indexed by their deadlines on the next poll
+    site.overstays.clearLimits();
+    path = garageFilePath(site, "overstayLimits.dat");
+    errors.clear();
+    if (readWholeFile(path, buffer)) {
+        parseOverstayLimits(buffer, site.overstays, errors);
+        reportParseErrors(path, errors);
     }
     else {
-        dailyMaxRate = 50.0; // Default daily maximum rate if file doesn't exist
+        site.overstays.setLimit("Handicapped", 4); // Default limits if the file doesn't exist
+        site.overstays.setLimit(OverstayMonitor::anyType, 72);
     }
+    site.plates.rebuild(site);
+    site.views.publishAll(site);
+    trimFloors(site);
 }
 
 void clearScreen() {
-    system("cls");
+    if (enableAnsiTerminal()) {
+        writeToTerminal("\x1b[H\x1b[2J\x1b[3J"); // Home the cursor and clear the screen and scrollback
+    }
+    else {
+        system("cls"); // Consoles without ANSI support
+    }
 }
 
 string generateParkingSpotId(const string& floor, int index) {
     return floor + "_" + to_string(index + 1);//generate spots ID in a fixed format
 }
 
-void displayVisualParkingStatus(const string& floor) {// Function to display visual parking status
-    cout << "Floor: " << floor << "\n";
-    const auto& spots = parkingLots[floor];
-    const int columnWidth = 20;
-
-    for (size_t i = 0; i < spots.size(); ++i) {
-        if (i % 5 == 0 && i != 0) cout << "\n";
-        const auto& spot = spots[i];
-        string spotStatus = spot.isOccupied ? "[X]" : "[ ]";
-        cout << left << setw(columnWidth) << (spotStatus + spot.id + "(" + spot.type + ")");// Display spot status, ID, and type.
+void displayVisualParkingStatus(FloorHandle floor) {// Function to display visual parking status
+    Garage& site = *currentGarage;
+    if (floor < 0 || floor >= site.floors.size()) {
+        return;
     }
-    cout << "\n";
+    loadFloors(site, { floor });
+    ReadView view(site);
+    const FloorVersion& spots = *view->floors[floor];
+    const size_t columnWidth = 20;
+
+    // The floor is formatted into one buffer and written at once
+    string text;
+    text.reserve(spots.spotCount * (columnWidth + 1) + 64);
+    text += "Floor: ";
+    text += spots.name;
+    text += "\n";
+    for (size_t i = 0; i < spots.spotCount; ++i) {
+        if (i % 5 == 0 && i != 0) text += "\n";
+        const auto& spot = spots.spot(i);
+        size_t cellStart = text.size();
+        text += spot.isOccupied ? "[X]" : "[ ]";// Display spot status, ID, and type.
+        text += spot.id;
+        text += "(";
+        text += spot.type;
+        text += ")";
+        size_t cellLength = text.size() - cellStart;
+        if (cellLength < columnWidth) {
+            text.append(columnWidth - cellLength, ' ');
+        }
+    }
+    text += "\n";
+    cout << text;
+    trimFloors(site);
 }
 
 
@@ -0,0 +1,467 @@
+#include "CommandLine.h"
+#include "Parking.h"
+#include "Benchmark.h"
+#include "GarageGenerator.h"
+#include "Simulator.h"
+#include "Trace.h"
+#include "Dashboard.h"
+#include "CustomerQuery.h"
+#include "BulkEdit.h"
+#include "BulkImport.h"
+#include "QueryEngine.h"
+#include "Replica.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+CommandLineOptions::CommandLineOptions(int argc, char* argv[], int first) {
+    for (int i = first; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument.size() > 2 && argument.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            values[argument.substr(2)] = argv[++i];
+        }
+        else {
+            plain.push_back(argument);
+        }
+    }
+}
+
+bool CommandLineOptions::has(const string& name) const {
+    return values.find(name) != values.end();
+}
+
+string CommandLineOptions::get(const string& name, const string& fallback) const {
+    auto it = values.find(name);
+    return it == values.end() ? fallback : it->second;
+}
+
+int CommandLineOptions::getInt(const string& name, int fallback) const {
+    auto it = values.find(name);
+    return it == values.end() ? fallback : atoi(it->second.c_str());
+}
+
+double CommandLineOptions::getDouble(const string& name, double fallback) const {
+    auto it = values.find(name);
+    return it == values.end() ? fallback : atof(it->second.c_str());
+}
+
+// Reads the garage shape options shared by --generate and --bench.
+static bool readGeneratorOptions(const CommandLineOptions& options, GeneratorOptions& garage) {
+    garage.floors = options.getInt("floors", garage.floors);
+    garage.spots = options.getInt("spots", garage.spots);
+    garage.occupancy = options.getDouble("occupancy", garage.occupancy);
+    garage.seed = static_cast<unsigned int>(options.getInt("seed", static_cast<int>(garage.seed)));
+    if (options.has("mix") && !parseTypeMix(options.get("mix"), garage.typeMix)) {
+        cerr << "Error: invalid type mix " << options.get("mix") << " (expected e.g. Compact=70,Handicapped=10,Motorcycle=20)\n";
+        return false;
+    }
+    return true;
+}
+
+static void printUsage() {
+    cerr << "Usage:\n"
+        << "  Car Parking                       Interactive parking management system\n"
+        << "  Car Parking --generate <dir> [--floors N] [--spots N] [--mix Type=weight,...] [--occupancy F] [--seed N]\n"
+        << "  Car Parking --bench [--sizes 1000,10000,...] [--spots-per-floor N] [--ops N] [--repeats N]\n"
+        << "                      [--mix Type=weight,...] [--occupancy F] [--seed N] [--out results.json]\n"
+        << "  Car Parking --bench-parser [spots]\n"
+        << "  Car Parking --simulate <dir> [--hours H] [--arrivals 300,300] [--vehicles Type=weight,...]\n"
+        << "                         [--dwell-minutes M] [--dwell-spread S] [--exits N] [--speed F]\n"
+        << "                         [--sample-minutes M] [--seed N] [--persist 1] [--dashboard 1] [--assign random|nearest]\n"
+        << "                         [--readers N] [--log 1] [--out report.json]\n"
+        << "  Car Parking --dashboard <dir>     Live occupancy display of the site in dir\n"
+        << "  Car Parking --customers <dir> [--status active|not-parked|departed] [--type T] [--min-hours H]\n"
+        << "                          [--min-fee F] [--sort plate|start|duration|fee] [--descending 1]\n"
+        << "                          [--page-size N] [--page N]   Customer listing; every page unless --page is given\n"
+        << "  Car Parking --bulk <dir> --action retype|delete|clear|add --spots B1_1-B1_500,B2_7 [--type T]\n"
+        << "                          Edits every spot in the ranges and saves them as one transaction\n"
+        << "  Car Parking --import <dir> --layout spots.csv | --customers customers.csv\n"
+        << "                          Adds the spots (floor,spot,parkingType) or customers (plate,vehicleType)\n"
+        << "                          of a CSV file; nothing is added unless every row is valid\n"
+        << "  Car Parking --query <dir> [\"count spots where hours>8 by floor\" ...] [--file queries.txt]\n"
+        << "                          Ad-hoc queries over the site's spots and sessions, one per argument or line\n"
+        << "  Car Parking --history <dir> --at \"YYYY-MM-DD HH:MM\" [--plate P]\n"
+        << "                          The site as it was at that time, rebuilt from its event log\n"
+        << "  Car Parking --bench-replay [--spots N] [--events N] [--interval N]   Event log replay speed\n"
+        << "  Car Parking --bench-kiosk [--spots N] [--logins N] [--rent-percent P] [--return-percent P] [--seed N]\n"
+        << "                          Customers, visitors, memory and customers.dat size under kiosk logins\n"
+        << "  Car Parking --bench-floors [--spots N] [--floors N] [--budget-mb F] [--transactions N] [--occupancy F]\n"
+        << "                          Load time and floor memory with every floor loaded and with floors on demand\n"
+        << "  Car Parking --overstays <dir> [--at \"YYYY-MM-DD HH:MM\"]\n"
+        << "                          Cars over their stay limit (overstayLimits.dat) now or at that time\n"
+        << "  Car Parking --standby <dir> [--name Main] [--poll-ms 10]\n"
+        << "                          Follows the event log of the site in dir; reads status, occupancy,\n"
+        << "                          query <query>, promote or quit from stdin. After promote the menus run\n"
+        << "                          on the standby's copy of the site\n"
+        << "  Car Parking --revenue <dir> [--by hour|day|month] [--last N] [--at \"YYYY-MM-DD HH:MM\"]\n"
+        << "                          Revenue of the last N periods up to now or that time, from ledger.dat\n"
+        << "Any mode also takes --trace trace.json to record spans in the Chrome trace format.\n";
+}
+
+// Runs one mode. Split from runCommandLine() so a trace covers the whole mode whichever way it returns.
+static int runMode(const string& mode, const CommandLineOptions& options) {
+
+    if (mode == "--bench-parser") {
+        int spots = options.positional().empty() ? 1000000 : atoi(options.positional()[0].c_str());
+        return runParserBenchmark(spots);
+    }
+    if (mode == "--generate") {
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        GeneratorOptions garage;
+        if (!readGeneratorOptions(options, garage)) {
+            return 1;
+        }
+        return generateGarageFiles(garage, options.positional()[0]) ? 0 : 1;
+    }
+    if (mode == "--bench") {
+        BenchmarkOptions bench;
+        if (options.has("sizes")) {
+            bench.sizes.clear();
+            stringstream ss(options.get("sizes"));
+            string size;
+            while (getline(ss, size, ',')) {
+                if (atoi(size.c_str()) > 0) {
+                    bench.sizes.push_back(atoi(size.c_str()));
+                }
+            }
+        }
+        bench.spotsPerFloor = max(1, options.getInt("spots-per-floor", bench.spotsPerFloor));
+        bench.operations = max(1, options.getInt("ops", bench.operations));
+        bench.repeats = max(1, options.getInt("repeats", bench.repeats));
+        bench.outputPath = options.get("out");
+        if (!readGeneratorOptions(options, bench.garage)) {
+            return 1;
+        }
+        return runBenchmarkSuite(bench);
+    }
+
+    if (mode == "--simulate") {
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        SimulationOptions simulation;
+        simulation.hours = options.getDouble("hours", simulation.hours);
+        if (options.has("arrivals")) {
+            simulation.arrivalsPerHour.clear();
+            stringstream ss(options.get("arrivals"));
+            string rate;
+            while (getline(ss, rate, ',')) {
+                simulation.arrivalsPerHour.push_back(atof(rate.c_str()));
+            }
+        }
+        if (options.has("vehicles") && !parseTypeMix(options.get("vehicles"), simulation.vehicleMix)) {
+            cerr << "Error: invalid vehicle mix " << options.get("vehicles") << " (expected e.g. Car=60,Van=30,Motorcycle=10)\n";
+            return 1;
+        }
+        simulation.meanDwellMinutes = options.getDouble("dwell-minutes", simulation.meanDwellMinutes);
+        simulation.dwellSpread = options.getDouble("dwell-spread", simulation.dwellSpread);
+        simulation.exitGates = options.getInt("exits", simulation.exitGates);
+        simulation.speed = options.getDouble("speed", simulation.speed);
+        simulation.sampleMinutes = options.getInt("sample-minutes", simulation.sampleMinutes);
+        simulation.seed = static_cast<unsigned int>(options.getInt("seed", static_cast<int>(simulation.seed)));
+        simulation.persist = options.getInt("persist", 0) != 0;
+        simulation.dashboard = options.getInt("dashboard", 0) != 0;
+        simulation.readers = options.getInt("readers", 0);
+        string assignment = options.get("assign", "random");
+        if (assignment != "random" && assignment != "nearest") {
+            cerr << "Error: --assign must be random or nearest\n";
+            return 1;
+        }
+        simulation.nearestSpot = assignment == "nearest";
+
+        Garage site;
+        site.name = "Simulation";
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        if (options.getInt("log", 0) != 0) {
+            site.events.open(site, time(nullptr)); // Records the run in the site's history, for a standby to follow
+        }
+        if (!options.has("out")) {
+            startConfigWatcher(); // Rates edited during the run apply to the next settlements
+            watchConfig(site);
+            int result = runSimulation(site, simulation, cout);
+            stopConfigWatcher();
+            return result;
+        }
+        ofstream outFile(options.get("out"));
+        if (!outFile.is_open()) {
+            cerr << "Error: Unable to open " << options.get("out") << " for writing\n";
+            return 1;
+        }
+        startConfigWatcher();
+        watchConfig(site);
+        int result = runSimulation(site, simulation, outFile);
+        stopConfigWatcher();
+        cerr << "Report written to " << options.get("out") << "\n";
+        return result;
+    }
+
+    if (mode == "--dashboard") {
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        runLiveDashboard(site);
+        return 0;
+    }
+
+    if (mode == "--customers") {
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        CustomerQuery query;
+        const map<string, CustomerStatus> statuses = { { "all", CustomerStatus::Any }, { "active", CustomerStatus::Active },
+            { "not-parked", CustomerStatus::NotParked }, { "departed", CustomerStatus::Departed } };
+        const map<string, CustomerSortKey> sortKeys = { { "plate", CustomerSortKey::Plate }, { "start", CustomerSortKey::StartTime },
+            { "duration", CustomerSortKey::Duration }, { "fee", CustomerSortKey::Fee } };
+        auto status = statuses.find(options.get("status", "all"));
+        auto sortKey = sortKeys.find(options.get("sort", "plate"));
+        if (status == statuses.end() || sortKey == sortKeys.end()) {
+            printUsage();
+            return 1;
+        }
+        query.status = status->second;
+        query.sortKey = sortKey->second;
+        query.parkingType = options.get("type");
+        query.minimumHours = options.getDouble("min-hours", 0);
+        query.minimumFee = options.getDouble("min-fee", 0);
+        query.descending = options.getInt("descending", 0) != 0;
+        query.pageSize = static_cast<size_t>(max(1, options.getInt("page-size", 20)));
+        int page = options.getInt("page", 0);
+
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        CustomerCursor cursor(site, query, time(nullptr));
+        while (!cursor.done() && (page <= 0 || static_cast<int>(cursor.pagesWritten()) < page)) {
+            if (page > 0 && static_cast<int>(cursor.pagesWritten()) < page - 1) {
+                ostream discard(nullptr); // Pages before the requested one only move the cursor
+                cursor.nextPage(discard);
+            }
+            else {
+                cursor.nextPage(cout);
+            }
+        }
+        cerr << cursor.rowsWritten() << " customers in " << cursor.pagesWritten() << " pages\n";
+        return 0;
+    }
+
+    if (mode == "--bulk") {
+        const map<string, BulkAction> actions = { { "retype", BulkAction::Retype }, { "delete", BulkAction::Delete },
+            { "clear", BulkAction::Clear }, { "add", BulkAction::Add } };
+        auto action = actions.find(options.get("action"));
+        BulkEdit edit;
+        if (options.positional().empty() || action == actions.end()) {
+            printUsage();
+            return 1;
+        }
+        if (!parseSpotRanges(options.get("spots"), edit.ranges)) {
+            cerr << "Error: invalid spot ranges " << options.get("spots") << " (expected e.g. B1_1-B1_500,B2_7)\n";
+            return 1;
+        }
+        edit.action = action->second;
+        edit.parkingType = options.get("type");
+
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        BulkEditSummary summary = applyBulkEdit(site, edit);
+        writeBulkEditSummary(cout, edit, summary);
+        return summary.errors.empty() && summary.saved ? 0 : 1;
+    }
+
+    if (mode == "--import") {
+        if (options.positional().empty() || options.has("layout") == options.has("customers")) {
+            printUsage();
+            return 1;
+        }
+        ImportKind kind = options.has("layout") ? ImportKind::Layout : ImportKind::Customers;
+
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        site.events.open(site, time(nullptr)); // So the import is checkpointed in the site's history
+        ImportSummary summary = importFile(site, kind, options.get(kind == ImportKind::Layout ? "layout" : "customers"));
+        writeImportSummary(cout, kind, summary);
+        return summary.errorCount == 0 && summary.saved ? 0 : 1;
+    }
+
+    if (mode == "--bench-replay") {
+        return runReplayBenchmark(options.getInt("spots", 10000), options.getInt("events", 100000), options.getInt("interval", 1000));
+    }
+    if (mode == "--bench-kiosk") {
+        KioskBenchmarkOptions kiosk;
+        kiosk.spots = options.getInt("spots", kiosk.spots);
+        kiosk.logins = options.getInt("logins", kiosk.logins);
+        kiosk.rentPercent = options.getInt("rent-percent", kiosk.rentPercent);
+        kiosk.returnPercent = options.getInt("return-percent", kiosk.returnPercent);
+        kiosk.seed = static_cast<unsigned int>(options.getInt("seed", static_cast<int>(kiosk.seed)));
+        return runKioskBenchmark(kiosk);
+    }
+    if (mode == "--bench-floors") {
+        FloorBenchmarkOptions floors;
+        floors.spots = options.getInt("spots", floors.spots);
+        floors.floors = options.getInt("floors", floors.floors);
+        floors.budgetMegabytes = options.getDouble("budget-mb", floors.budgetMegabytes);
+        floors.transactions = options.getInt("transactions", floors.transactions);
+        floors.occupancy = options.getDouble("occupancy", floors.occupancy);
+        floors.seed = static_cast<unsigned int>(options.getInt("seed", static_cast<int>(floors.seed)));
+        return runFloorBenchmark(floors);
+    }
+    if (mode == "--history") {
+        time_t asOf;
+        if (options.positional().empty() || !options.has("at")) {
+            printUsage();
+            return 1;
+        }
+        if (!parseLocalTime(options.get("at"), asOf)) {
+            cerr << "Error: invalid time " << options.get("at") << "\n";
+            return 1;
+        }
+        Garage state;
+        state.name = options.positional()[0];
+        state.dataDir = options.positional()[0];
+        ReplayResult result = reconstructSite(state.dataDir, asOf, state);
+        if (!result.restored) {
+            cerr << "Error: " << result.error << "\n";
+            return 1;
+        }
+        writeSiteHistory(cout, state, result, asOf, options.has("plate") ? options.get("plate") : "");
+        return 0;
+    }
+    if (mode == "--overstays") {
+        time_t asOf = time(nullptr);
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        if (options.has("at") && !parseLocalTime(options.get("at"), asOf)) {
+            cerr << "Error: invalid time " << options.get("at") << "\n";
+            return 1;
+        }
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        writeOverstays(cout, site.overstays.current(site, asOf), asOf);
+        return 0;
+    }
+    if (mode == "--standby") {
+        if (options.positional().empty()) {
+            printUsage();
+            return 1;
+        }
+        // The site lives with the other sites, so that after a promotion the menus work on it as it is
+        Garage& site = garages[options.get("name", "Main")];
+        site.name = options.get("name", "Main");
+        site.dataDir = options.positional()[0];
+        currentGarage = &site;
+        loadGarage(site); // Ledger, forecast, limits and entrance costs; the spots and customers come from the log
+        startConfigWatcher(); // Parking type edits are not in the log
+        int result = runStandby(site, options.getInt("poll-ms", 10), cin, cout);
+        if (result != standbyPromoted) {
+            stopConfigWatcher();
+        }
+        return result;
+    }
+    if (mode == "--revenue") {
+        time_t asOf = time(nullptr);
+        string by = options.has("by") ? options.get("by") : "day";
+        if (options.positional().empty() || (by != "hour" && by != "day" && by != "month")) {
+            printUsage();
+            return 1;
+        }
+        if (options.has("at") && !parseLocalTime(options.get("at"), asOf)) {
+            cerr << "Error: invalid time " << options.get("at") << "\n";
+            return 1;
+        }
+        LedgerPeriod period = by == "hour" ? LedgerPeriod::Hour : by == "day" ? LedgerPeriod::Day : LedgerPeriod::Month;
+        int last = options.getInt("last", period == LedgerPeriod::Hour ? 24 : period == LedgerPeriod::Day ? 31 : 12);
+        if (last < 1) {
+            cerr << "Error: --last must be at least 1\n";
+            return 1;
+        }
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        writeRevenueReport(cout, site.ledger, period, asOf, last);
+        return 0;
+    }
+    if (mode == "--query") {
+        vector<string> texts(options.positional().begin() + (options.positional().empty() ? 0 : 1), options.positional().end());
+        if (options.has("file")) {
+            ifstream file(options.get("file"));
+            if (!file) {
+                cerr << "Error: Unable to open " << options.get("file") << "\n";
+                return 1;
+            }
+            string line;
+            while (getline(file, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    texts.push_back(line);
+                }
+            }
+        }
+        if (options.positional().empty() || texts.empty()) {
+            printUsage();
+            return 1;
+        }
+
+        Garage site;
+        site.name = options.positional()[0];
+        site.dataDir = options.positional()[0];
+        loadGarage(site);
+        time_t now = time(nullptr);
+        int failed = 0;
+        for (const auto& text : texts) {
+            Query query;
+            string error;
+            if (texts.size() > 1) {
+                cout << "> " << text << "\n";
+            }
+            if (!parseQuery(text, query, error)) {
+                cerr << "Error: invalid query \"" << text << "\": " << error << "\n";
+                ++failed;
+                continue;
+            }
+            writeQueryResult(cout, query, runQuery(site, query, now));
+        }
+        return failed == 0 ? 0 : 1;
+    }
+
+    printUsage();
+    return 1;
+}
+
+int runCommandLine(int argc, char* argv[]) {
+    string mode = argv[1];
+    CommandLineOptions options(argc, argv, 2);
+    if (options.has("trace") && !startTracing(options.get("trace"))) {
+        return 1;
+    }
+    loadSharedData(); // The parking type to vehicle types table drives generation and validation
+    int result = runMode(mode, options);
+    if (options.has("trace")) {
+        uint64_t spans = stopTracing();
+        cerr << spans << " trace spans written to " << options.get("trace") << "\n";
+    }
+    return result;
+}
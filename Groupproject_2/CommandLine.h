@@ -0,0 +1,26 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Arguments of a command line mode: "--name value" pairs plus any plain arguments.
+class CommandLineOptions {
+public:
+    CommandLineOptions(int argc, char* argv[], int first);
+
+    bool has(const std::string& name) const;
+    std::string get(const std::string& name, const std::string& fallback = "") const;
+    int getInt(const std::string& name, int fallback) const;
+    double getDouble(const std::string& name, double fallback) const;
+
+    // Arguments that are not part of a "--name value" pair, in order.
+    const std::vector<std::string>& positional() const { return plain; }
+
+private:
+    std::map<std::string, std::string> values;
+    std::vector<std::string> plain;
+};
+
+// Runs the non-interactive mode named by argv[1] (for example --bench). Returns the process exit code.
+int runCommandLine(int argc, char* argv[]);
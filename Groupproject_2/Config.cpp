@@ -0,0 +1,360 @@
+#include "Config.h"
+#include "Parking.h"
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+double SiteConfig::hourlyRate(const string& parkingType) const {
+    auto rates = hourlyRates.find(parkingType);
+    if (rates == hourlyRates.end()) {
+        return 0.0;
+    }
+    auto defaultRate = rates->second.find("Default");
+    return defaultRate != rates->second.end() ? defaultRate->second : 0.0;
+}
+
+bool SiteConfig::acceptsVehicle(const string& parkingType, const string& vehicleType) const {
+    auto it = parkingTypes.find(parkingType);
+    return it != parkingTypes.end() && it->second.find(vehicleType) != it->second.end();
+}
+
+bool SiteConfig::knowsVehicle(const string& vehicleType) const {
+    for (const auto& type : parkingTypes) {
+        if (type.second.count(vehicleType) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SiteConfig::sameSettings(const SiteConfig& other) const {
+    return hourlyRates == other.hourlyRates && dailyMaxRate == other.dailyMaxRate && parkingTypes == other.parkingTypes;
+}
+
+// The shared parking type table, for sites that do not exist yet
+static mutex sharedTypesMutex;
+static map<string, set<string>> sharedTypes;
+
+map<string, set<string>> sharedParkingTypes() {
+    lock_guard<mutex> lock(sharedTypesMutex);
+    return sharedTypes;
+}
+
+ConfigStore::ConfigStore() {
+    SiteConfig* first = new SiteConfig();
+    first->parkingTypes = sharedParkingTypes();
+    first->version = ++published;
+    current.store(first);
+}
+
+ConfigStore::~ConfigStore() {
+    epochDomain().retire(current.exchange(nullptr));
+}
+
+uint64_t ConfigStore::swapIn(SiteConfig* next) {
+    next->version = ++published;
+    const SiteConfig* old = current.exchange(next); // Readers that pin from here on see the new config
+    epochDomain().retire(old);
+    epochDomain().collectIfDue();
+    return next->version;
+}
+
+bool ConfigStore::replace(const SiteConfig& config) {
+    lock_guard<mutex> lock(writerMutex);
+    if (current.load()->sameSettings(config)) {
+        return false;
+    }
+    swapIn(new SiteConfig(config));
+    return true;
+}
+
+ConfigView::ConfigView(const Garage& site) : config(site.config.latest()) {
+}
+
+bool readSiteRates(const Garage& site, SiteConfig& config) {
+    string buffer;
+    vector<ParseError> errors;
+    bool valid = true;
+
+    string path = garageFilePath(site, "hourlyRates.dat");
+    config.hourlyRates.clear();
+    if (readWholeFile(path, buffer)) {
+        parseHourlyRates(buffer, config.hourlyRates, errors);
+        reportParseErrors(path, errors);
+        valid = errors.empty();
+    }
+    else {
+        // Default hourly rates if the file doesn't exist
+        config.hourlyRates["Compact"]["Default"] = 2.0;
+        config.hourlyRates["Handicapped"]["Default"] = 3.0;
+        config.hourlyRates["Motorcycle"]["Default"] = 1.5;
+    }
+
+    path = garageFilePath(site, "dailyMaxRate.dat");
+    errors.clear();
+    if (readWholeFile(path, buffer)) {
+        if (!parseDailyMaxRate(buffer, config.dailyMaxRate, errors)) {
+            reportParseErrors(path, errors);
+            valid = false;
+        }
+    }
+    else {
+        config.dailyMaxRate = 50.0; // Default daily maximum rate if the file doesn't exist
+    }
+    return valid;
+}
+
+// Publishes the parking types in the site's config. Returns true if they changed.
+static bool publishParkingTypes(Garage& site, const map<string, set<string>>& parkingTypes) {
+    SiteConfig config;
+    {
+        ConfigView view(site);
+        config = *view;
+    }
+    config.parkingTypes = parkingTypes;
+    return site.config.replace(config); // Unchanged tables are not published again
+}
+
+void publishParkingTypes(const map<string, set<string>>& parkingTypes) {
+    {
+        lock_guard<mutex> lock(sharedTypesMutex);
+        sharedTypes = parkingTypes;
+    }
+    for (auto& entry : garages) {
+        publishParkingTypes(entry.second, parkingTypes);
+    }
+}
+
+// The watcher thread and the sites it watches
+static thread watcherThread;
+static mutex watcherMutex;
+static condition_variable watcherWakeUp;
+static bool watcherStopping = false;
+static vector<Garage*> watchedSites; // Guarded by watcherMutex
+static atomic<uint64_t> reloads{ 0 };
+static atomic<uint64_t> rejections{ 0 };
+
+static const char* const typesFile = "parkingTypeToVehicleTypes.dat";
+static const char* const rateFiles[] = { "hourlyRates.dat", "dailyMaxRate.dat" };
+static const auto settleTime = chrono::milliseconds(100); // Lets an editor finish writing before the file is read
+
+uint64_t configReloads() {
+    return reloads.load();
+}
+
+uint64_t configRejections() {
+    return rejections.load();
+}
+
+void watchConfig(Garage& site) {
+    lock_guard<mutex> lock(watcherMutex);
+    watchedSites.push_back(&site);
+    watcherWakeUp.notify_all();
+}
+
+// Reads the rate files of a site and swaps them in if they are valid and changed.
+static void reloadSiteRates(Garage& site) {
+    OperationTimer timer(Operation::ReloadConfig);
+    TraceSpan span("reloadSiteRates", site.name);
+    SiteConfig config;
+    {
+        ConfigView view(site);
+        config = *view;
+    }
+    if (!readSiteRates(site, config) || config.hourlyRates.empty()) {
+        ++rejections;
+        cerr << "Error: kept the current rates of site " << site.name << "\n";
+        return;
+    }
+    if (site.config.replace(config)) {
+        ++reloads;
+    }
+}
+
+// Reads the shared parking type table and swaps it into every watched site if it is valid and changed.
+static void reloadParkingTypes(const vector<Garage*>& sites) {
+    OperationTimer timer(Operation::ReloadConfig);
+    TraceSpan span("reloadParkingTypes");
+    string buffer;
+    if (!readWholeFile(typesFile, buffer)) {
+        return; // Being replaced; the rename brings another event
+    }
+    map<string, set<string>> parkingTypes;
+    vector<ParseError> errors;
+    parseParkingTypes(buffer, parkingTypes, errors);
+    reportParseErrors(typesFile, errors);
+    if (!errors.empty() || parkingTypes.empty()) {
+        ++rejections;
+        cerr << "Error: kept the current parking types\n";
+        return;
+    }
+    {
+        lock_guard<mutex> lock(sharedTypesMutex);
+        sharedTypes = parkingTypes;
+    }
+    for (Garage* site : sites) {
+        if (publishParkingTypes(*site, parkingTypes)) {
+            ++reloads;
+        }
+    }
+}
+
+// Reloads what changed. Sites are reloaded once however many of their files changed.
+static void reloadChanged(const vector<Garage*>& changedSites, bool typesChanged, const vector<Garage*>& sites) {
+    if (typesChanged) {
+        reloadParkingTypes(sites);
+    }
+    for (Garage* site : changedSites) {
+        reloadSiteRates(*site);
+    }
+}
+
+#ifdef __linux__
+// Watches the directories of the config files with inotify. A save by rename shows up as IN_MOVED_TO
+// and an edit in place as IN_CLOSE_WRITE, both naming the file inside the watched directory.
+static void runWatcher() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        cerr << "Error: Unable to watch the configuration files\n";
+        return;
+    }
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO;
+    map<int, string> directories; // Watch descriptor -> directory
+    int rootWatch = inotify_add_watch(fd, ".", mask);
+    directories[rootWatch] = ".";
+    vector<Garage*> sites;
+
+    unique_lock<mutex> lock(watcherMutex);
+    while (!watcherStopping) {
+        // Watches the directories of sites added since the last round
+        for (size_t i = sites.size(); i < watchedSites.size(); ++i) {
+            sites.push_back(watchedSites[i]);
+            string dir = sites.back()->dataDir.empty() ? "." : sites.back()->dataDir;
+            int watch = inotify_add_watch(fd, dir.c_str(), mask);
+            if (watch >= 0) {
+                directories[watch] = dir;
+            }
+        }
+        lock.unlock();
+
+        pollfd ready = { fd, POLLIN, 0 };
+        bool typesChanged = false;
+        vector<Garage*> changedSites;
+        // After the first event, keep reading until the files have been quiet for settleTime
+        for (int timeout = 250; poll(&ready, 1, timeout) > 0; timeout = static_cast<int>(settleTime.count())) {
+            alignas(inotify_event) char events[4096];
+            ssize_t length;
+            while ((length = read(fd, events, sizeof(events))) > 0) {
+                for (char* position = events; position < events + length;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+                    position += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) continue;
+                    string name = event->name;
+                    const string& dir = directories[event->wd];
+                    typesChanged = typesChanged || (dir == "." && name == typesFile);
+                    if (name != rateFiles[0] && name != rateFiles[1]) continue;
+                    for (Garage* site : sites) {
+                        string siteDir = site->dataDir.empty() ? "." : site->dataDir;
+                        if (siteDir == dir && find(changedSites.begin(), changedSites.end(), site) == changedSites.end()) {
+                            changedSites.push_back(site);
+                        }
+                    }
+                }
+            }
+        }
+        reloadChanged(changedSites, typesChanged, sites);
+        lock.lock();
+    }
+    close(fd);
+}
+#else
+// A rate file of one site, or the shared types file for a null site.
+struct WatchedFile {
+    Garage* site;
+    string path;
+    pair<filesystem::file_time_type, uintmax_t> stamp;
+};
+
+static pair<filesystem::file_time_type, uintmax_t> fileStamp(const string& path) {
+    error_code ec;
+    auto modified = filesystem::last_write_time(path, ec);
+    uintmax_t size = filesystem::file_size(path, ec);
+    return { ec ? filesystem::file_time_type() : modified, ec ? 0 : size };
+}
+
+// Compares the modification time and size of every config file once a second.
+static void runWatcher() {
+    vector<WatchedFile> files = { { nullptr, typesFile, fileStamp(typesFile) } };
+    vector<Garage*> sites;
+
+    unique_lock<mutex> lock(watcherMutex);
+    while (!watcherStopping) {
+        for (size_t i = sites.size(); i < watchedSites.size(); ++i) {
+            sites.push_back(watchedSites[i]);
+            for (const char* fileName : rateFiles) {
+                string path = garageFilePath(*sites.back(), fileName);
+                files.push_back({ sites.back(), path, fileStamp(path) });
+            }
+        }
+        lock.unlock();
+
+        bool typesChanged = false;
+        vector<Garage*> changedSites;
+        for (WatchedFile& file : files) {
+            auto stamp = fileStamp(file.path);
+            if (stamp == file.stamp) continue;
+            file.stamp = stamp;
+            if (file.site == nullptr) {
+                typesChanged = true;
+            }
+            else if (find(changedSites.begin(), changedSites.end(), file.site) == changedSites.end()) {
+                changedSites.push_back(file.site);
+            }
+        }
+        if (typesChanged || !changedSites.empty()) {
+            this_thread::sleep_for(settleTime);
+            reloadChanged(changedSites, typesChanged, sites);
+        }
+
+        lock.lock();
+        watcherWakeUp.wait_for(lock, chrono::seconds(1));
+    }
+}
+#endif
+
+void startConfigWatcher() {
+    if (watcherThread.joinable()) {
+        return;
+    }
+    watcherStopping = false;
+    watcherThread = thread(runWatcher);
+}
+
+void stopConfigWatcher() {
+    if (!watcherThread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(watcherMutex);
+        watcherStopping = true;
+    }
+    watcherWakeUp.notify_all();
+    watcherThread.join();
+    watchedSites.clear();
+}
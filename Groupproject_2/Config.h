@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "Epoch.h"
+
+struct Garage;
+
+// Pricing and type configuration of one site: its hourly rates and daily maximum, and the parking
+// type to vehicle types table shared by every site. A published config is never changed; an edit
+// or a reload builds a new one and swaps it in, so a fee is always computed from one consistent set
+// of rates.
+struct SiteConfig {
+    uint64_t version = 0;
+    std::map<std::string, std::map<std::string, double>> hourlyRates; // Parking type -> "Default" -> rate
+    double dailyMaxRate = 50.0;
+    std::map<std::string, std::set<std::string>> parkingTypes; // Parking type -> vehicle types
+
+    // Hourly rate of the parking type, 0 if none is set.
+    double hourlyRate(const std::string& parkingType) const;
+    bool acceptsVehicle(const std::string& parkingType, const std::string& vehicleType) const;
+    bool knowsVehicle(const std::string& vehicleType) const;
+
+    // True when the rates and types are the same, whatever the versions.
+    bool sameSettings(const SiteConfig& other) const;
+};
+
+// The published config of one site. Readers pin the epoch and load one pointer, and never take a
+// lock; writers copy the current config, change the copy and swap it in, and the config it replaced
+// is retired to the epoch domain and freed once no reader can still hold it.
+class ConfigStore {
+public:
+    ConfigStore();
+    ~ConfigStore();
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    // The current config; only safe to use while the calling thread is pinned.
+    const SiteConfig* latest() const { return current.load(); }
+
+    // Publishes a copy of the current config changed by edit. Writers take turns; readers never wait.
+    template <typename Edit>
+    uint64_t update(Edit edit) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        SiteConfig* next = new SiteConfig(*current.load());
+        edit(*next);
+        return swapIn(next);
+    }
+
+    // Publishes the rates and types of config unless they are what is already published, as they
+    // are when the watcher sees a file this process just saved. Returns true if it was swapped in.
+    bool replace(const SiteConfig& config);
+
+    uint64_t versionsPublished() const { return published.load(); }
+
+private:
+    uint64_t swapIn(SiteConfig* next); // Called with writerMutex held
+
+    std::atomic<const SiteConfig*> current{ nullptr };
+    std::atomic<uint64_t> published{ 0 };
+    std::mutex writerMutex; // Writers only
+};
+
+// A site's config as it was when the view was created. Costs an epoch pin and one atomic load.
+class ConfigView {
+public:
+    explicit ConfigView(const Garage& site);
+
+    ConfigView(const ConfigView&) = delete;
+    ConfigView& operator=(const ConfigView&) = delete;
+
+    const SiteConfig& operator*() const { return *config; }
+    const SiteConfig* operator->() const { return config; }
+
+private:
+    EpochGuard guard; // Pinned before the config is loaded
+    const SiteConfig* config;
+};
+
+// Reads the site's hourlyRates.dat and dailyMaxRate.dat into config, replacing its rates. A
+// missing file gives the default rates. Returns false if either file has an invalid line; the
+// errors are reported and the valid lines still read.
+bool readSiteRates(const Garage& site, SiteConfig& config);
+
+// The parking type to vehicle types table shared by every site, as it was last read or edited.
+// A site created from then on starts with it; sites read it from their config.
+std::map<std::string, std::set<std::string>> sharedParkingTypes();
+
+// Makes parkingTypes the shared table and publishes it in the config of every site.
+void publishParkingTypes(const std::map<std::string, std::set<std::string>>& parkingTypes);
+
+// Starts a background thread that watches the shared parkingTypeToVehicleTypes.dat and the rate
+// files of every watched site, using inotify where it is available and modification times
+// elsewhere. A changed file is parsed and validated on that thread, and only a valid config that
+// differs from the published one is swapped in; an invalid file is reported and the old config
+// kept. stopConfigWatcher() joins the thread.
+void startConfigWatcher();
+void stopConfigWatcher();
+
+// Adds a site to the sites whose rate files are watched. Sites are never removed, so the site must
+// live until the watcher is stopped.
+void watchConfig(Garage& site);
+
+// Number of configs the watcher has swapped in since it started, and files it rejected.
+uint64_t configReloads();
+uint64_t configRejections();
@@ -0,0 +1,205 @@
+#include "CustomerQuery.h"
+#include "Parking.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace std;
+
+CustomerStatus customerStatus(const Customer& customer) {
+    if (customer.startTime == 0) {
+        return CustomerStatus::NotParked;
+    }
+    return customer.endTime == 0 ? CustomerStatus::Active : CustomerStatus::Departed;
+}
+
+CustomerCursor::CustomerCursor(const Garage& site, const CustomerQuery& query, time_t now)
+    : view(site), config(site), query(query), now(now) {
+    this->query.pageSize = max<size_t>(this->query.pageSize, 1);
+}
+
+// Applies the filters and computes the sort value. The fee is only calculated when needed.
+bool CustomerCursor::matches(const Customer& customer, double& value) const {
+    CustomerStatus status = customerStatus(customer);
+    if (query.status != CustomerStatus::Any && query.status != status) {
+        return false;
+    }
+    if (!query.parkingType.empty() && customer.parkingType != query.parkingType) {
+        return false;
+    }
+
+    double hours = 0; // Started hours, as the fee calculation counts them
+    if (status != CustomerStatus::NotParked) {
+        hours = ceil(difftime(status == CustomerStatus::Active ? now : customer.endTime, customer.startTime) / 3600.0);
+    }
+    if (hours < query.minimumHours) {
+        return false;
+    }
+
+    double fee = 0;
+    if (query.minimumFee > 0 || query.sortKey == CustomerSortKey::Fee) {
+        if (status == CustomerStatus::Active) {
+            double totalHours;
+            fee = calculateParkingFee(*config, customer.parkingType, customer.startTime, now, totalHours);
+        }
+        else if (status == CustomerStatus::Departed) {
+            fee = customer.payment;
+        }
+        if (fee < query.minimumFee) {
+            return false;
+        }
+    }
+
+    switch (query.sortKey) {
+    case CustomerSortKey::StartTime:
+        value = static_cast<double>(customer.startTime);
+        break;
+    case CustomerSortKey::Duration:
+        value = hours;
+        break;
+    case CustomerSortKey::Fee:
+        value = fee;
+        break;
+    default:
+        value = 0;
+    }
+    return true;
+}
+
+// Returns whether a comes before b in the listing.
+bool CustomerCursor::before(const Position& a, const Position& b) const {
+    if (a.value != b.value) {
+        return query.descending ? a.value > b.value : a.value < b.value;
+    }
+    return query.descending ? *a.plate > *b.plate : *a.plate < *b.plate;
+}
+
+void CustomerCursor::writeRow(ostream& out, const Customer& customer) {
+    const char* vehicleType = customer.vehicleType.empty() ? "Not specified" : customer.vehicleType.c_str();
+    if (!query.detailed) {
+        out << "Plate Number: " << customer.plateNumber << "\n";
+        out << "Vehicle Type: " << vehicleType << "\n";
+        out << "--------------------------\n";
+        return;
+    }
+
+    out << "Plate Number: " << customer.plateNumber << "\n";
+    out << "Vehicle Type: " << vehicleType << "\n";
+    out << "Entrance: " << customer.entrance << "\n";
+
+    if (customer.vehicleType.empty() && customer.entrance == 0) {
+        out << "Status: Not rented a parking spot yet\n";
+    }
+    else if (customer.startTime == 0) {
+        out << "Start Time: Not yet parked\n";
+        out << "Current parking duration: Not yet parked\n";
+        out << "Current estimated payment due: Not yet parked\n";
+        out << "End Time: Not yet parked\n";
+    }
+    else if (customer.endTime == 0) {
+        double totalHours; // Total parking duration, rounded up to the nearest hour
+        double payment = calculateParkingFee(*config, customer.parkingType, customer.startTime, now, totalHours);
+
+        // Convert start time to string using the thread-safe localtime of the platform
+        struct tm timeinfo;
+        char startTimeStr[20];
+#ifdef _WIN32
+        localtime_s(&timeinfo, &customer.startTime);
+#else
+        localtime_r(&customer.startTime, &timeinfo);
+#endif
+        strftime(startTimeStr, sizeof(startTimeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
+
+        out << "Start Time: " << startTimeStr << "\n";
+        out << "Current parking duration: " << totalHours << " hours\n";
+        out << "Current estimated payment due: $" << fixed << setprecision(2) << payment << "\n";
+        out.unsetf(ios::floatfield);
+        out << "End Time: Not yet departed\n"; // Show not yet departed
+    }
+    else {
+        out << "Status: Departed\n"; // Show departed but don't display specific end time and payment
+    }
+    out << "--------------------------\n";
+}
+
+size_t CustomerCursor::nextPage(ostream& out) {
+    if (finished) {
+        return 0;
+    }
+    TraceSpan span("customerPage");
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    const GarageVersion& customers = *view;
+    size_t written = 0;
+    double value;
+
+    if (query.sortKey == CustomerSortKey::Plate && !query.descending) {
+        // The pages are already in plate order: resume after the last plate and write rows as they match
+        auto it = started ? customers.customerUpperBound(lastPlate) : customers.customersBegin();
+        for (; it != customers.customersEnd() && written < query.pageSize; ++it) {
+            if (matches(*it, value)) {
+                writeRow(out, *it);
+                lastPlate = it->plateNumber;
+                ++written;
+            }
+        }
+        finished = it == customers.customersEnd();
+    }
+    else if (query.sortKey == CustomerSortKey::Plate) {
+        auto it = started ? customers.customerLowerBound(lastPlate) : customers.customersEnd();
+        while (it != customers.customersBegin() && written < query.pageSize) {
+            --it;
+            if (matches(*it, value)) {
+                writeRow(out, *it);
+                lastPlate = it->plateNumber;
+                ++written;
+            }
+        }
+        finished = it == customers.customersBegin();
+    }
+    else {
+        // Keep the first pageSize rows after the last one written; the heap's front is the latest of them
+        vector<pair<Position, const Customer*>> page;
+        page.reserve(query.pageSize);
+        auto later = [this](const pair<Position, const Customer*>& a, const pair<Position, const Customer*>& b) {
+            return before(a.first, b.first);
+        };
+        Position last{ lastValue, &lastPlate };
+        size_t remaining = 0;
+        for (auto it = customers.customersBegin(); it != customers.customersEnd(); ++it) {
+            const Customer& customer = *it;
+            if (!matches(customer, value)) continue;
+            Position position{ value, &customer.plateNumber };
+            if (started && !before(last, position)) continue; // Already written
+            ++remaining;
+            if (page.size() < query.pageSize) {
+                page.emplace_back(position, &customer);
+                push_heap(page.begin(), page.end(), later);
+            }
+            else if (before(position, page.front().first)) {
+                pop_heap(page.begin(), page.end(), later);
+                page.back() = { position, &customer };
+                push_heap(page.begin(), page.end(), later);
+            }
+        }
+        sort_heap(page.begin(), page.end(), later);
+        for (const auto& row : page) {
+            writeRow(out, *row.second);
+        }
+        if (!page.empty()) {
+            lastValue = page.back().first.value;
+            lastPlate = *page.back().first.plate;
+        }
+        written = page.size();
+        finished = remaining <= query.pageSize;
+    }
+
+    started = true;
+    ++pages;
+    rows += written;
+    out.flags(flags);
+    out.precision(precision);
+    return written;
+}
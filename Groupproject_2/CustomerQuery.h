@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <ostream>
+#include <string>
+
+#include "Parking.h"
+
+// Where a customer is in the rental lifecycle.
+enum class CustomerStatus {
+    Any, // Filter value only: matches every customer
+    NotParked, // Registered but no start time yet
+    Active, // Parked and not yet departed
+    Departed
+};
+
+enum class CustomerSortKey {
+    Plate,
+    StartTime,
+    Duration,
+    Fee // Payment due so far for active customers, payment made for departed ones
+};
+
+// Filters, order and page size of a customer listing.
+struct CustomerQuery {
+    CustomerStatus status = CustomerStatus::Any;
+    std::string parkingType; // Empty matches every parking type
+    double minimumHours = 0; // Parking duration in started hours
+    double minimumFee = 0;
+    CustomerSortKey sortKey = CustomerSortKey::Plate;
+    bool descending = false;
+    size_t pageSize = 20;
+    bool detailed = true; // The full record of each customer, otherwise one line with plate and vehicle type
+};
+
+CustomerStatus customerStatus(const Customer& customer);
+
+// Walks the site's customers one page at a time. The cursor only remembers the sort position of
+// the last row it wrote, so memory stays bounded by the page size whatever the table size. Plate
+// order follows the customer map directly and each row is written as soon as it matches; other
+// orders keep the page's best rows in a heap of pageSize entries during one pass over the map.
+// Fees are only calculated for rows that are written, unless the query filters or sorts on them.
+// The cursor reads a view of the site and its rates pinned when it is created, so the site may change while it
+// is in use without affecting the listing; it must be used on the thread that created it.
+class CustomerCursor {
+public:
+    CustomerCursor(const Garage& site, const CustomerQuery& query, time_t now);
+
+    // Writes the next page to out. Returns the number of customers written, 0 once the listing is done.
+    size_t nextPage(std::ostream& out);
+
+    bool done() const { return finished; }
+    size_t pagesWritten() const { return pages; }
+    size_t rowsWritten() const { return rows; }
+
+private:
+    // Sort position of one customer.
+    struct Position {
+        double value;
+        const std::string* plate;
+    };
+
+    bool matches(const Customer& customer, double& value) const;
+    bool before(const Position& a, const Position& b) const;
+    void writeRow(std::ostream& out, const Customer& customer);
+
+    ReadView view;
+    ConfigView config; // Rates for the fees, pinned with the view
+    CustomerQuery query;
+    time_t now;
+    bool started = false;
+    bool finished = false;
+    double lastValue = 0;
+    std::string lastPlate;
+    size_t pages = 0;
+    size_t rows = 0;
+};
@@ -0,0 +1,156 @@
+#include "Dashboard.h"
+#include "Parking.h"
+
+#include <charconv>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+static const int cellWidth = 20; // Same layout as displayVisualParkingStatus()
+static const int cellsPerRow = 5;
+static const int dashboardRows = 40;
+static const int barWidth = 50;
+
+// Draws a number without building a string.
+static void writeNumber(ScreenRenderer& renderer, long long value) {
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    renderer.write(string_view(digits, result.ptr - digits));
+}
+
+void drawDashboard(ScreenRenderer& renderer, const Garage& site, time_t now, int maxRows) {
+    int totalSpots = 0;
+    int occupiedSpots = 0;
+    int spotRows = 0;
+    for (const auto& floor : site.floors) {
+        spotRows += 1 + static_cast<int>((floor.spots.size() + cellsPerRow - 1) / cellsPerRow);
+        for (const auto& spot : floor.spots) {
+            if (spot.type.empty()) continue; // Deleted spot
+            ++totalSpots;
+            occupiedSpots += spot.isOccupied ? 1 : 0;
+        }
+    }
+
+    renderer.beginFrame();
+    renderer.write("Live Parking Dashboard - Site ");
+    renderer.write(site.name);
+
+    struct tm timeinfo;
+    char clock[16];
+#ifdef _WIN32
+    localtime_s(&timeinfo, &now);
+#else
+    localtime_r(&now, &timeinfo);
+#endif
+    size_t clockLength = strftime(clock, sizeof(clock), "%H:%M:%S", &timeinfo);
+    renderer.moveTo(0, renderer.width() - static_cast<int>(clockLength));
+    renderer.write(string_view(clock, clockLength));
+
+    renderer.moveTo(1, 0);
+    renderer.write("Occupied ");
+    writeNumber(renderer, occupiedSpots);
+    renderer.write("/");
+    writeNumber(renderer, totalSpots);
+    renderer.write(" (");
+    writeNumber(renderer, totalSpots > 0 ? occupiedSpots * 100LL / totalSpots : 0);
+    renderer.write("%)");
+    renderer.moveTo(1, renderer.width() - 21);
+    renderer.write("Press Enter to exit");
+
+    vector<ForecastHour> expected = site.forecaster.forecast(site, "", "", now, 4);
+    if (!expected.empty()) {
+        renderer.moveTo(2, 0);
+        renderer.write("Expected free");
+        for (size_t i = 1; i < expected.size(); ++i) { // The hours after the one in progress
+            renderer.write("  +");
+            writeNumber(renderer, static_cast<long long>(i));
+            renderer.write("h ");
+            writeNumber(renderer, expected[i].freeSpots);
+        }
+    }
+
+    const int firstRow = 3;
+    int row = firstRow;
+    bool showSpots = firstRow + spotRows <= maxRows;
+    for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+        const Floor& floor = site.floors[handle];
+        if (row >= maxRows) {
+            renderer.moveTo(maxRows - 1, 0);
+            renderer.write("... ");
+            writeNumber(renderer, site.floors.size() - handle);
+            renderer.write(" more floors");
+            break;
+        }
+        if (showSpots) {
+            renderer.moveTo(row++, 0);
+            renderer.write("Floor: ");
+            renderer.write(floor.name);
+            for (size_t i = 0; i < floor.spots.size(); ++i) {
+                const ParkingSpot& spot = floor.spots[i];
+                int column = static_cast<int>(i % cellsPerRow) * cellWidth;
+                if (column == 0) ++row;
+                renderer.moveTo(row - 1, column);
+                renderer.write(spot.isOccupied ? "[X]" : "[ ]");
+                renderer.write(spot.id);
+                renderer.write("(");
+                renderer.write(spot.type);
+                renderer.write(")");
+            }
+        }
+        else {
+            // One bar per floor when the spots do not fit on the screen
+            int floorSpots = 0, floorOccupied = 0;
+            for (const auto& spot : floor.spots) {
+                if (spot.type.empty()) continue;
+                ++floorSpots;
+                floorOccupied += spot.isOccupied ? 1 : 0;
+            }
+            int filled = floorSpots > 0 ? static_cast<int>(static_cast<long long>(floorOccupied) * barWidth / floorSpots) : 0;
+            renderer.moveTo(row++, 0);
+            renderer.write(floor.name);
+            renderer.padTo(10);
+            renderer.write("[");
+            for (int i = 0; i < barWidth; ++i) {
+                renderer.write(i < filled ? "#" : "-");
+            }
+            renderer.write("] ");
+            writeNumber(renderer, floorOccupied);
+            renderer.write("/");
+            writeNumber(renderer, floorSpots);
+        }
+    }
+}
+
+// Identifies the current contents of the site's parking lot file.
+static pair<filesystem::file_time_type, uintmax_t> parkingLotsStamp(const Garage& site) {
+    error_code ec;
+    string path = garageFilePath(site, "parkingLots.dat");
+    auto modified = filesystem::last_write_time(path, ec);
+    uintmax_t size = filesystem::file_size(path, ec);
+    return { modified, ec ? 0 : size };
+}
+
+void runLiveDashboard(Garage& site) {
+    if (!enableAnsiTerminal()) {
+        cout << "This console cannot show the live dashboard\n";
+        return;
+    }
+    ScreenRenderer renderer(cellWidth * cellsPerRow, dashboardRows);
+    auto stamp = parkingLotsStamp(site);
+    while (true) {
+        drawDashboard(renderer, site, time(nullptr), dashboardRows);
+        renderer.present(); // Only the cells that changed since the last frame are written
+        if (waitForInput(250)) {
+            break;
+        }
+        auto latest = parkingLotsStamp(site);
+        if (latest != stamp) {
+            stamp = latest;
+            lock_guard<mutex> lock(site.mutex);
+            loadGarage(site); // Another kiosk has saved a change
+        }
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ctime>
+
+#include "ScreenRenderer.h"
+
+struct Garage;
+
+// Draws the occupancy dashboard of the site as one frame: a header with the totals, then every
+// floor's spots five to a row as in the parking status view. When the spots do not fit in
+// maxRows, each floor is drawn as one occupancy bar instead.
+void drawDashboard(ScreenRenderer& renderer, const Garage& site, time_t now, int maxRows);
+
+// Shows the live dashboard of the site until Enter is pressed. The site is reloaded whenever its
+// data files change, so rentals and settlements made at other kiosks appear as they happen.
+void runLiveDashboard(Garage& site);
@@ -0,0 +1,581 @@
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+bool TextCursor::nextLine(string_view& line) {
+    if (position >= text.size()) {
+        return false;
+    }
+    size_t end = text.find('\n', position);
+    if (end == string_view::npos) {
+        end = text.size();
+    }
+    line = text.substr(position, end - position);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    position = end + 1;
+    ++currentLine;
+    return true;
+}
+
+size_t splitTokens(string_view line, string_view* tokens, size_t maxTokens) {
+    size_t count = 0;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        if (i >= line.size()) break;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+        if (count < maxTokens) {
+            tokens[count] = line.substr(start, i - start);
+        }
+        ++count;
+    }
+    return count;
+}
+
+bool parseNumber(string_view token, long long& value) {
+    const char* first = token.data();
+    const char* last = first + token.size();
+    auto result = from_chars(first, last, value);
+    return result.ec == errc() && result.ptr == last;
+}
+
+bool parseNumber(string_view token, int& value) {
+    const char* first = token.data();
+    const char* last = first + token.size();
+    auto result = from_chars(first, last, value);
+    return result.ec == errc() && result.ptr == last;
+}
+
+bool parseNumber(string_view token, double& value) {
+    const char* first = token.data();
+    const char* last = first + token.size();
+    auto result = from_chars(first, last, value);
+    return result.ec == errc() && result.ptr == last && isfinite(value);
+}
+
+void assignField(string& field, string_view token) {
+    if (token == emptyFieldPlaceholder) {
+        field.clear();
+    }
+    else {
+        field.assign(token.data(), token.size());
+    }
+}
+
+bool readWholeFile(const string& path, string& buffer) {
+    TraceSpan span("readFile", path);
+    ifstream inFile(path, ios::binary);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    inFile.seekg(0, ios::end);
+    streamoff size = inFile.tellg();
+    inFile.seekg(0, ios::beg);
+    buffer.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    if (size > 0) {
+        inFile.read(&buffer[0], size);
+        buffer.resize(static_cast<size_t>(inFile.gcount()));
+    }
+    recordBytesLoaded(buffer.size());
+    return true;
+}
+
+// Builds an error message of the form "<what> '<token>'".
+static ParseError makeError(int line, const char* what, string_view token) {
+    string message = what;
+    message += " '";
+    message.append(token.data(), token.size());
+    message += "'";
+    return ParseError{ line, message };
+}
+
+// Counts the spot lines of the floor that starts at the beginning of text, up to its "#" line.
+static size_t countFloorSpots(string_view text) {
+    TextCursor cursor(text);
+    string_view line;
+    size_t count = 0;
+    while (cursor.nextLine(line) && line != "#") {
+        ++count;
+    }
+    return count;
+}
+
+// Parses one spot line. Lines have 7 fields; files written before empty fields were saved
+// as a placeholder have 5 when the spot has no vehicle type and plate number.
+static bool parseSpot(string_view line, int lineNumber, ParkingSpot& spot, vector<ParseError>& errors) {
+    string_view tokens[7];
+    size_t count = splitTokens(line, tokens, 7);
+    string_view id, type, occupied, vehicleType, plateNumber, startTime, entrance;
+    if (count == 7) {
+        id = tokens[0]; type = tokens[1]; occupied = tokens[2]; vehicleType = tokens[3];
+        plateNumber = tokens[4]; startTime = tokens[5]; entrance = tokens[6];
+    }
+    else if (count == 5) {
+        id = tokens[0]; type = tokens[1]; occupied = tokens[2]; startTime = tokens[3]; entrance = tokens[4];
+    }
+    else {
+        errors.push_back(ParseError{ lineNumber, "expected 7 fields but found " + to_string(count) });
+        return false;
+    }
+
+    if (occupied != "0" && occupied != "1") {
+        errors.push_back(makeError(lineNumber, "invalid occupied flag", occupied));
+        return false;
+    }
+    long long start;
+    bool validStart = parseNumber(startTime, start) && start >= 0;
+    int entranceNumber;
+    bool validEntrance = parseNumber(entrance, entranceNumber) && entranceNumber >= 0 && entranceNumber <= 2;
+    if (occupied == "0" && (!validStart || !validEntrance)) {
+        // Older versions wrote whatever was in memory for the car fields of a free spot. The spot
+        // is still good; only the fields of a car that is not there are dropped.
+        ParseError warning = makeError(lineNumber, !validStart ? "invalid start time" : "invalid entrance", !validStart ? startTime : entrance);
+        warning.message += " of a free spot; its vehicle, plate, start time and entrance are cleared";
+        warning.kept = true;
+        errors.push_back(move(warning));
+        vehicleType = plateNumber = string_view();
+        start = 0;
+        entranceNumber = 0;
+    }
+    else if (!validStart) {
+        errors.push_back(makeError(lineNumber, "invalid start time", startTime));
+        return false;
+    }
+    else if (!validEntrance) {
+        errors.push_back(makeError(lineNumber, "invalid entrance", entrance));
+        return false;
+    }
+
+    assignField(spot.id, id);
+    assignField(spot.type, type);
+    spot.isOccupied = occupied == "1";
+    assignField(spot.vehicleType, vehicleType);
+    assignField(spot.plateNumber, plateNumber);
+    spot.startTime = static_cast<time_t>(start);
+    spot.entrance = entranceNumber;
+
+    // A deleted spot is stored as occupied with no type; any other occupied spot needs a plate
+    if (spot.isOccupied && !spot.type.empty() && spot.plateNumber.empty()) {
+        errors.push_back(makeError(lineNumber, "occupied spot has no plate number", id));
+        return false;
+    }
+    return true;
+}
+
+void parseParkingLots(string_view text, Garage& site, vector<ParseError>& errors) {
+    TraceSpan span("parseParkingLots");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view floorToken;
+        if (splitTokens(line, &floorToken, 1) == 0) continue; // Blank line between floors
+
+        Floor& floor = site.floors[site.floors.add(string(floorToken))];
+        TraceSpan floorSpan("parseFloor", floor.name);
+        FloorSpots& spots = floor.spots;
+        spots.reserve(spots.size() + countFloorSpots(cursor.rest()));
+        while (cursor.nextLine(line)) {
+            if (line == "#") break; // End of current floor
+            ParkingSpot& spot = spots.emplace_back();
+            if (!parseSpot(line, cursor.lineNumber(), spot, errors)) {
+                spots.pop_back();
+            }
+        }
+    }
+}
+
+void parseFloorSpots(string_view text, FloorSpots& spots, vector<ParseError>& errors) {
+    TraceSpan span("parseFloorSpots");
+    spots.reserve(spots.size() + countFloorSpots(text));
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        if (line == "#") break; // End of the floor
+        ParkingSpot& spot = spots.emplace_back();
+        if (!parseSpot(line, cursor.lineNumber(), spot, errors)) {
+            spots.pop_back();
+        }
+    }
+}
+
+// Offset in text of the line after the given line of text.
+static uint64_t offsetAfter(string_view text, string_view line) {
+    size_t end = text.find('\n', static_cast<size_t>(line.data() - text.data()) + line.size());
+    return end == string_view::npos ? text.size() : end + 1;
+}
+
+bool scanParkingLots(string_view text, vector<ListedFloor>& floors, vector<ParseError>& errors) {
+    TraceSpan span("scanParkingLots");
+    set<string, less<>> seen;
+    ParkingSpot spot; // Reused, so its strings keep their storage
+    vector<ParseError> lineErrors;
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view floorToken;
+        if (splitTokens(line, &floorToken, 1) == 0) continue; // Blank line between floors
+        if (!seen.insert(string(floorToken)).second) {
+            errors.push_back(makeError(cursor.lineNumber(), "floor listed twice", floorToken));
+            return false;
+        }
+
+        ListedFloor floor;
+        floor.name = string(floorToken);
+        floor.extent.offset = offsetAfter(text, line);
+        uint64_t end = text.size();
+        while (cursor.nextLine(line)) {
+            if (line == "#") {
+                end = static_cast<uint64_t>(line.data() - text.data());
+                break;
+            }
+            // Only lines a load keeps are counted; what is wrong with them is reported by the load
+            lineErrors.clear();
+            if (parseSpot(line, cursor.lineNumber(), spot, lineErrors)) {
+                floor.extent.counts.add(spot.type, spot.isOccupied);
+            }
+        }
+        floor.extent.bytes = end - floor.extent.offset;
+        floors.push_back(move(floor));
+    }
+    return true;
+}
+
+bool parseFloorIndex(string_view text, string& stamp, vector<ListedFloor>& floors, vector<ParseError>& errors) {
+    TraceSpan span("parseFloorIndex");
+    TextCursor cursor(text);
+    string_view line;
+    string_view header[3];
+    if (!cursor.nextLine(line) || splitTokens(line, header, 3) != 3 || header[0] != "parkingLots.dat") {
+        errors.push_back(ParseError{ 1, "expected parkingLots.dat and its stamp" });
+        return false;
+    }
+    stamp.assign(header[1].data(), header[1].size());
+    stamp += " ";
+    stamp.append(header[2].data(), header[2].size());
+
+    set<string, less<>> seen;
+    vector<string_view> tokens(3 + 3 * 8);
+    while (cursor.nextLine(line)) {
+        size_t count = splitTokens(line, tokens.data(), tokens.size());
+        if (count == 0) continue;
+        if (count > tokens.size()) {
+            tokens.resize(count);
+            splitTokens(line, tokens.data(), tokens.size());
+        }
+        long long offset, bytes;
+        if (count < 3 || (count - 3) % 3 != 0) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected a floor, its offset and size and three fields per parking type" });
+            return false;
+        }
+        if (!parseNumber(tokens[1], offset) || offset < 0 || !parseNumber(tokens[2], bytes) || bytes < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid offset or size of floor", tokens[0]));
+            return false;
+        }
+        if (!seen.insert(string(tokens[0])).second) {
+            errors.push_back(makeError(cursor.lineNumber(), "floor listed twice", tokens[0]));
+            return false;
+        }
+        ListedFloor floor;
+        floor.name = string(tokens[0]);
+        floor.extent.offset = static_cast<uint64_t>(offset);
+        floor.extent.bytes = static_cast<uint64_t>(bytes);
+        for (size_t i = 3; i < count; i += 3) {
+            int occupied, total;
+            if (!parseNumber(tokens[i + 1], occupied) || !parseNumber(tokens[i + 2], total) || occupied < 0 || total < occupied) {
+                errors.push_back(makeError(cursor.lineNumber(), "invalid spot counts of parking type", tokens[i]));
+                return false;
+            }
+            floor.extent.counts.byParkingType[string(tokens[i])] = { occupied, total };
+            floor.extent.counts.spots += total;
+            floor.extent.counts.occupied += occupied;
+        }
+        floors.push_back(move(floor));
+    }
+    return true;
+}
+
+void parseCustomers(string_view text, CustomerMap& customers, vector<ParseError>& errors) {
+    TraceSpan span("parseCustomers");
+    TextCursor cursor(text);
+    string_view line;
+    string plateNumber;
+    while (cursor.nextLine(line)) {
+        string_view tokens[8];
+        size_t count = splitTokens(line, tokens, 8);
+        if (count == 0) continue;
+
+        // Files written before empty fields were saved as a placeholder have 6 fields when the
+        // customer has no parking type and vehicle type yet
+        string_view plate, startTime, endTime, parkingType, vehicleType, entrance, exit, payment;
+        if (count == 8) {
+            plate = tokens[0]; startTime = tokens[1]; endTime = tokens[2]; parkingType = tokens[3];
+            vehicleType = tokens[4]; entrance = tokens[5]; exit = tokens[6]; payment = tokens[7];
+        }
+        else if (count == 6) {
+            plate = tokens[0]; startTime = tokens[1]; endTime = tokens[2];
+            entrance = tokens[3]; exit = tokens[4]; payment = tokens[5];
+        }
+        else {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected 8 fields but found " + to_string(count) });
+            continue;
+        }
+
+        long long start, end;
+        int entranceNumber, exitNumber;
+        double amount;
+        if (!parseNumber(startTime, start) || start < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid start time", startTime));
+            continue;
+        }
+        if (!parseNumber(endTime, end) || end < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid end time", endTime));
+            continue;
+        }
+        if (!parseNumber(entrance, entranceNumber) || entranceNumber < 0 || entranceNumber > 2) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid entrance", entrance));
+            continue;
+        }
+        if (!parseNumber(exit, exitNumber) || exitNumber < 0 || exitNumber > 2) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid exit", exit));
+            continue;
+        }
+        if (!parseNumber(payment, amount) || amount < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid payment", payment));
+            continue;
+        }
+
+        plateNumber.assign(plate.data(), plate.size());
+        Customer& customer = customers[plateNumber]; // Filled in place, the node comes from the customer pool
+        customer.plateNumber = plateNumber;
+        customer.startTime = static_cast<time_t>(start);
+        customer.endTime = static_cast<time_t>(end);
+        assignField(customer.parkingType, parkingType);
+        assignField(customer.vehicleType, vehicleType);
+        customer.entrance = entranceNumber;
+        customer.exit = exitNumber;
+        customer.payment = amount;
+    }
+}
+
+void parseHourlyRates(string_view text, map<string, map<string, double>>& hourlyRates, vector<ParseError>& errors) {
+    TraceSpan span("parseHourlyRates");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[2];
+        size_t count = splitTokens(line, tokens, 2);
+        if (count == 0) continue;
+        if (count != 2) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected 2 fields but found " + to_string(count) });
+            continue;
+        }
+        double rate;
+        if (!parseNumber(tokens[1], rate) || rate < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid hourly rate", tokens[1]));
+            continue;
+        }
+        hourlyRates[string(tokens[0])]["Default"] = rate; // Load the rate associated with the parking type
+    }
+}
+
+void parseParkingTypes(string_view text, map<string, set<string>>& parkingTypes, vector<ParseError>& errors) {
+    TraceSpan span("parseParkingTypes");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[64];
+        size_t count = splitTokens(line, tokens, 64);
+        if (count == 0) continue;
+        if (count > 64) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "too many vehicle types (" + to_string(count - 1) + ")" });
+            continue;
+        }
+        set<string>& vehicleTypes = parkingTypes[string(tokens[0])];
+        vehicleTypes.clear();
+        for (size_t i = 1; i < count; ++i) {
+            vehicleTypes.emplace(tokens[i]);
+        }
+    }
+}
+
+bool parseDailyMaxRate(string_view text, double& dailyMaxRate, vector<ParseError>& errors) {
+    TraceSpan span("parseDailyMaxRate");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view token;
+        size_t count = splitTokens(line, &token, 1);
+        if (count == 0) continue;
+        double rate;
+        if (count != 1 || !parseNumber(token, rate) || rate < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid daily maximum rate", line));
+            return false;
+        }
+        dailyMaxRate = rate;
+        return true;
+    }
+    errors.push_back(ParseError{ cursor.lineNumber(), "missing daily maximum rate" });
+    return false;
+}
+
+void parseEntranceCosts(string_view text, SpotAllocator& allocator, vector<ParseError>& errors) {
+    TraceSpan span("parseEntranceCosts");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[5];
+        size_t count = splitTokens(line, tokens, 5);
+        if (count == 0 || tokens[0][0] == '#') continue;
+        if (count != 5) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected 5 fields but found " + to_string(count) });
+            continue;
+        }
+        int entrance;
+        if (!parseNumber(tokens[0], entrance) || entrance < 1 || entrance > SpotAllocator::entrances) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid entrance", tokens[0]));
+            continue;
+        }
+        EntranceCost cost;
+        if (!parseNumber(tokens[2], cost.floorCost) || cost.floorCost < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid floor cost", tokens[2]));
+            continue;
+        }
+        if (!parseNumber(tokens[3], cost.spotCost) || cost.spotCost < 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid spot cost", tokens[3]));
+            continue;
+        }
+        if (tokens[4] != "first" && tokens[4] != "last") {
+            errors.push_back(makeError(cursor.lineNumber(), "expected first or last but found", tokens[4]));
+            continue;
+        }
+        cost.fromEnd = tokens[4] == "last";
+        allocator.setEntranceCost(entrance, string(tokens[1]), cost);
+    }
+}
+
+void parseOverstayLimits(string_view text, OverstayMonitor& monitor, vector<ParseError>& errors) {
+    TraceSpan span("parseOverstayLimits");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[2];
+        size_t count = splitTokens(line, tokens, 2);
+        if (count == 0 || tokens[0][0] == '#') continue;
+        if (count != 2) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected 2 fields but found " + to_string(count) });
+            continue;
+        }
+        double hours;
+        if (!parseNumber(tokens[1], hours) || hours <= 0) {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid stay limit", tokens[1]));
+            continue;
+        }
+        monitor.setLimit(string(tokens[0]), hours);
+    }
+}
+
+void parseForecast(string_view text, OccupancyForecaster& forecaster, vector<ParseError>& errors) {
+    TraceSpan span("parseForecast");
+    const size_t fieldCount = 10 + 2 * TrafficSeries::hoursPerWeek;
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[fieldCount];
+        size_t count = splitTokens(line, tokens, fieldCount);
+        if (count == 0) continue;
+        if (count != fieldCount) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected " + to_string(fieldCount) + " fields but found " + to_string(count) });
+            continue;
+        }
+        TrafficSeries series;
+        bool valid = parseNumber(tokens[2], series.currentHour) && parseNumber(tokens[3], series.openArrivals) &&
+            parseNumber(tokens[4], series.openDepartures) && parseNumber(tokens[5], series.level) &&
+            parseNumber(tokens[6], series.recentArrivals) && parseNumber(tokens[7], series.recentDepartures) &&
+            parseNumber(tokens[8], series.dwellMinutes) && parseNumber(tokens[9], series.dwellCount);
+        for (int slot = 0; valid && slot < TrafficSeries::hoursPerWeek; ++slot) {
+            string_view arrivals = tokens[10 + slot];
+            series.seen[slot] = arrivals != emptyFieldPlaceholder;
+            valid = (!series.seen[slot] || parseNumber(arrivals, series.arrivals[slot])) &&
+                parseNumber(tokens[10 + TrafficSeries::hoursPerWeek + slot], series.departures[slot]);
+        }
+        if (!valid) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "invalid traffic series" });
+            continue;
+        }
+        string parkingType, floor;
+        assignField(parkingType, tokens[0]);
+        assignField(floor, tokens[1]);
+        forecaster.allSeries()[{ parkingType, floor }] = series;
+    }
+}
+
+void parseLedger(string_view text, RevenueLedger& ledger, vector<ParseError>& errors) {
+    TraceSpan span("parseLedger");
+    TextCursor cursor(text);
+    string_view line;
+    while (cursor.nextLine(line)) {
+        string_view tokens[7];
+        size_t count = splitTokens(line, tokens, 7);
+        if (count == 0) continue;
+        if (count != 7) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "expected 7 fields but found " + to_string(count) });
+            continue;
+        }
+        LedgerPeriod period;
+        if (tokens[0] == "H") period = LedgerPeriod::Hour;
+        else if (tokens[0] == "D") period = LedgerPeriod::Day;
+        else if (tokens[0] == "M") period = LedgerPeriod::Month;
+        else {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid period", tokens[0]));
+            continue;
+        }
+        long long key;
+        RevenueTotals totals;
+        if (!parseNumber(tokens[1], key) || !parseNumber(tokens[4], totals.payments) ||
+            !parseNumber(tokens[5], totals.cents) || !parseNumber(tokens[6], totals.hours)) {
+            errors.push_back(ParseError{ cursor.lineNumber(), "invalid revenue totals" });
+            continue;
+        }
+        RevenueRollup& rollup = ledger.rollups(period)[key];
+        string_view dimension = tokens[2];
+        int gate;
+        if (dimension == "all") {
+            rollup.total = totals;
+        }
+        else if (dimension == "type" || dimension == "floor") {
+            string value;
+            assignField(value, tokens[3]);
+            (dimension == "type" ? rollup.byParkingType : rollup.byFloor)[value] = totals;
+        }
+        else if ((dimension == "entrance" || dimension == "exit") && parseNumber(tokens[3], gate)) {
+            (dimension == "entrance" ? rollup.byEntrance : rollup.byExit)[gate] = totals;
+        }
+        else {
+            errors.push_back(makeError(cursor.lineNumber(), "invalid revenue slice", dimension));
+        }
+    }
+}
+
+void reportParseErrors(const string& path, const vector<ParseError>& errors) {
+    for (const auto& error : errors) {
+        cerr << (error.kept ? "Warning: " : "Error: ") << path << " line " << error.line << ": " << error.message << "\n";
+    }
+}
+
+size_t skippedLineCount(const vector<ParseError>& errors) {
+    size_t skipped = 0;
+    for (const auto& error : errors) {
+        skipped += error.kept ? 0 : 1;
+    }
+    return skipped;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "Parking.h"
+
+// Written in place of an empty text field, so that every record keeps a fixed number of tokens.
+const char* const emptyFieldPlaceholder = "-";
+
+// A problem found while parsing a data file. Lines are numbered from 1. A kept line was still
+// loaded, with the fields it could not use cleared; any other line was skipped.
+struct ParseError {
+    ParseError(int line, std::string message, bool kept = false) : line(line), message(std::move(message)), kept(kept) {}
+
+    int line;
+    std::string message;
+    bool kept;
+};
+
+// Walks a text buffer line by line without copying. Handles both \n and \r\n line endings.
+class TextCursor {
+public:
+    explicit TextCursor(std::string_view text) : text(text) {}
+
+    // Returns the next line without its line ending. Returns false at the end of the text.
+    bool nextLine(std::string_view& line);
+
+    // Number of the line most recently returned by nextLine().
+    int lineNumber() const { return currentLine; }
+
+    // Remaining unread text.
+    std::string_view rest() const { return text.substr(position); }
+
+private:
+    std::string_view text;
+    size_t position = 0;
+    int currentLine = 0;
+};
+
+// Splits a line into whitespace separated tokens. Returns the total number of tokens,
+// which may be larger than maxTokens; only the first maxTokens are stored.
+size_t splitTokens(std::string_view line, std::string_view* tokens, size_t maxTokens);
+
+// Converts a whole token to a number. Returns false if the token is not entirely a valid number.
+bool parseNumber(std::string_view token, long long& value);
+bool parseNumber(std::string_view token, int& value);
+bool parseNumber(std::string_view token, double& value);
+
+// Converts a text field, mapping the placeholder back to an empty string.
+void assignField(std::string& field, std::string_view token);
+
+// Returns the text to write for a field, using the placeholder when the field is empty.
+inline const char* fieldOrPlaceholder(const std::string& field) {
+    return field.empty() ? emptyFieldPlaceholder : field.c_str();
+}
+
+// Reads a whole file into one buffer. Returns false if the file cannot be opened.
+bool readWholeFile(const std::string& path, std::string& buffer);
+
+// Parses parkingLots.dat into the site's floors. A free spot whose start time or entrance is
+// invalid, as in files written before the start time and entrance of a free spot were set, is kept
+// without its car fields. Other invalid spot lines are skipped. Both are reported.
+void parseParkingLots(std::string_view text, Garage& site, std::vector<ParseError>& errors);
+
+// Parses the spot lines of one floor, up to a "#" line or the end of the text. Invalid spot lines
+// are kept or skipped and reported as parseParkingLots() does.
+void parseFloorSpots(std::string_view text, FloorSpots& spots, std::vector<ParseError>& errors);
+
+// A floor of the floor directory: its name, where its spot lines are in parkingLots.dat and its counts.
+struct ListedFloor {
+    std::string name;
+    FloorExtent extent;
+};
+
+// Finds the floors of parkingLots.dat and counts the spots that loading them would keep, without
+// storing the spots. Returns false if a floor is listed twice.
+bool scanParkingLots(std::string_view text, std::vector<ListedFloor>& floors, std::vector<ParseError>& errors);
+
+// Parses floorIndex.dat: a first line "parkingLots.dat <stamp>" with the size and write time of
+// the file it describes, then a line per floor of "<floor> <offset> <bytes>" followed by
+// "<parkingType> <occupied> <total>" for each parking type on the floor. Returns false, and
+// reports, if any line is invalid or a floor is listed twice.
+bool parseFloorIndex(std::string_view text, std::string& stamp, std::vector<ListedFloor>& floors, std::vector<ParseError>& errors);
+
+// Parses customers.dat into the site's customers. Invalid lines are skipped and reported.
+void parseCustomers(std::string_view text, CustomerMap& customers, std::vector<ParseError>& errors);
+
+// Parses hourlyRates.dat. Invalid lines are skipped and reported.
+void parseHourlyRates(std::string_view text, std::map<std::string, std::map<std::string, double>>& hourlyRates, std::vector<ParseError>& errors);
+
+// Parses parkingTypeToVehicleTypes.dat. Invalid lines are skipped and reported.
+void parseParkingTypes(std::string_view text, std::map<std::string, std::set<std::string>>& parkingTypes, std::vector<ParseError>& errors);
+
+// Parses dailyMaxRate.dat. Returns false (and reports) if the value is missing or invalid.
+bool parseDailyMaxRate(std::string_view text, double& dailyMaxRate, std::vector<ParseError>& errors);
+
+// Parses entranceCosts.dat: lines of "<entrance> <floor> <floorCost> <spotCost> <first|last>".
+// Invalid lines are skipped and reported.
+void parseEntranceCosts(std::string_view text, SpotAllocator& allocator, std::vector<ParseError>& errors);
+
+// Parses overstayLimits.dat: lines of "<parkingType> <hours>", with * for every parking type.
+// Invalid lines are skipped and reported.
+void parseOverstayLimits(std::string_view text, OverstayMonitor& monitor, std::vector<ParseError>& errors);
+
+// Parses forecast.dat: one line per traffic series with its parking type and floor ("-" for all),
+// the current hour and its counts, level, recent rates, dwell average and count, then the 168
+// hour-of-week arrival averages ("-" where there is no history yet) and the 168 departure averages.
+// Invalid lines are skipped and reported.
+void parseForecast(std::string_view text, OccupancyForecaster& forecaster, std::vector<ParseError>& errors);
+
+// Parses ledger.dat: lines of "<H|D|M> <key> <dimension> <value> <payments> <cents> <hours>" as
+// written by writeLedger(). Invalid lines are skipped and reported.
+void parseLedger(std::string_view text, RevenueLedger& ledger, std::vector<ParseError>& errors);
+
+// Writes the parse errors of one file to cerr, prefixed with the file path. Kept lines are
+// written as warnings.
+void reportParseErrors(const std::string& path, const std::vector<ParseError>& errors);
+
+// Returns the number of lines the errors say were skipped.
+size_t skippedLineCount(const std::vector<ParseError>& errors);
@@ -0,0 +1,136 @@
+#include "Epoch.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// Reader slot and pin depth of one thread. The slot is given back when the thread ends.
+struct ThreadReader {
+    EpochDomain::ReaderSlot* slot = nullptr;
+    int depth = 0;
+
+    ~ThreadReader() {
+        if (slot != nullptr) {
+            slot->pinned.store(0);
+            slot->owned.store(false);
+        }
+    }
+};
+
+static thread_local ThreadReader threadReader;
+
+EpochDomain& epochDomain() {
+    static EpochDomain* domain = new EpochDomain(); // Never destroyed, so threads may unpin during exit
+    return *domain;
+}
+
+EpochDomain::~EpochDomain() {
+    for (const Retired& object : retired) {
+        object.destroy(object.object);
+    }
+    SlotBlock* block = firstBlock.next.load();
+    while (block != nullptr) {
+        SlotBlock* next = block->next.load();
+        delete block;
+        block = next;
+    }
+}
+
+EpochDomain::ReaderSlot* EpochDomain::acquireSlot() {
+    SlotBlock* block = &firstBlock;
+    while (true) {
+        for (ReaderSlot& slot : block->slots) {
+            bool expected = false;
+            if (slot.owned.compare_exchange_strong(expected, true)) {
+                return &slot;
+            }
+        }
+        SlotBlock* next = block->next.load();
+        if (next == nullptr) {
+            // Every slot is taken by a live thread: add a block, unless another thread just did
+            SlotBlock* added = new SlotBlock();
+            if (block->next.compare_exchange_strong(next, added)) {
+                next = added;
+            }
+            else {
+                delete added;
+            }
+        }
+        block = next;
+    }
+}
+
+size_t EpochDomain::readerSlots() const {
+    size_t count = 0;
+    for (const SlotBlock* block = &firstBlock; block != nullptr; block = block->next.load()) {
+        count += slotsPerBlock;
+    }
+    return count;
+}
+
+void EpochDomain::pin() {
+    ThreadReader& reader = threadReader;
+    if (reader.depth++ > 0) {
+        return;
+    }
+    if (reader.slot == nullptr) {
+        reader.slot = acquireSlot();
+    }
+    // A writer that scanned the slots before this store did not count this reader, but it had
+    // already published its new pointers, so the loads after this store cannot see what it freed
+    reader.slot->pinned.store(epoch.load());
+}
+
+void EpochDomain::unpin() {
+    ThreadReader& reader = threadReader;
+    if (--reader.depth == 0) {
+        reader.slot->pinned.store(0);
+    }
+}
+
+void EpochDomain::retire(void* object, void (*destroy)(void*)) {
+    lock_guard<mutex> lock(retiredMutex);
+    retired.push_back(Retired{ epoch.load(), object, destroy });
+}
+
+size_t EpochDomain::collect() {
+    vector<Retired> expired;
+    {
+        lock_guard<mutex> lock(retiredMutex);
+        epoch.fetch_add(1);
+        uint64_t oldestPinned = numeric_limits<uint64_t>::max();
+        for (const SlotBlock* block = &firstBlock; block != nullptr; block = block->next.load()) {
+            for (const ReaderSlot& slot : block->slots) {
+                uint64_t pinned = slot.pinned.load();
+                if (pinned != 0) {
+                    oldestPinned = min(oldestPinned, pinned);
+                }
+            }
+        }
+        auto stillVisible = partition(retired.begin(), retired.end(),
+            [oldestPinned](const Retired& object) { return object.epoch >= oldestPinned; });
+        expired.assign(stillVisible, retired.end());
+        retired.erase(stillVisible, retired.end());
+    }
+    for (const Retired& object : expired) {
+        object.destroy(object.object); // Outside the lock, so other writers are not held up
+    }
+    return expired.size();
+}
+
+void EpochDomain::collectIfDue() {
+    bool due;
+    {
+        lock_guard<mutex> lock(retiredMutex);
+        due = retired.size() >= collectBatch;
+    }
+    if (due) {
+        collect();
+    }
+}
+
+size_t EpochDomain::retiredCount() {
+    lock_guard<mutex> lock(retiredMutex);
+    return retired.size();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation for data that readers use without locks. A reader pins the current
+// epoch before it loads a shared pointer and unpins when it is done; a writer that unlinks an
+// object retires it instead of deleting it, and the object is only freed once every reader pinned
+// at or before the epoch it was retired in has unpinned. Readers never wait, and writers never wait
+// for readers: memory retired while a reader is pinned simply stays allocated a little longer.
+// Each thread that pins keeps a reader slot until it ends; the slots grow by a block when every
+// one is taken, so any number of threads may be pinned at the same time.
+class EpochDomain {
+public:
+    static const int slotsPerBlock = 64;
+
+    ~EpochDomain();
+
+    // Pins the calling thread. Pins nest; only the outermost one takes a reader slot.
+    void pin();
+    void unpin();
+
+    // Queues an object to be deleted once no reader can still see it.
+    template <typename T>
+    void retire(const T* object) {
+        if (object != nullptr) {
+            retire(const_cast<T*>(object), [](void* pointer) { delete static_cast<T*>(pointer); });
+        }
+    }
+
+    // Moves to the next epoch and deletes every retired object no pinned reader can see.
+    // Returns the number of objects deleted.
+    size_t collect();
+
+    // Collects only once enough objects have been retired, so the cost of scanning the reader
+    // slots is shared by many writes.
+    void collectIfDue();
+
+    size_t retiredCount();
+    uint64_t currentEpoch() const { return epoch.load(); }
+    size_t readerSlots() const; // Slots allocated so far
+
+private:
+    struct Retired {
+        uint64_t epoch;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    // One cache line per reader, so readers on different threads do not share a line
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> pinned{ 0 }; // Epoch the reader pinned, 0 when not pinned
+        std::atomic<bool> owned{ false };
+    };
+
+    // Blocks are only ever appended, and freed with the domain, so readers and writers walk them without locks
+    struct SlotBlock {
+        ReaderSlot slots[slotsPerBlock];
+        std::atomic<SlotBlock*> next{ nullptr };
+    };
+
+    void retire(void* object, void (*destroy)(void*));
+    ReaderSlot* acquireSlot();
+
+    static const size_t collectBatch = 256;
+
+    std::atomic<uint64_t> epoch{ 1 };
+    SlotBlock firstBlock;
+    std::mutex retiredMutex; // Writers only
+    std::vector<Retired> retired;
+
+    friend struct ThreadReader;
+};
+
+// The domain shared by every site.
+EpochDomain& epochDomain();
+
+// Pins the epoch for the lifetime of the guard.
+class EpochGuard {
+public:
+    EpochGuard() { epochDomain().pin(); }
+    ~EpochGuard() { epochDomain().unpin(); }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
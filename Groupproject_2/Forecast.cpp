@@ -0,0 +1,193 @@
+#include "Forecast.h"
+#include "Parking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace std;
+
+static const double seasonalSmoothing = 0.3; // Weight of the latest week in an hour of the week's average
+static const double levelSmoothing = 0.2;
+static const double recentSmoothing = 0.2;
+static const double dwellSmoothing = 0.05;
+
+// Hour of the week, Sunday 00:00 local time being hour 0.
+static int hourOfWeek(long long hour) {
+    time_t start = static_cast<time_t>(hour * 3600);
+    struct tm timeinfo;
+#ifdef _WIN32
+    localtime_s(&timeinfo, &start);
+#else
+    localtime_r(&start, &timeinfo);
+#endif
+    return timeinfo.tm_wday * 24 + timeinfo.tm_hour;
+}
+
+void TrafficSeries::advanceTo(long long hour) {
+    if (currentHour < 0 || hour - currentHour > hoursPerWeek) {
+        currentHour = currentHour < 0 ? hour : hour - hoursPerWeek; // Older hours would be overwritten anyway
+    }
+    while (currentHour < hour) {
+        int slot = hourOfWeek(currentHour);
+        if (seen[slot]) {
+            if (arrivals[slot] > 0.5) {
+                double ratio = min(openArrivals / arrivals[slot], 5.0);
+                level = levelSmoothing * ratio + (1 - levelSmoothing) * level;
+            }
+            arrivals[slot] = seasonalSmoothing * openArrivals + (1 - seasonalSmoothing) * arrivals[slot];
+            departures[slot] = seasonalSmoothing * openDepartures + (1 - seasonalSmoothing) * departures[slot];
+        }
+        else {
+            arrivals[slot] = openArrivals;
+            departures[slot] = openDepartures;
+            seen[slot] = true;
+        }
+        recentArrivals = recentSmoothing * openArrivals + (1 - recentSmoothing) * recentArrivals;
+        recentDepartures = recentSmoothing * openDepartures + (1 - recentSmoothing) * recentDepartures;
+        openArrivals = 0;
+        openDepartures = 0;
+        ++currentHour;
+    }
+}
+
+double TrafficSeries::expectedArrivals(long long hour) const {
+    int slot = hourOfWeek(hour);
+    return seen[slot] ? arrivals[slot] * level : recentArrivals;
+}
+
+double TrafficSeries::expectedDepartures(long long hour) const {
+    int slot = hourOfWeek(hour);
+    return seen[slot] ? departures[slot] : recentDepartures;
+}
+
+// Returns the series of a slice, with every hour before the given one closed.
+TrafficSeries& OccupancyForecaster::slice(const string& parkingType, const string& floor, long long hour) {
+    TrafficSeries& slice = series[{ parkingType, floor }];
+    long long before = slice.currentHour;
+    slice.advanceTo(hour);
+    changed = changed || slice.currentHour != before;
+    return slice;
+}
+
+void OccupancyForecaster::recordArrival(const string& parkingType, const string& floor, time_t now) {
+    long long hour = now / 3600;
+    TrafficSeries* slices[] = { &slice(parkingType, floor, hour), &slice(parkingType, "", hour), &slice("", floor, hour), &slice("", "", hour) };
+    for (TrafficSeries* series : slices) {
+        ++series->openArrivals;
+        series->occupied += counted ? 1 : 0;
+    }
+}
+
+void OccupancyForecaster::recordDeparture(const string& parkingType, const string& floor, time_t startTime, time_t now) {
+    long long hour = now / 3600;
+    double dwell = startTime > 0 ? difftime(now, startTime) / 60 : 0;
+    TrafficSeries* slices[] = { &slice(parkingType, floor, hour), &slice(parkingType, "", hour), &slice("", floor, hour), &slice("", "", hour) };
+    for (TrafficSeries* series : slices) {
+        ++series->openDepartures;
+        series->occupied -= counted ? 1 : 0;
+        if (startTime > 0) {
+            series->dwellMinutes = series->dwellCount == 0 ? dwell : dwellSmoothing * dwell + (1 - dwellSmoothing) * series->dwellMinutes;
+            ++series->dwellCount;
+        }
+    }
+}
+
+void OccupancyForecaster::countSpots(const Garage& site) const {
+    for (auto& slice : series) {
+        slice.second.capacity = 0;
+        slice.second.occupied = 0;
+    }
+    for (const auto& floor : site.floors) {
+        for (const auto& spot : floor.spots) {
+            if (spot.type.empty()) continue; // Deleted spot
+            int occupied = spot.isOccupied ? 1 : 0;
+            for (const SeriesKey& key : { SeriesKey(spot.type, floor.name), SeriesKey(spot.type, ""), SeriesKey("", floor.name), SeriesKey("", "") }) {
+                TrafficSeries& slice = series[key];
+                ++slice.capacity;
+                slice.occupied += occupied;
+            }
+        }
+    }
+    counted = true;
+}
+
+vector<ForecastHour> OccupancyForecaster::forecast(const Garage& site, const string& parkingType, const string& floor, time_t now, int hours) const {
+    if (!counted) {
+        countSpots(site);
+    }
+    vector<ForecastHour> result;
+    auto found = series.find({ parkingType, floor });
+    if (found == series.end()) {
+        return result;
+    }
+    long long hour = now / 3600;
+    TrafficSeries slice = found->second; // The open hours are closed on a copy
+    slice.advanceTo(hour);
+
+    double occupied = slice.occupied;
+    for (int i = 0; i < hours; ++i) {
+        ForecastHour expected;
+        expected.start = i == 0 ? now : static_cast<time_t>((hour + i) * 3600);
+        expected.arrivals = slice.expectedArrivals(hour + i);
+        expected.departures = slice.expectedDepartures(hour + i);
+        if (i == 0) {
+            // Only the part of the hour in progress that has not been seen yet
+            expected.arrivals = max(0.0, expected.arrivals - slice.openArrivals);
+            expected.departures = max(0.0, expected.departures - slice.openDepartures);
+        }
+        expected.departures = min(expected.departures, occupied);
+        occupied = min(max(occupied + expected.arrivals - expected.departures, 0.0), static_cast<double>(slice.capacity));
+        expected.occupied = occupied;
+        expected.freeSpots = slice.capacity - static_cast<int>(lround(occupied));
+        result.push_back(expected);
+    }
+    return result;
+}
+
+// Writes one row per forecast hour of a slice.
+static void writeSlice(ostream& out, const string& name, const vector<ForecastHour>& hours) {
+    out << left << setw(14) << name << right;
+    for (const auto& hour : hours) {
+        out << setw(8) << hour.freeSpots;
+    }
+    out << "\n";
+}
+
+void writeForecastText(ostream& out, const Garage& site, time_t now, int hours) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+
+    out << "Expected free spots at the end of each hour\n";
+    out << left << setw(14) << "" << right;
+    for (int i = 0; i < hours; ++i) {
+        time_t end = static_cast<time_t>((now / 3600 + i + 1) * 3600);
+        struct tm timeinfo;
+        char label[8];
+#ifdef _WIN32
+        localtime_s(&timeinfo, &end);
+#else
+        localtime_r(&end, &timeinfo);
+#endif
+        strftime(label, sizeof(label), "%H:%M", &timeinfo);
+        out << setw(8) << label;
+    }
+    out << "\n";
+    writeSlice(out, "All", site.forecaster.forecast(site, "", "", now, hours));
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    for (const auto& type : parkingTypes) {
+        vector<ForecastHour> expected = site.forecaster.forecast(site, type.first, "", now, hours);
+        if (!expected.empty()) {
+            writeSlice(out, type.first, expected);
+        }
+    }
+
+    const auto& all = site.forecaster.allSeries();
+    auto total = all.find({ "", "" });
+    if (total != all.end() && total->second.dwellCount > 0) {
+        out << fixed << setprecision(0) << "Average stay: " << total->second.dwellMinutes << " minutes over "
+            << total->second.dwellCount << " departures\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Garage;
+
+// Expected traffic during one coming hour, and the occupancy at its end.
+struct ForecastHour {
+    time_t start; // Now for the hour in progress
+    double arrivals;
+    double departures;
+    double occupied;
+    int freeSpots;
+};
+
+// Rolling hourly aggregates of one slice of a site: a parking type on a floor, all floors of a
+// parking type, all types of a floor, or the whole site. Finished hours are folded into a smoothed
+// value per hour of the week (the seasonal average) and into a level that tracks how busy recent
+// hours were compared with their seasonal average.
+struct TrafficSeries {
+    static const int hoursPerWeek = 168;
+
+    std::array<double, hoursPerWeek> arrivals{}; // Smoothed arrivals in each hour of the week
+    std::array<double, hoursPerWeek> departures{};
+    std::array<bool, hoursPerWeek> seen{}; // Whether the hour of the week has any history yet
+    double level = 1; // Recent arrivals relative to their seasonal average
+    double recentArrivals = 0; // Smoothed arrivals per hour over all hours, for hours without history
+    double recentDepartures = 0;
+    double dwellMinutes = 0; // Smoothed dwell time of departures
+    long long dwellCount = 0;
+    long long currentHour = -1; // Hours since the epoch of the hour being counted
+    int openArrivals = 0; // Counts of the current hour
+    int openDepartures = 0;
+
+    // Spots of the slice and how many are occupied; kept by the forecaster, not persisted
+    int capacity = 0;
+    int occupied = 0;
+
+    // Closes every hour before the given one. Costs at most one step per hour of the week.
+    void advanceTo(long long hour);
+
+    double expectedArrivals(long long hour) const;
+    double expectedDepartures(long long hour) const;
+};
+
+// Short-horizon occupancy forecasts from the rent and settle events of a site. Each event updates
+// four series (type and floor, type, floor, site) in constant time, and a forecast walks a fixed
+// number of hours of one series whatever the history length.
+class OccupancyForecaster {
+public:
+    using SeriesKey = std::pair<std::string, std::string>; // Parking type and floor; empty means all
+
+    void recordArrival(const std::string& parkingType, const std::string& floor, time_t now);
+    void recordDeparture(const std::string& parkingType, const std::string& floor, time_t startTime, time_t now);
+
+    // Expected occupancy of a parking type on a floor (empty for all of them) for the hour in
+    // progress and the hours after it. Brings the series up to now and recounts spots if needed,
+    // which changes no history, so it can be asked of a const site.
+    std::vector<ForecastHour> forecast(const Garage& site, const std::string& parkingType, const std::string& floor, time_t now, int hours) const;
+
+    // The spot counts are taken again from the site before the next forecast.
+    void invalidate() { counted = false; }
+
+    // Set when an hour has closed since the series were last saved.
+    bool changedSinceSave() const { return changed; }
+    void markSaved() { changed = false; }
+    bool isLoaded() const { return loaded; }
+    void markLoaded() { loaded = true; }
+
+    std::map<SeriesKey, TrafficSeries>& allSeries() { return series; }
+    const std::map<SeriesKey, TrafficSeries>& allSeries() const { return series; }
+
+private:
+    void countSpots(const Garage& site) const;
+    TrafficSeries& slice(const std::string& parkingType, const std::string& floor, long long hour);
+
+    mutable std::map<SeriesKey, TrafficSeries> series;
+    mutable bool counted = false;
+    bool changed = false;
+    bool loaded = false;
+};
+
+// Writes the forecast of the site for the next hours: the whole site, then each parking type.
+void writeForecastText(std::ostream& out, const Garage& site, time_t now, int hours);
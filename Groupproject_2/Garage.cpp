@@ -0,0 +1,507 @@
+#include "Parking.h"
+#include "DataParser.h"
+#include "WorkerPool.h"
+#include "MemoryReport.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <filesystem>
+
+using namespace std;
+
+map<string, Garage> garages;
+Garage* currentGarage = nullptr;
+
+WorkerPool& workerPool() {
+    static WorkerPool pool(thread::hardware_concurrency());
+    return pool;
+}
+
+FloorHandle FloorRegistry::find(const string& name) const {
+    auto it = index.find(name);
+    return it == index.end() ? invalidFloor : it->second;
+}
+
+FloorHandle FloorRegistry::add(const string& name) {
+    auto it = index.find(name);
+    if (it != index.end()) {
+        return it->second;
+    }
+    FloorHandle floor = size();
+    // Floors loaded on demand are freed one at a time, so they do not come from the arena
+    floors.emplace_back(name, FloorSpots(onDemand() ? pmr::get_default_resource() : resource));
+    floors.back().changed = onDemand(); // Not in parkingLots.dat until the next save
+    index.emplace(name, floor);
+    return floor;
+}
+
+void FloorRegistry::clear() {
+    floors.clear();
+    index.clear();
+    sourcePath.clear();
+    stamp.clear();
+    extentsStamp.clear();
+    budgetBytes = 0;
+    skipped = 0;
+    parkedOn.clear();
+}
+
+string FloorRegistry::fileStamp(const string& path) {
+    error_code ec;
+    uintmax_t size = filesystem::file_size(path, ec);
+    if (ec) {
+        return "";
+    }
+    auto written = filesystem::last_write_time(path, ec);
+    return to_string(size) + " " + to_string(ec ? 0 : static_cast<long long>(written.time_since_epoch().count()));
+}
+
+void FloorRegistry::loadOnDemand(const string& path, const string& sourceStamp, size_t budget) {
+    sourcePath = path;
+    stamp = sourceStamp;
+    extentsStamp = sourceStamp;
+    budgetBytes = budget;
+}
+
+void FloorRegistry::addListed(const string& name, const FloorExtent& extent) {
+    FloorHandle floor = size();
+    floors.emplace_back(name, FloorSpots(pmr::get_default_resource()));
+    Floor& entry = floors.back();
+    entry.loaded = false;
+    entry.sourceOffset = extent.offset;
+    entry.sourceBytes = extent.bytes;
+    entry.counts = extent.counts;
+    index.emplace(name, floor);
+}
+
+void FloorRegistry::saved(const vector<FloorExtent>& extents, const string& savedStamp) {
+    if (!onDemand()) {
+        return;
+    }
+    for (size_t i = 0; i < extents.size() && i < floors.size(); ++i) {
+        floors[i].sourceOffset = extents[i].offset;
+        floors[i].sourceBytes = extents[i].bytes;
+        floors[i].counts = extents[i].counts;
+        floors[i].changed = false;
+        floors[i].listed = true;
+    }
+    stamp = savedStamp;
+    extentsStamp = savedStamp;
+}
+
+bool FloorRegistry::hasChanges() const {
+    for (const Floor& floor : floors) {
+        if (floor.changed) return true;
+    }
+    return false;
+}
+
+void FloorRegistry::touch(FloorHandle floor, bool writing) const {
+    Floor& entry = floors[floor];
+    if (!entry.loaded && !load(floor)) {
+        return; // Not marked changed, so a save copies its lines from the file
+    }
+    entry.lastUsed = ++useClock;
+    entry.changed = entry.changed || writing;
+}
+
+void FloorRegistry::useAll(bool writing) const {
+    if (onDemand()) {
+        for (FloorHandle floor = 0; floor < size(); ++floor) {
+            touch(floor, writing);
+        }
+    }
+}
+
+bool FloorRegistry::sourceCurrent() const {
+    string current = fileStamp(sourcePath);
+    if (current == extentsStamp) {
+        return true;
+    }
+    // parkingLots.dat was replaced since it was listed: find the floors not loaded in it again.
+    // stamp is kept, so the next loadGarage() still sees the loaded floors as out of date.
+    string buffer;
+    vector<ListedFloor> listed;
+    vector<ParseError> errors;
+    if (current.empty() || !readWholeFile(sourcePath, buffer) || !scanParkingLots(buffer, listed, errors)) {
+        reportParseErrors(sourcePath, errors);
+        cerr << "Error: Unable to list the floors of " << sourcePath << "\n";
+        return false;
+    }
+    unordered_map<string, const FloorExtent*> extents;
+    for (const ListedFloor& listedFloor : listed) {
+        extents.emplace(listedFloor.name, &listedFloor.extent);
+    }
+    for (Floor& entry : floors) {
+        if (entry.loaded) continue;
+        auto it = extents.find(entry.name);
+        entry.listed = it != extents.end();
+        if (entry.listed) {
+            entry.sourceOffset = it->second->offset;
+            entry.sourceBytes = it->second->bytes;
+            entry.counts = it->second->counts;
+        }
+    }
+    extentsStamp = current;
+    return true;
+}
+
+bool FloorRegistry::load(FloorHandle floor) const {
+    Floor& entry = floors[floor];
+    TraceSpan span("loadFloor", entry.name);
+    if (!sourceCurrent() || !entry.listed) {
+        cerr << "Error: Unable to read floor " << entry.name << " from " << sourcePath << "\n";
+        ++loadFailures;
+        return false;
+    }
+    string text(static_cast<size_t>(entry.sourceBytes), '\0');
+    ifstream inFile(sourcePath, ios::binary);
+    inFile.seekg(static_cast<streamoff>(entry.sourceOffset));
+    if (!text.empty()) {
+        inFile.read(&text[0], static_cast<streamsize>(text.size()));
+    }
+    if (!inFile) {
+        cerr << "Error: Unable to read floor " << entry.name << " from " << sourcePath << "\n";
+        ++loadFailures;
+        return false;
+    }
+    recordBytesLoaded(text.size());
+    vector<ParseError> errors;
+    parseFloorSpots(text, entry.spots, errors);
+    reportParseErrors(sourcePath + " (floor " + entry.name + ")", errors);
+    noteSkipped(skippedLineCount(errors));
+    for (const ParkingSpot& spot : entry.spots) {
+        if (spot.isOccupied && !spot.plateNumber.empty()) {
+            parkedOn[spot.plateNumber] = floor;
+        }
+    }
+    entry.loaded = true;
+    ++loads;
+    return true;
+}
+
+bool FloorRegistry::unload(FloorHandle floor) {
+    Floor& entry = floors[floor];
+    if (!onDemand() || !entry.loaded || entry.changed) {
+        return false;
+    }
+    FloorSpots(entry.spots.get_allocator()).swap(entry.spots); // Frees the storage; clear() would keep it
+    entry.loaded = false;
+    ++unloads;
+    return true;
+}
+
+size_t FloorRegistry::loadedBytes() const {
+    size_t bytes = 0;
+    for (const Floor& floor : floors) {
+        bytes += floor.spots.capacity() * sizeof(ParkingSpot);
+    }
+    return bytes;
+}
+
+vector<FloorHandle> FloorRegistry::trim() {
+    vector<FloorHandle> unloaded;
+    if (!onDemand()) {
+        return unloaded;
+    }
+    size_t bytes = loadedBytes();
+    while (bytes > budgetBytes) {
+        FloorHandle coldest = invalidFloor;
+        for (FloorHandle floor = 0; floor < size(); ++floor) {
+            const Floor& entry = floors[floor];
+            if (entry.loaded && !entry.changed && (coldest == invalidFloor || entry.lastUsed < floors[coldest].lastUsed)) {
+                coldest = floor;
+            }
+        }
+        if (coldest == invalidFloor) {
+            break; // Only changed floors are left; they stay until they are saved
+        }
+        bytes -= floors[coldest].spots.capacity() * sizeof(ParkingSpot);
+        unload(coldest);
+        unloaded.push_back(coldest);
+    }
+    return unloaded;
+}
+
+void FloorRegistry::copyListed(FloorHandle floor, ostream& out) const {
+    const Floor& entry = floors[floor];
+    if (!entry.spots.empty() || !sourceCurrent() || !entry.listed) {
+        // Spots were added to a floor that could not be loaded, or its lines are gone
+        cerr << "Error: Unable to read floor " << entry.name << " from " << sourcePath << "\n";
+        out.setstate(ios::failbit);
+        return;
+    }
+    ifstream inFile(sourcePath, ios::binary);
+    inFile.seekg(static_cast<streamoff>(entry.sourceOffset));
+    char buffer[64 * 1024];
+    uint64_t left = entry.sourceBytes;
+    while (left > 0 && inFile) {
+        streamsize chunk = static_cast<streamsize>(min<uint64_t>(left, sizeof(buffer)));
+        inFile.read(buffer, chunk);
+        out.write(buffer, inFile.gcount());
+        left -= static_cast<uint64_t>(inFile.gcount());
+    }
+    if (left > 0) {
+        cerr << "Error: Unable to read floor " << entry.name << " from " << sourcePath << "\n";
+        out.setstate(ios::failbit); // So the save that is writing it is not committed
+    }
+}
+
+FloorHandle FloorRegistry::parkedFloor(const string& plateNumber) const {
+    auto it = parkedOn.find(plateNumber);
+    return it == parkedOn.end() ? invalidFloor : it->second;
+}
+
+void FloorRegistry::noteParked(const string& plateNumber, FloorHandle floor) {
+    if (onDemand()) {
+        parkedOn[plateNumber] = floor;
+    }
+}
+
+void FloorRegistry::noteDeparted(const string& plateNumber) {
+    parkedOn.erase(plateNumber);
+}
+
+void FloorCounts::add(string_view parkingType, bool isOccupied) {
+    if (parkingType.empty()) {
+        return; // Deleted spot
+    }
+    auto type = byParkingType.find(parkingType);
+    if (type == byParkingType.end()) {
+        type = byParkingType.emplace(string(parkingType), make_pair(0, 0)).first;
+    }
+    ++type->second.second;
+    ++spots;
+    if (isOccupied) {
+        ++type->second.first;
+        ++occupied;
+    }
+}
+
+bool FloorCounts::hasFreeSpot(const SiteConfig& config, const string& vehicleType) const {
+    for (const auto& type : byParkingType) {
+        if (type.second.first < type.second.second && config.acceptsVehicle(type.first, vehicleType)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+string garageFilePath(const Garage& site, const string& fileName) {
+    if (site.dataDir.empty() || site.dataDir == ".") {
+        return fileName;
+    }
+    return site.dataDir + "/" + fileName;
+}
+
+void loadAllGarages() {
+    garages.clear();
+    currentGarage = nullptr;
+
+    ifstream inFile("sites.dat");
+    if (inFile.is_open()) {
+        string name, dataDir;
+        while (inFile >> name >> dataDir) {
+            Garage& site = garages[name];
+            site.name = name;
+            site.dataDir = dataDir;
+        }
+        inFile.close();
+    }
+    if (garages.empty()) {
+        // Without sites.dat there is a single site that keeps its data in the working directory
+        Garage& site = garages["Main"];
+        site.name = "Main";
+        site.dataDir = ".";
+    }
+
+    // Every site is an independent shard, so they can all be loaded at the same time
+    vector<future<void>> pending;
+    for (auto& entry : garages) {
+        Garage* site = &entry.second;
+        pending.push_back(workerPool().submit([site] {
+            lock_guard<mutex> lock(site->mutex);
+            loadGarage(*site);
+            site->events.open(*site, time(nullptr));
+            watchConfig(*site);
+            publishMemoryUsage(*site);
+        }));
+    }
+    for (auto& result : pending) {
+        result.get();
+    }
+
+    currentGarage = &garages.begin()->second;
+}
+
+void saveSiteList() {
+    ofstream outFile("sites.dat");
+    if (outFile.is_open()) {
+        for (const auto& entry : garages) {
+            outFile << entry.second.name << " " << entry.second.dataDir << "\n";
+        }
+        outFile.close();
+    }
+    else {
+        cerr << "Error: Unable to open sites.dat for writing\n";
+    }
+}
+
+Garage& addGarage(const string& name, const string& dataDir) {
+    error_code ec;
+    filesystem::create_directories(dataDir, ec);
+    if (ec) {
+        cerr << "Error: Unable to create directory " << dataDir << "\n";
+    }
+
+    Garage& site = garages[name];
+    site.name = name;
+    site.dataDir = dataDir;
+    loadGarage(site); // Picks up existing files, or the default rates for a brand new site
+    saveGarage(site);
+    site.events.open(site, time(nullptr));
+    watchConfig(site);
+    publishMemoryUsage(site);
+    saveSiteList();
+    currentGarage = &site;
+    return site;
+}
+
+bool selectGarage(const string& name) {
+    auto it = garages.find(name);
+    if (it == garages.end()) {
+        return false;
+    }
+    currentGarage = &it->second;
+    return true;
+}
+
+OccupancySummary computeOccupancy(const Garage& site) {
+    OccupancySummary summary;
+    summary.sites = 1;
+    ReadView view(site);
+    for (const FloorVersion* floor : view->floors) {
+        if (!floor->loaded) {
+            summary.totalSpots += floor->counts.spots;
+            summary.occupiedSpots += floor->counts.occupied;
+            for (const auto& type : floor->counts.byParkingType) {
+                summary.byParkingType[type.first].first += type.second.first;
+                summary.byParkingType[type.first].second += type.second.second;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < floor->spotCount; ++i) {
+            const ParkingSpot& spot = floor->spot(i);
+            if (spot.type.empty()) continue; // Deleted spots are not part of the garage any more
+            auto& counts = summary.byParkingType[spot.type];
+            ++counts.second;
+            ++summary.totalSpots;
+            if (spot.isOccupied) {
+                ++counts.first;
+                ++summary.occupiedSpots;
+            }
+        }
+    }
+    return summary;
+}
+
+// Adds the counters of one summary to another.
+static void mergeOccupancy(OccupancySummary& total, const OccupancySummary& part) {
+    total.sites += part.sites;
+    total.totalSpots += part.totalSpots;
+    total.occupiedSpots += part.occupiedSpots;
+    for (const auto& type : part.byParkingType) {
+        total.byParkingType[type.first].first += type.second.first;
+        total.byParkingType[type.first].second += type.second.second;
+    }
+}
+
+OccupancySummary aggregateOccupancy() {
+    vector<future<OccupancySummary>> pending;
+    for (auto& entry : garages) {
+        Garage* site = &entry.second;
+        pending.push_back(workerPool().submit([site] {
+            return computeOccupancy(*site); // Reads a view, so the site's writers are not held up
+        }));
+    }
+
+    OccupancySummary total;
+    for (auto& result : pending) {
+        mergeOccupancy(total, result.get());
+    }
+    return total;
+}
+
+void manageSites() {
+    int choice;
+    do {
+        clearScreen();
+        cout << "Site Management\n";
+        cout << "Current site: " << currentGarage->name << "\n\n";
+
+        // Per-site occupancy is computed in parallel, one task per site
+        vector<pair<string, future<OccupancySummary>>> pending;
+        for (auto& entry : garages) {
+            Garage* site = &entry.second;
+            pending.emplace_back(entry.first, workerPool().submit([site] {
+                return computeOccupancy(*site);
+            }));
+        }
+        OccupancySummary total;
+        for (auto& result : pending) {
+            OccupancySummary summary = result.second.get();
+            cout << left << setw(20) << result.first << summary.occupiedSpots << "/" << summary.totalSpots << " occupied\n";
+            mergeOccupancy(total, summary);
+        }
+
+        cout << "\nAll " << total.sites << " sites: " << total.occupiedSpots << "/" << total.totalSpots << " occupied\n";
+        for (const auto& type : total.byParkingType) {
+            cout << "  " << type.first << ": " << type.second.first << "/" << type.second.second << "\n";
+        }
+
+        cout << "\n1. Switch Site\n";
+        cout << "2. Add Site\n";
+        cout << "0. Exit\n";
+        cout << "Please choose: ";
+        cin >> choice;
+        while (cin.fail() || (choice < 0 || choice > 2)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter a number between 0 and 2: ";
+            cin >> choice;
+        }
+
+        if (choice == 1) {
+            string name;
+            cout << "Enter site name: ";
+            cin >> name;
+            if (!selectGarage(name)) {
+                cout << "Invalid site\n";
+                cout << "Press Enter to continue...";
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cin.get();
+            }
+        }
+        else if (choice == 2) {
+            string name, dataDir;
+            cout << "Enter new site name: ";
+            cin >> name;
+            if (garages.find(name) != garages.end()) {
+                cout << "Site already exists\n";
+            }
+            else {
+                cout << "Enter data directory for the site (e.g., sites/North): ";
+                cin >> dataDir;
+                addGarage(name, dataDir);
+                cout << "Site added successfully\n";
+            }
+            cout << "Press Enter to continue...";
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cin.get();
+        }
+    } while (choice != 0);
+}
@@ -0,0 +1,137 @@
+#include "GarageGenerator.h"
+#include "Parking.h"
+#include "DataParser.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+bool parseTypeMix(const string& text, vector<pair<string, double>>& typeMix) {
+    typeMix.clear();
+    stringstream ss(text);
+    string entry;
+    while (getline(ss, entry, ',')) {
+        size_t equals = entry.find('=');
+        double weight;
+        if (equals == string::npos || equals == 0 || !parseNumber(string_view(entry).substr(equals + 1), weight) || weight < 0) {
+            return false;
+        }
+        typeMix.emplace_back(entry.substr(0, equals), weight);
+    }
+    return !typeMix.empty();
+}
+
+// Makes a plate number that is unique for every counter value, e.g. "GA00042".
+static string makePlate(int counter) {
+    string plate = "G";
+    plate += static_cast<char>('A' + (counter / 100000) % 26);
+    string digits = to_string(counter % 100000);
+    plate.append(5 - digits.size(), '0');
+    plate += digits;
+    if (counter >= 2600000) {
+        plate += to_string(counter / 2600000); // Keeps very large garages unique
+    }
+    return plate;
+}
+
+bool generateGarageFiles(const GeneratorOptions& options, const string& dataDir) {
+    if (options.floors <= 0 || options.spots <= 0 || options.occupancy < 0 || options.occupancy > 1) {
+        cerr << "Error: invalid generator options\n";
+        return false;
+    }
+    error_code ec;
+    filesystem::create_directories(dataDir, ec);
+
+    // Parking types to use and their share of each floor
+    map<string, set<string>> parkingTypes = sharedParkingTypes();
+    vector<pair<string, double>> mix = options.typeMix;
+    if (mix.empty()) {
+        for (const auto& type : parkingTypes) {
+            mix.emplace_back(type.first, 1.0);
+        }
+    }
+    double totalWeight = 0;
+    for (const auto& type : mix) {
+        if (parkingTypes.find(type.first) == parkingTypes.end()) {
+            cerr << "Error: unknown parking type " << type.first << " in type mix\n";
+            return false;
+        }
+        totalWeight += type.second;
+    }
+    if (totalWeight <= 0) {
+        cerr << "Error: type mix has no weight\n";
+        return false;
+    }
+
+    mt19937 random(options.seed);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    uniform_int_distribution<int> entrance(1, 2);
+    uniform_int_distribution<int> parkedSeconds(0, 12 * 3600);
+    time_t now = options.now != 0 ? options.now : time(nullptr);
+
+    ofstream lots(dataDir + "/parkingLots.dat");
+    ofstream customerFile(dataDir + "/customers.dat");
+    if (!lots.is_open() || !customerFile.is_open()) {
+        cerr << "Error: Unable to write generated data to " << dataDir << "\n";
+        return false;
+    }
+
+    int plateCounter = 0;
+    for (int floorIndex = 0; floorIndex < options.floors; ++floorIndex) {
+        string floor = "B" + to_string(floorIndex + 1);
+        int floorSpots = options.spots / options.floors + (floorIndex < options.spots % options.floors ? 1 : 0);
+        lots << floor << "\n";
+
+        // Zone the floor in contiguous blocks, one per parking type
+        int spotNumber = 0;
+        double weightSoFar = 0;
+        for (const auto& type : mix) {
+            weightSoFar += type.second;
+            int blockEnd = static_cast<int>(floorSpots * weightSoFar / totalWeight + 0.5);
+            const set<string>& vehicles = parkingTypes.at(type.first);
+            for (; spotNumber < blockEnd; ++spotNumber) {
+                string id = floor + "_" + to_string(spotNumber + 1);
+                if (!vehicles.empty() && chance(random) < options.occupancy) {
+                    auto vehicle = vehicles.begin();
+                    advance(vehicle, uniform_int_distribution<size_t>(0, vehicles.size() - 1)(random));
+                    string plate = makePlate(plateCounter++);
+                    time_t start = now - parkedSeconds(random);
+                    int gate = entrance(random);
+                    lots << id << " " << type.first << " 1 " << *vehicle << " " << plate << " " << start << " " << gate << "\n";
+                    customerFile << plate << " " << start << " 0 " << type.first << " " << *vehicle << " " << gate << " 0 0\n";
+
+                    if (chance(random) < options.idleCustomers) {
+                        // A driver who logged in at the kiosk but never rented
+                        customerFile << makePlate(plateCounter++) << " 0 0 - - 0 0 0\n";
+                    }
+                }
+                else {
+                    lots << id << " " << type.first << " 0 - - 0 0\n";
+                }
+            }
+        }
+        lots << "#\n";
+    }
+
+    ofstream rates(dataDir + "/hourlyRates.dat");
+    const double defaultRates[] = { 2.0, 3.0, 1.5 };
+    int rateIndex = 0;
+    for (const auto& type : parkingTypes) {
+        rates << type.first << " " << defaultRates[rateIndex++ % 3] << "\n";
+    }
+    ofstream dailyMax(dataDir + "/dailyMaxRate.dat");
+    dailyMax << 50 << "\n";
+    ofstream types(dataDir + "/parkingTypeToVehicleTypes.dat");
+    for (const auto& type : parkingTypes) {
+        types << type.first;
+        for (const auto& vehicle : type.second) {
+            types << " " << vehicle;
+        }
+        types << "\n";
+    }
+    return true;
+}
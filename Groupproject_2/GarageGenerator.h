@@ -0,0 +1,26 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Shape of a synthetic garage.
+struct GeneratorOptions {
+    int floors = 4;
+    int spots = 1000; // Total number of spots, spread evenly over the floors
+    std::vector<std::pair<std::string, double>> typeMix; // Parking type and relative weight; empty means every parking type equally
+    double occupancy = 0.5; // Fraction of spots that are occupied
+    double idleCustomers = 0.02; // Logins without a rental as older versions saved them, as a fraction of the occupied spots; loadGarage() drops them
+    unsigned int seed = 1;
+    time_t now = 0; // Reference time for start times; 0 means the current time
+};
+
+// Parses a type mix such as "Compact=70,Handicapped=10,Motorcycle=20". Returns false on bad syntax.
+bool parseTypeMix(const std::string& text, std::vector<std::pair<std::string, double>>& typeMix);
+
+// Writes parkingLots.dat, customers.dat, hourlyRates.dat, dailyMaxRate.dat and
+// parkingTypeToVehicleTypes.dat for a synthetic garage into dataDir.
+// Floors are zoned in contiguous blocks per parking type, and occupied spots get a plate, a
+// compatible vehicle type, an entrance and a start time in the 12 hours before the reference time.
+bool generateGarageFiles(const GeneratorOptions& options, const std::string& dataDir);
@@ -0,0 +1,821 @@
+#include "History.h"
+#include "Parking.h"
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+static const char* const eventLogFile = "events.log";
+static const char* const historyDirectory = "history";
+static const char* const indexFile = "history/index.dat";
+
+// Width of one index.dat record: sequence, time and log offset as zero padded numbers and a newline.
+static const int indexFieldWidth = 20;
+static const streamoff indexRecordSize = 3 * (indexFieldWidth + 1);
+
+static const char* const eventNames[] = { "rent", "release", "settle", "customer", "remove", "rate", "daily", "checkpoint" };
+
+struct CheckpointRecord {
+    uint64_t sequence = 0;
+    time_t time = 0;
+    uint64_t offset = 0; // Log offset of the first event after the checkpoint
+};
+
+static string historyFilePath(const string& dataDir, const string& fileName) {
+    if (dataDir.empty() || dataDir == ".") {
+        return fileName;
+    }
+    return dataDir + "/" + fileName;
+}
+
+static string checkpointFileName(uint64_t sequence) {
+    return string(historyDirectory) + "/checkpoint_" + to_string(sequence) + ".dat";
+}
+
+static bool readIndexRecord(ifstream& index, streamoff record, CheckpointRecord& checkpoint) {
+    char line[indexRecordSize + 1] = {};
+    index.clear();
+    index.seekg(record * indexRecordSize);
+    if (!index.read(line, indexRecordSize)) {
+        return false;
+    }
+    long long sequence = 0, time = 0, offset = 0;
+    string_view text(line, indexRecordSize);
+    if (!parseNumber(text.substr(0, indexFieldWidth), sequence) ||
+        !parseNumber(text.substr(indexFieldWidth + 1, indexFieldWidth), time) ||
+        !parseNumber(text.substr(2 * (indexFieldWidth + 1), indexFieldWidth), offset)) {
+        return false;
+    }
+    checkpoint.sequence = static_cast<uint64_t>(sequence);
+    checkpoint.time = static_cast<time_t>(time);
+    checkpoint.offset = static_cast<uint64_t>(offset);
+    return true;
+}
+
+static streamoff indexRecordCount(ifstream& index) {
+    index.clear();
+    index.seekg(0, ios::end);
+    streamoff size = index.tellg();
+    return size > 0 ? size / indexRecordSize : 0;
+}
+
+static bool parseEventLine(string_view line, SiteEvent& event) {
+    string_view tokens[9];
+    size_t count = splitTokens(line, tokens, 9);
+    long long sequence = 0, time = 0;
+    if (count < 3 || !parseNumber(tokens[0], sequence) || !parseNumber(tokens[1], time)) {
+        return false;
+    }
+    event.sequence = static_cast<uint64_t>(sequence);
+    event.time = static_cast<time_t>(time);
+    auto name = find(begin(eventNames), end(eventNames), tokens[2]);
+    if (name == end(eventNames)) {
+        return false;
+    }
+    event.kind = static_cast<EventKind>(name - begin(eventNames));
+
+    switch (event.kind) {
+    case EventKind::Rent:
+        if (count != 8 || !parseNumber(tokens[7], event.gate)) return false;
+        assignField(event.floor, tokens[3]);
+        assignField(event.spotId, tokens[4]);
+        assignField(event.plateNumber, tokens[5]);
+        assignField(event.vehicleType, tokens[6]);
+        return true;
+    case EventKind::Release:
+    case EventKind::RemoveCustomer:
+        if (count != 4) return false;
+        assignField(event.plateNumber, tokens[3]);
+        return true;
+    case EventKind::Settle:
+        if (count != 6 || !parseNumber(tokens[4], event.gate) || !parseNumber(tokens[5], event.amount)) return false;
+        assignField(event.plateNumber, tokens[3]);
+        return true;
+    case EventKind::AddCustomer:
+        if (count != 6) return false;
+        assignField(event.plateNumber, tokens[3]);
+        assignField(event.vehicleType, tokens[4]);
+        assignField(event.parkingType, tokens[5]);
+        return true;
+    case EventKind::SetHourlyRate:
+        if (count != 5 || !parseNumber(tokens[4], event.amount)) return false;
+        assignField(event.parkingType, tokens[3]);
+        return true;
+    case EventKind::SetDailyMaxRate:
+        return count == 4 && parseNumber(tokens[3], event.amount);
+    case EventKind::Checkpoint:
+        event.periodic = count == 4 && tokens[3] == "interval";
+        return count == 3 || event.periodic;
+    }
+    return false;
+}
+
+bool EventLog::open(const Garage& site, time_t now) {
+    close();
+    dataDir = site.dataDir;
+    string logPath = historyFilePath(dataDir, eventLogFile);
+    error_code ec;
+    filesystem::create_directories(historyFilePath(dataDir, historyDirectory), ec);
+    if (ec) {
+        cerr << "Error: Unable to create " << historyFilePath(dataDir, historyDirectory) << "\n";
+        return false;
+    }
+
+    // Continue after the last checkpoint: its record gives the sequence, and only the events
+    // written since it have to be read to find the next one
+    CheckpointRecord last;
+    bool hasCheckpoint = false;
+    {
+        ifstream index(historyFilePath(dataDir, indexFile), ios::binary);
+        streamoff records = index.is_open() ? indexRecordCount(index) : 0;
+        hasCheckpoint = records > 0 && readIndexRecord(index, records - 1, last);
+    }
+    sequence = hasCheckpoint ? last.sequence + 1 : 1;
+    sinceCheckpoint = 0;
+
+    uintmax_t logSize = filesystem::exists(logPath, ec) ? filesystem::file_size(logPath, ec) : 0;
+    uint64_t start = hasCheckpoint ? min<uint64_t>(last.offset, logSize) : 0;
+    if (logSize > start) {
+        ifstream log(logPath, ios::binary);
+        log.seekg(static_cast<streamoff>(start));
+        string tail(static_cast<size_t>(logSize - start), '\0');
+        log.read(&tail[0], static_cast<streamsize>(tail.size()));
+        size_t complete = tail.rfind('\n');
+        complete = complete == string::npos ? 0 : complete + 1;
+        if (complete < tail.size()) {
+            filesystem::resize_file(logPath, start + complete, ec); // Torn by a crash mid-write
+        }
+        TextCursor cursor(string_view(tail).substr(0, complete));
+        string_view line;
+        SiteEvent event;
+        while (cursor.nextLine(line)) {
+            if (parseEventLine(line, event)) {
+                sequence = max(sequence, event.sequence + 1);
+                ++sinceCheckpoint;
+            }
+        }
+    }
+
+    out.open(logPath, ios::app | ios::binary);
+    if (!out.is_open()) {
+        cerr << "Error: Unable to open " << logPath << " for writing\n";
+        return false;
+    }
+    out << setprecision(12); // Payments and rates must replay exactly as they were charged
+    if (!hasCheckpoint) {
+        checkpoint(site, now);
+    }
+    return true;
+}
+
+void EventLog::close() {
+    if (out.is_open()) {
+        out.close();
+    }
+}
+
+void EventLog::record(const Garage& site, SiteEvent& event) {
+    event.sequence = sequence++;
+    out << event.sequence << " " << event.time << " " << eventNames[static_cast<int>(event.kind)];
+    switch (event.kind) {
+    case EventKind::Rent:
+        out << " " << fieldOrPlaceholder(event.floor) << " " << fieldOrPlaceholder(event.spotId) << " "
+            << fieldOrPlaceholder(event.plateNumber) << " " << fieldOrPlaceholder(event.vehicleType) << " " << event.gate;
+        break;
+    case EventKind::Release:
+    case EventKind::RemoveCustomer:
+        out << " " << fieldOrPlaceholder(event.plateNumber);
+        break;
+    case EventKind::Settle:
+        out << " " << fieldOrPlaceholder(event.plateNumber) << " " << event.gate << " " << event.amount;
+        break;
+    case EventKind::AddCustomer:
+        out << " " << fieldOrPlaceholder(event.plateNumber) << " " << fieldOrPlaceholder(event.vehicleType) << " "
+            << fieldOrPlaceholder(event.parkingType);
+        break;
+    case EventKind::SetHourlyRate:
+        out << " " << fieldOrPlaceholder(event.parkingType) << " " << event.amount;
+        break;
+    case EventKind::SetDailyMaxRate:
+        out << " " << event.amount;
+        break;
+    case EventKind::Checkpoint:
+        if (event.periodic) {
+            out << " interval";
+        }
+        break;
+    }
+    out << "\n";
+    out.flush(); // One write per event, so a crash loses at most the event being written
+    if (event.kind != EventKind::Checkpoint && ++sinceCheckpoint >= checkpointInterval) {
+        writeCheckpoint(site, event.time, true);
+    }
+}
+
+void EventLog::recordRent(const Garage& site, const string& floor, const string& spotId, const string& plateNumber,
+    const string& vehicleType, int entrance, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::Rent;
+    event.floor = floor;
+    event.spotId = spotId;
+    event.plateNumber = plateNumber;
+    event.vehicleType = vehicleType;
+    event.gate = entrance;
+    record(site, event);
+}
+
+void EventLog::recordRelease(const Garage& site, const string& plateNumber, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::Release;
+    event.plateNumber = plateNumber;
+    record(site, event);
+}
+
+void EventLog::recordSettle(const Garage& site, const string& plateNumber, int exit, double payment, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::Settle;
+    event.plateNumber = plateNumber;
+    event.gate = exit;
+    event.amount = payment;
+    record(site, event);
+}
+
+void EventLog::recordCustomer(const Garage& site, const string& plateNumber, const string& vehicleType,
+    const string& parkingType, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::AddCustomer;
+    event.plateNumber = plateNumber;
+    event.vehicleType = vehicleType;
+    event.parkingType = parkingType;
+    record(site, event);
+}
+
+void EventLog::recordCustomerRemoved(const Garage& site, const string& plateNumber, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::RemoveCustomer;
+    event.plateNumber = plateNumber;
+    record(site, event);
+}
+
+void EventLog::recordHourlyRate(const Garage& site, const string& parkingType, double rate, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::SetHourlyRate;
+    event.parkingType = parkingType;
+    event.amount = rate;
+    record(site, event);
+}
+
+void EventLog::recordDailyMaxRate(const Garage& site, double rate, time_t now) {
+    if (!isOpen()) return;
+    SiteEvent event;
+    event.time = now;
+    event.kind = EventKind::SetDailyMaxRate;
+    event.amount = rate;
+    record(site, event);
+}
+
+// A checkpoint file starts with the checkpoint's sequence and time and the byte length of each
+// section, followed by the sections in the formats of parkingLots.dat, customers.dat,
+// hourlyRates.dat and dailyMaxRate.dat.
+void EventLog::checkpoint(const Garage& site, time_t now) {
+    writeCheckpoint(site, now, false);
+}
+
+void EventLog::writeCheckpoint(const Garage& site, time_t now, bool periodic) {
+    if (!isOpen()) return;
+    TraceSpan span("writeCheckpoint", site.name);
+    uint64_t checkpointSequence = sequence;
+    ostringstream lots, customers, rates, daily;
+    writeParkingLots(lots, site);
+    customers << setprecision(12);
+    writeCustomers(customers, site.customers);
+    {
+        ConfigView config(site);
+        rates << setprecision(12);
+        writeHourlyRates(rates, config->hourlyRates);
+        daily << setprecision(12) << config->dailyMaxRate << "\n";
+    }
+
+    string path = historyFilePath(dataDir, checkpointFileName(checkpointSequence));
+    {
+        ofstream file(path + ".tmp", ios::binary);
+        file << checkpointSequence << " " << now << " " << lots.tellp() << " " << customers.tellp() << " "
+            << rates.tellp() << " " << daily.tellp() << "\n"
+            << lots.str() << customers.str() << rates.str() << daily.str();
+        file.close();
+        if (file.fail()) {
+            cerr << "Error: Unable to write " << path << "\n";
+            return; // The log goes on; the next checkpoint is tried after another interval
+        }
+        recordBytesPersisted(static_cast<uint64_t>(file.tellp()));
+    }
+    error_code ec;
+    filesystem::rename(path + ".tmp", path, ec);
+    if (ec) {
+        cerr << "Error: Unable to replace " << path << ": " << ec.message() << "\n";
+        return;
+    }
+
+    // The marker goes into the log before the index record, so every indexed offset is a line start
+    SiteEvent marker;
+    marker.time = now;
+    marker.kind = EventKind::Checkpoint;
+    marker.periodic = periodic;
+    record(site, marker);
+    ofstream index(historyFilePath(dataDir, indexFile), ios::app | ios::binary);
+    index << setfill('0') << setw(indexFieldWidth) << checkpointSequence << " " << setw(indexFieldWidth) << now << " "
+        << setw(indexFieldWidth) << static_cast<uint64_t>(out.tellp()) << "\n";
+    sinceCheckpoint = 0;
+}
+
+// Applies events to a rebuilt site the way rentSpot(), releaseSpot(), settleCustomer() and the
+// customer and rate screens change the live one, without the allocator, forecaster, views or
+// metrics the live site keeps. The spots and plates it changes are collected for publishing.
+class SiteReplayer {
+public:
+    explicit SiteReplayer(Garage& site) : site(site) {
+        for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+            const FloorSpots& spots = site.floors[floor].spots;
+            for (size_t i = 0; i < spots.size(); ++i) {
+                SpotRef spot{ floor, static_cast<int>(i) };
+                spotsById[site.floors[floor].name + " " + spots[i].id] = spot;
+                if (spots[i].isOccupied) {
+                    parkedAt[spots[i].plateNumber] = spot;
+                }
+            }
+        }
+    }
+
+    void apply(const SiteEvent& event) {
+        if (!event.plateNumber.empty()) {
+            touchedPlates.push_back(event.plateNumber);
+        }
+        switch (event.kind) {
+        case EventKind::Rent: {
+            auto found = spotsById.find(event.floor + " " + event.spotId);
+            if (found == spotsById.end()) {
+                return; // The spot was deleted by an edit the checkpoint already reflects
+            }
+            touchedSpots.push_back(found->second);
+            ParkingSpot& spot = site.floors[found->second.floor].spots[found->second.index];
+            spot.isOccupied = true;
+            spot.vehicleType = event.vehicleType;
+            spot.plateNumber = event.plateNumber;
+            spot.startTime = event.time;
+            spot.entrance = event.gate;
+            parkedAt[event.plateNumber] = found->second;
+            Customer& customer = site.customers[event.plateNumber];
+            customer.plateNumber = event.plateNumber;
+            customer.startTime = event.time;
+            customer.entrance = event.gate;
+            customer.parkingType = spot.type;
+            customer.vehicleType = event.vehicleType;
+            customer.endTime = 0;
+            customer.exit = 0;
+            break;
+        }
+        case EventKind::Release:
+            vacate(event.plateNumber);
+            break;
+        case EventKind::Settle:
+            if (recordPayments) {
+                recordPayment(event);
+            }
+            vacate(event.plateNumber);
+            site.customers.erase(event.plateNumber);
+            break;
+        case EventKind::RemoveCustomer:
+            vacate(event.plateNumber);
+            site.customers.erase(event.plateNumber);
+            break;
+        case EventKind::AddCustomer: {
+            if (site.customers.count(event.plateNumber) == 0) {
+                Customer& customer = site.customers[event.plateNumber];
+                customer.plateNumber = event.plateNumber;
+                customer.vehicleType = event.vehicleType;
+                customer.parkingType = event.parkingType;
+            }
+            break;
+        }
+        case EventKind::SetHourlyRate:
+            site.config.update([&event](SiteConfig& config) { config.hourlyRates[event.parkingType]["Default"] = event.amount; });
+            break;
+        case EventKind::SetDailyMaxRate:
+            site.config.update([&event](SiteConfig& config) { config.dailyMaxRate = event.amount; });
+            break;
+        case EventKind::Checkpoint:
+            break;
+        }
+    }
+
+    bool recordPayments = false; // Add settled payments to the site's ledger
+    vector<SpotRef> touchedSpots;
+    vector<string> touchedPlates;
+
+private:
+    // Adds a settle to the ledger as settleCustomer() did on the primary, before the car leaves.
+    void recordPayment(const SiteEvent& event) {
+        auto customer = site.customers.find(event.plateNumber);
+        if (customer == site.customers.end()) {
+            return;
+        }
+        auto parked = parkedAt.find(event.plateNumber);
+        if (parked == parkedAt.end() || customer->second.startTime == 0) {
+            return;
+        }
+        double hours = ceil(difftime(event.time, customer->second.startTime) / 3600.0);
+        site.ledger.record(SettledPayment{ customer->second.parkingType, site.floors[parked->second.floor].name,
+            customer->second.entrance, event.gate, event.time, event.amount, hours });
+    }
+
+    void vacate(const string& plateNumber) {
+        auto parked = parkedAt.find(plateNumber);
+        if (parked == parkedAt.end()) {
+            return;
+        }
+        touchedSpots.push_back(parked->second);
+        ParkingSpot& spot = site.floors[parked->second.floor].spots[parked->second.index];
+        spot.isOccupied = false;
+        spot.vehicleType = "";
+        spot.plateNumber = "";
+        spot.startTime = 0;
+        spot.entrance = 0;
+        parkedAt.erase(parked);
+    }
+
+    Garage& site;
+    unordered_map<string, SpotRef> spotsById; // "floor spot" -> spot
+    unordered_map<string, SpotRef> parkedAt; // Plate -> spot it occupies
+};
+
+static bool loadCheckpoint(const string& dataDir, uint64_t sequence, Garage& state, string& error) {
+    string path = historyFilePath(dataDir, checkpointFileName(sequence));
+    string buffer;
+    if (!readWholeFile(path, buffer)) {
+        error = "Unable to open " + path;
+        return false;
+    }
+    size_t headerEnd = buffer.find('\n');
+    string_view tokens[6];
+    long long sizes[4] = {};
+    if (headerEnd == string::npos || splitTokens(string_view(buffer).substr(0, headerEnd), tokens, 6) != 6) {
+        error = path + " has no header";
+        return false;
+    }
+    size_t offset = headerEnd + 1;
+    for (int i = 0; i < 4; ++i) {
+        if (!parseNumber(tokens[2 + i], sizes[i]) || sizes[i] < 0) {
+            error = path + " has a bad header";
+            return false;
+        }
+    }
+    if (offset + sizes[0] + sizes[1] + sizes[2] + sizes[3] > buffer.size()) {
+        error = path + " is shorter than its header says";
+        return false;
+    }
+
+    string_view text(buffer);
+    vector<ParseError> errors;
+    state.floors.clear();
+    state.arena.release();
+    state.customers.clear();
+    SiteConfig config;
+    config.hourlyRates.clear();
+    parseParkingLots(text.substr(offset, sizes[0]), state, errors);
+    offset += sizes[0];
+    parseCustomers(text.substr(offset, sizes[1]), state.customers, errors);
+    offset += sizes[1];
+    parseHourlyRates(text.substr(offset, sizes[2]), config.hourlyRates, errors);
+    offset += sizes[2];
+    parseDailyMaxRate(text.substr(offset, sizes[3]), config.dailyMaxRate, errors);
+    if (!errors.empty()) {
+        error = path + " line " + to_string(errors.front().line) + ": " + errors.front().message;
+        return false;
+    }
+    state.config.replace(config);
+    return true;
+}
+
+ReplayResult reconstructSite(const string& dataDir, time_t asOf, Garage& state, bool nearestCheckpoint) {
+    TraceSpan span("reconstructSite", dataDir);
+    ReplayResult result;
+    ifstream index(historyFilePath(dataDir, indexFile), ios::binary);
+    streamoff records = index.is_open() ? indexRecordCount(index) : 0;
+    CheckpointRecord first;
+    if (records == 0 || !readIndexRecord(index, 0, first)) {
+        result.error = "The site has no recorded history";
+        return result;
+    }
+    if (first.time > asOf) {
+        result.error = "The history of the site starts later, at checkpoint " + to_string(first.sequence);
+        return result;
+    }
+
+    // Last checkpoint at or before the time; checkpoints are written in time order
+    streamoff chosen = 0;
+    if (nearestCheckpoint) {
+        streamoff low = 0, high = records - 1;
+        while (low < high) {
+            streamoff middle = low + (high - low + 1) / 2;
+            CheckpointRecord record;
+            if (readIndexRecord(index, middle, record) && record.time <= asOf) {
+                low = middle;
+            }
+            else {
+                high = middle - 1;
+            }
+        }
+        chosen = low;
+    }
+    CheckpointRecord checkpoint;
+    readIndexRecord(index, chosen, checkpoint);
+    CheckpointRecord next;
+    bool hasNext = nearestCheckpoint && chosen + 1 < records && readIndexRecord(index, chosen + 1, next);
+
+    if (!loadCheckpoint(dataDir, checkpoint.sequence, state, result.error)) {
+        return result;
+    }
+    result.restored = true;
+    result.checkpointSequence = checkpoint.sequence;
+    result.checkpointTime = checkpoint.time;
+    result.lastSequence = checkpoint.sequence;
+    result.lastEventTime = checkpoint.time;
+
+    // Events between this checkpoint and the next; any later ones happened after the time
+    string logPath = historyFilePath(dataDir, eventLogFile);
+    error_code ec;
+    uint64_t logSize = filesystem::file_size(logPath, ec);
+    if (ec) {
+        logSize = 0;
+    }
+    uint64_t end = hasNext ? min<uint64_t>(next.offset, logSize) : logSize;
+    if (end > checkpoint.offset) {
+        string events(static_cast<size_t>(end - checkpoint.offset), '\0');
+        ifstream log(logPath, ios::binary);
+        log.seekg(static_cast<streamoff>(checkpoint.offset));
+        log.read(&events[0], static_cast<streamsize>(events.size()));
+        events.resize(static_cast<size_t>(log.gcount()));
+
+        SiteReplayer replayer(state);
+        TextCursor cursor(events);
+        string_view line;
+        SiteEvent event;
+        while (cursor.nextLine(line)) {
+            if (!parseEventLine(line, event)) {
+                result.truncated = true;
+                break;
+            }
+            if (event.time > asOf) {
+                break;
+            }
+            replayer.apply(event);
+            result.lastSequence = event.sequence;
+            result.lastEventTime = event.time;
+            if (event.kind != EventKind::Checkpoint) {
+                ++result.eventsReplayed;
+            }
+        }
+    }
+    state.plates.rebuild(state);
+    state.views.publishAll(state);
+    return result;
+}
+
+LogFollower::LogFollower() = default;
+LogFollower::~LogFollower() = default;
+
+bool LogFollower::restore(uint64_t checkpointSequence, Garage& state, string& error) {
+    if (!loadCheckpoint(dataDir, checkpointSequence, state, error)) {
+        return false;
+    }
+    replayer = make_unique<SiteReplayer>(state);
+    replayer->recordPayments = following; // The ledger read with the site already has the payments before start()
+    ++loaded;
+    return true;
+}
+
+bool LogFollower::start(const string& directory, Garage& state, string& error) {
+    TraceSpan span("startFollowing", directory);
+    dataDir = directory;
+    logPath = historyFilePath(dataDir, eventLogFile);
+    CheckpointRecord last;
+    {
+        ifstream index(historyFilePath(dataDir, indexFile), ios::binary);
+        streamoff records = index.is_open() ? indexRecordCount(index) : 0;
+        if (records == 0 || !readIndexRecord(index, records - 1, last)) {
+            error = "The site has no recorded history";
+            return false;
+        }
+    }
+    if (!restore(last.sequence, state, error)) {
+        return false;
+    }
+    offset = last.offset;
+    sequence = last.sequence;
+    eventTime = last.time;
+    catchUp(state);
+    following = true;
+    replayer->recordPayments = true;
+    state.plates.rebuild(state);
+    state.views.publishAll(state);
+    return true;
+}
+
+size_t LogFollower::catchUp(Garage& state) {
+    if (stuck || !replayer) {
+        return 0;
+    }
+    error_code ec;
+    uint64_t size = filesystem::file_size(logPath, ec);
+    if (ec || size <= offset) {
+        return 0;
+    }
+    string events(static_cast<size_t>(size - offset), '\0');
+    {
+        ifstream log(logPath, ios::binary);
+        log.seekg(static_cast<streamoff>(offset));
+        log.read(&events[0], static_cast<streamsize>(events.size()));
+        events.resize(static_cast<size_t>(log.gcount()));
+    }
+    size_t complete = events.rfind('\n');
+    if (complete == string::npos) {
+        return 0; // The line being written is not finished yet
+    }
+    events.resize(complete + 1);
+
+    TraceSpan span("applyShippedEvents", dataDir);
+    size_t count = 0;
+    bool reloaded = false;
+    TextCursor cursor(events);
+    string_view line;
+    SiteEvent event;
+    size_t consumed = 0;
+    while (cursor.nextLine(line)) {
+        if (!parseEventLine(line, event)) {
+            stuck = true;
+            cerr << "Error: " << logPath << " cannot be read past event " << sequence << "\n";
+            break;
+        }
+        consumed = cursor.rest().data() - events.data();
+        if (event.sequence <= sequence) {
+            continue; // Already in the checkpoint the copy started from
+        }
+        if (event.kind == EventKind::Checkpoint && !event.periodic) {
+            string error;
+            if (!restore(event.sequence, state, error)) {
+                stuck = true;
+                cerr << "Error: " << error << "\n";
+                break;
+            }
+            reloaded = true;
+        }
+        else {
+            replayer->apply(event);
+        }
+        sequence = event.sequence;
+        eventTime = event.time;
+        ++applied;
+        ++count;
+    }
+    offset += consumed;
+
+    // Publish what changed; a reloaded checkpoint or a large batch is published whole
+    vector<SpotRef>& spots = replayer->touchedSpots;
+    vector<string>& plates = replayer->touchedPlates;
+    if (reloaded || spots.size() > 4096) {
+        state.plates.rebuild(state);
+        state.views.publishAll(state);
+    }
+    else if (count > 0) {
+        sort(plates.begin(), plates.end());
+        plates.erase(unique(plates.begin(), plates.end()), plates.end());
+        for (const string& plateNumber : plates) {
+            if (state.customers.count(plateNumber) > 0) {
+                state.plates.insert(plateNumber);
+            }
+            else {
+                state.plates.erase(plateNumber);
+            }
+        }
+        state.views.publish(state, spots, plates);
+    }
+    spots.clear();
+    plates.clear();
+    return count;
+}
+
+uint64_t LogFollower::bytesBehind() const {
+    error_code ec;
+    uint64_t size = filesystem::file_size(logPath, ec);
+    return !ec && size > offset ? size - offset : 0;
+}
+
+string formatLocalTime(time_t time) {
+    struct tm timeinfo;
+#ifdef _WIN32
+    localtime_s(&timeinfo, &time);
+#else
+    localtime_r(&time, &timeinfo);
+#endif
+    char text[20];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return text;
+}
+
+bool parseLocalTime(const string& text, time_t& time) {
+    long long seconds;
+    if (parseNumber(text, seconds)) {
+        time = static_cast<time_t>(seconds);
+        return true;
+    }
+    struct tm timeinfo = {};
+    int fields = sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &timeinfo.tm_year, &timeinfo.tm_mon, &timeinfo.tm_mday,
+        &timeinfo.tm_hour, &timeinfo.tm_min, &timeinfo.tm_sec);
+    if (fields < 5) {
+        return false;
+    }
+    timeinfo.tm_year -= 1900;
+    timeinfo.tm_mon -= 1;
+    timeinfo.tm_isdst = -1; // Let the library decide whether daylight saving time applies
+    time = mktime(&timeinfo);
+    return time != static_cast<time_t>(-1);
+}
+
+void writeSiteHistory(ostream& out, const Garage& state, const ReplayResult& result, time_t asOf, const string& plateNumber) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+
+    out << "State as of " << formatLocalTime(asOf) << "\n";
+    out << "Restored checkpoint " << result.checkpointSequence << " (" << formatLocalTime(result.checkpointTime)
+        << ") and replayed " << result.eventsReplayed << " events up to event " << result.lastSequence << "\n";
+    if (result.truncated) {
+        out << "The log could not be read past event " << result.lastSequence << "\n";
+    }
+
+    OccupancySummary occupancy = computeOccupancy(state);
+    out << "Occupied spots: " << occupancy.occupiedSpots << " of " << occupancy.totalSpots << "\n";
+    out << fixed << setprecision(2);
+    ConfigView config(state);
+    out << "Hourly rates:";
+    for (const auto& type : config->hourlyRates) {
+        auto rate = type.second.find("Default");
+        if (rate != type.second.end()) {
+            out << " " << type.first << " $" << rate->second;
+        }
+    }
+    out << ", daily maximum $" << config->dailyMaxRate << "\n";
+
+    if (!plateNumber.empty()) {
+        auto customer = state.customers.find(plateNumber);
+        const ParkingSpot* parked = nullptr;
+        string parkedFloor;
+        for (const auto& floor : state.floors) {
+            for (const auto& spot : floor.spots) {
+                if (spot.isOccupied && spot.plateNumber == plateNumber) {
+                    parked = &spot;
+                    parkedFloor = floor.name;
+                }
+            }
+        }
+        if (customer == state.customers.end()) {
+            out << "Plate " << plateNumber << ": no customer record\n";
+        }
+        else if (parked == nullptr) {
+            out << "Plate " << plateNumber << ": not parked"
+                << (customer->second.vehicleType.empty() ? "" : ", vehicle " + customer->second.vehicleType) << "\n";
+        }
+        else {
+            double hours;
+            double fee = calculateParkingFee(state, customer->second.parkingType, parked->startTime, asOf, hours);
+            out << "Plate " << plateNumber << ": parked at " << parked->id << " on floor " << parkedFloor
+                << " (" << parked->type << ", " << parked->vehicleType << ") since " << formatLocalTime(parked->startTime)
+                << " through entrance " << parked->entrance << "\n";
+            out << "Fee so far: $" << fee << " for " << setprecision(1) << hours << " hours\n";
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+struct Garage;
+
+// Changes to a site that are recorded one by one. Edits to the spots themselves (adding,
+// retyping, deleting or clearing them) are recorded as a checkpoint of the whole site instead.
+enum class EventKind {
+    Rent,
+    Release, // A parked car left without settling
+    Settle,
+    AddCustomer,
+    RemoveCustomer,
+    SetHourlyRate,
+    SetDailyMaxRate,
+    Checkpoint // Marks where a checkpoint was taken; replay skips it
+};
+
+// One line of events.log. Only the fields of the event's kind are used.
+struct SiteEvent {
+    uint64_t sequence = 0;
+    time_t time = 0;
+    EventKind kind = EventKind::Rent;
+    std::string plateNumber;
+    std::string floor; // Rent
+    std::string spotId; // Rent
+    std::string vehicleType; // Rent, AddCustomer
+    std::string parkingType; // AddCustomer, SetHourlyRate
+    int gate = 0; // Entrance of a rent, exit of a settle
+    double amount = 0; // Payment of a settle, or the new rate
+    bool periodic = false; // Checkpoint taken every checkpointInterval events rather than after an edit
+};
+
+// Ordered log of every change to one site, in <dataDir>/events.log, with a checkpoint of the
+// whole site every checkpointInterval events in <dataDir>/history/. Each checkpoint has a fixed
+// width record in history/index.dat giving its sequence, time and the log offset just after it, so
+// the checkpoint for any time is found by binary search and only the events up to the next
+// checkpoint are read. The log is opened only for sites the menus work on; sites loaded by the
+// batch modes record nothing.
+class EventLog {
+public:
+    // Starts recording into the site's data directory, continuing the log already there. A torn
+    // last line is cut off. A site without history gets a first checkpoint.
+    bool open(const Garage& site, time_t now);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+
+    void recordRent(const Garage& site, const std::string& floor, const std::string& spotId, const std::string& plateNumber,
+        const std::string& vehicleType, int entrance, time_t now);
+    void recordRelease(const Garage& site, const std::string& plateNumber, time_t now);
+    void recordSettle(const Garage& site, const std::string& plateNumber, int exit, double payment, time_t now);
+    void recordCustomer(const Garage& site, const std::string& plateNumber, const std::string& vehicleType,
+        const std::string& parkingType, time_t now);
+    void recordCustomerRemoved(const Garage& site, const std::string& plateNumber, time_t now);
+    void recordHourlyRate(const Garage& site, const std::string& parkingType, double rate, time_t now);
+    void recordDailyMaxRate(const Garage& site, double rate, time_t now);
+
+    // Writes a checkpoint of the site as it is now. Called after edits that are not logged as
+    // events; the log marks it so that a standby following the log loads it.
+    void checkpoint(const Garage& site, time_t now);
+
+    uint64_t nextSequence() const { return sequence; }
+
+    uint64_t checkpointInterval = 1000;
+
+private:
+    void record(const Garage& site, SiteEvent& event);
+    void writeCheckpoint(const Garage& site, time_t now, bool periodic);
+
+    std::string dataDir;
+    std::ofstream out;
+    uint64_t sequence = 1; // Sequence of the next event
+    uint64_t sinceCheckpoint = 0;
+};
+
+// Outcome of rebuilding a site from its history.
+struct ReplayResult {
+    bool restored = false;
+    std::string error; // Why nothing was restored
+    uint64_t checkpointSequence = 0;
+    time_t checkpointTime = 0;
+    uint64_t lastSequence = 0; // Last event applied, or the checkpoint's sequence
+    time_t lastEventTime = 0;
+    size_t eventsReplayed = 0;
+    bool truncated = false; // Replay stopped at a line it could not read
+};
+
+// Rebuilds the site in dataDir as it was at the given time into state, a site that is not
+// otherwise in use: restores the last checkpoint taken at or before that time and applies the
+// events after it up to that time. The work is bounded by the checkpoint interval, not by the
+// length of the log. With nearestCheckpoint false, replay starts from the first checkpoint instead
+// and runs through every later one, which is what the replay benchmark times.
+ReplayResult reconstructSite(const std::string& dataDir, time_t asOf, Garage& state, bool nearestCheckpoint = true);
+
+class SiteReplayer;
+
+// Follows the event log of a site while another process appends to it, keeping a copy of the site
+// current. The copy starts from the last checkpoint, and every complete line appended after it is
+// applied the way reconstructSite() applies them. A checkpoint marking an edit that was not logged
+// event by event replaces the copy; checkpoints taken on the interval are passed over. Payments
+// settled after start() are added to the copy's revenue ledger.
+class LogFollower {
+public:
+    LogFollower();
+    ~LogFollower();
+
+    // Restores state, a site not otherwise in use, from the last checkpoint in dataDir and applies
+    // every complete event after it. Returns false and sets error if there is no history.
+    bool start(const std::string& dataDir, Garage& state, std::string& error);
+
+    // Applies the complete events appended since the last call and publishes the spots and
+    // customers they changed. The caller must hold the state exclusively. Returns the number of
+    // events applied.
+    size_t catchUp(Garage& state);
+
+    // Bytes of the log not applied yet, an incomplete last line included.
+    uint64_t bytesBehind() const;
+
+    uint64_t lastSequence() const { return sequence; }
+    time_t lastEventTime() const { return eventTime; }
+    uint64_t eventsApplied() const { return applied; }
+    uint64_t checkpointsLoaded() const { return loaded; }
+    bool stalled() const { return stuck; } // A line could not be read; nothing after it is applied
+
+private:
+    bool restore(uint64_t checkpointSequence, Garage& state, std::string& error);
+
+    std::string dataDir;
+    std::string logPath;
+    std::unique_ptr<SiteReplayer> replayer;
+    uint64_t offset = 0; // Log offset of the next line to apply
+    uint64_t sequence = 0;
+    time_t eventTime = 0;
+    uint64_t applied = 0;
+    uint64_t loaded = 0;
+    bool following = false; // Set once the copy has caught up at start()
+    bool stuck = false;
+};
+
+// Writes the occupancy and rates of a rebuilt site and, when a plate is given, that customer's
+// record, spot and fee so far as of the time.
+void writeSiteHistory(std::ostream& out, const Garage& state, const ReplayResult& result, time_t asOf,
+    const std::string& plateNumber);
+
+// Reads a local time written as "YYYY-MM-DD HH:MM[:SS]", or seconds since the epoch.
+bool parseLocalTime(const std::string& text, time_t& time);
+
+// Formats a time as "YYYY-MM-DD HH:MM:SS", the way the customer listing does.
+std::string formatLocalTime(time_t time);
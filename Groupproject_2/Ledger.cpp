@@ -0,0 +1,196 @@
+#include "Ledger.h"
+#include "DataParser.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+static const int hoursKept = 62 * 24;
+static const int daysKept = 2 * 366;
+
+void RevenueTotals::add(long long paymentCents, long long billedHours) {
+    cents += paymentCents;
+    ++payments;
+    hours += billedHours;
+}
+
+void RevenueTotals::add(const RevenueTotals& other) {
+    cents += other.cents;
+    payments += other.payments;
+    hours += other.hours;
+}
+
+void RevenueRollup::add(const RevenueRollup& other) {
+    total.add(other.total);
+    for (const auto& slice : other.byParkingType) byParkingType[slice.first].add(slice.second);
+    for (const auto& slice : other.byFloor) byFloor[slice.first].add(slice.second);
+    for (const auto& slice : other.byEntrance) byEntrance[slice.first].add(slice.second);
+    for (const auto& slice : other.byExit) byExit[slice.first].add(slice.second);
+}
+
+static struct tm localParts(time_t when) {
+    struct tm timeinfo;
+#ifdef _WIN32
+    localtime_s(&timeinfo, &when);
+#else
+    localtime_r(&when, &timeinfo);
+#endif
+    return timeinfo;
+}
+
+long long RevenueLedger::periodKey(LedgerPeriod period, time_t when) {
+    struct tm timeinfo = localParts(when);
+    long long month = (timeinfo.tm_year + 1900) * 100LL + timeinfo.tm_mon + 1;
+    if (period == LedgerPeriod::Month) {
+        return month;
+    }
+    long long day = month * 100 + timeinfo.tm_mday;
+    return period == LedgerPeriod::Day ? day : day * 100 + timeinfo.tm_hour;
+}
+
+time_t RevenueLedger::periodsBefore(LedgerPeriod period, time_t now, int count) {
+    struct tm timeinfo = localParts(now);
+    timeinfo.tm_min = 0;
+    timeinfo.tm_sec = 0;
+    timeinfo.tm_isdst = -1; // mktime() works out daylight saving for the new date
+    if (period == LedgerPeriod::Hour) {
+        timeinfo.tm_hour -= count;
+    }
+    else {
+        timeinfo.tm_hour = 0;
+        if (period == LedgerPeriod::Day) {
+            timeinfo.tm_mday -= count;
+        }
+        else {
+            timeinfo.tm_mday = 1;
+            timeinfo.tm_mon -= count;
+        }
+    }
+    return mktime(&timeinfo);
+}
+
+void RevenueLedger::record(const SettledPayment& payment) {
+    long long cents = llround(payment.amount * 100.0);
+    long long hours = llround(payment.hours);
+    for (int i = 0; i < periodCount; ++i) {
+        LedgerPeriod period = static_cast<LedgerPeriod>(i);
+        Rollups& rollups = periods[i];
+        long long key = periodKey(period, payment.endTime);
+        auto found = rollups.find(key);
+        if (found == rollups.end()) {
+            // A new period: drop the ones that have aged out of this granularity
+            int kept = period == LedgerPeriod::Hour ? hoursKept : period == LedgerPeriod::Day ? daysKept : 0;
+            if (kept > 0) {
+                long long oldest = periodKey(period, periodsBefore(period, payment.endTime, kept));
+                if (key < oldest) continue;
+                rollups.erase(rollups.begin(), rollups.lower_bound(oldest));
+            }
+            found = rollups.emplace(key, RevenueRollup()).first;
+        }
+        RevenueRollup& rollup = found->second;
+        rollup.total.add(cents, hours);
+        rollup.byParkingType[payment.parkingType].add(cents, hours);
+        rollup.byFloor[payment.floor].add(cents, hours);
+        rollup.byEntrance[payment.entrance].add(cents, hours);
+        rollup.byExit[payment.exit].add(cents, hours);
+    }
+    changed = true;
+}
+
+const RevenueRollup* RevenueLedger::rollupAt(LedgerPeriod period, time_t when) const {
+    const Rollups& periodRollups = rollups(period);
+    auto found = periodRollups.find(periodKey(period, when));
+    return found != periodRollups.end() ? &found->second : nullptr;
+}
+
+RevenueTotals RevenueLedger::lifetime() const {
+    RevenueTotals totals;
+    for (const auto& month : rollups(LedgerPeriod::Month)) {
+        totals.add(month.second.total);
+    }
+    return totals;
+}
+
+const char* periodCode(LedgerPeriod period) {
+    return period == LedgerPeriod::Hour ? "H" : period == LedgerPeriod::Day ? "D" : "M";
+}
+
+static void writeSlice(ostream& out, const char* code, long long key, const char* dimension, const string& value, const RevenueTotals& totals) {
+    out << code << " " << key << " " << dimension << " " << fieldOrPlaceholder(value) << " "
+        << totals.payments << " " << totals.cents << " " << totals.hours << "\n";
+}
+
+void writeLedger(ostream& out, const RevenueLedger& ledger) {
+    for (LedgerPeriod period : { LedgerPeriod::Hour, LedgerPeriod::Day, LedgerPeriod::Month }) {
+        const char* code = periodCode(period);
+        for (const auto& entry : ledger.rollups(period)) {
+            const RevenueRollup& rollup = entry.second;
+            writeSlice(out, code, entry.first, "all", "", rollup.total);
+            for (const auto& slice : rollup.byParkingType) writeSlice(out, code, entry.first, "type", slice.first, slice.second);
+            for (const auto& slice : rollup.byFloor) writeSlice(out, code, entry.first, "floor", slice.first, slice.second);
+            for (const auto& slice : rollup.byEntrance) writeSlice(out, code, entry.first, "entrance", to_string(slice.first), slice.second);
+            for (const auto& slice : rollup.byExit) writeSlice(out, code, entry.first, "exit", to_string(slice.first), slice.second);
+        }
+    }
+}
+
+// Formats a period key as a date: "YYYY-MM-DD HH:00", "YYYY-MM-DD" or "YYYY-MM".
+static string periodLabel(LedgerPeriod period, long long key) {
+    ostringstream label;
+    label << setfill('0');
+    if (period == LedgerPeriod::Hour) {
+        label << key / 1000000 << "-" << setw(2) << key / 10000 % 100 << "-" << setw(2) << key / 100 % 100 << " " << setw(2) << key % 100 << ":00";
+    }
+    else if (period == LedgerPeriod::Day) {
+        label << key / 10000 << "-" << setw(2) << key / 100 % 100 << "-" << setw(2) << key % 100;
+    }
+    else {
+        label << key / 100 << "-" << setw(2) << key % 100;
+    }
+    return label.str();
+}
+
+static void writeTotalsRow(ostream& out, const string& label, const RevenueTotals& totals) {
+    out << "  " << left << setw(18) << label << right << setw(10) << totals.payments << setw(12) << totals.amount()
+        << setw(10) << totals.hours << "\n";
+}
+
+template <typename Key>
+static void writeBreakdown(ostream& out, const char* title, const map<Key, RevenueTotals>& slices) {
+    out << title << ":\n";
+    for (const auto& slice : slices) {
+        ostringstream label;
+        label << slice.first;
+        writeTotalsRow(out, label.str().empty() ? string("(none)") : label.str(), slice.second);
+    }
+}
+
+void writeRevenueReport(ostream& out, const RevenueLedger& ledger, LedgerPeriod period, time_t now, int count) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    const char* unit = period == LedgerPeriod::Hour ? "hours" : period == LedgerPeriod::Day ? "days" : "months";
+    out << "Revenue of the last " << count << " " << unit << ":\n";
+
+    const RevenueLedger::Rollups& rollups = ledger.rollups(period);
+    auto first = rollups.lower_bound(RevenueLedger::periodKey(period, RevenueLedger::periodsBefore(period, now, count - 1)));
+    auto last = rollups.upper_bound(RevenueLedger::periodKey(period, now));
+    RevenueRollup range;
+    out << fixed << setprecision(2);
+    out << "  " << left << setw(18) << "Period" << right << setw(10) << "Payments" << setw(12) << "Revenue" << setw(10) << "Hours" << "\n";
+    for (auto it = first; it != last; ++it) {
+        writeTotalsRow(out, periodLabel(period, it->first), it->second.total);
+        range.add(it->second);
+    }
+    writeTotalsRow(out, "Total", range.total);
+
+    if (range.total.payments > 0) {
+        writeBreakdown(out, "By parking type", range.byParkingType);
+        writeBreakdown(out, "By floor", range.byFloor);
+        writeBreakdown(out, "By entrance", range.byEntrance);
+        writeBreakdown(out, "By exit", range.byExit);
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+
+// Granularity of a revenue rollup. Periods follow the local calendar.
+enum class LedgerPeriod {
+    Hour,
+    Day,
+    Month
+};
+
+// Payments added together. Amounts are kept in cents so that sums are exact.
+struct RevenueTotals {
+    long long cents = 0;
+    long long payments = 0;
+    long long hours = 0; // Hours billed
+
+    void add(long long paymentCents, long long billedHours);
+    void add(const RevenueTotals& other);
+    double amount() const { return cents / 100.0; }
+};
+
+// Revenue of one hour, day or month, in total and by each dimension it is reported on.
+struct RevenueRollup {
+    RevenueTotals total;
+    std::map<std::string, RevenueTotals> byParkingType;
+    std::map<std::string, RevenueTotals> byFloor;
+    std::map<int, RevenueTotals> byEntrance;
+    std::map<int, RevenueTotals> byExit;
+
+    void add(const RevenueRollup& other);
+};
+
+// One payment taken by settleCustomer().
+struct SettledPayment {
+    std::string parkingType;
+    std::string floor; // Empty if the car was no longer parked
+    int entrance = 0;
+    int exit = 0;
+    time_t endTime = 0; // The payment counts in the periods this falls in
+    double amount = 0;
+    double hours = 0;
+};
+
+// Revenue of a site rolled up by hour, day and month as payments are settled. Each payment adds
+// to one rollup of each granularity, so any period's revenue by type, floor, entrance or exit is
+// one lookup instead of a pass over the payments. Hours are kept for 62 days and days for two
+// years; months are kept for good. Like the forecaster, the rollups are read once, kept across
+// reloads and saved to ledger.dat with the site.
+class RevenueLedger {
+public:
+    using Rollups = std::map<long long, RevenueRollup>; // Period key -> rollup, oldest first
+
+    void record(const SettledPayment& payment);
+
+    // Rollups of a granularity, keyed by periodKey().
+    const Rollups& rollups(LedgerPeriod period) const { return periods[static_cast<int>(period)]; }
+    Rollups& rollups(LedgerPeriod period) { return periods[static_cast<int>(period)]; }
+
+    // Rollup of the period the time falls in, or null if nothing was paid in it.
+    const RevenueRollup* rollupAt(LedgerPeriod period, time_t when) const;
+
+    // Every payment recorded, from the monthly rollups.
+    RevenueTotals lifetime() const;
+
+    // Key of the period a time falls in: YYYYMMDDHH for hours, YYYYMMDD for days, YYYYMM for
+    // months, so keys sort in time order.
+    static long long periodKey(LedgerPeriod period, time_t when);
+
+    // Start of the period count periods before the one now falls in; 0 gives the current one.
+    static time_t periodsBefore(LedgerPeriod period, time_t now, int count);
+
+    bool changedSinceSave() const { return changed; }
+    void markSaved() { changed = false; }
+    bool isLoaded() const { return loaded; }
+    void markLoaded() { loaded = true; }
+
+private:
+    static const int periodCount = 3;
+
+    Rollups periods[periodCount];
+    bool changed = false;
+    bool loaded = false;
+};
+
+// Short name of a granularity as written to ledger.dat: H, D or M.
+const char* periodCode(LedgerPeriod period);
+
+// Writes ledger.dat: one line per rollup slice of "<H|D|M> <key> <dimension> <value> <payments>
+// <cents> <hours>", the dimension being all (value -), type, floor, entrance or exit.
+void writeLedger(std::ostream& out, const RevenueLedger& ledger);
+
+// Writes the revenue of the last count periods up to now, one line per period with payments,
+// then the whole range by parking type, floor, entrance and exit.
+void writeRevenueReport(std::ostream& out, const RevenueLedger& ledger, LedgerPeriod period, time_t now, int count);
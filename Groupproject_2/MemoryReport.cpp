@@ -0,0 +1,164 @@
+#include "MemoryReport.h"
+#include "Parking.h"
+#include "Metrics.h"
+
+#include <iomanip>
+
+using namespace std;
+
+// Per-node bookkeeping of the standard containers on 64-bit MSVC and libstdc++: a red-black tree
+// node holds three links and a colour, a hash node one or two links.
+static const size_t treeNodeOverhead = 4 * sizeof(void*);
+static const size_t hashNodeOverhead = 2 * sizeof(void*);
+
+// Heap bytes behind a string: nothing while it fits in the small string buffer.
+static size_t stringHeapBytes(const string& text) {
+    static const size_t inlineCapacity = string().capacity();
+    return text.capacity() > inlineCapacity ? text.capacity() + 1 : 0;
+}
+
+size_t MemoryReport::totalBytes() const {
+    size_t total = 0;
+    for (const auto& structure : structures) {
+        total += structure.totalBytes();
+    }
+    return total;
+}
+
+MemoryReport measureMemory(const Garage& site) {
+    MemoryReport report;
+    report.site = site.name;
+    report.arenaReserved = site.arena.bytesReserved();
+
+    StructureFootprint floors;
+    floors.name = "floors";
+    floors.containerBytes = site.floors.capacity() * sizeof(Floor) + site.floors.indexBucketCount() * sizeof(void*);
+    for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+        const Floor& floor = site.floors.peek(handle); // Floors not loaded have no spots to count
+        floors.containerBytes += floor.spots.capacity() * sizeof(ParkingSpot);
+        floors.containerBytes += sizeof(pair<const string, FloorHandle>) + hashNodeOverhead; // Name index entry
+        floors.containerBytes += floor.counts.byParkingType.size() * (sizeof(pair<const string, pair<int, int>>) + treeNodeOverhead);
+        floors.stringBytes += 2 * stringHeapBytes(floor.name); // The floor and its index key
+        for (const auto& type : floor.counts.byParkingType) {
+            floors.stringBytes += stringHeapBytes(type.first);
+        }
+        report.floorsLoaded += floor.loaded ? 1 : 0;
+        for (const auto& spot : floor.spots) {
+            floors.stringBytes += stringHeapBytes(spot.id) + stringHeapBytes(spot.type) +
+                stringHeapBytes(spot.vehicleType) + stringHeapBytes(spot.plateNumber);
+        }
+        floors.entries += floor.spots.size();
+    }
+    floors.containerBytes += site.floors.parkedHints() * (sizeof(pair<const string, FloorHandle>) + hashNodeOverhead);
+    report.spots = floors.entries;
+    report.floorCount = static_cast<size_t>(site.floors.size());
+    report.floorsOnDemand = site.floors.onDemand();
+    report.floorBudget = site.floors.budget();
+    report.floorLoads = site.floors.floorLoads();
+    report.floorUnloads = site.floors.floorUnloads();
+    report.floorLoadFailures = site.floors.floorLoadFailures();
+
+    StructureFootprint customers;
+    customers.name = "customers";
+    customers.entries = site.customers.size();
+    customers.containerBytes = site.customers.size() * (sizeof(CustomerMap::value_type) + treeNodeOverhead);
+    for (const auto& customer : site.customers) {
+        customers.stringBytes += stringHeapBytes(customer.first) + stringHeapBytes(customer.second.plateNumber) +
+            stringHeapBytes(customer.second.parkingType) + stringHeapBytes(customer.second.vehicleType);
+    }
+    report.customers = customers.entries;
+
+    StructureFootprint types;
+    types.name = "parkingTypeToVehicleTypes";
+    ConfigView config(site);
+    for (const auto& type : config->parkingTypes) {
+        types.entries += 1 + type.second.size();
+        types.containerBytes += sizeof(pair<const string, set<string>>) + treeNodeOverhead;
+        types.containerBytes += type.second.size() * (sizeof(string) + treeNodeOverhead);
+        types.stringBytes += stringHeapBytes(type.first);
+        for (const auto& vehicle : type.second) {
+            types.stringBytes += stringHeapBytes(vehicle);
+        }
+    }
+
+    StructureFootprint rates;
+    rates.name = "hourlyRates";
+    for (const auto& type : config->hourlyRates) {
+        rates.entries += 1 + type.second.size();
+        rates.containerBytes += sizeof(pair<const string, map<string, double>>) + treeNodeOverhead;
+        rates.containerBytes += type.second.size() * (sizeof(pair<const string, double>) + treeNodeOverhead);
+        rates.stringBytes += stringHeapBytes(type.first);
+        for (const auto& rate : type.second) {
+            rates.stringBytes += stringHeapBytes(rate.first);
+        }
+    }
+
+    StructureFootprint allocator;
+    allocator.name = "spotAllocator";
+    allocator.entries = site.allocator.indexedEntries();
+    allocator.containerBytes = allocator.entries * (site.allocator.entrySize() + treeNodeOverhead);
+
+    StructureFootprint plates;
+    plates.name = "plateIndex";
+    plates.entries = site.plates.size();
+    plates.containerBytes = site.plates.nodeCount() * site.plates.nodeSize();
+
+    StructureFootprint visitors;
+    visitors.name = "visitors";
+    visitors.entries = site.visitors.size();
+    visitors.containerBytes = visitors.entries * (sizeof(Visitor) + 2 * sizeof(void*)) + // List node
+        visitors.entries * (sizeof(pair<const string, list<Visitor>::iterator>) + hashNodeOverhead) +
+        site.visitors.bucketCount() * sizeof(void*);
+    for (const auto& visitor : site.visitors.visitors()) {
+        visitors.stringBytes += 2 * stringHeapBytes(visitor.plateNumber); // The visitor and its index key
+    }
+
+    report.structures = { floors, customers, types, rates, allocator, plates, visitors };
+    return report;
+}
+
+void writeMemoryText(ostream& out, const MemoryReport& report) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+
+    out << left << setw(28) << "structure" << right << setw(10) << "entries" << setw(14) << "containers"
+        << setw(14) << "strings" << setw(14) << "total" << "\n";
+    for (const auto& structure : report.structures) {
+        out << left << setw(28) << structure.name << right << setw(10) << structure.entries
+            << setw(14) << structure.containerBytes << setw(14) << structure.stringBytes
+            << setw(14) << structure.totalBytes() << "\n";
+    }
+    out << left << setw(28) << "total" << right << setw(52) << report.totalBytes() << "\n";
+
+    out << fixed << setprecision(1);
+    if (report.spots > 0) {
+        out << "Per spot: " << static_cast<double>(report.floors().totalBytes()) / report.spots << " bytes ("
+            << sizeof(ParkingSpot) << " inline)\n";
+    }
+    if (report.customers > 0) {
+        out << "Per customer: " << static_cast<double>(report.customerTable().totalBytes()) / report.customers << " bytes ("
+            << sizeof(CustomerMap::value_type) + treeNodeOverhead << " per node)\n";
+    }
+    out << "Floor arena reserved: " << report.arenaReserved << " bytes\n";
+    if (report.floorsOnDemand) {
+        out << "Floors loaded: " << report.floorsLoaded << " of " << report.floorCount << " (budget " << report.floorBudget
+            << " bytes; " << report.floorLoads << " loads, " << report.floorUnloads << " unloads, "
+            << report.floorLoadFailures << " failed)\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void publishMemoryUsage(const Garage& site) {
+    MemoryReport report = measureMemory(site);
+    MemoryGauge gauge;
+    gauge.site = report.site;
+    gauge.floorBytes = report.floors().totalBytes();
+    gauge.customerBytes = report.customerTable().totalBytes();
+    gauge.sharedBytes = report.structures[2].totalBytes();
+    gauge.rateBytes = report.structures[3].totalBytes();
+    gauge.spots = report.spots;
+    gauge.customers = report.customers;
+    setMemoryGauge(gauge);
+}
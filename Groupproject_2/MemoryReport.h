@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Garage;
+
+// Estimated footprint of one in-memory structure. Container bytes cover element storage, tree and
+// hash nodes and bucket arrays; string bytes cover payloads too long for the small string buffer.
+// Allocator block headers are not included.
+struct StructureFootprint {
+    std::string name;
+    size_t entries = 0;
+    size_t containerBytes = 0;
+    size_t stringBytes = 0;
+
+    size_t totalBytes() const { return containerBytes + stringBytes; }
+};
+
+// Footprint of one site together with the tables every site shares.
+struct MemoryReport {
+    std::string site;
+    std::vector<StructureFootprint> structures; // floors, customers, parkingTypeToVehicleTypes, hourlyRates, spotAllocator, plateIndex, visitors
+    size_t spots = 0;
+    size_t customers = 0;
+    size_t arenaReserved = 0; // Bytes the floor arena holds, including space not yet used
+    size_t floorCount = 0;
+    size_t floorsLoaded = 0; // Every floor, unless the site loads floors on demand
+    bool floorsOnDemand = false;
+    size_t floorBudget = 0; // Bytes of spots kept loaded, when floors are loaded on demand
+    uint64_t floorLoads = 0;
+    uint64_t floorUnloads = 0;
+    uint64_t floorLoadFailures = 0; // Floors that could not be read from parkingLots.dat
+
+    const StructureFootprint& floors() const { return structures[0]; }
+    const StructureFootprint& customerTable() const { return structures[1]; }
+    const StructureFootprint& visitorTable() const { return structures[6]; }
+    size_t totalBytes() const;
+};
+
+// Walks the site's floors, customers and rates and the shared parking type table.
+MemoryReport measureMemory(const Garage& site);
+
+void writeMemoryText(std::ostream& out, const MemoryReport& report);
+
+// Measures the site and hands the result to the metrics snapshot. Called by the thread that owns
+// the site, after it has been loaded or saved, so the metrics reporter never walks live containers.
+void publishMemoryUsage(const Garage& site);
@@ -0,0 +1,298 @@
+#include "Metrics.h"
+
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+static const char* const operationNames[] = {
+    "rentParkingSpot", "settleParkingFee", "searchAvailableSpots", "saveGarage", "loadGarage",
+    "addParkingSpot", "modifyParkingSpot", "deleteParkingSpot", "setHourlyRate", "setDailyMaxRate",
+    "modifyParkingTypeVehicleTypes", "clearParkingSpotOccupation", "addCustomerInformation", "deleteCustomerInformation",
+    "assignNearestSpot", "runQuery", "bulkImport", "reloadConfig"
+};
+static_assert(sizeof(operationNames) / sizeof(operationNames[0]) == static_cast<size_t>(Operation::Count),
+    "every operation needs a name");
+
+const char* operationName(Operation operation) {
+    return operationNames[static_cast<int>(operation)];
+}
+
+// Position of the highest set bit; value must not be zero.
+static int highestBit(uint64_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(subBucketCount)) {
+        return static_cast<int>(value); // Exact below 16 ns
+    }
+    int exponent = highestBit(value);
+    int shift = exponent - subBucketBits;
+    int subBucket = static_cast<int>(value >> shift) - subBucketCount;
+    return (shift + 1) * subBucketCount + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < subBucketCount) {
+        return static_cast<uint64_t>(index);
+    }
+    int shift = index / subBucketCount - 1;
+    uint64_t subBucket = static_cast<uint64_t>(index % subBucketCount + subBucketCount);
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    // Only the owning thread writes, so a relaxed load and store is enough and avoids a locked add
+    auto& bucket = counts[bucketIndex(nanoseconds)];
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    total.store(total.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    sum.store(sum.load(memory_order_relaxed) + nanoseconds, memory_order_relaxed);
+    if (nanoseconds > max.load(memory_order_relaxed)) {
+        max.store(nanoseconds, memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::addTo(vector<uint64_t>& merged, uint64_t& mergedTotal, uint64_t& mergedSum, uint64_t& mergedMax) const {
+    for (int i = 0; i < bucketCount; ++i) {
+        merged[i] += counts[i].load(memory_order_relaxed);
+    }
+    mergedTotal += total.load(memory_order_relaxed);
+    mergedSum += sum.load(memory_order_relaxed);
+    mergedMax = std::max(mergedMax, max.load(memory_order_relaxed));
+}
+
+// One histogram per operation for one thread. Registered once per thread and never freed, so a
+// snapshot still sees the operations of worker threads that have exited.
+struct ThreadHistograms {
+    array<LatencyHistogram, static_cast<size_t>(Operation::Count)> operations;
+};
+
+static mutex registryMutex;
+static vector<ThreadHistograms*> registry;
+static atomic<uint64_t> bytesPersisted{ 0 };
+static atomic<uint64_t> filesPersisted{ 0 };
+static atomic<uint64_t> bytesLoaded{ 0 };
+static const chrono::steady_clock::time_point processStart = chrono::steady_clock::now();
+static mutex gaugeMutex;
+static vector<MemoryGauge> memoryGauges;
+
+static ThreadHistograms& threadHistograms() {
+    thread_local ThreadHistograms* local = [] {
+        ThreadHistograms* histograms = new ThreadHistograms();
+        lock_guard<mutex> lock(registryMutex);
+        registry.push_back(histograms);
+        return histograms;
+    }();
+    return *local;
+}
+
+void recordLatency(Operation operation, chrono::steady_clock::duration elapsed) {
+    int64_t nanoseconds = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    threadHistograms().operations[static_cast<size_t>(operation)].record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0);
+}
+
+void recordBytesPersisted(uint64_t bytes) {
+    bytesPersisted.fetch_add(bytes, memory_order_relaxed);
+    filesPersisted.fetch_add(1, memory_order_relaxed);
+}
+
+void recordBytesLoaded(uint64_t bytes) {
+    bytesLoaded.fetch_add(bytes, memory_order_relaxed);
+}
+
+void setMemoryGauge(const MemoryGauge& gauge) {
+    lock_guard<mutex> lock(gaugeMutex);
+    for (auto& existing : memoryGauges) {
+        if (existing.site == gauge.site) {
+            existing = gauge;
+            return;
+        }
+    }
+    memoryGauges.push_back(gauge);
+}
+
+// Smallest bucket bound at or above the given fraction of the recorded values.
+static uint64_t percentile(const vector<uint64_t>& counts, uint64_t total, uint64_t max, double fraction) {
+    uint64_t rank = static_cast<uint64_t>(ceil(fraction * total));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::bucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+MetricsSnapshot takeMetricsSnapshot() {
+    MetricsSnapshot snapshot;
+    snapshot.takenAt = time(nullptr);
+    snapshot.uptimeSeconds = chrono::duration<double>(chrono::steady_clock::now() - processStart).count();
+    snapshot.bytesPersisted = bytesPersisted.load(memory_order_relaxed);
+    snapshot.filesPersisted = filesPersisted.load(memory_order_relaxed);
+    snapshot.bytesLoaded = bytesLoaded.load(memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(gaugeMutex);
+        snapshot.memory = memoryGauges;
+    }
+
+    lock_guard<mutex> lock(registryMutex);
+    vector<uint64_t> counts(LatencyHistogram::bucketCount);
+    for (int op = 0; op < static_cast<int>(Operation::Count); ++op) {
+        fill(counts.begin(), counts.end(), 0);
+        uint64_t total = 0, sum = 0, max = 0;
+        for (const ThreadHistograms* histograms : registry) {
+            histograms->operations[op].addTo(counts, total, sum, max);
+        }
+        if (total == 0) continue;
+
+        OperationStats stats;
+        stats.operation = static_cast<Operation>(op);
+        stats.count = total;
+        stats.mean = static_cast<double>(sum) / total;
+        stats.p50 = percentile(counts, total, max, 0.50);
+        stats.p90 = percentile(counts, total, max, 0.90);
+        stats.p99 = percentile(counts, total, max, 0.99);
+        stats.max = max;
+        snapshot.operations.push_back(stats);
+    }
+    return snapshot;
+}
+
+void writeMetricsText(ostream& out, const MetricsSnapshot& snapshot) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "Uptime: " << fixed << setprecision(0) << snapshot.uptimeSeconds << " s\n";
+    out << left << setw(32) << "operation" << right << setw(10) << "count" << setw(12) << "p50 us"
+        << setw(12) << "p90 us" << setw(12) << "p99 us" << setw(12) << "max us" << "\n";
+    out << setprecision(1);
+    for (const auto& stats : snapshot.operations) {
+        out << left << setw(32) << operationName(stats.operation) << right << setw(10) << stats.count
+            << setw(12) << stats.p50 / 1000.0 << setw(12) << stats.p90 / 1000.0
+            << setw(12) << stats.p99 / 1000.0 << setw(12) << stats.max / 1000.0 << "\n";
+    }
+    if (snapshot.operations.empty()) {
+        out << "No operations recorded yet\n";
+    }
+    out << "Bytes persisted: " << snapshot.bytesPersisted << " in " << snapshot.filesPersisted << " file writes\n";
+    out << "Bytes loaded: " << snapshot.bytesLoaded << "\n";
+    for (const auto& gauge : snapshot.memory) {
+        out << "Memory of site " << gauge.site << ": " << gauge.floorBytes << " bytes for " << gauge.spots << " spots";
+        if (gauge.spots > 0) out << " (" << static_cast<double>(gauge.floorBytes) / gauge.spots << " per spot)";
+        out << ", " << gauge.customerBytes << " bytes for " << gauge.customers << " customers";
+        if (gauge.customers > 0) out << " (" << static_cast<double>(gauge.customerBytes) / gauge.customers << " per customer)";
+        out << ", " << gauge.rateBytes + gauge.sharedBytes << " bytes for rates and parking types\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void writeMetricsJson(ostream& out, const MetricsSnapshot& snapshot) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "{\n  \"timestamp\": " << snapshot.takenAt << ",\n  \"uptime_s\": " << fixed << setprecision(1)
+        << snapshot.uptimeSeconds << ",\n  \"bytes_persisted\": " << snapshot.bytesPersisted
+        << ",\n  \"files_persisted\": " << snapshot.filesPersisted << ",\n  \"bytes_loaded\": " << snapshot.bytesLoaded
+        << ",\n  \"memory\": [";
+    for (size_t i = 0; i < snapshot.memory.size(); ++i) {
+        const MemoryGauge& gauge = snapshot.memory[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"site\": \"" << gauge.site << "\", \"floor_bytes\": " << gauge.floorBytes << ", \"spots\": " << gauge.spots
+            << ", \"bytes_per_spot\": " << (gauge.spots > 0 ? static_cast<double>(gauge.floorBytes) / gauge.spots : 0.0)
+            << ", \"customer_bytes\": " << gauge.customerBytes << ", \"customers\": " << gauge.customers
+            << ", \"bytes_per_customer\": " << (gauge.customers > 0 ? static_cast<double>(gauge.customerBytes) / gauge.customers : 0.0)
+            << ", \"hourly_rate_bytes\": " << gauge.rateBytes << ", \"parking_type_bytes\": " << gauge.sharedBytes << "}";
+    }
+    out << (snapshot.memory.empty() ? "" : "\n  ") << "],\n  \"operations\": [";
+    for (size_t i = 0; i < snapshot.operations.size(); ++i) {
+        const OperationStats& stats = snapshot.operations[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"operation\": \"" << operationName(stats.operation) << "\", \"count\": " << stats.count
+            << ", \"mean_ns\": " << stats.mean << ", \"p50_ns\": " << stats.p50 << ", \"p90_ns\": " << stats.p90
+            << ", \"p99_ns\": " << stats.p99 << ", \"max_ns\": " << stats.max << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool writeMetricsFile(const string& path) {
+    MetricsSnapshot snapshot = takeMetricsSnapshot();
+    ofstream outFile(path);
+    if (!outFile.is_open()) {
+        cerr << "Error: Unable to open " << path << " for writing\n";
+        return false;
+    }
+    writeMetricsJson(outFile, snapshot);
+    return true;
+}
+
+// State of the periodic reporter thread.
+static mutex reporterMutex;
+static condition_variable reporterWakeUp;
+static thread reporterThread;
+static bool reporterStopping = false;
+static volatile sig_atomic_t dumpRequested = 0;
+
+#ifdef _WIN32
+static const int dumpSignal = SIGBREAK;
+#else
+static const int dumpSignal = SIGUSR1;
+#endif
+
+// Only sets a flag; the reporter thread does the actual work within a second.
+static void onDumpSignal(int) {
+    dumpRequested = 1;
+    signal(dumpSignal, onDumpSignal); // Some platforms reset the handler after each delivery
+}
+
+void startMetricsReporter(const string& path, int intervalSeconds) {
+    if (reporterThread.joinable()) {
+        return;
+    }
+    reporterStopping = false;
+    signal(dumpSignal, onDumpSignal);
+    reporterThread = thread([path, intervalSeconds] {
+        auto nextDump = chrono::steady_clock::now() + chrono::seconds(intervalSeconds);
+        unique_lock<mutex> lock(reporterMutex);
+        while (!reporterStopping) {
+            reporterWakeUp.wait_for(lock, chrono::seconds(1)); // Polls the signal flag once a second
+            if (dumpRequested) {
+                dumpRequested = 0;
+                writeMetricsText(cerr, takeMetricsSnapshot());
+                writeMetricsFile(path);
+            }
+            else if (intervalSeconds > 0 && chrono::steady_clock::now() >= nextDump) {
+                writeMetricsFile(path);
+                nextDump = chrono::steady_clock::now() + chrono::seconds(intervalSeconds);
+            }
+        }
+        writeMetricsFile(path);
+    });
+}
+
+void stopMetricsReporter() {
+    if (!reporterThread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(reporterMutex);
+        reporterStopping = true;
+    }
+    reporterWakeUp.notify_all();
+    reporterThread.join();
+    signal(dumpSignal, SIG_DFL);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+// Operations whose latency is recorded.
+enum class Operation {
+    Rent,
+    Settle,
+    Search,
+    Save,
+    Load,
+    AddSpot,
+    ModifySpot,
+    DeleteSpot,
+    SetHourlyRate,
+    SetDailyMaxRate,
+    ModifyParkingTypes,
+    ClearOccupation,
+    AddCustomer,
+    DeleteCustomer,
+    Assign,
+    Query,
+    Import,
+    ReloadConfig,
+    Count
+};
+
+const char* operationName(Operation operation);
+
+// Latency histogram with log-sized buckets in the style of HdrHistogram. Values are grouped by power
+// of two and every power of two is split into 16 linear sub-buckets, so a reported percentile is
+// within 1/16 of the recorded value. Each histogram has a single writer thread; readers may merge
+// it at any time.
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 4;
+    static const int subBucketCount = 1 << subBucketBits;
+    static const int bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+    void record(uint64_t nanoseconds);
+    void addTo(std::vector<uint64_t>& counts, uint64_t& total, uint64_t& sum, uint64_t& max) const;
+
+private:
+    std::array<std::atomic<uint64_t>, bucketCount> counts{};
+    std::atomic<uint64_t> total{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> max{ 0 };
+};
+
+// Records one operation into the calling thread's histogram.
+void recordLatency(Operation operation, std::chrono::steady_clock::duration elapsed);
+
+// Counts bytes written to and read from the data files.
+void recordBytesPersisted(uint64_t bytes);
+void recordBytesLoaded(uint64_t bytes);
+
+// Times an operation from construction until stop() or destruction, whichever comes first.
+// The operation also appears as a span in the trace while tracing is on.
+class OperationTimer {
+public:
+    explicit OperationTimer(Operation operation) : operation(operation), start(std::chrono::steady_clock::now()) {}
+    ~OperationTimer() { stop(); }
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    void stop() {
+        if (running) {
+            running = false;
+            auto end = std::chrono::steady_clock::now();
+            recordLatency(operation, end - start);
+            if (tracingOn()) {
+                recordSpan(operationName(operation), "", toTraceClock(start), toTraceClock(end));
+            }
+        }
+    }
+
+private:
+    static uint64_t toTraceClock(std::chrono::steady_clock::time_point time) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+    }
+
+    Operation operation;
+    std::chrono::steady_clock::time_point start;
+    bool running = true;
+};
+
+// Latency summary of one operation, in nanoseconds.
+struct OperationStats {
+    Operation operation;
+    uint64_t count = 0;
+    double mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+};
+
+// Memory footprint of one site as last published by publishMemoryUsage(), in bytes.
+struct MemoryGauge {
+    std::string site;
+    uint64_t floorBytes = 0;
+    uint64_t customerBytes = 0;
+    uint64_t rateBytes = 0;
+    uint64_t sharedBytes = 0; // parkingTypeToVehicleTypes
+    uint64_t spots = 0;
+    uint64_t customers = 0;
+};
+
+// Replaces the gauge of gauge.site.
+void setMemoryGauge(const MemoryGauge& gauge);
+
+// Every thread's histograms merged at one point in time.
+struct MetricsSnapshot {
+    time_t takenAt = 0;
+    double uptimeSeconds = 0;
+    std::vector<OperationStats> operations; // Only operations that were recorded at least once
+    uint64_t bytesPersisted = 0;
+    uint64_t filesPersisted = 0;
+    uint64_t bytesLoaded = 0;
+    std::vector<MemoryGauge> memory;
+};
+
+MetricsSnapshot takeMetricsSnapshot();
+void writeMetricsText(std::ostream& out, const MetricsSnapshot& snapshot);
+void writeMetricsJson(std::ostream& out, const MetricsSnapshot& snapshot);
+
+// Writes a JSON snapshot to path. Returns false if the file cannot be written.
+bool writeMetricsFile(const std::string& path);
+
+// Starts a background thread that writes a JSON snapshot to path every intervalSeconds, and
+// immediately when the process receives SIGUSR1 (Ctrl+Break on Windows), which also prints the
+// text form to standard error. stopMetricsReporter() writes a final snapshot and joins the thread.
+void startMetricsReporter(const std::string& path, int intervalSeconds);
+void stopMetricsReporter();
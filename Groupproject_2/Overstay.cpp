@@ -0,0 +1,217 @@
+#include "Overstay.h"
+#include "Parking.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+const char* const OverstayMonitor::anyType = "*";
+
+static const size_t maxQueuedAlerts = 1000; // Older alerts are dropped if nobody takes them
+
+static time_t deadlineOf(time_t startTime, double hours) {
+    return startTime + static_cast<time_t>(hours * 3600.0);
+}
+
+void OverstayMonitor::setLimit(const string& parkingType, double hours) {
+    if (hours > 0) {
+        limitHours[parkingType] = hours;
+    }
+    else {
+        limitHours.erase(parkingType);
+    }
+    built = false; // Deadlines are computed again from the new limits
+}
+
+void OverstayMonitor::clearLimits() {
+    limitHours.clear();
+    built = false;
+}
+
+double OverstayMonitor::nextLimit(const string& parkingType, double passedHours) const {
+    double next = 0;
+    for (const char* type : { parkingType.c_str(), anyType }) {
+        auto limit = limitHours.find(type);
+        if (limit != limitHours.end() && limit->second > passedHours && (next == 0 || limit->second < next)) {
+            next = limit->second;
+        }
+    }
+    return next;
+}
+
+void OverstayMonitor::schedule(const string& plateNumber, const Session& session) {
+    double next = nextLimit(session.parkingType, session.passedHours);
+    if (next > 0) {
+        deadlines.push_back(Deadline{ deadlineOf(session.startTime, next), session.id, plateNumber, next });
+        push_heap(deadlines.begin(), deadlines.end(), greater<Deadline>());
+    }
+}
+
+void OverstayMonitor::sessionStarted(const string& plateNumber, const string& spotId, const string& parkingType, time_t startTime) {
+    if (!built) {
+        return; // The next poll picks the car up from the spots
+    }
+    Session& session = sessions[plateNumber];
+    session = Session{ nextSession++, spotId, parkingType, startTime, 0 };
+    overstays.erase(plateNumber);
+    schedule(plateNumber, session);
+}
+
+void OverstayMonitor::sessionEnded(const string& plateNumber) {
+    if (!built) {
+        return;
+    }
+    sessions.erase(plateNumber); // Its deadline is dropped when it reaches the top of the heap
+    overstays.erase(plateNumber);
+
+    // Ended sessions' deadlines are only dropped when they surface; rebuild the heap once they
+    // outnumber the live ones, so it stays proportional to the parked cars
+    if (deadlines.size() > 2 * sessions.size() + 64) {
+        deadlines.clear();
+        for (const auto& entry : sessions) {
+            double next = nextLimit(entry.second.parkingType, entry.second.passedHours);
+            if (next > 0) {
+                deadlines.push_back(Deadline{ deadlineOf(entry.second.startTime, next), entry.second.id, entry.first, next });
+            }
+        }
+        make_heap(deadlines.begin(), deadlines.end(), greater<Deadline>());
+    }
+}
+
+void OverstayMonitor::rebuild(const Garage& site, time_t now) {
+    TraceSpan span("rebuildOverstays", site.name);
+    // Limits a car had already passed are kept, so a reload does not report them again
+    unordered_map<string, Session> previous;
+    previous.swap(sessions);
+    deadlines.clear();
+    overstays.clear();
+    for (const Floor& floor : site.floors) {
+        for (const ParkingSpot& spot : floor.spots) {
+            if (!spot.isOccupied || spot.plateNumber.empty() || spot.type.empty()) continue;
+            Session session{ nextSession++, spot.id, spot.type, spot.startTime, 0 };
+            auto known = previous.find(spot.plateNumber);
+            if (known != previous.end() && known->second.startTime == spot.startTime) {
+                session.passedHours = known->second.passedHours;
+            }
+            else if (!seeded) {
+                double next;
+                while ((next = nextLimit(session.parkingType, session.passedHours)) > 0 && deadlineOf(session.startTime, next) <= now) {
+                    session.passedHours = next;
+                }
+            }
+            if (session.passedHours > 0) {
+                overstays[spot.plateNumber] = OverstayAlert{ spot.plateNumber, spot.id, spot.type, spot.startTime,
+                    session.passedHours, deadlineOf(spot.startTime, session.passedHours) };
+            }
+            double next = nextLimit(session.parkingType, session.passedHours);
+            if (next > 0) {
+                deadlines.push_back(Deadline{ deadlineOf(session.startTime, next), session.id, spot.plateNumber, next });
+            }
+            sessions[spot.plateNumber] = move(session);
+        }
+    }
+    make_heap(deadlines.begin(), deadlines.end(), greater<Deadline>());
+    built = true;
+    seeded = true;
+}
+
+void OverstayMonitor::poll(const Garage& site, time_t now) {
+    if (!built) {
+        rebuild(site, now);
+    }
+    while (!deadlines.empty() && deadlines.front().when <= now) {
+        pop_heap(deadlines.begin(), deadlines.end(), greater<Deadline>());
+        Deadline deadline = move(deadlines.back());
+        deadlines.pop_back();
+        auto found = sessions.find(deadline.plateNumber);
+        if (found == sessions.end() || found->second.id != deadline.session) {
+            continue; // The car has left, or left and came back
+        }
+
+        // Skip to the longest limit already passed, so a late poll reports one alert
+        Session& session = found->second;
+        double passed = deadline.limitHours;
+        double next;
+        while ((next = nextLimit(session.parkingType, passed)) > 0 && deadlineOf(session.startTime, next) <= now) {
+            passed = next;
+        }
+        session.passedHours = passed;
+
+        OverstayAlert alert{ deadline.plateNumber, session.spotId, session.parkingType, session.startTime,
+            passed, deadlineOf(session.startTime, passed) };
+        overstays[deadline.plateNumber] = alert;
+        if (alerts.size() == maxQueuedAlerts) {
+            alerts.erase(alerts.begin());
+        }
+        alerts.push_back(move(alert));
+        ++fired;
+        schedule(deadline.plateNumber, session);
+    }
+}
+
+vector<OverstayAlert> OverstayMonitor::takeAlerts() {
+    vector<OverstayAlert> taken;
+    taken.swap(alerts);
+    return taken;
+}
+
+vector<OverstayAlert> OverstayMonitor::current(const Garage& site, time_t now) {
+    poll(site, now);
+    vector<OverstayAlert> list;
+    list.reserve(overstays.size());
+    for (const auto& entry : overstays) {
+        list.push_back(entry.second);
+    }
+    sort(list.begin(), list.end(), [](const OverstayAlert& a, const OverstayAlert& b) {
+        return a.startTime != b.startTime ? a.startTime < b.startTime : a.plateNumber < b.plateNumber;
+    });
+    return list;
+}
+
+void writeOverstayLimits(ostream& out, const OverstayMonitor& monitor) {
+    for (const auto& limit : monitor.limits()) {
+        out << limit.first << " " << limit.second << "\n";
+    }
+}
+
+void writeOverstays(ostream& out, const vector<OverstayAlert>& overstays, time_t now) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    if (overstays.empty()) {
+        out << "No cars are over their stay limit\n";
+    }
+    else {
+        out << overstays.size() << " cars over their stay limit:\n";
+        out << left << setw(12) << "Plate" << setw(12) << "Spot" << setw(14) << "Type" << setw(21) << "Parked since"
+            << right << setw(8) << "Hours" << setw(8) << "Limit" << "\n";
+        out << fixed << setprecision(1);
+        for (const auto& overstay : overstays) {
+            out << left << setw(12) << overstay.plateNumber << setw(12) << overstay.spotId << setw(14) << overstay.parkingType
+                << setw(21) << formatLocalTime(overstay.startTime) << right
+                << setw(8) << difftime(now, overstay.startTime) / 3600.0 << setw(8) << overstay.limitHours << "\n";
+        }
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void logOverstayAlerts(const Garage& site, const vector<OverstayAlert>& alerts) {
+    if (alerts.empty()) {
+        return;
+    }
+    string path = garageFilePath(site, "alerts.log");
+    ofstream outFile(path, ios::app);
+    if (!outFile.is_open()) {
+        cerr << "Error: Unable to open " << path << " for writing\n";
+        return;
+    }
+    for (const auto& alert : alerts) {
+        outFile << formatLocalTime(alert.deadline) << " overstay " << alert.plateNumber << " " << alert.spotId << " "
+            << alert.parkingType << " parked since " << formatLocalTime(alert.startTime) << " limit " << alert.limitHours << " h\n";
+    }
+}
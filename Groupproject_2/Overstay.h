@@ -0,0 +1,102 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Garage;
+
+// A parked car that has passed a stay limit.
+struct OverstayAlert {
+    std::string plateNumber;
+    std::string spotId;
+    std::string parkingType;
+    time_t startTime = 0;
+    double limitHours = 0; // Longest limit passed so far
+    time_t deadline = 0; // When that limit was passed
+};
+
+// Stay limits of a site and the parked cars that have passed them. Each parked car has one entry in
+// a min-heap keyed by the time it passes its next limit, so poll() only looks at the cars whose
+// deadline has come, however many are parked. A car passing a limit is reported once and then
+// waits in the heap for its next, longer limit. rentSpot() and the code that frees spots keep it up
+// to date; code that edits spots directly must call invalidate(), and the next poll rebuilds it
+// from the parked cars without reporting again the limits they had already passed. Cars that are
+// already over a limit the first time the site is indexed are listed as overstays without an
+// alert, so starting the program again does not repeat the alerts it logged before.
+class OverstayMonitor {
+public:
+    // Limit for every parking type, used for types without their own and as a second limit for
+    // types with a shorter one.
+    static const char* const anyType; // "*"
+
+    // Sets the limit of a parking type (or anyType) in hours; 0 removes it. Rebuilds on next poll.
+    void setLimit(const std::string& parkingType, double hours);
+    void clearLimits();
+    const std::map<std::string, double>& limits() const { return limitHours; }
+
+    void sessionStarted(const std::string& plateNumber, const std::string& spotId, const std::string& parkingType, time_t startTime);
+    void sessionEnded(const std::string& plateNumber);
+
+    void invalidate() { built = false; }
+
+    // Moves the cars whose deadlines have come by now into the current overstays and queues an
+    // alert for each. A car that passed several limits since the last poll gets one alert, for the
+    // longest. O(k log n) for k deadlines passed.
+    void poll(const Garage& site, time_t now);
+
+    // Alerts queued by poll() since the last call.
+    std::vector<OverstayAlert> takeAlerts();
+
+    // Every car over a limit as of now, longest parked first. Polls first; the alerts stay queued.
+    std::vector<OverstayAlert> current(const Garage& site, time_t now);
+
+    size_t sessionCount() const { return sessions.size(); }
+    size_t pendingDeadlines() const { return deadlines.size(); }
+    unsigned long long alertsFired() const { return fired; }
+
+private:
+    struct Session {
+        unsigned long long id;
+        std::string spotId;
+        std::string parkingType;
+        time_t startTime;
+        double passedHours; // Longest limit passed, 0 if none
+    };
+
+    struct Deadline {
+        time_t when;
+        unsigned long long session;
+        std::string plateNumber;
+        double limitHours;
+
+        bool operator>(const Deadline& other) const { return when > other.when; }
+    };
+
+    // Smallest limit of the parking type longer than passed, or 0 if there is none.
+    double nextLimit(const std::string& parkingType, double passedHours) const;
+    void schedule(const std::string& plateNumber, const Session& session);
+    void rebuild(const Garage& site, time_t now);
+
+    std::map<std::string, double> limitHours; // Parking type or anyType -> hours
+    std::unordered_map<std::string, Session> sessions; // Parked cars by plate
+    std::vector<Deadline> deadlines; // Min-heap on when; entries of ended sessions are dropped when they surface
+    std::map<std::string, OverstayAlert> overstays; // Cars over a limit, by plate
+    std::vector<OverstayAlert> alerts; // Fired and not yet taken
+    unsigned long long nextSession = 1;
+    unsigned long long fired = 0;
+    bool built = false;
+    bool seeded = false; // Indexed once; later rebuilds keep the limits each car had passed
+};
+
+// Writes overstayLimits.dat: one "<parkingType or *> <hours>" line per limit.
+void writeOverstayLimits(std::ostream& out, const OverstayMonitor& monitor);
+
+// Writes the cars over their limit as of now, with how long each has been parked.
+void writeOverstays(std::ostream& out, const std::vector<OverstayAlert>& overstays, time_t now);
+
+// Appends fired alerts to the site's alerts.log, one line each.
+void logOverstayAlerts(const Garage& site, const std::vector<OverstayAlert>& alerts);
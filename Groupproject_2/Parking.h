@@ -0,0 +1,540 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ctime>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <memory_resource>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "Arena.h"
+#include "Config.h"
+#include "Epoch.h"
+#include "Forecast.h"
+#include "History.h"
+#include "Ledger.h"
+#include "Overstay.h"
+#include "PlateIndex.h"
+#include "Visitor.h"
+
+// Structure definitions
+struct ParkingSpot {
+    std::string id;
+    std::string type;
+    bool isOccupied = false;
+    std::string vehicleType;
+    std::string plateNumber;
+    time_t startTime = 0;
+    int entrance = 0;
+};
+
+struct Customer {
+    std::string plateNumber;
+    time_t startTime = 0;
+    time_t endTime = 0;
+    std::string parkingType;
+    std::string vehicleType;
+    int entrance = 0;
+    int exit = 0;
+    double payment = 0.0;
+};
+
+// Spots of one floor, stored in the owning site's arena.
+using FloorSpots = std::pmr::vector<ParkingSpot>;
+
+// Dense handle of a floor within its site: the floor's index in the site's FloorRegistry.
+using FloorHandle = int;
+const FloorHandle invalidFloor = -1;
+
+// Spot counts of a floor. Deleted spots are not counted.
+struct FloorCounts {
+    int spots = 0;
+    int occupied = 0;
+    std::map<std::string, std::pair<int, int>, std::less<>> byParkingType; // parking type -> (occupied, total)
+
+    void add(std::string_view parkingType, bool isOccupied);
+
+    // Returns whether a free spot of a parking type that accepts the vehicle type under config is counted.
+    bool hasFreeSpot(const SiteConfig& config, const std::string& vehicleType) const;
+};
+
+struct Floor {
+    Floor(std::string name, FloorSpots spots) : name(std::move(name)), spots(std::move(spots)) {}
+
+    std::string name;
+    FloorSpots spots;
+
+    // Used when the site loads its floors on demand
+    bool loaded = true; // False while only the floor's directory entry is in memory
+    bool changed = false; // Taken for writing since it was loaded or saved, so it is not unloaded
+    uint64_t lastUsed = 0;
+    uint64_t sourceOffset = 0; // The floor's spot lines in parkingLots.dat
+    uint64_t sourceBytes = 0;
+    bool listed = true; // False if a rescan of a replaced parkingLots.dat did not find the floor
+    FloorCounts counts; // As of the last load or save
+};
+
+// Where the spot lines of one floor were written, and their counts.
+struct FloorExtent {
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+    FloorCounts counts;
+};
+
+// The floors of one site. Floors are stored contiguously and identified by their handle, so
+// whole-garage scans are linear walks; a floor name is resolved once, where the input arrives.
+//
+// A site can also load its floors on demand. Then only a directory is kept up front: every
+// floor's name, where its spot lines are in parkingLots.dat and its counts. A floor's spots are
+// parsed the first time it is used through operator[] or an iteration, and a non-const use marks
+// it changed. A floor whose lines cannot be read is reported and stays unloaded and unchanged, with
+// no spots, so a save copies its lines from the file rather than writing it empty. If
+// parkingLots.dat was replaced since it was listed, the floors not loaded are found in it again
+// before one is read. trim() unloads the least recently used unchanged floors while the loaded
+// spots take more than the budget.
+class FloorRegistry {
+public:
+    explicit FloorRegistry(std::pmr::memory_resource* resource) : resource(resource) {}
+
+    // Returns the handle of the named floor, or invalidFloor if there is no such floor.
+    FloorHandle find(const std::string& name) const;
+
+    // Returns the handle of the named floor, adding an empty floor if it does not exist yet.
+    FloorHandle add(const std::string& name);
+
+    // Removes every floor and goes back to loading floors in full. The spot storage is released
+    // with the arena that backs it.
+    void clear();
+
+    // Identifies a version of a file by its size and write time, or returns "" if it does not exist.
+    static std::string fileStamp(const std::string& path);
+
+    // Makes an empty registry load its floors on demand from the parkingLots.dat at path, with
+    // loaded spots kept to budgetBytes where the changed floors allow. stamp identifies the
+    // version of the file the directory describes.
+    void loadOnDemand(const std::string& path, const std::string& stamp, size_t budgetBytes);
+    bool onDemand() const { return !sourcePath.empty(); }
+    const std::string& sourceStamp() const { return stamp; }
+    size_t budget() const { return budgetBytes; }
+
+    // Adds a floor of the directory. Its spots are loaded when it is first used.
+    void addListed(const std::string& name, const FloorExtent& extent);
+
+    // Records where a save wrote every floor, in floor order, and which file version it wrote.
+    // No floor is changed after it.
+    void saved(const std::vector<FloorExtent>& extents, const std::string& savedStamp);
+
+    // Returns whether a floor was taken for writing since the last load or save.
+    bool hasChanges() const;
+
+    // Spot lines of parkingLots.dat that were skipped by a load since the floors were listed or
+    // parsed. While there are any, the file is not saved over, so the lines are not lost.
+    void noteSkipped(size_t lines) const { skipped += lines; }
+    size_t skippedLines() const { return skipped; }
+
+    // Drops a floor's spots if it is loaded and unchanged. Returns whether it was dropped.
+    bool unload(FloorHandle floor);
+
+    // Unloads the least recently used unchanged floors while the loaded spots take more than the
+    // budget. Returns the floors unloaded.
+    std::vector<FloorHandle> trim();
+
+    // Writes the spot lines of a floor that is not loaded, as they are in parkingLots.dat. Sets
+    // the stream's failbit if they cannot be read.
+    void copyListed(FloorHandle floor, std::ostream& out) const;
+
+    // The floor a plate was last seen parked on, or invalidFloor. Only kept when floors load on
+    // demand, and it can be out of date, so the floor has to be checked.
+    FloorHandle parkedFloor(const std::string& plateNumber) const;
+    void noteParked(const std::string& plateNumber, FloorHandle floor);
+    void noteDeparted(const std::string& plateNumber);
+
+    bool isLoaded(FloorHandle floor) const { return floors[floor].loaded; }
+    const Floor& peek(FloorHandle floor) const { return floors[floor]; } // The floor as it is, without loading it
+    size_t loadedBytes() const; // Spot storage of the loaded floors
+    uint64_t floorLoads() const { return loads; }
+    uint64_t floorLoadFailures() const { return loadFailures; }
+    uint64_t floorUnloads() const { return unloads; }
+    size_t parkedHints() const { return parkedOn.size(); }
+
+    Floor& operator[](FloorHandle floor) { return use(floor, true); }
+    const Floor& operator[](FloorHandle floor) const { return use(floor, false); }
+    FloorHandle size() const { return static_cast<FloorHandle>(floors.size()); }
+    size_t capacity() const { return floors.capacity(); }
+    size_t indexBucketCount() const { return index.bucket_count(); }
+
+    std::vector<Floor>::iterator begin() { useAll(true); return floors.begin(); }
+    std::vector<Floor>::iterator end() { return floors.end(); }
+    std::vector<Floor>::const_iterator begin() const { useAll(false); return floors.begin(); }
+    std::vector<Floor>::const_iterator end() const { return floors.end(); }
+
+private:
+    Floor& use(FloorHandle floor, bool writing) const {
+        Floor& entry = floors[floor];
+        if (onDemand()) {
+            touch(floor, writing);
+        }
+        return entry;
+    }
+    void useAll(bool writing) const;
+    void touch(FloorHandle floor, bool writing) const; // Loads the floor if needed and marks it used
+    bool load(FloorHandle floor) const; // Returns false, with the floor left unloaded, if it cannot be read
+    bool sourceCurrent() const; // Rescans parkingLots.dat if it was replaced; false if it cannot be
+
+    std::pmr::memory_resource* resource;
+    mutable std::vector<Floor> floors; // Floors not loaded yet are filled in by const uses
+    std::unordered_map<std::string, FloorHandle> index;
+    std::string sourcePath; // parkingLots.dat when floors load on demand, otherwise empty
+    std::string stamp; // The file version the floors were listed from
+    mutable std::string extentsStamp; // The file version the extents of floors not loaded are in
+    size_t budgetBytes = 0;
+    mutable uint64_t useClock = 0;
+    mutable uint64_t loads = 0;
+    mutable uint64_t loadFailures = 0;
+    mutable size_t skipped = 0;
+    uint64_t unloads = 0;
+    mutable std::unordered_map<std::string, FloorHandle> parkedOn; // Plate -> floor last seen parked on
+};
+
+// Position of a spot within a site: its floor and its index on that floor.
+struct SpotRef {
+    FloorHandle floor;
+    int index;
+};
+
+// Distance of a floor's spots from one entrance: floorCost to reach the floor, then spotCost for
+// every spot passed on the way, counting from the floor's first spot or from its last.
+struct EntranceCost {
+    double floorCost = 0;
+    double spotCost = 1;
+    bool fromEnd = false;
+};
+
+struct Garage;
+
+// Free spots of a site ordered by their distance from each entrance, one ordered set per entrance
+// and parking type, so the nearest spot a vehicle fits in is found in O(log n). rentSpot() and
+// releaseSpot() keep it up to date; code that edits spots directly must call invalidate(), and
+// the next assignment rebuilds it.
+class SpotAllocator {
+public:
+    static const int entrances = 2;
+
+    // Sets the cost model of a floor as seen from an entrance. Floors without one cost 1000 per
+    // floor in floor order, plus 1 per spot counted from the first spot for entrance 1 and from
+    // the last spot for entrance 2.
+    void setEntranceCost(int entrance, const std::string& floor, const EntranceCost& cost);
+
+    // Drops the cost models and the index.
+    void clear();
+
+    void invalidate() { built = false; }
+    bool isBuilt() const { return built; }
+
+    // Indexes every free spot of the site. O(n log n).
+    void rebuild(const Garage& site);
+
+    void spotTaken(const Garage& site, SpotRef spot);
+    void spotFreed(const Garage& site, SpotRef spot);
+
+    // Returns the free spot nearest the entrance that accepts the vehicle type under config, or a
+    // spot with an invalid floor if there is none.
+    SpotRef nearest(const SiteConfig& config, const std::string& vehicleType, int entrance) const;
+
+    // Returns the spot nearest() would, for a site whose floors load on demand, without the index.
+    // Floors are visited by the cost of reaching them and loaded one at a time, skipping those
+    // whose counts show no free spot for the vehicle, until no floor left could hold a nearer
+    // spot. Floors loaded on the way that do not hold the spot are unloaded again.
+    SpotRef nearestOnDemand(Garage& site, const std::string& vehicleType, int entrance) const;
+
+    // Number of (entrance, spot) entries in the index, and the size of one entry.
+    size_t indexedEntries() const;
+    size_t entrySize() const { return sizeof(FreeSpot); }
+
+private:
+    struct FreeSpot {
+        double cost;
+        FloorHandle floor;
+        int index;
+
+        bool operator<(const FreeSpot& other) const {
+            if (cost != other.cost) return cost < other.cost;
+            return floor != other.floor ? floor < other.floor : index < other.index;
+        }
+    };
+
+    // Looks up the spot's cost from an entrance; false if the spot is not indexable.
+    bool freeSpot(const Garage& site, int entrance, SpotRef spot, FreeSpot& entry) const;
+
+    // The cost model of a floor from an entrance, numbered from 0.
+    EntranceCost floorCost(const Garage& site, int entrance, FloorHandle floor) const;
+
+    std::map<std::pair<int, std::string>, EntranceCost> entranceCosts; // (entrance, floor name) -> cost model
+    std::vector<EntranceCost> floorCosts[entrances]; // Resolved per floor handle when the index is built
+    std::map<std::string, std::set<FreeSpot>> freeSpots[entrances]; // Parking type -> free spots by cost
+    bool built = false;
+};
+
+// Immutable copy of up to spotsPerPage consecutive spots of a floor.
+struct SpotPage {
+    static const size_t spotsPerPage = 8;
+    std::vector<ParkingSpot> spots;
+};
+
+// Immutable copy of a floor as a list of spot pages. A floor that is not loaded is published
+// with its counts and no spots.
+struct FloorVersion {
+    std::string name;
+    std::vector<const SpotPage*> pages;
+    size_t spotCount = 0;
+    bool loaded = true;
+    FloorCounts counts; // Of a floor that is not loaded
+
+    const ParkingSpot& spot(size_t index) const {
+        return pages[index / SpotPage::spotsPerPage]->spots[index % SpotPage::spotsPerPage];
+    }
+};
+
+// Immutable run of customers in plate order. Pages are split when they reach twice pageSize.
+struct CustomerPage {
+    static const size_t pageSize = 16;
+    std::vector<Customer> customers;
+};
+
+struct GarageVersion;
+
+// Position of a customer in a version, walking the customer pages in plate order.
+class CustomerIterator {
+public:
+    CustomerIterator(const GarageVersion* version, size_t page, size_t index) : version(version), page(page), index(index) {}
+
+    const Customer& operator*() const;
+    const Customer* operator->() const { return &**this; }
+    CustomerIterator& operator++();
+    CustomerIterator& operator--();
+    bool operator==(const CustomerIterator& other) const { return page == other.page && index == other.index; }
+    bool operator!=(const CustomerIterator& other) const { return !(*this == other); }
+
+private:
+    const GarageVersion* version;
+    size_t page;
+    size_t index;
+};
+
+// One published state of a site. Nothing reachable from a version changes once it is published; the
+// next version shares every page that did not change with it, so publishing a rent or a settle
+// copies one spot page, one customer page and the page lists above them, not the whole site.
+struct GarageVersion {
+    uint64_t number = 0;
+    time_t published = 0;
+    std::vector<const FloorVersion*> floors;
+    std::vector<const CustomerPage*> customerPages; // In plate order, none empty
+    size_t customerCount = 0;
+
+    CustomerIterator customersBegin() const { return CustomerIterator(this, 0, 0); }
+    CustomerIterator customersEnd() const { return CustomerIterator(this, customerPages.size(), 0); }
+    CustomerIterator customerLowerBound(const std::string& plateNumber) const; // First customer not before the plate
+    CustomerIterator customerUpperBound(const std::string& plateNumber) const; // First customer after the plate
+    const Customer* findCustomer(const std::string& plateNumber) const;
+};
+
+// The versions published for one site. Writers, which already hold the site exclusively, publish a
+// new version after every change; readers pin the current one through a ReadView. Replaced pages and
+// versions are retired to the epoch domain and freed once no reader can still hold them, so writers
+// never wait for readers and readers never take a lock.
+class GarageVersions {
+public:
+    GarageVersions() = default;
+    ~GarageVersions();
+
+    GarageVersions(const GarageVersions&) = delete;
+    GarageVersions& operator=(const GarageVersions&) = delete;
+
+    // Publishes a version copied from the whole site. O(spots + customers); for loads and bulk edits.
+    void publishAll(const Garage& site);
+
+    // Publishes a version that takes the given spots and customers again from the site and shares
+    // everything else with the current version.
+    void publish(const Garage& site, const std::vector<SpotRef>& spots, const std::vector<std::string>& plateNumbers);
+
+    // Publishes the given floors again if they were loaded or unloaded since they were published.
+    void republishFloors(const Garage& site, const std::vector<FloorHandle>& floors);
+
+    // The current version; only safe to use while the calling thread is pinned.
+    const GarageVersion* latest() const { return current.load(); }
+    uint64_t versionsPublished() const { return published; }
+
+private:
+    void swapIn(GarageVersion* version, bool retireTree);
+
+    std::atomic<const GarageVersion*> current{ nullptr };
+    uint64_t published = 0;
+};
+
+// A consistent, read-only view of a site as of the moment it was created. It costs an epoch pin
+// and one atomic load, takes no lock, and does not hold up writers however long it is kept; changes
+// published after it was created are not visible through it.
+class ReadView {
+public:
+    explicit ReadView(const Garage& site);
+
+    ReadView(const ReadView&) = delete;
+    ReadView& operator=(const ReadView&) = delete;
+
+    const GarageVersion& operator*() const { return *version; }
+    const GarageVersion* operator->() const { return version; }
+
+private:
+    EpochGuard guard; // Pinned before the version is loaded
+    const GarageVersion* version;
+};
+
+// Customer records keyed by plate number; the map nodes come from a fixed-size pool.
+using CustomerMap = std::map<std::string, Customer, std::less<std::string>, PoolAllocator<std::pair<const std::string, Customer>>>;
+
+// One garage site. Every site is an isolated shard with its own floors, customers,
+// rates and data directory; only the parking type and vehicle type definitions are shared.
+struct Garage {
+    std::string name;
+    std::string dataDir;
+    Arena arena; // Backs every floor's spot storage; freed in one shot when the site is reloaded
+    FloorRegistry floors{ &arena };
+    CustomerMap customers;
+    PlateIndex plates; // Plate numbers of the customers, for prefix and near-miss lookups
+    VisitorTable visitors; // Plates logged in at the kiosk that have not rented; never saved
+    ConfigStore config; // Rates and parking types, swapped in whole; fees read it without a lock
+    SpotAllocator allocator; // Free spots by distance from each entrance, from entranceCosts.dat
+    OccupancyForecaster forecaster; // Hourly traffic aggregates, kept across reloads and saved to forecast.dat
+    RevenueLedger ledger; // Settled payments rolled up by hour, day and month, kept across reloads and saved to ledger.dat
+    OverstayMonitor overstays; // Parked cars by the time they pass their next stay limit, from overstayLimits.dat
+    EventLog events; // Every change in order, with checkpoints; open only for the sites the menus work on
+    GarageVersions views; // Published copies of the floors and customers for lock-free readers
+    std::mutex mutex; // Held by worker pool tasks while they change this site; readers use views
+};
+
+// Occupancy counters for one site, or for several sites added together.
+struct OccupancySummary {
+    int sites = 0;
+    int totalSpots = 0;
+    int occupiedSpots = 0;
+    std::map<std::string, std::pair<int, int>> byParkingType; // parking type -> (occupied, total)
+};
+
+// Outcome of rentSpot().
+enum class RentResult {
+    Rented,
+    InvalidSpot,
+    SpotOccupied,
+    IncompatibleVehicle,
+    NoFreeSpot
+};
+
+// Global variables shared by every site
+extern std::string adminPassword;
+extern std::map<std::string, Garage> garages;
+extern Garage* currentGarage;
+
+// Loads the shared data (admin password and parking type to vehicle types) from the root directory.
+void loadSharedData();
+
+// Saves the shared data (admin password and parking type to vehicle types) to the root directory.
+void saveSharedData();
+
+// Loads the floors, customers, hourly rates and daily max rate of one site from its data directory.
+// A save that was interrupted after it was committed is finished first. If the directory has a
+// floorBudget.dat (megabytes of loaded spots), only the floor directory is read: floorIndex.dat
+// when it describes parkingLots.dat as it is, otherwise a scan of parkingLots.dat. Floors then load
+// on demand, and a reload keeps the loaded floors if parkingLots.dat has not changed.
+void loadGarage(Garage& site);
+
+// Saves the floors, customers, hourly rates and daily max rate of one site to its data directory,
+// with the floor directory in floorIndex.dat. The files are replaced together: all are written to
+// temporaries, a commit marker is written, and then each is renamed over the old one. Returns
+// false, leaving the old files, if any write fails. Trims the loaded floors after a save.
+bool saveGarage(Garage& site);
+
+// Saves only the hourly rates and daily max rate of the site's current config, replacing both files
+// together as saveGarage() does. Returns false, leaving the old files, if either write fails.
+bool saveRates(Garage& site);
+
+// Write the floors, customers and hourly rates of a site in the formats of parkingLots.dat,
+// customers.dat and hourlyRates.dat. Floors that are not loaded are copied from the site's
+// parkingLots.dat; writeParkingLots() returns where each floor's spot lines went, relative to
+// where it started writing.
+std::vector<FloorExtent> writeParkingLots(std::ostream& out, const Garage& site);
+void writeCustomers(std::ostream& out, const CustomerMap& customers);
+void writeHourlyRates(std::ostream& out, const std::map<std::string, std::map<std::string, double>>& hourlyRates);
+
+// Returns the path of a data file inside the given site's data directory.
+std::string garageFilePath(const Garage& site, const std::string& fileName);
+
+// Loads sites.dat (or creates the default site) and loads every site in parallel on the worker pool.
+void loadAllGarages();
+
+// Saves the list of sites to sites.dat.
+void saveSiteList();
+
+// Adds a new site with its own data directory and makes it the current site.
+Garage& addGarage(const std::string& name, const std::string& dataDir);
+
+// Makes the named site the current one. Returns false if there is no such site.
+bool selectGarage(const std::string& name);
+
+// Counts the occupancy of a single site from a read view, without locking it.
+OccupancySummary computeOccupancy(const Garage& site);
+
+// Counts the occupancy of every site in parallel on the worker pool and adds the results together.
+OccupancySummary aggregateOccupancy();
+
+// Returns the index of the spot with the given id on a floor, or -1 if there is no such spot.
+int findSpotIndex(const Floor& floor, const std::string& spotId);
+
+// Returns every free spot of the site that accepts the vehicle type, in floor order.
+std::vector<SpotRef> findAvailableSpots(const Garage& site, const std::string& vehicleType);
+std::vector<SpotRef> findAvailableSpots(const GarageVersion& view, const SiteConfig& config, const std::string& vehicleType);
+
+// Rents a spot to a customer and records the rental on the customer, which turns a kiosk visitor
+// into a customer. Does not save.
+RentResult rentSpot(Garage& site, SpotRef spot, const std::string& plateNumber, const std::string& vehicleType, int entrance, time_t now);
+
+// Rents the free spot nearest the entrance that accepts the vehicle type, and returns it in spot.
+// Does not save.
+RentResult rentNearestSpot(Garage& site, const std::string& plateNumber, const std::string& vehicleType, int entrance, time_t now, SpotRef& spot);
+
+// Calculates the fee for a stay: the hourly rate for every started hour, a 20% surcharge that grows
+// with every 6 hours parked, capped at the site's daily maximum rate. The Garage form reads the
+// site's current config without taking a lock.
+double calculateParkingFee(const Garage& site, const std::string& parkingType, time_t startTime, time_t endTime, double& totalHours);
+double calculateParkingFee(const SiteConfig& config, const std::string& parkingType, time_t startTime, time_t endTime, double& totalHours);
+
+// Loads the given floors of a site whose floors load on demand and publishes them, so read views
+// show their spots. Does nothing for other sites.
+void loadFloors(Garage& site, const std::vector<FloorHandle>& floors);
+
+// Unloads the least recently used unchanged floors of a site whose floors load on demand while it
+// is over its floor budget, and publishes them as not loaded.
+void trimFloors(Garage& site);
+
+// Frees the spot occupied by the plate number at time now. Returns false if the plate is not parked.
+bool releaseSpot(Garage& site, const std::string& plateNumber, time_t now);
+
+// Charges a customer, frees their spot, adds the payment to the site's revenue ledger and removes
+// the customer record. A customer who is not parked is removed without a ledger entry. Does not save.
+// Returns false if there is no such customer.
+bool settleCustomer(Garage& site, const std::string& plateNumber, int exit, time_t now, double& payment);
+
+// Removes a customer record without charging it, and frees the spot the plate is parked in, if any.
+// Does not save. Returns false if there is no such customer.
+bool removeCustomer(Garage& site, const std::string& plateNumber, time_t now);
+
+// Clears the console screen.
+void clearScreen();
+
+// Shows every site with its occupancy, and lets the admin switch to or add a site.
+void manageSites();
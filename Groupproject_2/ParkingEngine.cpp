@@ -0,0 +1,279 @@
+#include "Parking.h"
+#include "Metrics.h"
+
+#include <cmath>
+
+using namespace std;
+
+int findSpotIndex(const Floor& floor, const string& spotId) {
+    for (size_t i = 0; i < floor.spots.size(); ++i) {
+        if (floor.spots[i].id == spotId) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+vector<SpotRef> findAvailableSpots(const Garage& site, const string& vehicleType) {
+    OperationTimer timer(Operation::Search);
+    ConfigView config(site);
+    vector<SpotRef> available;
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        const FloorSpots& spots = site.floors[floor].spots;
+        for (size_t i = 0; i < spots.size(); ++i) {
+            if (!spots[i].isOccupied && config->acceptsVehicle(spots[i].type, vehicleType)) {
+                available.push_back(SpotRef{ floor, static_cast<int>(i) });
+            }
+        }
+    }
+    return available;
+}
+
+vector<SpotRef> findAvailableSpots(const GarageVersion& view, const SiteConfig& config, const string& vehicleType) {
+    OperationTimer timer(Operation::Search);
+    vector<SpotRef> available;
+    for (size_t floor = 0; floor < view.floors.size(); ++floor) {
+        const FloorVersion& spots = *view.floors[floor];
+        size_t index = 0;
+        for (const SpotPage* page : spots.pages) {
+            for (const ParkingSpot& spot : page->spots) {
+                if (!spot.isOccupied && config.acceptsVehicle(spot.type, vehicleType)) {
+                    available.push_back(SpotRef{ static_cast<FloorHandle>(floor), static_cast<int>(index) });
+                }
+                ++index;
+            }
+        }
+    }
+    return available;
+}
+
+RentResult rentSpot(Garage& site, SpotRef spotRef, const string& plateNumber, const string& vehicleType, int entrance, time_t now) {
+    OperationTimer timer(Operation::Rent);
+    const FloorRegistry& floors = site.floors; // Checked without taking the floor for writing
+    if (spotRef.floor < 0 || spotRef.floor >= floors.size() ||
+        spotRef.index < 0 || spotRef.index >= static_cast<int>(floors[spotRef.floor].spots.size())) {
+        return RentResult::InvalidSpot;
+    }
+    const ParkingSpot& current = floors[spotRef.floor].spots[spotRef.index];
+    if (current.isOccupied) {
+        return RentResult::SpotOccupied;
+    }
+    if (!ConfigView(site)->acceptsVehicle(current.type, vehicleType)) {
+        return RentResult::IncompatibleVehicle;
+    }
+
+    ParkingSpot& spot = site.floors[spotRef.floor].spots[spotRef.index];
+    spot.isOccupied = true;
+    spot.vehicleType = vehicleType;
+    spot.plateNumber = plateNumber;
+    spot.startTime = now;
+    spot.entrance = entrance;
+    if (site.allocator.isBuilt()) {
+        site.allocator.spotTaken(site, spotRef);
+    }
+    site.floors.noteParked(plateNumber, spotRef.floor);
+    site.forecaster.recordArrival(spot.type, site.floors[spotRef.floor].name, now);
+    site.overstays.sessionStarted(plateNumber, spot.id, spot.type, now);
+
+    Customer& customer = site.customers[plateNumber];
+    site.plates.insert(plateNumber);
+    site.visitors.remove(plateNumber);
+    customer.plateNumber = plateNumber;
+    customer.startTime = now;
+    customer.entrance = entrance;
+    customer.parkingType = spot.type;  // Ensure parking type is recorded correctly
+    customer.vehicleType = vehicleType;
+    customer.endTime = 0;  // Initialize end time as 0
+    customer.exit = 0;  // Initialize exit as 0
+    site.events.recordRent(site, site.floors[spotRef.floor].name, spot.id, plateNumber, vehicleType, entrance, now);
+    site.views.publish(site, { spotRef }, { plateNumber });
+    return RentResult::Rented;
+}
+
+RentResult rentNearestSpot(Garage& site, const string& plateNumber, const string& vehicleType, int entrance, time_t now, SpotRef& spot) {
+    OperationTimer timer(Operation::Assign);
+    if (!ConfigView(site)->knowsVehicle(vehicleType)) {
+        return RentResult::IncompatibleVehicle;
+    }
+    if (entrance < 1 || entrance > SpotAllocator::entrances) {
+        return RentResult::InvalidSpot;
+    }
+
+    if (site.floors.onDemand()) {
+        // The index would load every floor; search the floors by their counts instead
+        spot = site.allocator.nearestOnDemand(site, vehicleType, entrance);
+        return spot.floor == invalidFloor ? RentResult::NoFreeSpot : rentSpot(site, spot, plateNumber, vehicleType, entrance, now);
+    }
+    if (!site.allocator.isBuilt()) {
+        site.allocator.rebuild(site);
+    }
+    ConfigView config(site);
+    spot = site.allocator.nearest(*config, vehicleType, entrance);
+    if (spot.floor == invalidFloor) {
+        return RentResult::NoFreeSpot;
+    }
+    RentResult result = rentSpot(site, spot, plateNumber, vehicleType, entrance, now);
+    if (result != RentResult::Rented) {
+        // A spot was edited without invalidating the index: rebuild it and try once more
+        site.allocator.rebuild(site);
+        spot = site.allocator.nearest(*config, vehicleType, entrance);
+        result = spot.floor == invalidFloor ? RentResult::NoFreeSpot : rentSpot(site, spot, plateNumber, vehicleType, entrance, now);
+    }
+    return result;
+}
+
+double calculateParkingFee(const SiteConfig& config, const string& parkingType, time_t startTime, time_t endTime, double& totalHours) {
+    totalHours = ceil(difftime(endTime, startTime) / 3600.0); // Round up to nearest hour
+
+    double rate = config.hourlyRate(parkingType);
+    double initialPayment = totalHours * rate;
+
+    // Add a 20% surcharge for each 6-hour interval
+    int sixHourIntervals = static_cast<int>(totalHours) / 6;
+    double surcharge = 0.0;
+    if (sixHourIntervals > 0) {
+        for (int i = 1; i <= sixHourIntervals; ++i) {
+            surcharge += 6 * rate * 0.2 * i;
+        }
+        // Add surcharge for the remaining hours after the last 6-hour interval
+        double remainingHours = totalHours - (sixHourIntervals * 6);
+        surcharge += remainingHours * rate * 0.2 * sixHourIntervals;
+    }
+
+    double payment = initialPayment + surcharge;
+    if (payment > config.dailyMaxRate) { // Apply daily max rate
+        payment = config.dailyMaxRate;
+    }
+    return payment;
+}
+
+double calculateParkingFee(const Garage& site, const string& parkingType, time_t startTime, time_t endTime, double& totalHours) {
+    ConfigView config(site); // One config for the whole calculation, even if a reload swaps it meanwhile
+    return calculateParkingFee(*config, parkingType, startTime, endTime, totalHours);
+}
+
+// Returns the index of the spot the plate is parked in on a floor, or -1.
+static int findParkedIndex(const FloorSpots& spots, const string& plateNumber) {
+    for (size_t i = 0; i < spots.size(); ++i) {
+        if (spots[i].isOccupied && spots[i].plateNumber == plateNumber) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Returns the spot the plate is parked in, or a spot with an invalid floor. When floors load on
+// demand, the floor the plate was last seen on and the loaded floors are searched first; then the
+// other floors with parked cars are loaded one at a time, and unloaded again if the plate is not
+// on them.
+static SpotRef findParkedSpot(Garage& site, const string& plateNumber) {
+    const FloorRegistry& floors = site.floors; // Searching does not change a floor
+    FloorHandle hinted = floors.parkedFloor(plateNumber);
+    for (int pass = 0; pass < 3; ++pass) { // The floor last seen on, then the loaded floors, then the rest
+        for (FloorHandle floor = 0; floor < floors.size(); ++floor) {
+            bool wasLoaded = floors.isLoaded(floor);
+            bool skipped = pass == 0 ? floor != hinted : pass == 1 ? !wasLoaded || floor == hinted : wasLoaded || floor == hinted;
+            if (skipped || (!wasLoaded && floors.peek(floor).counts.occupied == 0)) continue;
+            int index = findParkedIndex(floors[floor].spots, plateNumber);
+            if (index >= 0) {
+                return SpotRef{ floor, index };
+            }
+            if (!wasLoaded) {
+                site.floors.unload(floor);
+            }
+        }
+    }
+    return SpotRef{ invalidFloor, -1 };
+}
+
+// Frees the spot occupied by the plate number without publishing the change. Returns the spot in
+// freed, or false if the plate is not parked.
+static bool vacateSpot(Garage& site, const string& plateNumber, time_t now, SpotRef& freed) {
+    freed = findParkedSpot(site, plateNumber);
+    if (freed.floor == invalidFloor) {
+        return false;
+    }
+    ParkingSpot& spot = site.floors[freed.floor].spots[freed.index];
+    site.forecaster.recordDeparture(spot.type, site.floors[freed.floor].name, spot.startTime, now);
+    site.overstays.sessionEnded(plateNumber);
+    site.floors.noteDeparted(plateNumber);
+    spot.isOccupied = false;
+    spot.vehicleType = "";
+    spot.plateNumber = "";
+    spot.startTime = 0;
+    spot.entrance = 0;
+    if (site.allocator.isBuilt()) {
+        site.allocator.spotFreed(site, freed);
+    }
+    return true;
+}
+
+void loadFloors(Garage& site, const vector<FloorHandle>& floors) {
+    if (!site.floors.onDemand()) {
+        return;
+    }
+    const FloorRegistry& registry = site.floors;
+    for (FloorHandle floor : floors) {
+        registry[floor]; // Loads it without taking it for writing
+    }
+    site.views.republishFloors(site, floors);
+}
+
+void trimFloors(Garage& site) {
+    if (!site.floors.onDemand()) {
+        return;
+    }
+    // Floors unloaded by a search were never published loaded, so only these need publishing
+    site.views.republishFloors(site, site.floors.trim());
+}
+
+bool releaseSpot(Garage& site, const string& plateNumber, time_t now) {
+    SpotRef freed;
+    if (!vacateSpot(site, plateNumber, now, freed)) {
+        return false;
+    }
+    site.events.recordRelease(site, plateNumber, now);
+    site.views.publish(site, { freed }, {});
+    return true;
+}
+
+bool removeCustomer(Garage& site, const string& plateNumber, time_t now) {
+    auto it = site.customers.find(plateNumber);
+    if (it == site.customers.end()) {
+        return false;
+    }
+    SpotRef freed;
+    bool parked = vacateSpot(site, plateNumber, now, freed);
+    site.customers.erase(it);
+    site.plates.erase(plateNumber);
+    site.events.recordCustomerRemoved(site, plateNumber, now);
+    site.views.publish(site, parked ? vector<SpotRef>{ freed } : vector<SpotRef>(), { plateNumber });
+    return true;
+}
+
+bool settleCustomer(Garage& site, const string& plateNumber, int exit, time_t now, double& payment) {
+    OperationTimer timer(Operation::Settle);
+    auto it = site.customers.find(plateNumber);
+    if (it == site.customers.end()) {
+        return false;
+    }
+    Customer& customer = it->second;
+    double totalHours;
+    customer.endTime = now;
+    customer.exit = exit;
+    customer.payment = calculateParkingFee(site, customer.parkingType, customer.startTime, now, totalHours);
+    payment = customer.payment;
+
+    SpotRef freed;
+    bool parked = vacateSpot(site, plateNumber, now, freed);
+    if (parked && customer.startTime != 0) {
+        // A customer who never parked has no stay to bill, only a record to remove
+        site.ledger.record(SettledPayment{ customer.parkingType, site.floors[freed.floor].name,
+            customer.entrance, exit, now, payment, totalHours });
+    }
+    site.customers.erase(it);
+    site.plates.erase(plateNumber);
+    site.events.recordSettle(site, plateNumber, exit, payment, now);
+    site.views.publish(site, parked ? vector<SpotRef>{ freed } : vector<SpotRef>(), { plateNumber }); // One version for the spot and the customer
+    return true;
+}
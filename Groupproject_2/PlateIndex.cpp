@@ -0,0 +1,200 @@
+#include "PlateIndex.h"
+#include "Parking.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void PlateIndex::clear() {
+    nodes.clear();
+    freeNodes.clear();
+}
+
+void PlateIndex::rebuild(const Garage& site) {
+    clear();
+    for (const auto& customer : site.customers) {
+        insert(customer.first);
+    }
+}
+
+int PlateIndex::child(int node, char label) const {
+    for (int next = nodes[node].firstChild; next >= 0 && nodes[next].label <= label; next = nodes[next].nextSibling) {
+        if (nodes[next].label == label) {
+            return next;
+        }
+    }
+    return -1;
+}
+
+// Adds an empty child in character order, reusing a freed node if there is one.
+int PlateIndex::addChild(int node, char label) {
+    int added;
+    if (!freeNodes.empty()) {
+        added = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[added] = Node();
+    }
+    else {
+        added = static_cast<int>(nodes.size());
+        nodes.emplace_back(); // May move the nodes, so only indexes are held across this
+    }
+    nodes[added].label = label;
+
+    int previous = -1;
+    int next = nodes[node].firstChild;
+    while (next >= 0 && nodes[next].label < label) {
+        previous = next;
+        next = nodes[next].nextSibling;
+    }
+    nodes[added].nextSibling = next;
+    if (previous < 0) {
+        nodes[node].firstChild = added;
+    }
+    else {
+        nodes[previous].nextSibling = added;
+    }
+    return added;
+}
+
+void PlateIndex::unlink(int parent, int node) {
+    if (nodes[parent].firstChild == node) {
+        nodes[parent].firstChild = nodes[node].nextSibling;
+        return;
+    }
+    int previous = nodes[parent].firstChild;
+    while (nodes[previous].nextSibling != node) {
+        previous = nodes[previous].nextSibling;
+    }
+    nodes[previous].nextSibling = nodes[node].nextSibling;
+}
+
+void PlateIndex::insert(const string& plateNumber) {
+    if (contains(plateNumber)) {
+        return;
+    }
+    if (nodes.empty()) {
+        nodes.emplace_back(); // Root
+    }
+    int node = 0;
+    ++nodes[node].plates;
+    for (char label : plateNumber) {
+        int next = child(node, label);
+        node = next >= 0 ? next : addChild(node, label);
+        ++nodes[node].plates;
+    }
+    nodes[node].terminal = true;
+}
+
+void PlateIndex::erase(const string& plateNumber) {
+    if (!contains(plateNumber)) {
+        return;
+    }
+    vector<int> path{ 0 };
+    for (char label : plateNumber) {
+        path.push_back(child(path.back(), label));
+    }
+    for (int node : path) {
+        --nodes[node].plates;
+    }
+    nodes[path.back()].terminal = false;
+
+    // The highest node left without plates takes the rest of the path with it: any other branch
+    // below it would still count a plate
+    for (size_t depth = 1; depth < path.size(); ++depth) {
+        if (nodes[path[depth]].plates == 0) {
+            unlink(path[depth - 1], path[depth]);
+            freeNodes.insert(freeNodes.end(), path.begin() + depth, path.end());
+            break;
+        }
+    }
+}
+
+bool PlateIndex::contains(const string& plateNumber) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    int node = 0;
+    for (char label : plateNumber) {
+        node = child(node, label);
+        if (node < 0) {
+            return false;
+        }
+    }
+    return nodes[node].terminal;
+}
+
+void PlateIndex::collectPlates(int node, string& path, size_t limit, vector<string>& plates) const {
+    if (nodes[node].terminal) {
+        plates.push_back(path);
+    }
+    for (int next = nodes[node].firstChild; next >= 0 && plates.size() < limit; next = nodes[next].nextSibling) {
+        path.push_back(nodes[next].label);
+        collectPlates(next, path, limit, plates);
+        path.pop_back();
+    }
+}
+
+size_t PlateIndex::withPrefix(const string& prefix, size_t limit, vector<string>& plates) const {
+    if (nodes.empty()) {
+        return 0;
+    }
+    int node = 0;
+    for (char label : prefix) {
+        node = child(node, label);
+        if (node < 0) {
+            return 0;
+        }
+    }
+    if (limit > 0) {
+        string path = prefix;
+        size_t before = plates.size();
+        collectPlates(node, path, before + limit, plates);
+    }
+    return nodes[node].plates;
+}
+
+// Walks the trie along the text with at most one edit. Until the edit is spent every child is a
+// candidate; after it only the child matching the next character is, so the walk costs about
+// plate length * children per node * plate length steps however many plates are indexed.
+void PlateIndex::collectSimilar(int node, const string& text, size_t position, bool edited, string& path,
+    vector<string>& found) const {
+    if (position == text.size() && nodes[node].terminal) {
+        found.push_back(path);
+    }
+    if (!edited && position < text.size()) {
+        collectSimilar(node, text, position + 1, true, path, found); // The text has an extra character
+    }
+    for (int next = nodes[node].firstChild; next >= 0; next = nodes[next].nextSibling) {
+        char label = nodes[next].label;
+        bool matches = position < text.size() && text[position] == label;
+        if (!matches && edited) {
+            continue;
+        }
+        path.push_back(label);
+        if (matches) {
+            collectSimilar(next, text, position + 1, edited, path, found);
+        }
+        else if (position < text.size()) {
+            collectSimilar(next, text, position + 1, true, path, found); // A character was misread
+        }
+        if (!edited) {
+            collectSimilar(next, text, position, true, path, found); // The text dropped a character
+        }
+        path.pop_back();
+    }
+}
+
+vector<string> PlateIndex::similar(const string& text, size_t limit) const {
+    vector<string> found;
+    if (nodes.empty()) {
+        return found;
+    }
+    string path;
+    collectSimilar(0, text, 0, false, path, found);
+    sort(found.begin(), found.end());
+    found.erase(unique(found.begin(), found.end()), found.end()); // Reached by more than one edit
+    if (found.size() > limit) {
+        found.resize(limit);
+    }
+    return found;
+}
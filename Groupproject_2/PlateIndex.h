@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct Garage;
+
+// Plate numbers of a site's customers in a trie, so a customer can be found from the start of a
+// plate or from a plate with one character misread, added or dropped. Every node counts the plates
+// below it, so a prefix is counted in O(prefix length), and a node whose count drops to zero is
+// unlinked and reused, so the trie does not grow with plates that came and went. The owner keeps it
+// in step with its customer table: insert() where a customer is added, erase() where one is removed.
+class PlateIndex {
+public:
+    void clear();
+
+    // Indexes every customer of the site. O(n * plate length).
+    void rebuild(const Garage& site);
+
+    void insert(const std::string& plateNumber);
+    void erase(const std::string& plateNumber);
+    bool contains(const std::string& plateNumber) const;
+    size_t size() const { return nodes.empty() ? 0 : nodes[0].plates; }
+
+    // Appends up to limit plates that start with the prefix to plates, in plate order, and returns
+    // how many plates start with it.
+    size_t withPrefix(const std::string& prefix, size_t limit, std::vector<std::string>& plates) const;
+
+    // Returns up to limit plates, in plate order, that one substitution, insertion or deletion of a
+    // character turns the text into; the text itself is included if it is indexed.
+    std::vector<std::string> similar(const std::string& text, size_t limit) const;
+
+    // Nodes in use and the size of one, for the memory report.
+    size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+    size_t nodeSize() const { return sizeof(Node); }
+
+private:
+    struct Node {
+        int firstChild = -1; // Children are kept in character order
+        int nextSibling = -1;
+        int plates = 0; // Plates ending at or below this node
+        char label = 0;
+        bool terminal = false; // A plate ends here
+    };
+
+    int child(int node, char label) const;
+    int addChild(int node, char label);
+    void unlink(int parent, int node);
+    void collectPlates(int node, std::string& path, size_t limit, std::vector<std::string>& plates) const;
+    void collectSimilar(int node, const std::string& text, size_t position, bool edited, std::string& path,
+        std::vector<std::string>& found) const;
+
+    std::vector<Node> nodes; // nodes[0] is the root once anything has been inserted
+    std::vector<int> freeNodes;
+};
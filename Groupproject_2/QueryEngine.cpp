@@ -0,0 +1,488 @@
+#include "QueryEngine.h"
+#include "Parking.h"
+#include "CustomerQuery.h"
+#include "DataParser.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+struct ColumnSpec {
+    const char* name;
+    bool categorical; // Text compared with = and != only, otherwise a number
+};
+
+static const ColumnSpec spotColumns[] = {
+    { "floor", true }, { "type", true }, { "vehicle", true }, { "plate", true },
+    { "occupied", false }, { "entrance", false }, { "hours", false }, { "fee", false }
+};
+static const ColumnSpec sessionColumns[] = {
+    { "plate", true }, { "status", true }, { "type", true }, { "vehicle", true }, { "floor", true },
+    { "entrance", false }, { "exit", false }, { "hours", false }, { "fee", false }
+};
+static const size_t spotColumnCount = sizeof(spotColumns) / sizeof(spotColumns[0]);
+static const size_t sessionColumnCount = sizeof(sessionColumns) / sizeof(sessionColumns[0]);
+
+// Column positions within the tables above.
+enum SpotColumn { SpotFloor, SpotType, SpotVehicle, SpotPlate, SpotOccupied, SpotEntrance, SpotHours, SpotFee };
+enum SessionColumn { SessionPlate, SessionStatus, SessionType, SessionVehicle, SessionFloor, SessionEntrance, SessionExit, SessionHours, SessionFee };
+
+static const char* const statusNames[] = { "not-parked", "active", "departed" }; // In CustomerStatus order after Any
+
+// Returns the position of the column in the table, or -1 if it has no such column.
+static int findColumn(QueryTable table, const string& name) {
+    const ColumnSpec* columns = table == QueryTable::Spots ? spotColumns : sessionColumns;
+    size_t count = table == QueryTable::Spots ? spotColumnCount : sessionColumnCount;
+    for (size_t i = 0; i < count; ++i) {
+        if (name == columns[i].name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+static bool isCategorical(QueryTable table, int column) {
+    return (table == QueryTable::Spots ? spotColumns : sessionColumns)[column].categorical;
+}
+
+static string lowercase(string text) {
+    transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return text;
+}
+
+// Splits a predicate such as hours>=8 into its column, operator and value.
+static bool parsePredicate(const string& text, QueryTable table, QueryPredicate& predicate, string& error) {
+    size_t opStart = text.find_first_of("!<>=");
+    if (opStart == string::npos || opStart == 0) {
+        error = "expected a condition such as hours>8, not " + text;
+        return false;
+    }
+    size_t opEnd = opStart + 1;
+    if (opEnd < text.size() && text[opEnd] == '=') {
+        ++opEnd;
+    }
+    static const map<string, QueryOperator> operators = {
+        { "=", QueryOperator::Equal }, { "==", QueryOperator::Equal }, { "!=", QueryOperator::NotEqual },
+        { "<", QueryOperator::Less }, { "<=", QueryOperator::LessOrEqual },
+        { ">", QueryOperator::Greater }, { ">=", QueryOperator::GreaterOrEqual }
+    };
+    auto op = operators.find(text.substr(opStart, opEnd - opStart));
+    string value = text.substr(opEnd);
+    predicate.column = lowercase(text.substr(0, opStart));
+    int column = findColumn(table, predicate.column);
+    if (op == operators.end() || value.empty()) {
+        error = "invalid condition " + text;
+        return false;
+    }
+    if (column < 0) {
+        error = "unknown column " + predicate.column;
+        return false;
+    }
+    predicate.op = op->second;
+
+    bool equality = predicate.op == QueryOperator::Equal || predicate.op == QueryOperator::NotEqual;
+    if (isCategorical(table, column)) {
+        if (!equality) {
+            error = "only = and != apply to " + predicate.column;
+            return false;
+        }
+        stringstream ss(value);
+        string alternative;
+        while (getline(ss, alternative, '|')) {
+            predicate.values.push_back(alternative == emptyFieldPlaceholder ? "" : alternative);
+        }
+        return true;
+    }
+    if (!parseNumber(value, predicate.number)) {
+        error = predicate.column + " needs a number, not " + value;
+        return false;
+    }
+    return true;
+}
+
+bool parseQuery(const string& text, Query& query, string& error) {
+    stringstream ss(text);
+    vector<string> words;
+    string word;
+    while (ss >> word) {
+        words.push_back(word);
+    }
+    size_t next = 0;
+    auto keyword = [&](const char* expected) {
+        if (next < words.size() && lowercase(words[next]) == expected) {
+            ++next;
+            return true;
+        }
+        return false;
+    };
+
+    query = Query();
+    string valueColumn;
+    if (keyword("count")) {
+        query.aggregate = QueryAggregate::Count;
+    }
+    else if (keyword("sum") || keyword("avg")) {
+        query.aggregate = lowercase(words[next - 1]) == "sum" ? QueryAggregate::Sum : QueryAggregate::Average;
+        if (next == words.size()) {
+            error = "expected a column after " + words[next - 1];
+            return false;
+        }
+        valueColumn = lowercase(words[next++]);
+    }
+    else {
+        error = "a query starts with count, sum or avg";
+        return false;
+    }
+
+    if (keyword("spots")) {
+        query.table = QueryTable::Spots;
+    }
+    else if (keyword("sessions")) {
+        query.table = QueryTable::Sessions;
+    }
+    else {
+        error = "expected spots or sessions";
+        return false;
+    }
+    if (!valueColumn.empty()) {
+        int column = findColumn(query.table, valueColumn);
+        if (column < 0 || isCategorical(query.table, column)) {
+            error = valueColumn + " is not a numeric column";
+            return false;
+        }
+        query.valueColumn = valueColumn;
+    }
+
+    if (keyword("where")) {
+        do {
+            if (next == words.size()) {
+                error = "expected a condition";
+                return false;
+            }
+            QueryPredicate predicate;
+            if (!parsePredicate(words[next++], query.table, predicate, error)) {
+                return false;
+            }
+            query.predicates.push_back(predicate);
+        } while (keyword("and"));
+    }
+    if (keyword("by")) {
+        if (next == words.size() || findColumn(query.table, lowercase(words[next])) < 0) {
+            error = next == words.size() ? "expected a column after by" : "unknown column " + words[next];
+            return false;
+        }
+        query.groupColumn = lowercase(words[next++]);
+    }
+    if (next != words.size()) {
+        error = "unexpected " + words[next];
+        return false;
+    }
+    return true;
+}
+
+// One column of a snapshot. Text is stored as codes into a dictionary of the distinct values.
+struct ColumnData {
+    bool used = false;
+    bool categorical = false;
+    vector<uint32_t> codes;
+    vector<string> dictionary;
+    unordered_map<string, uint32_t> lookup;
+    vector<double> values;
+
+    void addText(const string& text) {
+        auto inserted = lookup.emplace(text, static_cast<uint32_t>(dictionary.size()));
+        if (inserted.second) {
+            dictionary.push_back(text);
+        }
+        codes.push_back(inserted.first->second);
+    }
+};
+
+// The columns of a table a query reads, one array per column.
+struct Snapshot {
+    size_t rows = 0;
+    vector<ColumnData> columns;
+};
+
+static void snapshotSpots(const Garage& site, time_t now, Snapshot& snapshot) {
+    vector<ColumnData>& c = snapshot.columns;
+    for (const auto& floor : site.floors) {
+        c[SpotFloor].dictionary.push_back(floor.name); // Floor codes are the floor handles
+    }
+    for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+        for (const auto& spot : site.floors[handle].spots) {
+            if (spot.type.empty()) continue; // Deleted spot
+            ++snapshot.rows;
+            if (c[SpotFloor].used) c[SpotFloor].codes.push_back(static_cast<uint32_t>(handle));
+            if (c[SpotType].used) c[SpotType].addText(spot.type);
+            if (c[SpotVehicle].used) c[SpotVehicle].addText(spot.vehicleType);
+            if (c[SpotPlate].used) c[SpotPlate].addText(spot.plateNumber);
+            if (c[SpotOccupied].used) c[SpotOccupied].values.push_back(spot.isOccupied ? 1 : 0);
+            if (c[SpotEntrance].used) c[SpotEntrance].values.push_back(spot.entrance);
+            if (c[SpotHours].used) c[SpotHours].values.push_back(spot.isOccupied ? difftime(now, spot.startTime) / 3600 : 0);
+            if (c[SpotFee].used) {
+                double totalHours;
+                c[SpotFee].values.push_back(spot.isOccupied ? calculateParkingFee(site, spot.type, spot.startTime, now, totalHours) : 0);
+            }
+        }
+    }
+}
+
+static void snapshotSessions(const Garage& site, time_t now, Snapshot& snapshot) {
+    vector<ColumnData>& c = snapshot.columns;
+    unordered_map<string, FloorHandle> parkedOn; // Plate number -> floor, for the floor column
+    if (c[SessionFloor].used) {
+        for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+            c[SessionFloor].dictionary.push_back(site.floors[handle].name);
+            for (const auto& spot : site.floors[handle].spots) {
+                if (spot.isOccupied && !spot.type.empty()) {
+                    parkedOn[spot.plateNumber] = handle;
+                }
+            }
+        }
+        c[SessionFloor].dictionary.push_back(""); // Sessions not parked on any floor
+    }
+    for (const char* status : statusNames) {
+        c[SessionStatus].dictionary.push_back(status);
+    }
+
+    for (const auto& entry : site.customers) {
+        const Customer& customer = entry.second;
+        CustomerStatus status = customerStatus(customer);
+        ++snapshot.rows;
+        if (c[SessionPlate].used) c[SessionPlate].addText(customer.plateNumber);
+        if (c[SessionStatus].used) c[SessionStatus].codes.push_back(static_cast<uint32_t>(status) - 1);
+        if (c[SessionType].used) c[SessionType].addText(customer.parkingType);
+        if (c[SessionVehicle].used) c[SessionVehicle].addText(customer.vehicleType);
+        if (c[SessionFloor].used) {
+            auto floor = status == CustomerStatus::Active ? parkedOn.find(customer.plateNumber) : parkedOn.end();
+            c[SessionFloor].codes.push_back(static_cast<uint32_t>(floor == parkedOn.end() ? site.floors.size() : floor->second));
+        }
+        if (c[SessionEntrance].used) c[SessionEntrance].values.push_back(customer.entrance);
+        if (c[SessionExit].used) c[SessionExit].values.push_back(customer.exit);
+        if (c[SessionHours].used) {
+            double hours = 0;
+            if (status != CustomerStatus::NotParked) {
+                hours = difftime(status == CustomerStatus::Active ? now : customer.endTime, customer.startTime) / 3600;
+            }
+            c[SessionHours].values.push_back(hours);
+        }
+        if (c[SessionFee].used) {
+            double fee = customer.payment;
+            if (status == CustomerStatus::Active) {
+                double totalHours;
+                fee = calculateParkingFee(site, customer.parkingType, customer.startTime, now, totalHours);
+            }
+            c[SessionFee].values.push_back(status == CustomerStatus::NotParked ? 0 : fee);
+        }
+    }
+}
+
+// Keeps the rows for which keep(row) holds: every row of the table for the first predicate, the
+// rows still selected for the others. The selection is compacted without a branch per row.
+template <typename Keep>
+static void narrow(vector<uint32_t>& selection, bool first, size_t rows, Keep keep) {
+    size_t kept = 0;
+    if (first) {
+        selection.resize(rows);
+        for (uint32_t row = 0; row < rows; ++row) {
+            selection[kept] = row;
+            kept += keep(row) ? 1 : 0;
+        }
+    }
+    else {
+        for (uint32_t row : selection) {
+            selection[kept] = row;
+            kept += keep(row) ? 1 : 0;
+        }
+    }
+    selection.resize(kept);
+}
+
+static void applyPredicate(const ColumnData& column, const QueryPredicate& predicate, vector<uint32_t>& selection, bool first, size_t rows) {
+    if (column.categorical) {
+        bool equal = predicate.op == QueryOperator::Equal;
+        vector<uint8_t> accepted(column.dictionary.size(), equal ? 0 : 1);
+        for (const auto& value : predicate.values) {
+            auto code = find(column.dictionary.begin(), column.dictionary.end(), value);
+            if (code != column.dictionary.end()) {
+                accepted[code - column.dictionary.begin()] = equal ? 1 : 0;
+            }
+        }
+        const uint32_t* codes = column.codes.data();
+        const uint8_t* accept = accepted.data();
+        narrow(selection, first, rows, [=](uint32_t row) { return accept[codes[row]] != 0; });
+        return;
+    }
+
+    const double* values = column.values.data();
+    double number = predicate.number;
+    switch (predicate.op) {
+    case QueryOperator::Equal: narrow(selection, first, rows, [=](uint32_t row) { return values[row] == number; }); break;
+    case QueryOperator::NotEqual: narrow(selection, first, rows, [=](uint32_t row) { return values[row] != number; }); break;
+    case QueryOperator::Less: narrow(selection, first, rows, [=](uint32_t row) { return values[row] < number; }); break;
+    case QueryOperator::LessOrEqual: narrow(selection, first, rows, [=](uint32_t row) { return values[row] <= number; }); break;
+    case QueryOperator::Greater: narrow(selection, first, rows, [=](uint32_t row) { return values[row] > number; }); break;
+    case QueryOperator::GreaterOrEqual: narrow(selection, first, rows, [=](uint32_t row) { return values[row] >= number; }); break;
+    }
+}
+
+static string numberKey(double value) {
+    ostringstream key;
+    key << value;
+    return key.str();
+}
+
+QueryResult runQuery(const Garage& site, const Query& query, time_t now) {
+    OperationTimer timer(Operation::Query);
+    TraceSpan span("runQuery", site.name);
+    QueryResult result;
+
+    Snapshot snapshot;
+    size_t columnCount = query.table == QueryTable::Spots ? spotColumnCount : sessionColumnCount;
+    snapshot.columns.resize(columnCount);
+    for (size_t i = 0; i < columnCount; ++i) {
+        snapshot.columns[i].categorical = isCategorical(query.table, static_cast<int>(i));
+    }
+    int valueColumn = query.valueColumn.empty() ? -1 : findColumn(query.table, query.valueColumn);
+    int groupColumn = query.groupColumn.empty() ? -1 : findColumn(query.table, query.groupColumn);
+    for (const auto& predicate : query.predicates) {
+        snapshot.columns[findColumn(query.table, predicate.column)].used = true;
+    }
+    if (valueColumn >= 0) snapshot.columns[valueColumn].used = true;
+    if (groupColumn >= 0) snapshot.columns[groupColumn].used = true;
+
+    {
+        TraceSpan snapshotSpan("snapshotColumns", site.name);
+        if (query.table == QueryTable::Spots) {
+            snapshotSpots(site, now, snapshot);
+        }
+        else {
+            snapshotSessions(site, now, snapshot);
+        }
+    }
+    result.scanned = snapshot.rows;
+
+    vector<uint32_t> selection;
+    for (size_t i = 0; i < query.predicates.size(); ++i) {
+        const QueryPredicate& predicate = query.predicates[i];
+        applyPredicate(snapshot.columns[findColumn(query.table, predicate.column)], predicate, selection, i == 0, snapshot.rows);
+    }
+    if (query.predicates.empty()) {
+        narrow(selection, true, snapshot.rows, [](uint32_t) { return true; });
+    }
+    result.matched = selection.size();
+
+    const double* values = valueColumn >= 0 ? snapshot.columns[valueColumn].values.data() : nullptr;
+    if (groupColumn < 0) {
+        QueryGroup total;
+        total.count = static_cast<long long>(selection.size());
+        if (values != nullptr) {
+            for (uint32_t row : selection) {
+                total.sum += values[row];
+            }
+        }
+        result.groups.push_back(total);
+        return result;
+    }
+
+    const ColumnData& group = snapshot.columns[groupColumn];
+    if (group.categorical) {
+        vector<long long> counts(group.dictionary.size(), 0);
+        vector<double> sums(group.dictionary.size(), 0);
+        const uint32_t* codes = group.codes.data();
+        for (uint32_t row : selection) {
+            ++counts[codes[row]];
+        }
+        if (values != nullptr) {
+            for (uint32_t row : selection) {
+                sums[codes[row]] += values[row];
+            }
+        }
+        for (size_t code = 0; code < counts.size(); ++code) {
+            if (counts[code] > 0) {
+                result.groups.push_back(QueryGroup{ fieldOrPlaceholder(group.dictionary[code]), counts[code], sums[code] });
+            }
+        }
+        sort(result.groups.begin(), result.groups.end(), [](const QueryGroup& a, const QueryGroup& b) { return a.key < b.key; });
+    }
+    else {
+        map<double, QueryGroup> groups;
+        for (uint32_t row : selection) {
+            QueryGroup& entry = groups[group.values[row]];
+            ++entry.count;
+            entry.sum += values != nullptr ? values[row] : 0;
+        }
+        for (auto& entry : groups) {
+            entry.second.key = numberKey(entry.first);
+            result.groups.push_back(entry.second);
+        }
+    }
+    return result;
+}
+
+void writeQueryResult(ostream& out, const Query& query, const QueryResult& result) {
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+
+    bool grouped = !query.groupColumn.empty();
+    bool hasValue = query.aggregate != QueryAggregate::Count;
+    string valueName = (query.aggregate == QueryAggregate::Sum ? "sum " : "avg ") + query.valueColumn;
+    size_t keyWidth = grouped ? query.groupColumn.size() : 5;
+    for (const auto& group : result.groups) {
+        keyWidth = max(keyWidth, group.key.size());
+    }
+    keyWidth += 2;
+
+    out << left << setw(keyWidth) << (grouped ? query.groupColumn : "") << right << setw(10) << "count";
+    if (hasValue) {
+        out << setw(16) << valueName;
+    }
+    out << "\n" << fixed << setprecision(2);
+    auto writeRow = [&](const string& key, long long count, double sum) {
+        out << left << setw(keyWidth) << key << right << setw(10) << count;
+        if (hasValue) {
+            double value = query.aggregate == QueryAggregate::Sum ? sum : (count > 0 ? sum / count : 0);
+            out << setw(16) << value;
+        }
+        out << "\n";
+    };
+    long long totalCount = 0;
+    double totalSum = 0;
+    for (const auto& group : result.groups) {
+        writeRow(grouped ? group.key : "Total", group.count, group.sum);
+        totalCount += group.count;
+        totalSum += group.sum;
+    }
+    if (grouped) {
+        writeRow("Total", totalCount, totalSum);
+    }
+    out << result.matched << " of " << result.scanned << (query.table == QueryTable::Spots ? " spots" : " sessions") << " matched\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void writeQueryHelp(ostream& out) {
+    out << "Query syntax:\n"
+        << "  count|sum <column>|avg <column> spots|sessions [where <condition> [and <condition>...]] [by <column>]\n"
+        << "Conditions compare a column with =, !=, <, <=, > or >= and take no spaces, e.g. hours>8 or floor=B1|B2.\n"
+        << "Spot columns: ";
+    for (size_t i = 0; i < spotColumnCount; ++i) {
+        out << spotColumns[i].name << (i + 1 < spotColumnCount ? ", " : "\n");
+    }
+    out << "Session columns: ";
+    for (size_t i = 0; i < sessionColumnCount; ++i) {
+        out << sessionColumns[i].name << (i + 1 < sessionColumnCount ? ", " : "\n");
+    }
+    out << "Status is not-parked, active or departed; " << emptyFieldPlaceholder << " matches an empty value.\n"
+        << "Example: count spots where type=Handicapped and floor=B2 and hours>8\n"
+        << "Example: sum fee spots where occupied=1 by floor\n";
+}
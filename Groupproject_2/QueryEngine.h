@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Garage;
+
+// Tables a query can read: every spot of the site that is not deleted, or every customer record.
+enum class QueryTable {
+    Spots,
+    Sessions
+};
+
+enum class QueryAggregate {
+    Count,
+    Sum,
+    Average
+};
+
+enum class QueryOperator {
+    Equal,
+    NotEqual,
+    Less,
+    LessOrEqual,
+    Greater,
+    GreaterOrEqual
+};
+
+// One condition of a query, such as hours>8 or floor=B1|B2.
+struct QueryPredicate {
+    std::string column;
+    QueryOperator op = QueryOperator::Equal;
+    std::vector<std::string> values; // Alternatives of = and !=; one number for the other operators
+    double number = 0;
+};
+
+// A parsed query:
+//   count|sum <column>|avg <column> spots|sessions [where <predicate> [and <predicate>...]] [by <column>]
+// Spot columns: floor, type, vehicle, plate, occupied (0 or 1), entrance, hours, fee.
+// Session columns: plate, status (not-parked, active or departed), type, vehicle, floor (active
+// sessions only), entrance, exit, hours, fee.
+// Hours are elapsed hours of the stay so far, or of the whole stay for departed sessions. Fee is the
+// payment due so far for parked vehicles and the payment made for departed sessions.
+struct Query {
+    QueryAggregate aggregate = QueryAggregate::Count;
+    std::string valueColumn; // Summed or averaged column
+    QueryTable table = QueryTable::Spots;
+    std::vector<QueryPredicate> predicates;
+    std::string groupColumn; // Empty for a single total
+};
+
+struct QueryGroup {
+    std::string key;
+    long long count = 0;
+    double sum = 0;
+};
+
+struct QueryResult {
+    std::vector<QueryGroup> groups; // In key order
+    size_t scanned = 0; // Rows of the table
+    size_t matched = 0;
+};
+
+// Parses the query text. On failure returns false and sets error to a message for the user.
+bool parseQuery(const std::string& text, Query& query, std::string& error);
+
+// Runs a query against the site as of now. The columns the query reads are copied out of the site
+// into flat arrays first, with text columns turned into small integer codes, so each predicate is a
+// tight loop over one array that narrows a list of selected rows and the aggregation is one more
+// loop over the selection. Fees are only calculated when the query reads them.
+QueryResult runQuery(const Garage& site, const Query& query, time_t now);
+
+// Writes the result as a table with the group, count and sum or average.
+void writeQueryResult(std::ostream& out, const Query& query, const QueryResult& result);
+
+// Writes the query syntax and the columns of each table.
+void writeQueryHelp(std::ostream& out);
@@ -0,0 +1,292 @@
+#include "Parking.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const GarageVersion emptyVersion; // Seen by readers of a site that has not been loaded
+
+const Customer& CustomerIterator::operator*() const {
+    return version->customerPages[page]->customers[index];
+}
+
+CustomerIterator& CustomerIterator::operator++() {
+    if (++index == version->customerPages[page]->customers.size()) {
+        ++page;
+        index = 0;
+    }
+    return *this;
+}
+
+CustomerIterator& CustomerIterator::operator--() {
+    if (index == 0) {
+        --page;
+        index = version->customerPages[page]->customers.size() - 1;
+    }
+    else {
+        --index;
+    }
+    return *this;
+}
+
+// Returns the page that holds the plate, or would hold it: the first page whose last plate is not
+// before it.
+static size_t customerPageFor(const GarageVersion& version, const string& plateNumber) {
+    auto page = lower_bound(version.customerPages.begin(), version.customerPages.end(), plateNumber,
+        [](const CustomerPage* page, const string& plate) { return page->customers.back().plateNumber < plate; });
+    return page - version.customerPages.begin();
+}
+
+static bool plateBefore(const Customer& customer, const string& plate) {
+    return customer.plateNumber < plate;
+}
+
+CustomerIterator GarageVersion::customerLowerBound(const string& plateNumber) const {
+    size_t page = customerPageFor(*this, plateNumber);
+    if (page == customerPages.size()) {
+        return customersEnd();
+    }
+    const vector<Customer>& customers = customerPages[page]->customers;
+    return CustomerIterator(this, page, lower_bound(customers.begin(), customers.end(), plateNumber, plateBefore) - customers.begin());
+}
+
+CustomerIterator GarageVersion::customerUpperBound(const string& plateNumber) const {
+    CustomerIterator it = customerLowerBound(plateNumber);
+    if (it != customersEnd() && it->plateNumber == plateNumber) {
+        ++it;
+    }
+    return it;
+}
+
+const Customer* GarageVersion::findCustomer(const string& plateNumber) const {
+    CustomerIterator it = customerLowerBound(plateNumber);
+    return it != customersEnd() && it->plateNumber == plateNumber ? &*it : nullptr;
+}
+
+static SpotPage* copySpotPage(const Floor& floor, size_t page) {
+    SpotPage* copy = new SpotPage();
+    size_t first = page * SpotPage::spotsPerPage;
+    size_t last = min(first + SpotPage::spotsPerPage, floor.spots.size());
+    copy->spots.assign(floor.spots.begin() + first, floor.spots.begin() + last);
+    return copy;
+}
+
+static FloorVersion* copyFloor(const Floor& floor) {
+    FloorVersion* copy = new FloorVersion();
+    copy->name = floor.name;
+    copy->spotCount = floor.spots.size();
+    size_t pages = (floor.spots.size() + SpotPage::spotsPerPage - 1) / SpotPage::spotsPerPage;
+    copy->pages.reserve(pages);
+    for (size_t page = 0; page < pages; ++page) {
+        copy->pages.push_back(copySpotPage(floor, page));
+    }
+    return copy;
+}
+
+// A floor that is not loaded: its name and counts, and no spots.
+static FloorVersion* listFloor(const Floor& floor) {
+    FloorVersion* copy = new FloorVersion();
+    copy->name = floor.name;
+    copy->loaded = false;
+    copy->counts = floor.counts;
+    return copy;
+}
+
+// Retires every node of a version that nothing else shares.
+static void retireVersionTree(const GarageVersion* version) {
+    EpochDomain& domain = epochDomain();
+    for (const FloorVersion* floor : version->floors) {
+        for (const SpotPage* page : floor->pages) {
+            domain.retire(page);
+        }
+        domain.retire(floor);
+    }
+    for (const CustomerPage* page : version->customerPages) {
+        domain.retire(page);
+    }
+    domain.retire(version);
+}
+
+GarageVersions::~GarageVersions() {
+    const GarageVersion* version = current.exchange(nullptr);
+    if (version != nullptr) {
+        retireVersionTree(version);
+        epochDomain().collect();
+    }
+}
+
+void GarageVersions::swapIn(GarageVersion* version, bool retireTree) {
+    version->number = ++published;
+    version->published = time(nullptr);
+    const GarageVersion* old = current.exchange(version); // Readers that pin from here on see the new version
+    if (old != nullptr) {
+        if (retireTree) {
+            retireVersionTree(old);
+        }
+        else {
+            epochDomain().retire(old);
+        }
+    }
+    epochDomain().collectIfDue();
+}
+
+void GarageVersions::publishAll(const Garage& site) {
+    TraceSpan span("publishAllViews", site.name);
+    GarageVersion* version = new GarageVersion();
+    version->floors.reserve(site.floors.size());
+    for (FloorHandle handle = 0; handle < site.floors.size(); ++handle) {
+        const Floor& floor = site.floors.peek(handle); // Floors that are not loaded stay that way
+        version->floors.push_back(floor.loaded ? copyFloor(floor) : listFloor(floor));
+    }
+
+    CustomerPage* page = nullptr;
+    for (const auto& entry : site.customers) {
+        if (page == nullptr || page->customers.size() == CustomerPage::pageSize) {
+            page = new CustomerPage();
+            page->customers.reserve(CustomerPage::pageSize);
+            version->customerPages.push_back(page);
+        }
+        page->customers.push_back(entry.second);
+        page->customers.back().plateNumber = entry.first;
+    }
+    version->customerCount = site.customers.size();
+    swapIn(version, true);
+}
+
+void GarageVersions::publish(const Garage& site, const vector<SpotRef>& spots, const vector<string>& plateNumbers) {
+    const GarageVersion* old = current.load();
+    if (old == nullptr || static_cast<size_t>(site.floors.size()) != old->floors.size()) {
+        publishAll(site); // Nothing published yet, or floors were added
+        return;
+    }
+    EpochDomain& domain = epochDomain();
+    GarageVersion* version = new GarageVersion(*old); // Shares every floor and page
+
+    // Spot pages: copy each floor touched once, then each page touched once
+    vector<FloorVersion*> copiedFloors(version->floors.size(), nullptr);
+    vector<pair<FloorHandle, size_t>> copiedPages;
+    for (const SpotRef& spot : spots) {
+        const Floor& live = site.floors[spot.floor];
+        FloorVersion*& floor = copiedFloors[spot.floor];
+        if (floor == nullptr) {
+            const FloorVersion* before = version->floors[spot.floor];
+            if (!before->loaded || before->spotCount != live.spots.size()) {
+                // The floor was loaded or spots were added to it since: take all of it again
+                for (const SpotPage* page : before->pages) {
+                    domain.retire(page);
+                }
+                floor = copyFloor(live);
+                for (size_t page = 0; page < floor->pages.size(); ++page) {
+                    copiedPages.emplace_back(spot.floor, page);
+                }
+            }
+            else {
+                floor = new FloorVersion(*before);
+            }
+            domain.retire(before);
+            version->floors[spot.floor] = floor;
+        }
+        size_t page = spot.index / SpotPage::spotsPerPage;
+        if (find(copiedPages.begin(), copiedPages.end(), make_pair(spot.floor, page)) != copiedPages.end()) {
+            continue;
+        }
+        domain.retire(floor->pages[page]);
+        floor->pages[page] = copySpotPage(live, page);
+        copiedPages.emplace_back(spot.floor, page);
+    }
+
+    // Customer pages: copy the page the plate belongs in and insert, replace or remove the record
+    for (const string& plateNumber : plateNumbers) {
+        auto live = site.customers.find(plateNumber);
+        size_t index = customerPageFor(*version, plateNumber);
+        if (index == version->customerPages.size()) {
+            if (live == site.customers.end()) continue;
+            if (index > 0) {
+                --index; // After every plate so far: append to the last page
+            }
+        }
+        CustomerPage* page = new CustomerPage();
+        if (index < version->customerPages.size()) {
+            const vector<Customer>& before = version->customerPages[index]->customers;
+            page->customers.reserve(before.size() + 1); // Room for an insert without growing again
+            page->customers.assign(before.begin(), before.end());
+        }
+        auto position = lower_bound(page->customers.begin(), page->customers.end(), plateNumber, plateBefore);
+        bool present = position != page->customers.end() && position->plateNumber == plateNumber;
+        if (live != site.customers.end()) {
+            if (!present) {
+                position = page->customers.insert(position, live->second);
+                ++version->customerCount;
+            }
+            else {
+                *position = live->second;
+            }
+            position->plateNumber = plateNumber;
+        }
+        else if (present) {
+            page->customers.erase(position);
+            --version->customerCount;
+        }
+        else {
+            delete page; // Neither published nor live
+            continue;
+        }
+
+        if (index < version->customerPages.size()) {
+            domain.retire(version->customerPages[index]);
+        }
+        else {
+            version->customerPages.push_back(nullptr);
+        }
+        if (page->customers.empty()) {
+            delete page;
+            version->customerPages.erase(version->customerPages.begin() + index);
+        }
+        else if (page->customers.size() >= 2 * CustomerPage::pageSize) {
+            CustomerPage* upper = new CustomerPage();
+            upper->customers.assign(page->customers.begin() + CustomerPage::pageSize, page->customers.end());
+            page->customers.resize(CustomerPage::pageSize);
+            version->customerPages[index] = page;
+            version->customerPages.insert(version->customerPages.begin() + index + 1, upper);
+        }
+        else {
+            version->customerPages[index] = page;
+        }
+    }
+
+    swapIn(version, false);
+}
+
+void GarageVersions::republishFloors(const Garage& site, const vector<FloorHandle>& floors) {
+    const GarageVersion* old = current.load();
+    if (old == nullptr || static_cast<size_t>(site.floors.size()) != old->floors.size()) {
+        publishAll(site);
+        return;
+    }
+    EpochDomain& domain = epochDomain();
+    GarageVersion* version = nullptr;
+    for (FloorHandle handle : floors) {
+        const FloorVersion* before = (version != nullptr ? version : old)->floors[handle];
+        const Floor& live = site.floors.peek(handle);
+        if (before->loaded == live.loaded) {
+            continue;
+        }
+        if (version == nullptr) {
+            version = new GarageVersion(*old); // Shares every floor and page
+        }
+        for (const SpotPage* page : before->pages) {
+            domain.retire(page);
+        }
+        domain.retire(before);
+        version->floors[handle] = live.loaded ? copyFloor(live) : listFloor(live);
+    }
+    if (version != nullptr) {
+        swapIn(version, false);
+    }
+}
+
+ReadView::ReadView(const Garage& site) {
+    const GarageVersion* latest = site.views.latest();
+    version = latest != nullptr ? latest : &emptyVersion;
+}
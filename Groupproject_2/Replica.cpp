@@ -0,0 +1,230 @@
+#include "Replica.h"
+#include "Parking.h"
+#include "Benchmark.h"
+#include "Config.h"
+#include "QueryEngine.h"
+#include "Trace.h"
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static const size_t maxSamples = 100000;
+
+static double elapsedNs(chrono::steady_clock::time_point start) {
+    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+}
+
+// Time since the file was last written, or 0 if it cannot be read.
+static double nanosecondsSinceWritten(const string& path) {
+    error_code ec;
+    auto written = filesystem::last_write_time(path, ec);
+    if (ec) {
+        return 0;
+    }
+    auto age = filesystem::file_time_type::clock::now() - written;
+    return max(0.0, static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(age).count()));
+}
+
+StandbyReplica::StandbyReplica(Garage& site, int pollMilliseconds) : site(site), pollMilliseconds(max(1, pollMilliseconds)) {
+}
+
+StandbyReplica::~StandbyReplica() {
+    stop();
+}
+
+bool StandbyReplica::start(string& error) {
+    {
+        lock_guard<mutex> lock(site.mutex);
+        if (!follower.start(site.dataDir, site, error)) {
+            return false;
+        }
+        appliedAtStart = follower.eventsApplied();
+    }
+    startedAt = chrono::steady_clock::now();
+    stopping = false;
+    thread = std::thread(&StandbyReplica::follow, this);
+    return true;
+}
+
+void StandbyReplica::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    thread.join();
+}
+
+size_t StandbyReplica::applyPending() {
+    string logPath = garageFilePath(site, "events.log");
+    double lag = nanosecondsSinceWritten(logPath); // Taken before reading, so it covers every event read
+    auto start = chrono::steady_clock::now();
+    size_t applied;
+    {
+        lock_guard<mutex> lock(site.mutex);
+        applied = follower.catchUp(site);
+    }
+    if (applied == 0) {
+        return 0;
+    }
+    double applyNs = elapsedNs(start);
+    lock_guard<mutex> lock(stateMutex);
+    size_t slot = static_cast<size_t>(batches % maxSamples);
+    if (lagSamples.size() < maxSamples) {
+        lagSamples.push_back(lag + applyNs);
+        applySamples.push_back(applyNs);
+    }
+    else {
+        lagSamples[slot] = lag + applyNs;
+        applySamples[slot] = applyNs;
+    }
+    ++batches;
+    applySeconds += applyNs / 1e9;
+    return applied;
+}
+
+void StandbyReplica::follow() {
+    unique_lock<mutex> lock(stateMutex);
+    while (!stopping) {
+        lock.unlock();
+        applyPending();
+        lock.lock();
+        wakeUp.wait_for(lock, chrono::milliseconds(pollMilliseconds));
+    }
+}
+
+bool StandbyReplica::promote(string& error) {
+    TraceSpan span("promoteStandby", site.name);
+    auto start = chrono::steady_clock::now();
+    stop();
+    applyPending(); // Whatever the primary wrote before it stopped
+    lock_guard<mutex> lock(site.mutex);
+    if (follower.stalled()) {
+        error = "the log could not be read past event " + to_string(follower.lastSequence());
+        return false;
+    }
+
+    // The primary's indexes were not kept on the standby; each is rebuilt when it is first used
+    site.allocator.invalidate();
+    site.overstays.invalidate();
+    site.forecaster.invalidate();
+    if (!site.events.open(site, time(nullptr))) {
+        error = "unable to open the event log for writing";
+        return false;
+    }
+    if (!saveGarage(site)) {
+        error = "unable to save the site";
+        return false;
+    }
+    watchConfig(site);
+    lock_guard<mutex> stateLock(stateMutex);
+    promoteMilliseconds = elapsedNs(start) / 1e6;
+    return true;
+}
+
+void StandbyReplica::writeStatus(ostream& out) const {
+    uint64_t applied, lastSequence, checkpoints, behind;
+    time_t lastEventTime;
+    bool stalled;
+    {
+        lock_guard<mutex> lock(site.mutex);
+        applied = follower.eventsApplied();
+        lastSequence = follower.lastSequence();
+        lastEventTime = follower.lastEventTime();
+        checkpoints = follower.checkpointsLoaded();
+        stalled = follower.stalled();
+        behind = follower.bytesBehind();
+    }
+    lock_guard<mutex> lock(stateMutex);
+    TimingStats lag = summarizeTimings(lagSamples);
+    TimingStats apply = summarizeTimings(applySamples);
+    double wallSeconds = elapsedNs(startedAt) / 1e9;
+    uint64_t followed = applied - appliedAtStart;
+
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(3);
+    out << "{\n  \"site\": \"" << site.name << "\",\n  \"last_sequence\": " << lastSequence
+        << ",\n  \"last_event_time\": \"" << formatLocalTime(lastEventTime) << "\""
+        << ",\n  \"events_applied\": " << followed << ",\n  \"batches\": " << batches
+        << ",\n  \"checkpoints_loaded\": " << checkpoints << ",\n  \"bytes_behind\": " << behind
+        << ",\n  \"stalled\": " << (stalled ? "true" : "false")
+        << ",\n  \"lag_ms\": {\"p50\": " << lag.p50 / 1e6 << ", \"p99\": " << lag.p99 / 1e6 << ", \"max\": " << lag.max / 1e6 << "}"
+        << ",\n  \"batch_apply_ms\": {\"p50\": " << apply.p50 / 1e6 << ", \"p99\": " << apply.p99 / 1e6 << ", \"max\": " << apply.max / 1e6 << "}"
+        << ",\n  \"apply_events_per_sec\": " << setprecision(1) << (applySeconds > 0 ? followed / applySeconds : 0.0)
+        << ",\n  \"events_per_wall_sec\": " << (wallSeconds > 0 ? followed / wallSeconds : 0.0);
+    if (promoteMilliseconds >= 0) {
+        out << ",\n  \"promote_ms\": " << setprecision(3) << promoteMilliseconds;
+    }
+    out << "\n}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+int runStandby(Garage& site, int pollMilliseconds, istream& in, ostream& out) {
+    StandbyReplica replica(site, pollMilliseconds);
+    string error;
+    if (!replica.start(error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    OccupancySummary started = computeOccupancy(site);
+    out << "Standby of " << site.name << " following " << garageFilePath(site, "events.log") << ": "
+        << started.occupiedSpots << " of " << started.totalSpots << " spots occupied\n";
+
+    string line;
+    while (getline(in, line)) {
+        istringstream words(line);
+        string command;
+        words >> command;
+        if (command.empty()) {
+            continue;
+        }
+        if (command == "status") {
+            replica.writeStatus(out);
+        }
+        else if (command == "occupancy") {
+            OccupancySummary occupancy = computeOccupancy(site); // From a read view; the follower is not held up
+            out << "Occupied spots: " << occupancy.occupiedSpots << " of " << occupancy.totalSpots << "\n";
+            for (const auto& type : occupancy.byParkingType) {
+                out << "  " << type.first << ": " << type.second.first << " of " << type.second.second << "\n";
+            }
+        }
+        else if (command == "query") {
+            string text;
+            getline(words >> ws, text);
+            Query query;
+            if (!parseQuery(text, query, error)) {
+                out << "Invalid query: " << error << "\n";
+                continue;
+            }
+            lock_guard<mutex> lock(site.mutex); // Queries read the site itself
+            writeQueryResult(out, query, runQuery(site, query, time(nullptr)));
+        }
+        else if (command == "promote") {
+            if (!replica.promote(error)) {
+                cerr << "Error: promotion failed: " << error << "\n";
+                return 1;
+            }
+            replica.writeStatus(out);
+            out << "Promoted " << site.name << " to primary\n";
+            return standbyPromoted;
+        }
+        else if (command == "quit") {
+            break;
+        }
+        else {
+            out << "Commands: status, occupancy, query <query>, promote, quit\n";
+        }
+    }
+    replica.stop();
+    replica.writeStatus(out);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "History.h"
+
+struct Garage;
+
+// Exit code of runStandby() when the standby was promoted and the menus should take over its site.
+const int standbyPromoted = 100;
+
+// A standby copy of a site kept current from the primary's event log. The primary already writes
+// and flushes every committed change to events.log before it moves on, so the log is what is
+// shipped: a thread of the standby checks it every pollMilliseconds and applies the lines appended
+// since, holding the site's mutex only while it applies them. Readers of the copy use read views
+// and never wait for it. Promotion applies what is left of the log and makes the copy the live
+// site without loading anything again.
+class StandbyReplica {
+public:
+    StandbyReplica(Garage& site, int pollMilliseconds);
+    ~StandbyReplica();
+
+    StandbyReplica(const StandbyReplica&) = delete;
+    StandbyReplica& operator=(const StandbyReplica&) = delete;
+
+    // Restores the site from its history and starts following the log. Returns false and sets
+    // error if the site has no history.
+    bool start(std::string& error);
+
+    // Stops following. The copy keeps what was applied so far.
+    void stop();
+
+    // Applies the rest of the log, then opens the site's event log for writing, saves the site's
+    // files from the copy and drops the indexes the primary keeps, so they are rebuilt on first use.
+    // Only promote once the primary has stopped writing the log.
+    bool promote(std::string& error);
+
+    // Replication lag and apply throughput so far, as JSON.
+    void writeStatus(std::ostream& out) const;
+
+private:
+    void follow();
+    size_t applyPending(); // Called with the site's mutex not held
+
+    Garage& site;
+    LogFollower follower;
+    int pollMilliseconds;
+    std::thread thread;
+    mutable std::mutex stateMutex; // Guards stopping and the counters below
+    std::condition_variable wakeUp;
+    bool stopping = false;
+    std::vector<double> lagSamples; // Nanoseconds from the log being written to its events being applied; the last maxSamples batches
+    std::vector<double> applySamples; // Nanoseconds to apply each batch, likewise
+    uint64_t batches = 0;
+    double applySeconds = 0;
+    uint64_t appliedAtStart = 0;
+    std::chrono::steady_clock::time_point startedAt;
+    double promoteMilliseconds = -1;
+};
+
+// Runs a standby of site until stdin closes or asks it to stop. Reads one command per line:
+// status, occupancy, query <query text>, promote or quit. Returns standbyPromoted after a
+// promotion, otherwise the process exit code.
+int runStandby(Garage& site, int pollMilliseconds, std::istream& in, std::ostream& out);
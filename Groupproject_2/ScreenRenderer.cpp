@@ -0,0 +1,155 @@
+#include "ScreenRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <conio.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Unchanged cells shorter than this between two changed ones are rewritten rather than skipped,
+// since a cursor move costs about as many bytes.
+static const int minimumSkip = 8;
+
+ScreenRenderer::ScreenRenderer(int width, int rows) : columns(max(width, 1)) {
+    current.assign(static_cast<size_t>(columns) * rows, ' ');
+    previous.assign(current.size(), ' ');
+    output.reserve(current.size() * 2);
+}
+
+void ScreenRenderer::ensureRows(int count) {
+    size_t cells = static_cast<size_t>(columns) * count;
+    if (cells > current.size()) {
+        current.resize(cells, ' ');
+        previous.resize(cells, ' ');
+    }
+}
+
+void ScreenRenderer::beginFrame() {
+    fill(current.begin(), current.end(), ' ');
+    usedRows = 0;
+    cursorRow = 0;
+    cursorColumn = 0;
+}
+
+void ScreenRenderer::moveTo(int row, int column) {
+    cursorRow = max(row, 0);
+    cursorColumn = max(column, 0);
+}
+
+void ScreenRenderer::write(string_view text) {
+    ensureRows(cursorRow + 1);
+    usedRows = max(usedRows, cursorRow + 1);
+    char* line = &current[static_cast<size_t>(cursorRow) * columns];
+    for (char c : text) {
+        if (cursorColumn >= columns) break;
+        line[cursorColumn++] = c;
+    }
+}
+
+void ScreenRenderer::padTo(int column) {
+    cursorColumn = max(cursorColumn, min(column, columns));
+}
+
+// Appends the escape sequence that puts the terminal cursor at a 0-based row and column.
+static void appendCursorMove(string& output, int row, int column) {
+    output += "\x1b[";
+    output += to_string(row + 1);
+    output += ';';
+    output += to_string(column + 1);
+    output += 'H';
+}
+
+size_t ScreenRenderer::present() {
+    output.clear();
+    int rows = max(usedRows, shownRows); // Rows the previous frame showed below this one are blanked
+    if (fullRedraw) {
+        output += "\x1b[H\x1b[2J";
+    }
+    for (int row = 0; row < rows; ++row) {
+        const char* now = &current[static_cast<size_t>(row) * columns];
+        const char* before = &previous[static_cast<size_t>(row) * columns];
+        int column = 0;
+        while (column < columns) {
+            if (!fullRedraw && now[column] == before[column]) {
+                ++column;
+                continue;
+            }
+            // Extend the run over changed cells and over short stretches of unchanged ones
+            int runEnd = column + 1;
+            int lastChanged = column;
+            while (runEnd < columns && (fullRedraw || runEnd - lastChanged < minimumSkip)) {
+                if (fullRedraw || now[runEnd] != before[runEnd]) {
+                    lastChanged = runEnd;
+                }
+                ++runEnd;
+            }
+            if (fullRedraw) {
+                while (lastChanged > column && now[lastChanged] == ' ') --lastChanged; // Screen is already blank
+                if (now[lastChanged] == ' ') break;
+            }
+            appendCursorMove(output, row, column);
+            output.append(now + column, now + lastChanged + 1);
+            column = lastChanged + 1;
+        }
+    }
+    appendCursorMove(output, usedRows, 0); // Leave the cursor below the frame
+    fullRedraw = false;
+    shownRows = usedRows;
+    swap(current, previous);
+    writeToTerminal(output);
+    return output.size();
+}
+
+bool enableAnsiTerminal() {
+#ifdef _WIN32
+    static int enabled = -1;
+    if (enabled < 0) {
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        enabled = console != INVALID_HANDLE_VALUE && GetConsoleMode(console, &mode) &&
+            SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING) ? 1 : 0;
+    }
+    return enabled == 1;
+#else
+    return true;
+#endif
+}
+
+void writeToTerminal(const string& bytes) {
+    cout.flush();
+    size_t written = 0;
+    while (written < bytes.size()) {
+#ifdef _WIN32
+        int result = _write(1, bytes.data() + written, static_cast<unsigned int>(bytes.size() - written));
+#else
+        ssize_t result = ::write(1, bytes.data() + written, bytes.size() - written);
+#endif
+        if (result <= 0) break;
+        written += static_cast<size_t>(result);
+    }
+}
+
+bool waitForInput(int timeoutMs) {
+#ifdef _WIN32
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    do {
+        if (_kbhit()) return true;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    } while (chrono::steady_clock::now() < deadline);
+    return false;
+#else
+    pollfd input{ 0, POLLIN, 0 };
+    return poll(&input, 1, timeoutMs) > 0;
+#endif
+}
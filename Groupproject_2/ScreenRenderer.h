@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Character grid that is drawn into once per frame and sent to the terminal as the difference from
+// the previous frame: ANSI cursor moves and the changed characters only, in a single write.
+// Storage is kept between frames, so steady-state frames do not allocate.
+class ScreenRenderer {
+public:
+    explicit ScreenRenderer(int width = 100, int rows = 50);
+
+    // Starts a new frame with every cell blank.
+    void beginFrame();
+
+    // Moves the drawing cursor. Rows and columns count from 0.
+    void moveTo(int row, int column);
+
+    // Draws text at the drawing cursor and advances it. Text past the right edge is clipped.
+    void write(std::string_view text);
+
+    // Moves the drawing cursor right to the column, leaving blanks behind it. Used to pad fields.
+    void padTo(int column);
+
+    int row() const { return cursorRow; }
+    int column() const { return cursorColumn; }
+
+    // Sends the frame to the terminal and keeps it as the base for the next diff.
+    // Returns the number of bytes written.
+    size_t present();
+
+    // Makes the next present() redraw every cell, e.g. after something else wrote to the screen.
+    void invalidate() { fullRedraw = true; }
+
+    int width() const { return columns; }
+
+private:
+    void ensureRows(int count);
+
+    int columns;
+    int usedRows = 0; // Rows drawn into this frame
+    int shownRows = 0; // Rows shown by the previous frame
+    int cursorRow = 0;
+    int cursorColumn = 0;
+    bool fullRedraw = true;
+    std::vector<char> current;
+    std::vector<char> previous;
+    std::string output;
+};
+
+// Turns on ANSI escape sequence handling where the console needs it (Windows 10 and later).
+// Returns false if the terminal cannot interpret them.
+bool enableAnsiTerminal();
+
+// Writes the bytes to standard output with one system call, after flushing cout.
+void writeToTerminal(const std::string& bytes);
+
+// Waits up to timeoutMs for a line of keyboard input. Returns true if input is waiting.
+bool waitForInput(int timeoutMs);
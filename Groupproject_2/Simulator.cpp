@@ -0,0 +1,328 @@
+#include "Simulator.h"
+#include "Parking.h"
+#include "Benchmark.h"
+#include "Dashboard.h"
+#include "CustomerQuery.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+// One pending arrival, departure or occupancy sample, ordered by simulated time.
+struct SimulationEvent {
+    enum Kind { Arrival, Departure, Sample, HourEnd };
+
+    double time; // Seconds since the start of the simulation
+    long long sequence; // Keeps events at the same time in the order they were scheduled
+    Kind kind;
+    int gate; // Entrance of an arrival, exit of a departure
+    string plateNumber;
+
+    bool operator>(const SimulationEvent& other) const {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+    }
+};
+
+// One point of the occupancy time series.
+struct OccupancySample {
+    int minute;
+    int occupied;
+    int parked; // Cars that arrived during the simulation and have not left yet
+    long long rejected; // Rejections so far
+};
+
+static double elapsedNs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+static void writeLatency(ostream& out, bool last, const string& operation, const TimingStats& stats) {
+    out << "    {\"operation\": \"" << operation << "\", \"count\": " << stats.count
+        << ", \"mean_ns\": " << stats.mean << ", \"p50_ns\": " << stats.p50 << ", \"p99_ns\": " << stats.p99
+        << ", \"max_ns\": " << stats.max << "}" << (last ? "\n" : ",\n");
+}
+
+int runSimulation(Garage& site, const SimulationOptions& options, ostream& report) {
+    // The data files record entrance and exit numbers 1 and 2
+    if (options.hours <= 0 || options.arrivalsPerHour.empty() || options.arrivalsPerHour.size() > 2 ||
+        options.exitGates < 1 || options.exitGates > 2 || options.meanDwellMinutes <= 0 ||
+        options.dwellSpread < 0 || options.speed < 0 || options.sampleMinutes <= 0 || options.readers < 0) {
+        cerr << "Error: invalid simulation options\n";
+        return 1;
+    }
+    for (double rate : options.arrivalsPerHour) {
+        if (rate < 0) {
+            cerr << "Error: arrival rates must not be negative\n";
+            return 1;
+        }
+    }
+
+    // Vehicle types drivers arrive with and their share of the traffic
+    map<string, set<string>> parkingTypes = ConfigView(site)->parkingTypes;
+    vector<pair<string, double>> mix = options.vehicleMix;
+    if (mix.empty()) {
+        set<string> vehicleTypes;
+        for (const auto& type : parkingTypes) {
+            vehicleTypes.insert(type.second.begin(), type.second.end());
+        }
+        for (const auto& vehicle : vehicleTypes) {
+            mix.emplace_back(vehicle, 1.0);
+        }
+    }
+    vector<double> weights;
+    for (const auto& vehicle : mix) {
+        bool known = false;
+        for (const auto& type : parkingTypes) {
+            known = known || type.second.count(vehicle.first) > 0;
+        }
+        if (!known) {
+            cerr << "Error: unknown vehicle type " << vehicle.first << " in vehicle mix\n";
+            return 1;
+        }
+        weights.push_back(vehicle.second);
+    }
+    if (weights.empty()) {
+        cerr << "Error: no vehicle types are defined\n";
+        return 1;
+    }
+
+    mt19937 random(options.seed);
+    discrete_distribution<size_t> vehicleChoice(weights.begin(), weights.end());
+    double logMean = log(options.meanDwellMinutes * 60) - options.dwellSpread * options.dwellSpread / 2;
+    lognormal_distribution<double> dwellSeconds(logMean, options.dwellSpread);
+    uniform_int_distribution<int> exitChoice(1, options.exitGates);
+    vector<exponential_distribution<double>> interArrival;
+    for (double rate : options.arrivalsPerHour) {
+        interArrival.emplace_back(rate > 0 ? rate / 3600.0 : 1.0);
+    }
+
+    priority_queue<SimulationEvent, vector<SimulationEvent>, greater<SimulationEvent>> events;
+    long long sequence = 0;
+    double duration = options.hours * 3600;
+    time_t startTime = time(nullptr);
+
+    for (size_t entrance = 0; entrance < options.arrivalsPerHour.size(); ++entrance) {
+        if (options.arrivalsPerHour[entrance] > 0) {
+            events.push(SimulationEvent{ interArrival[entrance](random), sequence++, SimulationEvent::Arrival, static_cast<int>(entrance + 1), "" });
+        }
+    }
+    for (double sample = 0; sample <= duration; sample += options.sampleMinutes * 60.0) {
+        events.push(SimulationEvent{ sample, sequence++, SimulationEvent::Sample, 0, "" });
+    }
+    // Hour boundaries of the clock, where the occupancy forecast for the hour ahead is checked
+    for (time_t boundary = (startTime / 3600 + 1) * 3600; boundary - startTime <= duration; boundary += 3600) {
+        events.push(SimulationEvent{ static_cast<double>(boundary - startTime), sequence++, SimulationEvent::HourEnd, 0, "" });
+    }
+    int occupied = 0;
+    int totalSpots = 0;
+    for (const auto& floor : site.floors) {
+        for (const auto& spot : floor.spots) {
+            if (spot.type.empty()) continue; // Deleted spot
+            ++totalSpots;
+            if (spot.isOccupied) {
+                ++occupied;
+                if (!spot.plateNumber.empty()) {
+                    events.push(SimulationEvent{ dwellSeconds(random), sequence++, SimulationEvent::Departure, exitChoice(random), spot.plateNumber });
+                }
+            }
+        }
+    }
+
+    long long arrivals = 0, rented = 0, rejected = 0, departures = 0, plateCounter = 0;
+    int parked = 0;
+    double revenue = 0;
+    long long ledgerCentsBefore = site.ledger.lifetime().cents; // The ledger should take exactly the payments made here
+    vector<double> searchSamples, rentSamples, settleSamples, overstaySamples;
+    vector<OccupancySample> samples;
+    double predictedOccupied = -1; // Forecast made at the last hour boundary for the next one
+    int occupiedAtPrediction = 0;
+    int forecastsChecked = 0;
+    double forecastError = 0, naiveError = 0; // Absolute errors of the forecast and of "no change"
+    auto wallStart = chrono::steady_clock::now();
+
+    ScreenRenderer renderer;
+    auto lastFrame = wallStart;
+    bool dashboard = options.dashboard && enableAnsiTerminal();
+    const int dashboardRows = 40;
+    // Redraws the dashboard after an occupancy change unless a frame was shown very recently
+    auto showChange = [&](time_t now, bool force) {
+        auto wallNow = chrono::steady_clock::now();
+        if (dashboard && (force || wallNow - lastFrame >= chrono::milliseconds(33))) {
+            drawDashboard(renderer, site, now, dashboardRows);
+            renderer.present();
+            lastFrame = wallNow;
+        }
+    };
+
+    // Reports over the whole site that run next to the gates: occupancy by type, then every
+    // customer sorted by fee. They read views and never take the site's mutex.
+    atomic<bool> stopReaders{ false };
+    atomic<long long> readerReports{ 0 };
+    vector<thread> readers;
+    for (int i = 0; i < options.readers; ++i) {
+        readers.emplace_back([&site, &stopReaders, &readerReports] {
+            CustomerQuery query;
+            query.sortKey = CustomerSortKey::Fee;
+            query.detailed = false;
+            query.pageSize = 1000;
+            ostream discard(nullptr);
+            while (!stopReaders.load()) {
+                computeOccupancy(site);
+                CustomerCursor cursor(site, query, time(nullptr));
+                cursor.nextPage(discard);
+                ++readerReports;
+            }
+        });
+    }
+
+    while (!events.empty() && events.top().time <= duration) {
+        SimulationEvent event = events.top();
+        events.pop();
+        if (options.speed > 0) {
+            this_thread::sleep_until(wallStart + chrono::duration_cast<chrono::steady_clock::duration>(
+                chrono::duration<double>(event.time / options.speed)));
+        }
+        time_t now = startTime + static_cast<time_t>(event.time);
+        lock_guard<mutex> lock(site.mutex);
+
+        if (event.kind == SimulationEvent::Arrival) {
+            ++arrivals;
+            int entrance = event.gate;
+            events.push(SimulationEvent{ event.time + interArrival[entrance - 1](random), sequence++, SimulationEvent::Arrival, entrance, "" });
+
+            const string& vehicleType = mix[vehicleChoice(random)].first;
+            string plateNumber = "SIM" + to_string(plateCounter++);
+            RentResult result;
+            if (options.nearestSpot) {
+                SpotRef spot;
+                auto start = chrono::steady_clock::now();
+                result = rentNearestSpot(site, plateNumber, vehicleType, entrance, now, spot);
+                rentSamples.push_back(elapsedNs(start));
+            }
+            else {
+                auto start = chrono::steady_clock::now();
+                vector<SpotRef> available = findAvailableSpots(site, vehicleType);
+                searchSamples.push_back(elapsedNs(start));
+                if (available.empty()) {
+                    ++rejected; // Lot is full for this vehicle type, the driver turns away
+                    continue;
+                }
+
+                SpotRef spot = available[uniform_int_distribution<size_t>(0, available.size() - 1)(random)];
+                start = chrono::steady_clock::now();
+                result = rentSpot(site, spot, plateNumber, vehicleType, entrance, now);
+                rentSamples.push_back(elapsedNs(start));
+            }
+            if (result != RentResult::Rented) {
+                ++rejected;
+                continue;
+            }
+            if (options.persist) {
+                saveGarage(site);
+            }
+            ++rented;
+            ++occupied;
+            ++parked;
+            events.push(SimulationEvent{ event.time + dwellSeconds(random), sequence++, SimulationEvent::Departure, exitChoice(random), plateNumber });
+            showChange(now, false);
+        }
+        else if (event.kind == SimulationEvent::Departure) {
+            double payment = 0;
+            auto start = chrono::steady_clock::now();
+            bool settled = settleCustomer(site, event.plateNumber, event.gate, now, payment);
+            settleSamples.push_back(elapsedNs(start));
+            if (!settled) {
+                releaseSpot(site, event.plateNumber, now); // A parked car without a customer record
+            }
+            if (options.persist) {
+                saveGarage(site);
+            }
+            ++departures;
+            --occupied;
+            if (event.plateNumber.compare(0, 3, "SIM") == 0) {
+                --parked;
+            }
+            revenue += payment;
+            showChange(now, false);
+        }
+        else if (event.kind == SimulationEvent::HourEnd) {
+            if (predictedOccupied >= 0) {
+                forecastError += fabs(predictedOccupied - occupied);
+                naiveError += abs(occupiedAtPrediction - occupied);
+                ++forecastsChecked;
+            }
+            vector<ForecastHour> expected = site.forecaster.forecast(site, "", "", now, 1);
+            predictedOccupied = expected.empty() ? -1 : expected[0].occupied;
+            occupiedAtPrediction = occupied;
+        }
+        else {
+            samples.push_back(OccupancySample{ static_cast<int>(event.time / 60), occupied, parked, rejected });
+            auto start = chrono::steady_clock::now();
+            site.overstays.poll(site, now); // Fires the stay limits passed since the last sample
+            site.overstays.takeAlerts();
+            overstaySamples.push_back(elapsedNs(start));
+        }
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    stopReaders = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    showChange(startTime + static_cast<time_t>(duration), true);
+
+    int liveOccupied = 0;
+    for (const auto& floor : site.floors) {
+        for (const auto& spot : floor.spots) {
+            liveOccupied += spot.isOccupied && !spot.type.empty() ? 1 : 0;
+        }
+    }
+    bool viewMatches = computeOccupancy(site).occupiedSpots == liveOccupied;
+
+    cerr << "Simulated " << options.hours << " h: " << arrivals << " arrivals, " << rented << " rented, "
+        << rejected << " rejected, " << departures << " departures in " << fixed << setprecision(2) << wallSeconds << " s\n";
+
+    report << fixed << setprecision(1);
+    report << "{\n  \"simulation\": \"parking\",\n  \"seed\": " << options.seed
+        << ",\n  \"simulated_hours\": " << options.hours << ",\n  \"total_spots\": " << totalSpots
+        << ",\n  \"arrivals_per_hour\": [";
+    for (size_t i = 0; i < options.arrivalsPerHour.size(); ++i) {
+        report << (i > 0 ? ", " : "") << options.arrivalsPerHour[i];
+    }
+    report << "],\n  \"mean_dwell_minutes\": " << options.meanDwellMinutes
+        << ",\n  \"arrivals\": " << arrivals << ",\n  \"rented\": " << rented << ",\n  \"rejected\": " << rejected
+        << ",\n  \"rejection_rate\": " << setprecision(4) << (arrivals > 0 ? static_cast<double>(rejected) / arrivals : 0.0)
+        << ",\n  \"departures\": " << departures << ",\n  \"revenue\": " << setprecision(2) << revenue
+        << ",\n  \"ledger_revenue\": " << (site.ledger.lifetime().cents - ledgerCentsBefore) / 100.0
+        << ",\n  \"wall_seconds\": " << setprecision(3) << wallSeconds
+        << ",\n  \"throughput_ops_per_sec\": " << setprecision(1) << (wallSeconds > 0 ? (rented + departures) / wallSeconds : 0.0)
+        << ",\n  \"throughput_per_simulated_hour\": " << (rented + departures) / options.hours
+        << ",\n  \"forecast_hours_checked\": " << forecastsChecked
+        << ",\n  \"forecast_mean_absolute_error\": " << (forecastsChecked > 0 ? forecastError / forecastsChecked : 0.0)
+        << ",\n  \"no_change_mean_absolute_error\": " << (forecastsChecked > 0 ? naiveError / forecastsChecked : 0.0)
+        << ",\n  \"reader_threads\": " << options.readers << ",\n  \"reader_reports\": " << readerReports.load()
+        << ",\n  \"versions_published\": " << site.views.versionsPublished()
+        << ",\n  \"config_reloads\": " << configReloads()
+        << ",\n  \"overstay_alerts\": " << site.overstays.alertsFired()
+        << ",\n  \"overstays_at_end\": " << site.overstays.current(site, startTime + static_cast<time_t>(duration)).size()
+        << ",\n  \"view_matches_site\": " << (viewMatches ? "true" : "false")
+        << ",\n  \"latency\": [\n";
+    writeLatency(report, false, "searchAvailableSpots", summarizeTimings(searchSamples));
+    writeLatency(report, false, options.nearestSpot ? "assignNearestSpot" : "rentParkingSpot", summarizeTimings(rentSamples));
+    writeLatency(report, false, "settleParkingFee", summarizeTimings(settleSamples));
+    writeLatency(report, true, "pollOverstays", summarizeTimings(overstaySamples));
+    report << "  ],\n  \"occupancy\": [";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const OccupancySample& sample = samples[i];
+        report << (i == 0 ? "\n" : ",\n") << "    {\"minute\": " << sample.minute << ", \"occupied\": " << sample.occupied
+            << ", \"rate\": " << setprecision(4) << (totalSpots > 0 ? static_cast<double>(sample.occupied) / totalSpots : 0.0)
+            << ", \"simulated_cars\": " << sample.parked << ", \"rejected\": " << sample.rejected << "}";
+    }
+    report << "\n  ]\n}\n";
+    return 0;
+}
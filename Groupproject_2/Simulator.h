@@ -0,0 +1,36 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Garage;
+
+// Settings for a traffic simulation.
+struct SimulationOptions {
+    double hours = 4; // Simulated duration
+    std::vector<double> arrivalsPerHour = { 300, 300 }; // Mean Poisson arrival rate at each entrance
+    std::vector<std::pair<std::string, double>> vehicleMix; // Vehicle type and relative weight; empty means every vehicle type equally
+    double meanDwellMinutes = 120; // Dwell times are log-normal with this mean
+    double dwellSpread = 0.6; // Standard deviation of the log of the dwell time
+    int exitGates = 2;
+    double speed = 0; // Simulated seconds per wall clock second; 0 runs at full speed
+    int sampleMinutes = 15; // Interval between occupancy samples
+    unsigned int seed = 1;
+    bool persist = false; // Save the site after every rent and settlement, as the kiosk does
+    bool nearestSpot = false; // Drivers are assigned the free spot nearest their entrance instead of a random one
+    bool dashboard = false; // Redraw the live dashboard on every occupancy change, at most 30 times a second
+    int readers = 0; // Threads that keep running whole-site reports on read views during the simulation
+};
+
+// Drives rentSpot() and settleCustomer() on the site with a discrete-event simulation of arrivals
+// and departures, using the simulated time as the engine's clock. Drivers that find no free spot
+// for their vehicle type leave and count as rejections. Cars already parked when the simulation
+// starts leave after a dwell time drawn from the same distribution.
+// Writes a JSON report with throughput, rejection rate, latencies and occupancy over time, and how
+// far the site's occupancy forecast for each coming hour was off, next to assuming no change.
+// With reader threads, it also reports how many whole-site reports they ran against read views
+// while rents and settlements were published, and whether the last view matches the site.
+// Returns the process exit code.
+int runSimulation(Garage& site, const SimulationOptions& options, std::ostream& report);
@@ -0,0 +1,179 @@
+#include "Parking.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+static const double defaultFloorCost = 1000; // Cost of going one floor further, in spots passed
+
+void SpotAllocator::setEntranceCost(int entrance, const string& floor, const EntranceCost& cost) {
+    entranceCosts[{ entrance, floor }] = cost;
+    built = false;
+}
+
+void SpotAllocator::clear() {
+    entranceCosts.clear();
+    for (int entrance = 0; entrance < entrances; ++entrance) {
+        floorCosts[entrance].clear();
+        freeSpots[entrance].clear();
+    }
+    built = false;
+}
+
+EntranceCost SpotAllocator::floorCost(const Garage& site, int entrance, FloorHandle floor) const {
+    auto configured = entranceCosts.find({ entrance + 1, site.floors.peek(floor).name });
+    if (configured != entranceCosts.end()) {
+        return configured->second;
+    }
+    return EntranceCost{ floor * defaultFloorCost, 1, entrance == 1 };
+}
+
+void SpotAllocator::rebuild(const Garage& site) {
+    TraceSpan span("rebuildSpotAllocator", site.name);
+    for (int entrance = 0; entrance < entrances; ++entrance) {
+        freeSpots[entrance].clear();
+        floorCosts[entrance].clear();
+        for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+            floorCosts[entrance].push_back(floorCost(site, entrance, floor));
+        }
+    }
+    built = true;
+
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        const FloorSpots& spots = site.floors[floor].spots;
+        for (size_t i = 0; i < spots.size(); ++i) {
+            if (!spots[i].isOccupied) {
+                spotFreed(site, SpotRef{ floor, static_cast<int>(i) });
+            }
+        }
+    }
+}
+
+bool SpotAllocator::freeSpot(const Garage& site, int entrance, SpotRef spot, FreeSpot& entry) const {
+    if (spot.floor < 0 || static_cast<size_t>(spot.floor) >= floorCosts[entrance].size()) {
+        return false; // Floor added since the index was built
+    }
+    const EntranceCost& cost = floorCosts[entrance][spot.floor];
+    int spotCount = static_cast<int>(site.floors[spot.floor].spots.size());
+    int passed = cost.fromEnd ? spotCount - 1 - spot.index : spot.index;
+    entry = FreeSpot{ cost.floorCost + cost.spotCost * passed, spot.floor, spot.index };
+    return true;
+}
+
+void SpotAllocator::spotTaken(const Garage& site, SpotRef spot) {
+    const string& type = site.floors[spot.floor].spots[spot.index].type;
+    for (int entrance = 0; entrance < entrances; ++entrance) {
+        FreeSpot entry;
+        auto spots = freeSpots[entrance].find(type);
+        if (spots != freeSpots[entrance].end() && freeSpot(site, entrance, spot, entry)) {
+            spots->second.erase(entry);
+        }
+    }
+}
+
+void SpotAllocator::spotFreed(const Garage& site, SpotRef spot) {
+    const string& type = site.floors[spot.floor].spots[spot.index].type;
+    if (type.empty()) {
+        return; // Deleted spot
+    }
+    for (int entrance = 0; entrance < entrances; ++entrance) {
+        FreeSpot entry;
+        if (!freeSpot(site, entrance, spot, entry)) {
+            built = false;
+            return;
+        }
+        freeSpots[entrance][type].insert(entry);
+    }
+}
+
+SpotRef SpotAllocator::nearest(const SiteConfig& config, const string& vehicleType, int entrance) const {
+    SpotRef best{ invalidFloor, -1 };
+    if (entrance < 1 || entrance > entrances) {
+        return best;
+    }
+    const FreeSpot* bestEntry = nullptr;
+    for (const auto& type : config.parkingTypes) {
+        if (type.second.find(vehicleType) == type.second.end()) continue;
+        auto spots = freeSpots[entrance - 1].find(type.first);
+        if (spots == freeSpots[entrance - 1].end() || spots->second.empty()) continue;
+        const FreeSpot& candidate = *spots->second.begin();
+        if (bestEntry == nullptr || candidate < *bestEntry) {
+            bestEntry = &candidate;
+        }
+    }
+    if (bestEntry != nullptr) {
+        best = SpotRef{ bestEntry->floor, bestEntry->index };
+    }
+    return best;
+}
+
+SpotRef SpotAllocator::nearestOnDemand(Garage& site, const string& vehicleType, int entrance) const {
+    TraceSpan span("nearestOnDemand", site.name);
+    SpotRef best{ invalidFloor, -1 };
+    if (entrance < 1 || entrance > entrances) {
+        return best;
+    }
+
+    // The cheapest a spot of each floor can be is the cost of reaching the floor, unless spots
+    // further along are cheaper
+    ConfigView config(site);
+    vector<pair<double, FloorHandle>> candidates;
+    vector<EntranceCost> costs;
+    for (FloorHandle floor = 0; floor < site.floors.size(); ++floor) {
+        costs.push_back(floorCost(site, entrance - 1, floor));
+        const Floor& entry = site.floors.peek(floor);
+        if (entry.loaded || entry.counts.hasFreeSpot(*config, vehicleType)) {
+            double lowest = costs.back().spotCost >= 0 ? costs.back().floorCost : -numeric_limits<double>::infinity();
+            candidates.emplace_back(lowest, floor);
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+
+    const FloorRegistry& floors = site.floors; // Searching does not change a floor
+    FreeSpot bestEntry{ 0, invalidFloor, -1 };
+    bool bestLoadedHere = false; // The best floor so far was loaded by this search
+    for (const auto& candidate : candidates) {
+        FloorHandle floor = candidate.second;
+        if (bestEntry.floor != invalidFloor && bestEntry < FreeSpot{ candidate.first, floor, -1 }) {
+            break; // No spot of this floor or any later one is nearer
+        }
+        bool wasLoaded = floors.isLoaded(floor);
+        const FloorSpots& spots = floors[floor].spots;
+        const EntranceCost& cost = costs[floor];
+        bool improved = false;
+        int spotCount = static_cast<int>(spots.size());
+        for (int i = 0; i < spotCount; ++i) {
+            const ParkingSpot& spot = spots[i];
+            if (spot.isOccupied || spot.type.empty() || !config->acceptsVehicle(spot.type, vehicleType)) continue;
+            int passed = cost.fromEnd ? spotCount - 1 - i : i;
+            FreeSpot entry{ cost.floorCost + cost.spotCost * passed, floor, i };
+            if (bestEntry.floor == invalidFloor || entry < bestEntry) {
+                bestEntry = entry;
+                improved = true;
+            }
+        }
+        if (improved) {
+            if (bestLoadedHere && best.floor != floor) {
+                site.floors.unload(best.floor);
+            }
+            best = SpotRef{ bestEntry.floor, bestEntry.index };
+            bestLoadedHere = !wasLoaded;
+        }
+        else if (!wasLoaded) {
+            site.floors.unload(floor);
+        }
+    }
+    return best;
+}
+
+size_t SpotAllocator::indexedEntries() const {
+    size_t count = 0;
+    for (int entrance = 0; entrance < entrances; ++entrance) {
+        for (const auto& type : freeSpots[entrance]) {
+            count += type.second.size();
+        }
+    }
+    return count;
+}
@@ -0,0 +1,205 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> tracingEnabled{ false };
+
+// One finished span as buffered by the thread that ran it.
+struct SpanRecord {
+    const char* name;
+    char detail[48];
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// Single-producer, single-consumer ring of one thread's spans. The owning thread only moves head and
+// the trace writer only moves tail, so neither side takes a lock. Spans are dropped when it is full.
+struct SpanRing {
+    static const uint64_t capacity = 8192;
+
+    SpanRecord records[capacity];
+    atomic<uint64_t> head{ 0 };
+    atomic<uint64_t> tail{ 0 };
+    atomic<uint64_t> dropped{ 0 };
+    int threadId = 0;
+};
+
+// Rings are registered on a thread's first span and never freed, so spans of threads that have
+// exited are still written.
+static mutex registryMutex;
+static vector<SpanRing*> registry;
+
+// State of the trace writer.
+static mutex writerMutex;
+static condition_variable writerWakeUp;
+static thread writerThread;
+static bool writerStopping = false;
+static ofstream traceFile;
+static uint64_t traceStartNs = 0;
+static uint64_t spansWritten = 0;
+
+uint64_t traceClock() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Copies text into a fixed-size buffer, truncating it if needed.
+static void copyDetail(char (&buffer)[48], const char* text) {
+    size_t length = strlen(text);
+    if (length > sizeof(buffer) - 1) length = sizeof(buffer) - 1;
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+}
+
+static SpanRing& threadRing() {
+    thread_local SpanRing* local = [] {
+        SpanRing* ring = new SpanRing();
+        lock_guard<mutex> lock(registryMutex);
+        ring->threadId = static_cast<int>(registry.size()) + 1;
+        registry.push_back(ring);
+        return ring;
+    }();
+    return *local;
+}
+
+void recordSpan(const char* name, const char* detail, uint64_t startNs, uint64_t endNs) {
+    SpanRing& ring = threadRing();
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    if (head - ring.tail.load(memory_order_acquire) >= SpanRing::capacity) {
+        ring.dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    SpanRecord& record = ring.records[head % SpanRing::capacity];
+    record.name = name;
+    copyDetail(record.detail, detail);
+    record.startNs = startNs;
+    record.endNs = endNs;
+    ring.head.store(head + 1, memory_order_release);
+}
+
+void TraceSpan::begin(const char* text) {
+    copyDetail(detail, text);
+    startNs = traceClock();
+}
+
+void TraceSpan::end() {
+    recordSpan(name, detail, startNs, traceClock());
+}
+
+// Writes a string as a JSON string literal.
+static void writeJsonString(ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        }
+        else if (static_cast<unsigned char>(*c) >= 0x20) {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+// Moves every buffered span into the trace file. Called with writerMutex held.
+static void drainRings() {
+    vector<SpanRing*> rings;
+    {
+        lock_guard<mutex> lock(registryMutex);
+        rings = registry;
+    }
+    for (SpanRing* ring : rings) {
+        uint64_t tail = ring->tail.load(memory_order_relaxed);
+        uint64_t head = ring->head.load(memory_order_acquire);
+        for (; tail < head; ++tail) {
+            const SpanRecord& record = ring->records[tail % SpanRing::capacity];
+            if (record.startNs < traceStartNs) continue; // Finished after tracing was turned off and on again
+            traceFile << (spansWritten++ == 0 ? "\n" : ",\n") << "{\"name\":";
+            writeJsonString(traceFile, record.name);
+            traceFile << ",\"cat\":\"parking\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId
+                << ",\"ts\":" << (record.startNs - traceStartNs) / 1000.0
+                << ",\"dur\":" << (record.endNs - record.startNs) / 1000.0;
+            if (record.detail[0] != '\0') {
+                traceFile << ",\"args\":{\"detail\":";
+                writeJsonString(traceFile, record.detail);
+                traceFile << "}";
+            }
+            traceFile << "}";
+        }
+        ring->tail.store(head, memory_order_release);
+    }
+}
+
+bool startTracing(const string& path) {
+    lock_guard<mutex> lock(writerMutex);
+    if (writerThread.joinable()) {
+        return false;
+    }
+    traceFile.open(path);
+    if (!traceFile.is_open()) {
+        cerr << "Error: Unable to open " << path << " for writing\n";
+        return false;
+    }
+    traceFile << fixed << setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    traceStartNs = traceClock();
+    spansWritten = 0;
+    writerStopping = false;
+
+    // Spans buffered before this session started belong to no trace
+    {
+        lock_guard<mutex> registryLock(registryMutex);
+        for (SpanRing* ring : registry) {
+            ring->tail.store(ring->head.load(memory_order_acquire), memory_order_release);
+            ring->dropped.store(0, memory_order_relaxed);
+        }
+    }
+    tracingEnabled.store(true, memory_order_relaxed);
+
+    writerThread = thread([] {
+        unique_lock<mutex> lock(writerMutex);
+        while (!writerStopping) {
+            writerWakeUp.wait_for(lock, chrono::milliseconds(100));
+            drainRings();
+        }
+    });
+    return true;
+}
+
+uint64_t stopTracing() {
+    tracingEnabled.store(false, memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(writerMutex);
+        if (!writerThread.joinable()) {
+            return 0;
+        }
+        writerStopping = true;
+    }
+    writerWakeUp.notify_all();
+    writerThread.join();
+
+    lock_guard<mutex> lock(writerMutex);
+    drainRings(); // Spans that finished while the writer was stopping
+    traceFile << "\n]}\n";
+    traceFile.close();
+
+    uint64_t dropped = 0;
+    {
+        lock_guard<mutex> registryLock(registryMutex);
+        for (SpanRing* ring : registry) {
+            dropped += ring->dropped.load(memory_order_relaxed);
+        }
+    }
+    if (dropped > 0) {
+        cerr << "Warning: " << dropped << " trace spans were dropped because a buffer was full\n";
+    }
+    return spansWritten;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Spans in the Chrome trace event format, viewable in chrome://tracing or ui.perfetto.dev.
+// Each thread buffers its finished spans in its own lock-free ring; a writer thread drains the
+// rings into the trace file while tracing is on. When tracing is off a span costs one branch.
+
+extern std::atomic<bool> tracingEnabled;
+
+inline bool tracingOn() {
+    return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// Nanoseconds on the steady clock, the time base of every span.
+uint64_t traceClock();
+
+// Buffers one finished span. name must be a string literal; detail is copied (and truncated).
+void recordSpan(const char* name, const char* detail, uint64_t startNs, uint64_t endNs);
+
+// Opens the trace file and starts collecting spans. Returns false if tracing is already on or
+// the file cannot be opened.
+bool startTracing(const std::string& path);
+
+// Stops collecting, writes the remaining spans and closes the file. Returns the number of spans
+// written, and reports any spans dropped because a ring was full.
+uint64_t stopTracing();
+
+// Times the enclosing scope as one span.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(name) {
+        if (tracingOn()) begin("");
+    }
+    TraceSpan(const char* name, const char* detail) : name(name) {
+        if (tracingOn()) begin(detail);
+    }
+    TraceSpan(const char* name, const std::string& detail) : name(name) {
+        if (tracingOn()) begin(detail.c_str());
+    }
+    ~TraceSpan() {
+        if (startNs != 0) end();
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    void begin(const char* detail);
+    void end();
+
+    const char* name;
+    uint64_t startNs = 0;
+    char detail[48]; // Only filled in while tracing
+};
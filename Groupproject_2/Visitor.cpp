@@ -0,0 +1,42 @@
+#include "Visitor.h"
+
+using namespace std;
+
+void VisitorTable::touch(const string& plateNumber, time_t now) {
+    auto found = index.find(plateNumber);
+    if (found != index.end()) {
+        found->second->lastSeen = now;
+        order.splice(order.end(), order, found->second); // Most recently seen last
+    }
+    else {
+        order.push_back(Visitor{ plateNumber, now, now });
+        index.emplace(plateNumber, prev(order.end()));
+    }
+    evictIdle(now);
+    while (index.size() > capacity) {
+        evictOldest();
+    }
+}
+
+void VisitorTable::remove(const string& plateNumber) {
+    auto found = index.find(plateNumber);
+    if (found != index.end()) {
+        order.erase(found->second);
+        index.erase(found);
+    }
+}
+
+void VisitorTable::evictOldest() {
+    index.erase(order.front().plateNumber);
+    order.pop_front();
+    ++evictions;
+}
+
+size_t VisitorTable::evictIdle(time_t now) {
+    size_t count = 0;
+    while (!order.empty() && now - order.front().lastSeen > idleSeconds) {
+        evictOldest();
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// A plate typed at the kiosk that has not rented a spot.
+struct Visitor {
+    std::string plateNumber;
+    time_t firstSeen = 0;
+    time_t lastSeen = 0;
+};
+
+// Plates that logged in at the kiosk without renting. They are kept in memory only and never reach
+// customers.dat; a plate becomes a customer when it rents. Visitors are kept least recently seen
+// first, so a visitor idle for longer than idleSeconds is evicted by the next login, and the least
+// recently seen one is evicted when there are more than capacity, however many plates are typed.
+// Each login costs O(1) plus the visitors it evicts.
+class VisitorTable {
+public:
+    // Records a login of the plate at now, then evicts the visitors that have been idle too long.
+    void touch(const std::string& plateNumber, time_t now);
+
+    // Forgets the plate, which has rented and is a customer now.
+    void remove(const std::string& plateNumber);
+
+    // Evicts the visitors not seen for idleSeconds before now. Returns how many were evicted.
+    size_t evictIdle(time_t now);
+
+    bool contains(const std::string& plateNumber) const { return index.count(plateNumber) > 0; }
+    size_t size() const { return index.size(); }
+    uint64_t evicted() const { return evictions; }
+
+    // Visitors least recently seen first, and the hash buckets, for the memory report.
+    const std::list<Visitor>& visitors() const { return order; }
+    size_t bucketCount() const { return index.bucket_count(); }
+
+    size_t capacity = 10000;
+    time_t idleSeconds = 30 * 60;
+
+private:
+    void evictOldest();
+
+    std::list<Visitor> order; // Least recently seen first
+    std::unordered_map<std::string, std::list<Visitor>::iterator> index; // Plate -> its place in order
+    uint64_t evictions = 0;
+};